@@ -139,9 +139,69 @@ BmErr bcmp_init(NetworkDevice network_device) {
 
 void *bcmp_get_queue(void) { return CTX.queue; }
 
+/*!
+  @brief Send A Message Too Large For One Frame As Fragments
+
+  @details The header is serialized once and tagged with a message id and
+           the CRC of the whole message, each fragment carries a copy with
+           its frag_id and its own checksum. Fragments are sent back-to-back,
+           the receiver reassembles them by frag_id.
+
+  @param *dst destination ip
+  @param type message type
+  @param *data message buffer
+  @param size message length in bytes
+  @param seq_num The sequence number of the message
+  @param reply_cb A callback function to handle reply messages
+
+  @return BmOK on success
+  @return BmErr on failure
+*/
+static BmErr bcmp_tx_fragments(const BmIpAddr *dst, BcmpMessageType type,
+                               uint8_t *data, uint32_t size, uint32_t seq_num,
+                               BmErr (*reply_cb)(uint8_t *payload)) {
+  BcmpHeader header;
+  BmErr err = serialize_header(&header, data, type, seq_num, reply_cb);
+  if (err != BmOK) {
+    bm_debug("Could not properly serialize message\n");
+    return err;
+  }
+
+  serialize_message_id(&header, data, size);
+  header.frag_total = (size + bcmp_fragment_payload_len - 1) /
+                      bcmp_fragment_payload_len;
+  for (uint8_t i = 0; i < header.frag_total && err == BmOK; i++) {
+    const uint32_t offset = i * bcmp_fragment_payload_len;
+    const uint32_t len = size - offset < bcmp_fragment_payload_len
+                             ? size - offset
+                             : bcmp_fragment_payload_len;
+    void *buf = bm_ip_tx_new(dst, len + sizeof(BcmpHeader));
+    if (!buf) {
+      bm_debug("Could not allocate memory for bcmp fragment\n");
+      return BmENOMEM;
+    }
+
+    header.frag_id = i;
+    err = serialize_fragment(buf, &header, &data[offset], len);
+    if (err == BmOK) {
+      err = bm_ip_tx_perform(buf, NULL);
+      if (err != BmOK) {
+        bm_debug("Error sending BMCP fragment %u %d\n", i, err);
+      }
+    }
+
+    bm_ip_tx_cleanup(buf);
+  }
+
+  return err;
+}
+
 /*!
   @brief BCMP packet transmit function. Header and checksum added and computer within
 
+  @details Messages larger than one frame, up to bcmp_max_message_len, are
+           sent as fragments
+
   @param *dst destination ip
   @param type message type
   @param *data message buffer
@@ -158,7 +218,10 @@ BmErr bcmp_tx(const BmIpAddr *dst, BcmpMessageType type, uint8_t *data,
   BmErr err = BmEINVAL;
   void *buf = NULL;
 
-  if (dst && (uint32_t)size + sizeof(BcmpHeartbeat) <= max_payload_len) {
+  if (dst && size > bcmp_fragment_payload_len &&
+      size <= bcmp_max_message_len) {
+    err = bcmp_tx_fragments(dst, type, data, size, seq_num, reply_cb);
+  } else if (dst && size <= bcmp_fragment_payload_len) {
     buf = bm_ip_tx_new(dst, size + sizeof(BcmpHeader));
     if (buf) {
       err = serialize(buf, data, size, type, seq_num, reply_cb);
@@ -183,27 +246,22 @@ BmErr bcmp_tx(const BmIpAddr *dst, BcmpMessageType type, uint8_t *data,
 }
 
 /*!
-  @brief Forward the payload to all ports other than the ingress port.
-
-  @details See section 5.4.4.2 of the Bristlemouth spec for details.
+  @brief Forward One Frame To All Ports Other Than The Ingress Port
 
   @param header header message buffer to forward
   @param payload payload to be forwarded
-  @param size payload size
+  @param size payload size, at most one frame
   @param ingress_port Port on which the packet was received.
 
   @return BmOK on success
   @return BmErr on failure
 */
-BmErr bcmp_ll_forward(BcmpHeader *header, void *payload, uint32_t size,
-                      uint8_t ingress_port) {
-  if (!header || !payload) {
-    return BmEINVAL;
-  }
-
+static BmErr ll_forward_frame(BcmpHeader *header, void *payload, uint32_t size,
+                              uint8_t ingress_port) {
   // Forward out every port except the one the packet arrived on.
   uint8_t num_ports = CTX.num_ports;
   BmErr err = BmEINVAL;
+  bool checksum_ready = false;
   for (uint8_t egress_port = 1; egress_port <= num_ports; egress_port++) {
     if (egress_port == ingress_port) {
       continue;
@@ -215,11 +273,18 @@ BmErr bcmp_ll_forward(BcmpHeader *header, void *payload, uint32_t size,
     }
 
     // L2 will clear the egress port from the destination address, so calculate
-    // the checksum against the plain link-local multicast address.
-    header->checksum = 0;
-    bm_ip_tx_copy(forward, header, sizeof(BcmpHeader), 0);
-    bm_ip_tx_copy(forward, payload, size, sizeof(BcmpHeader));
-    header->checksum = packet_checksum(forward, size + sizeof(BcmpHeader));
+    // the checksum against the plain link-local multicast address. Every copy
+    // is identical until L2 adds the egress port and patches the checksum
+    // incrementally, so it is only computed for the first one.
+    if (!checksum_ready) {
+      header->checksum = 0;
+      bm_ip_tx_copy(forward, header, sizeof(BcmpHeader), 0);
+      bm_ip_tx_copy(forward, payload, size, sizeof(BcmpHeader));
+      header->checksum = packet_checksum(forward, size + sizeof(BcmpHeader));
+      checksum_ready = true;
+    } else {
+      bm_ip_tx_copy(forward, payload, size, sizeof(BcmpHeader));
+    }
     bm_ip_tx_copy(forward, header, sizeof(BcmpHeader), 0);
 
     uint8_t port_specific_dst[sizeof(multicast_ll_addr)];
@@ -244,3 +309,47 @@ BmErr bcmp_ll_forward(BcmpHeader *header, void *payload, uint32_t size,
 
   return err;
 }
+
+/*!
+  @brief Forward the payload to all ports other than the ingress port.
+
+  @details See section 5.4.4.2 of the Bristlemouth spec for details.
+           A reassembled message is forwarded as fragments again, keeping
+           the message id and CRC it arrived with.
+
+  @param header header message buffer to forward
+  @param payload payload to be forwarded
+  @param size payload size
+  @param ingress_port Port on which the packet was received.
+
+  @return BmOK on success
+  @return BmErr on failure
+*/
+BmErr bcmp_ll_forward(BcmpHeader *header, void *payload, uint32_t size,
+                      uint8_t ingress_port) {
+  if (!header || !payload) {
+    return BmEINVAL;
+  }
+
+  if (size <= bcmp_fragment_payload_len) {
+    return ll_forward_frame(header, payload, size, ingress_port);
+  }
+  if (size > bcmp_max_message_len) {
+    return BmEINVAL;
+  }
+
+  BmErr err = BmOK;
+  header->frag_total =
+      (size + bcmp_fragment_payload_len - 1) / bcmp_fragment_payload_len;
+  for (uint8_t i = 0; i < header->frag_total && err == BmOK; i++) {
+    const uint32_t offset = i * bcmp_fragment_payload_len;
+    const uint32_t len = size - offset < bcmp_fragment_payload_len
+                             ? size - offset
+                             : bcmp_fragment_payload_len;
+    header->frag_id = i;
+    err = ll_forward_frame(header, (uint8_t *)payload + offset, len,
+                           ingress_port);
+  }
+
+  return err;
+}
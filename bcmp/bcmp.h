@@ -6,7 +6,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-// FIXME: Remove when we can split payloads.
+// Largest BCMP frame, larger messages are sent as fragments (see packet.h)
 #define bcmp_max_payload_size_bytes (1500)
 #define ipv6_header_length (40)
 // 1500 MTU minus ipv6 header
@@ -10,11 +10,14 @@
 typedef struct {
   uint16_t type;
   uint16_t checksum;
+  // Fragmented messages carry the CRC-16 of the whole message, little endian,
+  // in flags and reserved. Unused otherwise.
   uint8_t flags;
   uint8_t reserved;
   uint32_t seq_num;
   uint8_t frag_total;
   uint8_t frag_id;
+  // Id of a fragmented message, unique per sender until it wraps
   uint8_t next_header;
 } __attribute__((packed)) BcmpHeader;
 
@@ -1,6 +1,7 @@
 #include "packet.h"
 #include "bm_config.h"
 #include "bm_os.h"
+#include "crc.h"
 #include "ll.h"
 #include <inttypes.h>
 #include <stdbool.h>
@@ -29,6 +30,21 @@ typedef struct BcmpRequestElement {
   BcmpSequencedRequestCb cb;
 } BcmpRequestElement;
 
+typedef struct {
+  uint8_t *buf;
+  BmIpAddr src;
+  uint16_t type;
+  uint32_t seq_num;
+  uint8_t frag_total;
+  uint8_t message_id;
+  uint16_t crc;
+  uint8_t received_count;
+  uint32_t received[(UINT8_MAX + 1) / 32];
+  // Known once the last fragment is in
+  uint32_t size;
+  uint32_t timestamp_ms;
+} BcmpReassembly;
+
 struct PacketInfo {
   struct {
     BcmpGetIPAddr src_ip;
@@ -41,6 +57,8 @@ struct PacketInfo {
   BmTimer timer;
   LL sequence_list;
   LL packet_list;
+  BcmpReassembly reassembly[bcmp_reassembly_slots];
+  BcmpReassemblyStats reassembly_stats;
 };
 
 static struct PacketInfo PACKET;
@@ -328,6 +346,153 @@ static BcmpRequestElement *sequence_list_find_message(uint32_t seq_num) {
   return element;
 }
 
+/*!
+ @brief CRC Of The Whole Message A Fragment Belongs To
+
+ @details Carried little endian in the flags and reserved bytes, which are
+          otherwise unused
+
+ @param header fragment header
+
+ @return CRC-16/CCITT of the reassembled message
+ */
+static uint16_t fragment_crc(const BcmpHeader *header) {
+  return (uint16_t)(header->flags | (header->reserved << 8));
+}
+
+/*!
+ @brief Find The Reassembly Slot Of A Fragment
+
+ @details Slots whose last fragment arrived more than
+          bcmp_reassembly_timeout_ms ago are freed on the way. A fragment of
+          a message not seen before takes a free slot, sized for frag_total
+          full fragments. Non-sequenced messages all share seq_num 0, so the
+          message id in next_header tells them apart.
+
+ @param data fragment being processed
+ @param now_ms current time in milliseconds
+
+ @return slot collecting the fragment's message
+ @return NULL if every slot is busy or there is no memory
+ */
+static BcmpReassembly *reassembly_slot(const BcmpProcessData *data,
+                                       uint32_t now_ms) {
+  BcmpReassembly *free_slot = NULL;
+
+  for (uint8_t i = 0; i < bcmp_reassembly_slots; i++) {
+    BcmpReassembly *slot = &PACKET.reassembly[i];
+    if (slot->buf && now_ms - slot->timestamp_ms > bcmp_reassembly_timeout_ms) {
+      bm_debug("BCMP - Reassembly of message type %" PRIu16
+               " seq_num %" PRIu32 " timed out\n",
+               slot->type, slot->seq_num);
+      bm_free(slot->buf);
+      memset(slot, 0, sizeof(BcmpReassembly));
+      PACKET.reassembly_stats.timed_out++;
+    }
+    if (!slot->buf) {
+      free_slot = free_slot ? free_slot : slot;
+    } else if (slot->type == data->header->type &&
+               slot->seq_num == data->header->seq_num &&
+               slot->frag_total == data->header->frag_total &&
+               slot->message_id == data->header->next_header &&
+               memcmp(&slot->src, data->src, sizeof(BmIpAddr)) == 0) {
+      return slot;
+    }
+  }
+
+  if (free_slot) {
+    free_slot->buf = (uint8_t *)bm_malloc(data->header->frag_total *
+                                          bcmp_fragment_payload_len);
+    if (!free_slot->buf) {
+      return NULL;
+    }
+    memcpy(&free_slot->src, data->src, sizeof(BmIpAddr));
+    free_slot->type = data->header->type;
+    free_slot->seq_num = data->header->seq_num;
+    free_slot->frag_total = data->header->frag_total;
+    free_slot->message_id = data->header->next_header;
+    free_slot->crc = fragment_crc(data->header);
+  }
+
+  return free_slot;
+}
+
+/*!
+ @brief Add A Fragment To The Message It Belongs To
+
+ @details Fragments may arrive in any order, duplicates are ignored. Once the
+          last missing fragment is in, data is pointed at the whole message,
+          which the caller frees after processing it.
+
+ @param data fragment being processed, the whole message when complete
+ @param message set to the reassembled message buffer when complete
+
+ @return BmOK when the message is complete
+ @return BmEINPROGRESS when fragments are still missing
+ @return BmEBADMSG if the fragment is malformed, the message too large or
+         its CRC does not match
+ @return BmENOMEM if the fragment can not be held
+ */
+static BmErr reassemble(BcmpProcessData *data, uint8_t **message) {
+  const BcmpHeader *header = data->header;
+  const uint8_t last = header->frag_total - 1;
+  const uint32_t now_ms = bm_ticks_to_ms(bm_get_tick_count());
+
+  if (header->frag_total > bcmp_max_fragments || header->frag_id > last ||
+      (header->frag_id < last && data->size != bcmp_fragment_payload_len) ||
+      data->size > bcmp_fragment_payload_len) {
+    return BmEBADMSG;
+  }
+
+  BcmpReassembly *slot = reassembly_slot(data, now_ms);
+  if (!slot) {
+    bm_debug("BCMP - No room to reassemble message type %" PRIu16 "\n",
+             header->type);
+    PACKET.reassembly_stats.dropped++;
+    return BmENOMEM;
+  }
+
+  const uint32_t bit = 1U << (header->frag_id % 32);
+  uint32_t *received = &slot->received[header->frag_id / 32];
+  if (!(*received & bit)) {
+    *received |= bit;
+    slot->received_count++;
+    memcpy(&slot->buf[header->frag_id * bcmp_fragment_payload_len],
+           data->payload, data->size);
+    if (header->frag_id == last) {
+      slot->size = header->frag_id * bcmp_fragment_payload_len + data->size;
+    }
+  }
+  slot->timestamp_ms = now_ms;
+
+  if (slot->received_count < slot->frag_total) {
+    return BmEINPROGRESS;
+  }
+
+  if (slot->size > bcmp_max_message_len) {
+    bm_free(slot->buf);
+    memset(slot, 0, sizeof(BcmpReassembly));
+    return BmEBADMSG;
+  }
+
+  if (crc16_ccitt(0, slot->buf, slot->size) != slot->crc) {
+    bm_debug("BCMP - Reassembled message type %" PRIu16
+             " failed its CRC check\n",
+             slot->type);
+    bm_free(slot->buf);
+    memset(slot, 0, sizeof(BcmpReassembly));
+    PACKET.reassembly_stats.corrupt++;
+    return BmEBADMSG;
+  }
+
+  *message = slot->buf;
+  data->payload = slot->buf;
+  data->size = slot->size;
+  memset(slot, 0, sizeof(BcmpReassembly));
+  PACKET.reassembly_stats.completed++;
+  return BmOK;
+}
+
 /*!
  @brief Initialize Packet Module
 
@@ -420,6 +585,8 @@ BmErr packet_remove(BcmpMessageType type) {
           serializes the header from the received message and then
           reports the payload to the associated packet processor item.
           The packet processor is then responsible for serializing the payload.
+          Fragments are held until their message is complete, the processor
+          is then handed the whole message.
 
  @param payload incoming data to be parsed and processed
  @param size size of incoming payload
@@ -434,6 +601,7 @@ BmErr process_received_message(void *payload, uint32_t size) {
   BcmpRequestElement *request_message = NULL;
   BcmpPacketCfg *cfg = NULL;
   void *buf = NULL;
+  uint8_t *message = NULL;
   uint16_t checksum_read = 0;
   uint16_t checksum_calc = 0;
 
@@ -466,6 +634,14 @@ BmErr process_received_message(void *payload, uint32_t size) {
 
     check_endianness(data.header, BcmpHeaderMessage);
 
+    if (data.header->frag_total > 1) {
+      err = reassemble(&data, &message);
+      if (err != BmOK) {
+        // Fragment is held until the rest of its message arrives
+        return err == BmEINPROGRESS ? BmOK : err;
+      }
+    }
+
     // Process parsed message type
     if ((err = ll_get_item(&PACKET.packet_list, data.header->type,
                            (void **)&cfg)) == BmOK &&
@@ -506,19 +682,21 @@ BmErr process_received_message(void *payload, uint32_t size) {
       }
     }
   }
+  bm_free(message);
   return err;
 }
 
 /*!
- @brief Serialize A BCMP Message In Little Endian Format
+ @brief Serialize The Header Of An Outgoing BCMP Message
 
- @details Serializes an incoming/outgoing message into an associated structure
-          see messages.h for potential structures. This allows incoming and
-          outgoing messages to be in a consistent endianess.
+ @details Places data in little endian form and fills in a header for it,
+          registering the sequence number of a sequenced request. The header
+          stays in host order, serialize_fragment writes it to each frame.
+          Fragmentation fields are zeroed for the caller to set, see
+          serialize_message_id.
 
- @param payload buffer to be formatted and serialized
- @param data passed in formatted data structure cast to a void pointer
- @param size size in bytes of data to be serialized
+ @param header header to fill in
+ @param data message to be sent, formatted in place
  @param type type of message to serialize
  @param seq_num number of sequence reply
  @param cb callback of message that is to be sequenced upon a sequenced reply
@@ -526,15 +704,14 @@ BmErr process_received_message(void *payload, uint32_t size) {
  @return BmOK on success
  @return BmError on failure
  */
-BmErr serialize(void *payload, void *data, uint32_t size, BcmpMessageType type,
-                uint32_t seq_num, BcmpSequencedRequestCb cb) {
+BmErr serialize_header(BcmpHeader *header, void *data, BcmpMessageType type,
+                       uint32_t seq_num, BcmpSequencedRequestCb cb) {
   static uint32_t message_count = 0;
   BmErr err = BmEINVAL;
-  BcmpHeader *header = NULL;
   BcmpPacketCfg *cfg = NULL;
   BcmpRequestElement request_message;
 
-  if (payload && data && PACKET.initialized) {
+  if (header && data && PACKET.initialized) {
     // Check endianness of type and place into little endian form
     check_endianness(data, type);
 
@@ -542,12 +719,11 @@ BmErr serialize(void *payload, void *data, uint32_t size, BcmpMessageType type,
     if ((err = ll_get_item(&PACKET.packet_list, type, (void *)&cfg)) == BmOK &&
         cfg) {
 
-      header = (BcmpHeader *)PACKET.cb.data(payload);
       header->checksum = 0;
-      header->flags = 0;       // Unused
-      header->reserved = 0;    // Unused
-      header->frag_total = 0;  // Unused
-      header->frag_id = 0;     // Unused
+      header->flags = 0;    // Unused
+      header->reserved = 0; // Unused
+      header->frag_total = 0;
+      header->frag_id = 0;
       header->next_header = 0; // Unused
       header->type = type;
       if (cfg->sequenced_reply) {
@@ -565,14 +741,112 @@ BmErr serialize(void *payload, void *data, uint32_t size, BcmpMessageType type,
         // If the message doesn't use sequence numbers, set it to 0
         header->seq_num = 0;
       }
+    }
+  }
+
+  return err;
+}
+
+/*!
+ @brief Tag The Header Of A Message Sent As Fragments
+
+ @details Gives the message its own id in next_header, so the receiver can
+          tell apart messages that share type and seq_num, and stores the
+          CRC of the whole message in flags and reserved so the receiver can
+          check the reassembled result. Forwarded fragments keep both.
+
+ @param header header from serialize_header
+ @param data message data, already formatted by serialize_header
+ @param size size in bytes of data
+ */
+void serialize_message_id(BcmpHeader *header, const void *data,
+                          uint32_t size) {
+  static uint8_t message_id = 0;
+
+  if (header && data) {
+    const uint16_t crc = crc16_ccitt(0, (const uint8_t *)data, size);
+    header->next_header = message_id++;
+    header->flags = crc & 0xFF;
+    header->reserved = crc >> 8;
+  }
+}
+
+/*!
+ @brief Write A Header And Data Into An Outgoing Frame
+
+ @details Writes the header in little endian format followed by data, then
+          the checksum of the two
+
+ @param payload buffer to be formatted
+ @param header header from serialize_header, fragmentation fields set
+ @param data message data, already formatted by serialize_header
+ @param size size in bytes of data
+
+ @return BmOK on success
+ @return BmError on failure
+ */
+BmErr serialize_fragment(void *payload, const BcmpHeader *header,
+                         const void *data, uint32_t size) {
+  BmErr err = BmEINVAL;
+
+  if (payload && header && (data || !size) && PACKET.initialized) {
+    err = BmOK;
+    BcmpHeader *frame_header = (BcmpHeader *)PACKET.cb.data(payload);
+    memcpy(frame_header, header, sizeof(BcmpHeader));
+    frame_header->checksum = 0;
+
+    // Format header in little endian format and append data onto payload
+    check_endianness(frame_header, BcmpHeaderMessage);
+    if (size) {
+      memcpy(((uint8_t *)frame_header) + sizeof(BcmpHeader), data, size);
+    }
+
+    frame_header->checksum =
+        packet_checksum(payload, size + sizeof(BcmpHeader));
+  }
+
+  return err;
+}
+
+/*!
+ @brief Serialize A BCMP Message In Little Endian Format
+
+ @details Serializes an incoming/outgoing message into an associated structure
+          see messages.h for potential structures. This allows incoming and
+          outgoing messages to be in a consistent endianess.
+
+ @param payload buffer to be formatted and serialized
+ @param data passed in formatted data structure cast to a void pointer
+ @param size size in bytes of data to be serialized
+ @param type type of message to serialize
+ @param seq_num number of sequence reply
+ @param cb callback of message that is to be sequenced upon a sequenced reply
 
-      // Format header in little endian format and append data onto payload
-      check_endianness(header, BcmpHeaderMessage);
-      memcpy(((uint8_t *)header) + sizeof(BcmpHeader), data, size);
+ @return BmOK on success
+ @return BmError on failure
+ */
+BmErr serialize(void *payload, void *data, uint32_t size, BcmpMessageType type,
+                uint32_t seq_num, BcmpSequencedRequestCb cb) {
+  BmErr err = BmEINVAL;
+  BcmpHeader header;
 
-      header->checksum = packet_checksum(payload, size + sizeof(BcmpHeader));
+  if (payload) {
+    err = serialize_header(&header, data, type, seq_num, cb);
+    if (err == BmOK) {
+      err = serialize_fragment(payload, &header, data, size);
     }
   }
 
   return err;
 }
+
+/*!
+ @brief Get Fragment Reassembly Counters
+
+ @param stats filled in with the counters since boot
+ */
+void packet_get_reassembly_stats(BcmpReassemblyStats *stats) {
+  if (stats) {
+    *stats = PACKET.reassembly_stats;
+  }
+}
@@ -1,7 +1,31 @@
+#include "bcmp.h"
 #include "messages.h"
 #include "util.h"
 #include <stdint.h>
 
+// Largest BCMP message, fragmented or not, that is sent or reassembled
+#ifndef bcmp_max_message_len
+#define bcmp_max_message_len (8192)
+#endif
+
+// Messages that can be reassembled at the same time, each holds a buffer of
+// up to bcmp_max_message_len bytes until it completes or times out
+#ifndef bcmp_reassembly_slots
+#define bcmp_reassembly_slots (2)
+#endif
+
+// A message is dropped when its next fragment doesn't arrive within this time
+#ifndef bcmp_reassembly_timeout_ms
+#define bcmp_reassembly_timeout_ms (500)
+#endif
+
+// Every fragment but the last carries a full frame of payload, so a
+// fragment's offset in the message follows from its frag_id
+#define bcmp_fragment_payload_len (max_payload_len - sizeof(BcmpHeader))
+#define bcmp_max_fragments                                                     \
+  ((bcmp_max_message_len + bcmp_fragment_payload_len - 1) /                    \
+   bcmp_fragment_payload_len)
+
 typedef struct {
   BcmpHeader *header;
   uint8_t *payload;
@@ -17,6 +41,15 @@ typedef uint16_t (*BcmpGetChecksum)(void *payload, uint32_t size);
 typedef BmErr (*BcmpProcessCb)(BcmpProcessData data);
 typedef BmErr (*BcmpSequencedRequestCb)(uint8_t *payload);
 
+typedef struct {
+  uint32_t completed;
+  uint32_t timed_out;
+  // Fragments dropped because every reassembly slot was busy
+  uint32_t dropped;
+  // Reassembled messages that failed their CRC check
+  uint32_t corrupt;
+} BcmpReassemblyStats;
+
 typedef struct {
   bool sequenced_reply;
   bool sequenced_request;
@@ -30,4 +63,11 @@ uint16_t packet_checksum(void *payload, uint32_t size);
 BmErr process_received_message(void *payload, uint32_t size);
 BmErr serialize(void *payload, void *data, uint32_t size, BcmpMessageType type,
                 uint32_t seq_num, BcmpSequencedRequestCb cb);
+BmErr serialize_header(BcmpHeader *header, void *data, BcmpMessageType type,
+                       uint32_t seq_num, BcmpSequencedRequestCb cb);
+BmErr serialize_fragment(void *payload, const BcmpHeader *header,
+                         const void *data, uint32_t size);
+void serialize_message_id(BcmpHeader *header, const void *data,
+                          uint32_t size);
+void packet_get_reassembly_stats(BcmpReassemblyStats *stats);
 BmErr packet_remove(BcmpMessageType type);
@@ -1,4 +1,7 @@
 #include "bm_os.h"
+#if bm_heap_tlsf
+#include "tlsf.h"
+#endif
 
 #include "FreeRTOS.h"
 #include "queue.h"
@@ -7,10 +10,59 @@
 #include "task.h"
 #include "timers.h"
 
+#if bm_heap_tlsf
+
+// The scheduler is suspended around the allocator, as the FreeRTOS heaps do
+static BmTlsf *heap;
+
+static BmTlsf *heap_get(void) {
+  if (!heap) {
+    static uint8_t pool[bm_heap_size] __attribute__((aligned(8)));
+    heap = bm_tlsf_create(pool, sizeof(pool));
+  }
+  return heap;
+}
+
+void *bm_malloc(size_t size) {
+  vTaskSuspendAll();
+  void *ptr = bm_tlsf_malloc(heap_get(), size);
+  (void)xTaskResumeAll();
+  return ptr;
+}
+
+void bm_free(void *ptr) {
+  vTaskSuspendAll();
+  bm_tlsf_free(heap_get(), ptr);
+  (void)xTaskResumeAll();
+}
+
+BmErr bm_heap_stats(BmHeapStats *stats) {
+  if (!stats) {
+    return BmEINVAL;
+  }
+  BmErr err = BmENOMEM;
+  vTaskSuspendAll();
+  if (heap_get()) {
+    bm_tlsf_stats(heap, stats);
+    err = BmOK;
+  }
+  (void)xTaskResumeAll();
+  return err;
+}
+
+#else
+
 void *bm_malloc(size_t size) { return pvPortMalloc(size); }
 
 void bm_free(void *ptr) { vPortFree(ptr); }
 
+/// Statistics come from the TLSF heap only
+BmErr bm_heap_stats(BmHeapStats *stats) {
+  return stats ? BmENODATA : BmEINVAL;
+}
+
+#endif // bm_heap_tlsf
+
 BmQueue bm_queue_create(uint32_t queue_length, uint32_t item_size) {
   return xQueueCreate(queue_length, item_size);
 }
@@ -26,6 +78,27 @@ BmErr bm_queue_receive(BmQueue queue, void *item, uint32_t timeout_ms) {
   }
 }
 
+BmErr bm_queue_receive_many(BmQueue queue, void *items, uint32_t max_items,
+                            uint32_t *received, uint32_t timeout_ms) {
+  if (!queue || !items || !received || max_items == 0) {
+    return BmEINVAL;
+  }
+
+  // Block for the first item only, then drain whatever is already waiting
+  // without yielding back to the scheduler
+  *received = 0;
+  uint8_t *out = (uint8_t *)items;
+  UBaseType_t item_size = uxQueueGetQueueItemSize((QueueHandle_t)queue);
+  TickType_t wait = pdMS_TO_TICKS(timeout_ms);
+  while (*received < max_items &&
+         xQueueReceive(queue, out + (*received * item_size), wait) == pdPASS) {
+    (*received)++;
+    wait = 0;
+  }
+
+  return *received > 0 ? BmOK : BmETIMEDOUT;
+}
+
 BmErr bm_queue_send(BmQueue queue, const void *item, uint32_t timeout_ms) {
   if (queue && xQueueSend(queue, item, pdMS_TO_TICKS(timeout_ms)) == pdPASS) {
     return BmOK;
@@ -193,4 +266,57 @@ uint32_t bm_ms_to_ticks(uint32_t ms) { return pdMS_TO_TICKS(ms); }
 
 uint32_t bm_ticks_to_ms(uint32_t ticks) { return pdTICKS_TO_MS(ticks); }
 
+// Tick count widened with the scheduler's overflow count, so it does not
+// go backwards when the tick counter wraps
+static uint64_t tick_time_us(void) {
+  TimeOut_t now;
+  vTaskSetTimeOutState(&now);
+  uint64_t ticks = (uint64_t)now.xTimeOnEntering;
+  if (sizeof(TickType_t) < sizeof(uint64_t)) {
+    ticks |= (uint64_t)(UBaseType_t)now.xOverflowCount
+             << (sizeof(TickType_t) * 8U % 64U);
+  }
+  return ticks / configTICK_RATE_HZ * 1000000U +
+         ticks % configTICK_RATE_HZ * 1000000U / configTICK_RATE_HZ;
+}
+
+#ifdef bm_time_counter
+
+// The 32-bit hardware counter extended to 64 bits. Wraps are counted from
+// the change in the counter between calls, wraps missed because no one
+// asked for the time in a while are recovered from the tick time.
+static uint64_t counter_total;
+static uint32_t counter_last;
+static uint64_t counter_last_tick_us;
+
+uint64_t bm_get_time_us(void) {
+  taskENTER_CRITICAL();
+  const uint64_t tick_us = tick_time_us();
+  const uint32_t count = (uint32_t)bm_time_counter();
+  const uint64_t hz = (uint64_t)bm_time_counter_hz;
+  uint64_t delta = (uint32_t)(count - counter_last);
+  const uint64_t elapsed_us = tick_us - counter_last_tick_us;
+  const uint64_t expected = elapsed_us / 1000000U * hz +
+                            elapsed_us % 1000000U * hz / 1000000U;
+  if (expected > delta) {
+    // Round to the nearest whole number of wraps, the tick time is only
+    // accurate to a tick
+    delta += (expected - delta + (1ULL << 31)) >> 32 << 32;
+  }
+  counter_total += delta;
+  counter_last = count;
+  counter_last_tick_us = tick_us;
+  const uint64_t total = counter_total;
+  taskEXIT_CRITICAL();
+  return total / hz * 1000000U + total % hz * 1000000U / hz;
+}
+
+#else
+
+// Resolution is one tick
+uint64_t bm_get_time_us(void) { return tick_time_us(); }
+
+#endif
+uint64_t bm_get_time_ns(void) { return bm_get_time_us() * 1000U; }
+
 void bm_delay(uint32_t ms) { vTaskDelay(pdMS_TO_TICKS(ms)); }
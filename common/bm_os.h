@@ -1,3 +1,5 @@
+#pragma once
+
 #include "util.h"
 
 #include <stdbool.h>
@@ -23,13 +25,46 @@ typedef void (*BmTimerCallback)(BmTimer timer);
 typedef void (*BmTask)(void *arg);
 
 // Memory functions - these may not necessarily be tied to the OS but I'm including them here for now
+
+/// Serve bm_malloc from a TLSF pool of bm_heap_size bytes instead of the
+/// platform heap. Allocation and free take bounded time and bm_heap_stats
+/// reports usage and fragmentation.
+#ifndef bm_heap_tlsf
+#define bm_heap_tlsf 0
+#endif
+#ifndef bm_heap_size
+#define bm_heap_size (64U * 1024U)
+#endif
+
+/// FreeRTOS ports time bm_get_time_us with the tick count, one tick of
+/// resolution, unless bm_time_counter() is defined to read a free running
+/// 32-bit hardware counter of bm_time_counter_hz, such as the Cortex-M DWT
+/// cycle counter. The counter must not wrap within a couple of ticks.
+
+/// Allocation counts are bucketed by requested size, class n holding
+/// requests of up to 16 << n bytes and the last class everything larger
+#define bm_heap_size_classes 8
+
+typedef struct BmHeapStats {
+  uint32_t total_bytes;
+  uint32_t live_bytes;
+  uint32_t high_water;
+  uint32_t largest_free;
+  uint32_t failed;
+  uint32_t alloc_count[bm_heap_size_classes];
+} BmHeapStats;
+
 void *bm_malloc(size_t size);
 void bm_free(void *ptr);
+/// BmENODATA when the platform heap does not report statistics
+BmErr bm_heap_stats(BmHeapStats *stats);
 
 // Queue functions
 BmQueue bm_queue_create(uint32_t queue_length, uint32_t item_size);
 void bm_queue_delete(BmQueue queue);
 BmErr bm_queue_receive(BmQueue queue, void *item, uint32_t timeout_ms);
+BmErr bm_queue_receive_many(BmQueue queue, void *items, uint32_t max_items,
+                            uint32_t *received, uint32_t timeout_ms);
 BmErr bm_queue_send(BmQueue queue, const void *item, uint32_t timeout_ms);
 BmErr bm_queue_send_to_front_from_isr(BmQueue queue, const void *item);
 
@@ -71,6 +106,8 @@ uint32_t bm_get_tick_count(void);
 uint32_t bm_get_tick_count_from_isr(void);
 uint32_t bm_ms_to_ticks(uint32_t ms);
 uint32_t bm_ticks_to_ms(uint32_t ticks);
+uint64_t bm_get_time_us(void);
+uint64_t bm_get_time_ns(void);
 void bm_delay(uint32_t ms);
 
 // These use time_remaining from util.c
@@ -3,24 +3,67 @@
 
 // Request POSIX.1-2008 interfaces (clock_gettime, etc.) on Linux/glibc.
 #define _POSIX_C_SOURCE 200809L
+#if defined(__linux__)
+// syscall() for futex parking, CPU_SET and sched_setaffinity for task affinity
+#define _GNU_SOURCE
+#endif
 
 #include "bm_os.h"
+#include "bm_posix.h"
+#if bm_heap_tlsf
+#include "tlsf.h"
+#endif
 
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 // ---------------------------------------------------------------------------
 // Helpers
 // ---------------------------------------------------------------------------
 
-/// Compute an absolute timespec deadline from a relative timeout in ms.
-/// Uses CLOCK_REALTIME because macOS lacks pthread_condattr_setclock.
+/// Clock that condition variable deadlines are measured against. Linux binds
+/// every condvar to CLOCK_MONOTONIC so a wall clock step (NTP, an RTC set over
+/// BCMP) can neither fire timeouts early nor stall them. macOS lacks
+/// pthread_condattr_setclock and stays on CLOCK_REALTIME.
+#if defined(__linux__)
+#define cond_clock CLOCK_MONOTONIC
+#else
+#define cond_clock CLOCK_REALTIME
+#endif
+
+/// Initialize a condition variable that times out against cond_clock.
+static int cond_init(pthread_cond_t *cond) {
+#if defined(__linux__)
+  pthread_condattr_t attr;
+  int rc = pthread_condattr_init(&attr);
+  if (rc == 0) {
+    rc = pthread_condattr_setclock(&attr, cond_clock);
+    if (rc == 0) {
+      rc = pthread_cond_init(cond, &attr);
+    }
+    pthread_condattr_destroy(&attr);
+  }
+  return rc;
+#else
+  return pthread_cond_init(cond, NULL);
+#endif
+}
+
+/// Compute an absolute cond_clock deadline from a relative timeout in ms.
 static void deadline_from_ms(uint32_t timeout_ms, struct timespec *ts) {
-  clock_gettime(CLOCK_REALTIME, ts);
+  clock_gettime(cond_clock, ts);
   uint64_t ns = (uint64_t)timeout_ms * 1000000ULL;
   ts->tv_sec += (time_t)(ns / 1000000000ULL);
   ts->tv_nsec += (long)(ns % 1000000000ULL);
@@ -30,16 +73,490 @@ static void deadline_from_ms(uint32_t timeout_ms, struct timespec *ts) {
   }
 }
 
+/// Monotonic time in ns, for deadlines that must not move with the wall clock.
+static uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/// Sleep for a relative number of ns, resuming after signal interruptions.
+/// Linux sleeps to an absolute CLOCK_MONOTONIC deadline so repeated EINTR
+/// cannot stretch the delay.
+static void sleep_ns(uint64_t ns) {
+#if defined(__linux__)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  ns += (uint64_t)ts.tv_nsec;
+  ts.tv_sec += (time_t)(ns / 1000000000ULL);
+  ts.tv_nsec = (long)(ns % 1000000000ULL);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+  }
+#else
+  struct timespec ts = {(time_t)(ns / 1000000000ULL),
+                        (long)(ns % 1000000000ULL)};
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+  }
+#endif
+}
+
 // ---------------------------------------------------------------------------
 // Memory
 // ---------------------------------------------------------------------------
+#if bm_heap_tlsf
+
+static struct {
+  pthread_once_t once;
+  pthread_mutex_t lock;
+  BmTlsf *tlsf;
+} HEAP = {
+    .once = PTHREAD_ONCE_INIT,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void heap_init(void) {
+  static max_align_t pool[bm_heap_size / sizeof(max_align_t)];
+  HEAP.tlsf = bm_tlsf_create(pool, sizeof(pool));
+}
+
+void *bm_malloc(size_t size) {
+  pthread_once(&HEAP.once, heap_init);
+  pthread_mutex_lock(&HEAP.lock);
+  void *ptr = bm_tlsf_malloc(HEAP.tlsf, size);
+  pthread_mutex_unlock(&HEAP.lock);
+  return ptr;
+}
+
+void bm_free(void *ptr) {
+  pthread_once(&HEAP.once, heap_init);
+  pthread_mutex_lock(&HEAP.lock);
+  bm_tlsf_free(HEAP.tlsf, ptr);
+  pthread_mutex_unlock(&HEAP.lock);
+}
+
+BmErr bm_heap_stats(BmHeapStats *stats) {
+  if (!stats) {
+    return BmEINVAL;
+  }
+  pthread_once(&HEAP.once, heap_init);
+  if (!HEAP.tlsf) {
+    return BmENOMEM;
+  }
+  pthread_mutex_lock(&HEAP.lock);
+  bm_tlsf_stats(HEAP.tlsf, stats);
+  pthread_mutex_unlock(&HEAP.lock);
+  return BmOK;
+}
+
+#else
+
 void *bm_malloc(size_t size) { return malloc(size); }
 void bm_free(void *ptr) { free(ptr); }
 
+/// The libc heap does not report usage or fragmentation
+BmErr bm_heap_stats(BmHeapStats *stats) {
+  return stats ? BmENODATA : BmEINVAL;
+}
+
+#endif // bm_heap_tlsf
+
 // ---------------------------------------------------------------------------
 // Queues
 // ---------------------------------------------------------------------------
 
+/// Queues are bounded multi-producer rings that never take a lock to send or
+/// receive, only to park a thread that has to block.  Set to 0 for the
+/// original mutex and condition variable queue.
+#ifndef bm_posix_queue_lockfree
+#define bm_posix_queue_lockfree 1
+#endif
+
+#if bm_posix_queue_lockfree
+
+/// Parking for threads that block on a queue, an event count: a waiter
+/// registers, checks its condition once more and sleeps only if the count
+/// has not moved since it registered.  Wakers bump the count, and only make
+/// a system call when someone is registered.
+typedef struct {
+  uint32_t seq;
+  uint32_t waiters;
+#if !defined(__linux__)
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+#endif
+} PosixParker;
+
+static void parker_init(PosixParker *p) {
+#if !defined(__linux__)
+  pthread_mutex_init(&p->lock, NULL);
+  cond_init(&p->cond);
+#else
+  (void)p;
+#endif
+}
+
+static void parker_destroy(PosixParker *p) {
+#if !defined(__linux__)
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->cond);
+#else
+  (void)p;
+#endif
+}
+
+static uint32_t parker_prepare(PosixParker *p) {
+  __atomic_add_fetch(&p->waiters, 1, __ATOMIC_SEQ_CST);
+  // Pairs with the fence in parker_wake, either the waker sees this waiter
+  // or the waiter's next check sees what the waker published
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  return __atomic_load_n(&p->seq, __ATOMIC_SEQ_CST);
+}
+
+static void parker_cancel(PosixParker *p) {
+  __atomic_sub_fetch(&p->waiters, 1, __ATOMIC_RELAXED);
+}
+
+/// Sleep until woken or the monotonic deadline passes (UINT64_MAX waits
+/// forever).  Returns false once the deadline has passed.
+static bool parker_wait(PosixParker *p, uint32_t key, uint64_t deadline_ns) {
+  bool ret = true;
+  if (deadline_ns != UINT64_MAX) {
+    const uint64_t now = monotonic_ns();
+    if (now >= deadline_ns) {
+      parker_cancel(p);
+      return false;
+    }
+#if defined(__linux__)
+    const uint64_t remaining = deadline_ns - now;
+    struct timespec ts = {(time_t)(remaining / 1000000000ULL),
+                          (long)(remaining % 1000000000ULL)};
+    syscall(SYS_futex, &p->seq, FUTEX_WAIT_PRIVATE, key, &ts, NULL, 0);
+#else
+    struct timespec ts;
+    deadline_from_ms((uint32_t)((deadline_ns - now + 999999U) / 1000000U),
+                     &ts);
+    pthread_mutex_lock(&p->lock);
+    while (__atomic_load_n(&p->seq, __ATOMIC_ACQUIRE) == key) {
+      if (pthread_cond_timedwait(&p->cond, &p->lock, &ts) == ETIMEDOUT) {
+        break;
+      }
+    }
+    pthread_mutex_unlock(&p->lock);
+#endif
+    ret = monotonic_ns() < deadline_ns;
+  } else {
+#if defined(__linux__)
+    syscall(SYS_futex, &p->seq, FUTEX_WAIT_PRIVATE, key, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&p->lock);
+    while (__atomic_load_n(&p->seq, __ATOMIC_ACQUIRE) == key) {
+      pthread_cond_wait(&p->cond, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+#endif
+  }
+  parker_cancel(p);
+  return ret;
+}
+
+static void parker_wake(PosixParker *p) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&p->waiters, __ATOMIC_RELAXED) == 0) {
+    return;
+  }
+#if defined(__linux__)
+  __atomic_add_fetch(&p->seq, 1, __ATOMIC_SEQ_CST);
+  syscall(SYS_futex, &p->seq, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+#else
+  pthread_mutex_lock(&p->lock);
+  __atomic_add_fetch(&p->seq, 1, __ATOMIC_SEQ_CST);
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+#endif
+}
+
+/// Bounded ring of fixed size items (D. Vyukov's bounded queue).  Each cell
+/// carries a sequence number telling whether it is free for the position a
+/// sender claimed (twice the position) or holds the item for the position a
+/// receiver claimed (twice the position plus one), so senders only contend on
+/// claiming the tail.  Doubling keeps a full cell apart from one free for the
+/// next lap, which would otherwise look alike in a ring of one cell.
+/// Receivers claim the head the same way, which costs nothing extra for the
+/// usual single receiver and keeps a queue shared by several receivers
+/// correct.  Positions are 64 bits wide and never wrap.
+typedef struct {
+  uint64_t head;
+  uint8_t head_pad[64 - sizeof(uint64_t)];
+  uint64_t tail;
+  uint8_t tail_pad[64 - sizeof(uint64_t)];
+  uint8_t *cells;
+  uint32_t stride;
+  uint32_t capacity;
+} PosixRing;
+
+static bool ring_init(PosixRing *r, uint32_t capacity, uint32_t item_size) {
+  // Sequence number first, items padded so sequence numbers stay aligned
+  r->stride = (uint32_t)(sizeof(uint64_t) +
+                         ((item_size + sizeof(uint64_t) - 1) &
+                          ~(sizeof(uint64_t) - 1)));
+  r->capacity = capacity;
+  r->cells = (uint8_t *)malloc((size_t)capacity * r->stride);
+  if (!r->cells) {
+    return false;
+  }
+  for (uint32_t i = 0; i < capacity; i++) {
+    *(uint64_t *)(r->cells + (size_t)i * r->stride) = 2ULL * i;
+  }
+  return true;
+}
+
+static inline uint64_t *ring_cell(PosixRing *r, uint64_t pos) {
+  return (uint64_t *)(r->cells + (size_t)(pos % r->capacity) * r->stride);
+}
+
+static bool ring_push(PosixRing *r, const void *item, uint32_t item_size) {
+  uint64_t pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+  for (;;) {
+    uint64_t *cell = ring_cell(r, pos);
+    const int64_t diff =
+        (int64_t)(__atomic_load_n(cell, __ATOMIC_ACQUIRE) - 2 * pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&r->tail, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        memcpy(cell + 1, item, item_size);
+        __atomic_store_n(cell, 2 * pos + 1, __ATOMIC_RELEASE);
+        return true;
+      }
+    } else if (diff < 0) {
+      // The cell still holds the item from a lap ago, the ring is full
+      return false;
+    } else {
+      pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+static bool ring_pop(PosixRing *r, void *item, uint32_t item_size) {
+  uint64_t pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+  for (;;) {
+    uint64_t *cell = ring_cell(r, pos);
+    const int64_t diff =
+        (int64_t)(__atomic_load_n(cell, __ATOMIC_ACQUIRE) - (2 * pos + 1));
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&r->head, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        memcpy(item, cell + 1, item_size);
+        __atomic_store_n(cell, 2 * (pos + r->capacity), __ATOMIC_RELEASE);
+        return true;
+      }
+    } else if (diff < 0) {
+      // Empty, or the sender that claimed this cell has not filled it yet
+      return false;
+    } else {
+      pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+/// Items sent to the front go to a ring of their own that receivers drain
+/// first.  Unlike FreeRTOS, several items sent to the front are received in
+/// the order they were sent, and the front has its own queue_length of room.
+typedef struct {
+  PosixRing ring;
+  PosixRing front;
+  uint32_t item_size;
+  PosixParker not_empty;
+  PosixParker not_full;
+} PosixQueue;
+
+static uint64_t deadline_ns_from_ms(uint32_t timeout_ms) {
+  if (timeout_ms == UINT32_MAX) {
+    return UINT64_MAX;
+  }
+  return monotonic_ns() + (uint64_t)timeout_ms * 1000000ULL;
+}
+
+/// Attempts a blocked sender or receiver makes before parking, a peer that is
+/// running usually frees a slot or sends an item within a few hundred ns,
+/// sooner than a park and wake through the kernel would take.  Nothing can
+/// make progress while we spin on a single CPU, so there we park right away.
+#ifndef bm_posix_queue_spin_tries
+#define bm_posix_queue_spin_tries 128
+#endif
+
+static uint32_t queue_spin_tries(void) {
+  static uint32_t tries = UINT32_MAX;
+  uint32_t ret = __atomic_load_n(&tries, __ATOMIC_RELAXED);
+  if (ret == UINT32_MAX) {
+    ret = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? bm_posix_queue_spin_tries : 0;
+    __atomic_store_n(&tries, ret, __ATOMIC_RELAXED);
+  }
+  return ret;
+}
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ volatile("yield");
+#endif
+}
+
+static inline bool queue_pop(PosixQueue *q, void *item) {
+  return ring_pop(&q->front, item, q->item_size) ||
+         ring_pop(&q->ring, item, q->item_size);
+}
+
+BmQueue bm_queue_create(uint32_t queue_length, uint32_t item_size) {
+  if (!queue_length) {
+    return NULL;
+  }
+  PosixQueue *q = (PosixQueue *)calloc(1, sizeof(PosixQueue));
+  if (!q) {
+    return NULL;
+  }
+  if (!ring_init(&q->ring, queue_length, item_size) ||
+      !ring_init(&q->front, queue_length, item_size)) {
+    free(q->ring.cells);
+    free(q);
+    return NULL;
+  }
+  parker_init(&q->not_empty);
+  parker_init(&q->not_full);
+  q->item_size = item_size;
+  return (BmQueue)q;
+}
+
+void bm_queue_delete(BmQueue queue) {
+  PosixQueue *q = (PosixQueue *)queue;
+  if (q) {
+    parker_destroy(&q->not_empty);
+    parker_destroy(&q->not_full);
+    free(q->ring.cells);
+    free(q->front.cells);
+    free(q);
+  }
+}
+
+/// Wait until at least one item can be received, leaving it in item.
+static BmErr queue_wait_item(PosixQueue *q, void *item, uint32_t timeout_ms) {
+  if (queue_pop(q, item)) {
+    return BmOK;
+  }
+  if (timeout_ms == 0) {
+    return BmETIMEDOUT;
+  }
+  for (uint32_t i = 0, n = queue_spin_tries(); i < n; i++) {
+    cpu_relax();
+    if (queue_pop(q, item)) {
+      return BmOK;
+    }
+  }
+  const uint64_t deadline = deadline_ns_from_ms(timeout_ms);
+  for (;;) {
+    const uint32_t key = parker_prepare(&q->not_empty);
+    if (queue_pop(q, item)) {
+      parker_cancel(&q->not_empty);
+      return BmOK;
+    }
+    if (!parker_wait(&q->not_empty, key, deadline)) {
+      return queue_pop(q, item) ? BmOK : BmETIMEDOUT;
+    }
+    if (queue_pop(q, item)) {
+      return BmOK;
+    }
+  }
+}
+
+BmErr bm_queue_receive(BmQueue queue, void *item, uint32_t timeout_ms) {
+  PosixQueue *q = (PosixQueue *)queue;
+  if (!q || !item) {
+    return BmEINVAL;
+  }
+  BmErr err = queue_wait_item(q, item, timeout_ms);
+  if (err == BmOK) {
+    parker_wake(&q->not_full);
+  }
+  return err;
+}
+
+/// Block until at least one item is available (or the timeout expires), then
+/// drain up to max_items without blocking again.
+BmErr bm_queue_receive_many(BmQueue queue, void *items, uint32_t max_items,
+                            uint32_t *received, uint32_t timeout_ms) {
+  PosixQueue *q = (PosixQueue *)queue;
+  if (!q || !items || !received || max_items == 0) {
+    return BmEINVAL;
+  }
+  *received = 0;
+
+  uint8_t *out = (uint8_t *)items;
+  BmErr err = queue_wait_item(q, out, timeout_ms);
+  if (err != BmOK) {
+    return err;
+  }
+  uint32_t n = 1;
+  while (n < max_items && queue_pop(q, out + ((size_t)n * q->item_size))) {
+    n++;
+  }
+  *received = n;
+  parker_wake(&q->not_full);
+  return BmOK;
+}
+
+BmErr bm_queue_send(BmQueue queue, const void *item, uint32_t timeout_ms) {
+  PosixQueue *q = (PosixQueue *)queue;
+  if (!q || !item) {
+    return BmEINVAL;
+  }
+
+  if (!ring_push(&q->ring, item, q->item_size)) {
+    if (timeout_ms == 0) {
+      return BmENOMEM;
+    }
+    for (uint32_t i = 0, n = queue_spin_tries(); i < n; i++) {
+      cpu_relax();
+      if (ring_push(&q->ring, item, q->item_size)) {
+        parker_wake(&q->not_empty);
+        return BmOK;
+      }
+    }
+    const uint64_t deadline = deadline_ns_from_ms(timeout_ms);
+    for (;;) {
+      const uint32_t key = parker_prepare(&q->not_full);
+      if (ring_push(&q->ring, item, q->item_size)) {
+        parker_cancel(&q->not_full);
+        break;
+      }
+      if (!parker_wait(&q->not_full, key, deadline)) {
+        if (ring_push(&q->ring, item, q->item_size)) {
+          break;
+        }
+        return BmETIMEDOUT;
+      }
+      if (ring_push(&q->ring, item, q->item_size)) {
+        break;
+      }
+    }
+  }
+  parker_wake(&q->not_empty);
+  return BmOK;
+}
+
+BmErr bm_queue_send_to_front_from_isr(BmQueue queue, const void *item) {
+  PosixQueue *q = (PosixQueue *)queue;
+  if (!q || !item) {
+    return BmEINVAL;
+  }
+  if (!ring_push(&q->front, item, q->item_size)) {
+    return BmENOMEM;
+  }
+  parker_wake(&q->not_empty);
+  return BmOK;
+}
+
+#else
+
 typedef struct {
   pthread_mutex_t lock;
   pthread_cond_t not_empty;
@@ -53,6 +570,9 @@ typedef struct {
 } PosixQueue;
 
 BmQueue bm_queue_create(uint32_t queue_length, uint32_t item_size) {
+  if (!queue_length) {
+    return NULL;
+  }
   PosixQueue *q = (PosixQueue *)calloc(1, sizeof(PosixQueue));
   if (!q) {
     return NULL;
@@ -63,8 +583,8 @@ BmQueue bm_queue_create(uint32_t queue_length, uint32_t item_size) {
     return NULL;
   }
   pthread_mutex_init(&q->lock, NULL);
-  pthread_cond_init(&q->not_empty, NULL);
-  pthread_cond_init(&q->not_full, NULL);
+  cond_init(&q->not_empty);
+  cond_init(&q->not_full);
   q->item_size = item_size;
   q->capacity = queue_length;
   return (BmQueue)q;
@@ -113,6 +633,49 @@ BmErr bm_queue_receive(BmQueue queue, void *item, uint32_t timeout_ms) {
   return BmOK;
 }
 
+/// Block until at least one item is available (or the timeout expires), then
+/// drain up to max_items under a single lock acquisition.
+BmErr bm_queue_receive_many(BmQueue queue, void *items, uint32_t max_items,
+                            uint32_t *received, uint32_t timeout_ms) {
+  PosixQueue *q = (PosixQueue *)queue;
+  if (!q || !items || !received || max_items == 0) {
+    return BmEINVAL;
+  }
+  *received = 0;
+
+  pthread_mutex_lock(&q->lock);
+  while (q->count == 0) {
+    if (timeout_ms == 0) {
+      pthread_mutex_unlock(&q->lock);
+      return BmETIMEDOUT;
+    }
+    if (timeout_ms == UINT32_MAX) {
+      pthread_cond_wait(&q->not_empty, &q->lock);
+    } else {
+      struct timespec ts;
+      deadline_from_ms(timeout_ms, &ts);
+      if (pthread_cond_timedwait(&q->not_empty, &q->lock, &ts) == ETIMEDOUT) {
+        pthread_mutex_unlock(&q->lock);
+        return BmETIMEDOUT;
+      }
+    }
+  }
+
+  uint32_t n = q->count < max_items ? q->count : max_items;
+  uint8_t *out = (uint8_t *)items;
+  for (uint32_t i = 0; i < n; i++) {
+    memcpy(out + (i * q->item_size), q->storage + (q->head * q->item_size),
+           q->item_size);
+    q->head = (q->head + 1) % q->capacity;
+  }
+  q->count -= n;
+  *received = n;
+  // More than one slot may have been freed, wake every blocked sender
+  pthread_cond_broadcast(&q->not_full);
+  pthread_mutex_unlock(&q->lock);
+  return BmOK;
+}
+
 BmErr bm_queue_send(BmQueue queue, const void *item, uint32_t timeout_ms) {
   PosixQueue *q = (PosixQueue *)queue;
   if (!q || !item) {
@@ -166,6 +729,8 @@ BmErr bm_queue_send_to_front_from_isr(BmQueue queue, const void *item) {
   return BmOK;
 }
 
+#endif // bm_posix_queue_lockfree
+
 // ---------------------------------------------------------------------------
 // Stream buffers
 // ---------------------------------------------------------------------------
@@ -192,8 +757,8 @@ BmBuffer bm_stream_buffer_create(uint32_t max_size) {
     return NULL;
   }
   pthread_mutex_init(&sb->lock, NULL);
-  pthread_cond_init(&sb->not_empty, NULL);
-  pthread_cond_init(&sb->not_full, NULL);
+  cond_init(&sb->not_empty);
+  cond_init(&sb->not_full);
   sb->capacity = max_size;
   return (BmBuffer)sb;
 }
@@ -324,7 +889,7 @@ BmSemaphore bm_mutex_create(void) {
     return NULL;
   }
   pthread_mutex_init(&s->lock, NULL);
-  pthread_cond_init(&s->cond, NULL);
+  cond_init(&s->cond);
   s->count = 1; // Mutex starts available
   return (BmSemaphore)s;
 }
@@ -335,7 +900,7 @@ BmSemaphore bm_semaphore_create(void) {
     return NULL;
   }
   pthread_mutex_init(&s->lock, NULL);
-  pthread_cond_init(&s->cond, NULL);
+  cond_init(&s->cond);
   s->count = 0; // Binary semaphore starts unavailable
   return (BmSemaphore)s;
 }
@@ -394,32 +959,194 @@ BmErr bm_semaphore_take(BmSemaphore semaphore, uint32_t timeout_ms) {
 // Tasks
 // ---------------------------------------------------------------------------
 
+/// Number of bm priorities with their own scheduling entry. Higher
+/// priorities share the last entry.
+#ifndef bm_posix_task_priorities
+#define bm_posix_task_priorities 32
+#endif
+/// Policy of every bm priority without an explicit entry. Build with
+/// -Dbm_posix_task_policy=BmPosixSchedFifo to run all tasks real-time.
+#ifndef bm_posix_task_policy
+#define bm_posix_task_policy BmPosixSchedOther
+#endif
+/// FIFO/RR priority of bm priority 0 under the default mapping. bm priority
+/// n maps to base + n, keeping the FreeRTOS ordering between tasks.
+#ifndef bm_posix_task_rt_base
+#define bm_posix_task_rt_base 10
+#endif
+/// CPU set of every bm priority without an explicit entry, 0 for any CPU
+#ifndef bm_posix_task_cpu_mask
+#define bm_posix_task_cpu_mask 0
+#endif
+/// bm_task_create sizes stacks in words like xTaskCreate. Hosted threads
+/// also carry libc frames, so smaller requests are raised to this floor.
+#ifndef bm_posix_task_stack_min
+#define bm_posix_task_stack_min (64U * 1024U)
+#endif
+
+static struct {
+  pthread_mutex_t lock;
+  bool set[bm_posix_task_priorities];
+  BmPosixTaskSched sched[bm_posix_task_priorities];
+  BmPosixTaskStats stats;
+} TASKS = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
 typedef struct {
   BmTask func;
   void *arg;
+  uint64_t cpu_mask;
 } TaskTrampoline;
 
+static uint32_t task_sched_index(uint32_t priority) {
+  return priority < bm_posix_task_priorities ? priority
+                                             : bm_posix_task_priorities - 1;
+}
+
+static int task_policy(BmPosixSchedPolicy policy) {
+  switch (policy) {
+  case BmPosixSchedFifo:
+    return SCHED_FIFO;
+  case BmPosixSchedRr:
+    return SCHED_RR;
+  default:
+    return SCHED_OTHER;
+  }
+}
+
+static void task_sched_lookup(uint32_t priority, BmPosixTaskSched *sched) {
+  uint32_t i = task_sched_index(priority);
+  pthread_mutex_lock(&TASKS.lock);
+  if (TASKS.set[i]) {
+    *sched = TASKS.sched[i];
+  } else {
+    sched->policy = bm_posix_task_policy;
+    sched->sched_priority = bm_posix_task_rt_base + (int)i;
+    sched->cpu_mask = bm_posix_task_cpu_mask;
+  }
+  pthread_mutex_unlock(&TASKS.lock);
+}
+
+BmErr bm_posix_task_sched_set(uint32_t priority,
+                              const BmPosixTaskSched *sched) {
+  if (!sched || sched->policy > BmPosixSchedRr) {
+    return BmEINVAL;
+  }
+  uint32_t i = task_sched_index(priority);
+  pthread_mutex_lock(&TASKS.lock);
+  TASKS.sched[i] = *sched;
+  TASKS.set[i] = true;
+  pthread_mutex_unlock(&TASKS.lock);
+  return BmOK;
+}
+
+BmErr bm_posix_task_sched_get(uint32_t priority, BmPosixTaskSched *sched) {
+  if (!sched) {
+    return BmEINVAL;
+  }
+  task_sched_lookup(priority, sched);
+  return BmOK;
+}
+
+void bm_posix_task_stats(BmPosixTaskStats *stats) {
+  if (stats) {
+    pthread_mutex_lock(&TASKS.lock);
+    *stats = TASKS.stats;
+    pthread_mutex_unlock(&TASKS.lock);
+  }
+}
+
+static void task_count(uint32_t *counter) {
+  pthread_mutex_lock(&TASKS.lock);
+  (*counter)++;
+  pthread_mutex_unlock(&TASKS.lock);
+}
+
+/// Restrict the calling thread to the CPUs in mask. Bits past CPU_SETSIZE
+/// and offline CPUs are rejected by the kernel and counted as denied.
+static void task_apply_affinity(uint64_t mask) {
+  if (!mask) {
+    return;
+  }
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; cpu++) {
+    if (mask & (1ULL << cpu)) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    task_count(&TASKS.stats.affinity_denied);
+  }
+#else
+  task_count(&TASKS.stats.affinity_denied);
+#endif
+}
+
 static void *posix_task_trampoline(void *param) {
   TaskTrampoline *t = (TaskTrampoline *)param;
   BmTask func = t->func;
   void *arg = t->arg;
+  uint64_t cpu_mask = t->cpu_mask;
   free(t);
+  task_apply_affinity(cpu_mask);
   func(arg);
   return NULL;
 }
 
+/// Stack bytes for a request in words, raised to bm_posix_task_stack_min
+/// and PTHREAD_STACK_MIN and rounded up to whole pages.
+static size_t task_stack_bytes(uint32_t stack_size) {
+  size_t bytes = (size_t)stack_size * sizeof(void *);
+  if (bytes < bm_posix_task_stack_min) {
+    bytes = bm_posix_task_stack_min;
+  }
+  if (bytes < (size_t)PTHREAD_STACK_MIN) {
+    bytes = (size_t)PTHREAD_STACK_MIN;
+  }
+  long page = sysconf(_SC_PAGESIZE);
+  if (page > 0) {
+    bytes = (bytes + (size_t)page - 1) / (size_t)page * (size_t)page;
+  }
+  return bytes;
+}
+
+/// Thread attributes for a task. Real-time policies are requested
+/// explicitly, so the thread never runs at the creator's priority.
+static void task_attr_init(pthread_attr_t *attr, size_t stack_bytes,
+                           const BmPosixTaskSched *sched) {
+  pthread_attr_init(attr);
+  pthread_attr_setstacksize(attr, stack_bytes);
+  int policy = task_policy(sched->policy);
+  if (policy == SCHED_OTHER) {
+    return;
+  }
+  struct sched_param param = {0};
+  int lo = sched_get_priority_min(policy);
+  int hi = sched_get_priority_max(policy);
+  param.sched_priority = sched->sched_priority < lo   ? lo
+                         : sched->sched_priority > hi ? hi
+                                                      : sched->sched_priority;
+  pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setschedpolicy(attr, policy);
+  pthread_attr_setschedparam(attr, &param);
+}
+
 BmErr bm_task_create(BmTask task, const char *name, uint32_t stack_size,
                      void *arg, uint32_t priority, BmTaskHandle task_handle) {
   (void)name;
-  (void)stack_size;
-  (void)priority;
 
   TaskTrampoline *t = (TaskTrampoline *)malloc(sizeof(*t));
   if (!t) {
     return BmENOMEM;
   }
+  BmPosixTaskSched sched;
+  task_sched_lookup(priority, &sched);
   t->func = task;
   t->arg = arg;
+  t->cpu_mask = sched.cpu_mask;
 
   pthread_t *thread = (pthread_t *)malloc(sizeof(pthread_t));
   if (!thread) {
@@ -427,7 +1154,19 @@ BmErr bm_task_create(BmTask task, const char *name, uint32_t stack_size,
     return BmENOMEM;
   }
 
-  int rc = pthread_create(thread, NULL, posix_task_trampoline, t);
+  size_t stack_bytes = task_stack_bytes(stack_size);
+  pthread_attr_t attr;
+  task_attr_init(&attr, stack_bytes, &sched);
+  int rc = pthread_create(thread, &attr, posix_task_trampoline, t);
+  pthread_attr_destroy(&attr);
+  if (rc == EPERM && sched.policy != BmPosixSchedOther) {
+    // Unprivileged: start under the default policy rather than not at all
+    task_count(&TASKS.stats.sched_denied);
+    sched.policy = BmPosixSchedOther;
+    task_attr_init(&attr, stack_bytes, &sched);
+    rc = pthread_create(thread, &attr, posix_task_trampoline, t);
+    pthread_attr_destroy(&attr);
+  }
   if (rc != 0) {
     free(t);
     free(thread);
@@ -460,109 +1199,214 @@ void bm_start_scheduler(void) {
 // Timers
 // ---------------------------------------------------------------------------
 
-typedef struct {
-  pthread_mutex_t lock;
-  pthread_cond_t cond;
-  pthread_t thread;
-  bool thread_created;
-  bool running;
-  bool auto_reload;
-  bool delete_requested;
-  bool
-      self_delete; // true when bm_timer_delete was called from this timer's own thread
-  bool needs_reset;
+/// All timers are driven by one service thread, like the FreeRTOS timer task:
+/// callbacks run on it one at a time and should not block for long.  Active
+/// timers sit in a hierarchical timing wheel at 1 ms resolution, each level
+/// has 64 slots and spans 64 times the level below it.  A timer is placed in
+/// the lowest level that spans its remaining time and moves down a level each
+/// time the level below wraps, so start, stop and reset are O(1) no matter
+/// how many timers exist.
+
+#define timer_wheel_bits 6
+#define timer_wheel_slots (1U << timer_wheel_bits)
+#define timer_wheel_mask (timer_wheel_slots - 1)
+#define timer_wheel_levels 4
+// Timers further out than the wheel spans (about 4.6 hours) wait in the top
+// level and are placed again each time it comes around
+#define timer_wheel_span (1ULL << (timer_wheel_bits * timer_wheel_levels))
+
+typedef struct PosixTimer {
+  // Slot list links, pprev points at whatever points at this timer and is
+  // NULL while the timer is dormant
+  struct PosixTimer *next;
+  struct PosixTimer **pprev;
+  uint64_t expiry_ms;
   uint32_t period_ms;
+  bool auto_reload;
   void *timer_id;
   BmTimerCallback cb;
 } PosixTimer;
 
-static void *posix_timer_thread(void *param) {
-  PosixTimer *t = (PosixTimer *)param;
+static struct {
+  pthread_once_t once;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool started;
+  // Next tick to process, everything before it has been processed
+  uint64_t now_ms;
+  // Active timers, in the wheel or about to fire
+  uint32_t pending;
+  PosixTimer *slots[timer_wheel_levels][timer_wheel_slots];
+  // Timer whose callback is running, and whether it was deleted meanwhile
+  PosixTimer *firing;
+  bool firing_deleted;
+} WHEEL = {
+    .once = PTHREAD_ONCE_INIT,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64_t monotonic_ms(void) { return monotonic_ns() / 1000000U; }
+
+static void timer_link(PosixTimer **head, PosixTimer *t) {
+  t->next = *head;
+  if (t->next) {
+    t->next->pprev = &t->next;
+  }
+  t->pprev = head;
+  *head = t;
+}
+
+static void timer_unlink(PosixTimer *t) {
+  *t->pprev = t->next;
+  if (t->next) {
+    t->next->pprev = t->pprev;
+  }
+  t->next = NULL;
+  t->pprev = NULL;
+}
+
+/// Place a timer in the slot for its expiry.  Expiries that already passed
+/// fire on the next tick processed.
+static void wheel_place(PosixTimer *t) {
+  uint64_t expiry = t->expiry_ms > WHEEL.now_ms ? t->expiry_ms : WHEEL.now_ms;
+  if (expiry - WHEEL.now_ms >= timer_wheel_span) {
+    expiry = WHEEL.now_ms + timer_wheel_span - 1;
+  }
+  uint32_t level = 0;
+  while (level < timer_wheel_levels - 1 &&
+         expiry - WHEEL.now_ms >= 1ULL << (timer_wheel_bits * (level + 1))) {
+    level++;
+  }
+  const uint32_t slot =
+      (uint32_t)(expiry >> (timer_wheel_bits * level)) & timer_wheel_mask;
+  timer_link(&WHEEL.slots[level][slot], t);
+}
 
-  pthread_mutex_lock(&t->lock);
+static void timer_add(PosixTimer *t) {
+  if (!WHEEL.pending) {
+    // The service thread stops ticking while there is nothing to fire
+    const uint64_t now = monotonic_ms();
+    if (now > WHEEL.now_ms) {
+      WHEEL.now_ms = now;
+    }
+  }
+  wheel_place(t);
+  WHEEL.pending++;
+}
+
+static void timer_remove(PosixTimer *t) {
+  timer_unlink(t);
+  WHEEL.pending--;
+}
+
+/// Process the tick at WHEEL.now_ms.  Called with the lock held, which is
+/// dropped around each callback so callbacks can use the timer API.
+static void wheel_tick(void) {
+  const uint64_t now = WHEEL.now_ms;
+
+  // Each time a level wraps, the next slot of the level above moves down
+  for (uint32_t level = 1; level < timer_wheel_levels; level++) {
+    if ((now >> (timer_wheel_bits * (level - 1))) & timer_wheel_mask) {
+      break;
+    }
+    PosixTimer **slot =
+        &WHEEL.slots[level][(now >> (timer_wheel_bits * level)) &
+                            timer_wheel_mask];
+    PosixTimer *t = *slot;
+    *slot = NULL;
+    while (t) {
+      PosixTimer *next = t->next;
+      wheel_place(t);
+      t = next;
+    }
+  }
+
+  // Take the expired timers off the wheel.  They stay linked on this list
+  // until they fire so another thread can still stop or delete them.
+  PosixTimer *expired = WHEEL.slots[0][now & timer_wheel_mask];
+  WHEEL.slots[0][now & timer_wheel_mask] = NULL;
+  if (expired) {
+    expired->pprev = &expired;
+  }
+  WHEEL.now_ms = now + 1;
+
+  PosixTimer *t;
+  while ((t = expired)) {
+    timer_remove(t);
+    // Like FreeRTOS, reload from the expiry rather than from now so periods
+    // don't drift, and before the callback so it can stop the timer
+    if (t->auto_reload) {
+      t->expiry_ms += t->period_ms;
+      timer_add(t);
+    }
+    WHEEL.firing = t;
+    WHEEL.firing_deleted = false;
+    BmTimerCallback cb = t->cb;
+    pthread_mutex_unlock(&WHEEL.lock);
+    cb((BmTimer)t);
+    pthread_mutex_lock(&WHEEL.lock);
+    if (WHEEL.firing_deleted) {
+      free(t);
+    }
+    WHEEL.firing = NULL;
+  }
+}
+
+static void *timer_service_thread(void *param) {
+  (void)param;
+  pthread_mutex_lock(&WHEEL.lock);
   for (;;) {
-    // Phase 1: wait to be started (or deleted)
-    while (!t->running && !t->delete_requested) {
-      pthread_cond_wait(&t->cond, &t->lock);
-    }
-    if (t->delete_requested) {
-      bool do_free = t->self_delete;
-      pthread_mutex_unlock(&t->lock);
-      if (do_free) {
-        pthread_mutex_destroy(&t->lock);
-        pthread_cond_destroy(&t->cond);
-        free(t);
-      }
-      return NULL;
+    const uint64_t now = monotonic_ms();
+    while (WHEEL.pending && WHEEL.now_ms <= now) {
+      wheel_tick();
+    }
+    if (!WHEEL.pending) {
+      pthread_cond_wait(&WHEEL.cond, &WHEEL.lock);
+      continue;
     }
 
-    // Phase 2: running — sleep for the period
-    struct timespec ts;
-    deadline_from_ms(t->period_ms, &ts);
-    t->needs_reset = false;
-
-    while (t->running && !t->delete_requested) {
-      int rc = pthread_cond_timedwait(&t->cond, &t->lock, &ts);
-      if (t->delete_requested) {
-        bool do_free = t->self_delete;
-        pthread_mutex_unlock(&t->lock);
-        if (do_free) {
-          pthread_mutex_destroy(&t->lock);
-          pthread_cond_destroy(&t->cond);
-          free(t);
-        }
-        return NULL;
-      }
-      if (!t->running) {
-        break; // stopped
-      }
-      if (t->needs_reset) {
-        t->needs_reset = false;
-        deadline_from_ms(t->period_ms, &ts);
-        continue;
-      }
-      if (rc == ETIMEDOUT) {
-        // Fire the callback (unlock during callback to avoid deadlock)
-        BmTimerCallback cb = t->cb;
-        pthread_mutex_unlock(&t->lock);
-        cb((BmTimer)t);
-        pthread_mutex_lock(&t->lock);
-        if (t->auto_reload && t->running && !t->delete_requested) {
-          deadline_from_ms(t->period_ms, &ts);
-          continue;
-        } else {
-          t->running = false;
-          break;
-        }
-      }
-      // Spurious wakeup — just re-wait with same deadline
+    // Sleep until the next tick with timers to fire or until the lowest
+    // level wraps, whichever comes first
+    uint64_t wake = WHEEL.now_ms;
+    while ((wake & timer_wheel_mask) &&
+           !WHEEL.slots[0][wake & timer_wheel_mask]) {
+      wake++;
+    }
+    if (wake > now) {
+      struct timespec ts;
+      deadline_from_ms((uint32_t)(wake - now), &ts);
+      pthread_cond_timedwait(&WHEEL.cond, &WHEEL.lock, &ts);
     }
   }
+  return NULL;
+}
+
+static void timer_service_start(void) {
+  pthread_t thread;
+  if (cond_init(&WHEEL.cond) != 0) {
+    return;
+  }
+  if (pthread_create(&thread, NULL, timer_service_thread, NULL) == 0) {
+    pthread_detach(thread);
+    WHEEL.started = true;
+  }
 }
 
 BmTimer bm_timer_create(const char *name, uint32_t period_ms, bool auto_reload,
                         void *timer_id, BmTimerCallback cb) {
   (void)name;
+  pthread_once(&WHEEL.once, timer_service_start);
+  if (!WHEEL.started || !cb) {
+    return NULL;
+  }
   PosixTimer *t = (PosixTimer *)calloc(1, sizeof(*t));
   if (!t) {
     return NULL;
   }
-  pthread_mutex_init(&t->lock, NULL);
-  pthread_cond_init(&t->cond, NULL);
   t->period_ms = period_ms;
   t->auto_reload = auto_reload;
   t->timer_id = timer_id;
   t->cb = cb;
-
-  int rc = pthread_create(&t->thread, NULL, posix_timer_thread, t);
-  if (rc != 0) {
-    pthread_mutex_destroy(&t->lock);
-    pthread_cond_destroy(&t->cond);
-    free(t);
-    return NULL;
-  }
-  t->thread_created = true;
-  pthread_detach(t->thread);
   return (BmTimer)t;
 }
 
@@ -576,53 +1420,44 @@ static int timed_mutex_lock(pthread_mutex_t *lock, uint32_t timeout_ms) {
   if (timeout_ms == 0) {
     return pthread_mutex_trylock(lock) == 0 ? 0 : ETIMEDOUT;
   }
-  struct timespec deadline;
-  deadline_from_ms(timeout_ms, &deadline);
-  static const struct timespec sleep_interval = {0, 1000000L}; // 1 ms
+  uint64_t deadline = monotonic_ns() + (uint64_t)timeout_ms * 1000000ULL;
   for (;;) {
     if (pthread_mutex_trylock(lock) == 0) {
       return 0;
     }
-    struct timespec now;
-    clock_gettime(CLOCK_REALTIME, &now);
-    if (now.tv_sec > deadline.tv_sec ||
-        (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec)) {
+    if (monotonic_ns() >= deadline) {
       return ETIMEDOUT;
     }
-    nanosleep(&sleep_interval, NULL);
+    sleep_ns(1000000ULL); // 1 ms
   }
 }
 
 void bm_timer_delete(BmTimer timer, uint32_t timeout_ms) {
   PosixTimer *t = (PosixTimer *)timer;
-  if (!t) {
+  if (!t || timed_mutex_lock(&WHEEL.lock, timeout_ms) != 0) {
     return;
   }
-  // If called from within this timer's own callback thread, destroying the
-  // mutex here would crash posix_timer_thread when it tries to relock after
-  // the callback returns.  Mark for deferred self-cleanup instead.
-  if (t->thread_created && pthread_equal(pthread_self(), t->thread)) {
-    if (timed_mutex_lock(&t->lock, timeout_ms) != 0) {
-      return;
-    }
-    t->delete_requested = true;
-    t->running = false;
-    t->self_delete = true;
-    pthread_mutex_unlock(&t->lock);
-    return; // posix_timer_thread will free memory after cb() returns
+  if (t->pprev) {
+    timer_remove(t);
   }
-  if (timed_mutex_lock(&t->lock, timeout_ms) != 0) {
-    return;
+  if (WHEEL.firing == t) {
+    // Deleted from its own callback or while it runs, the service thread
+    // frees it once the callback returns
+    WHEEL.firing_deleted = true;
+  } else {
+    free(t);
   }
-  t->delete_requested = true;
-  pthread_cond_signal(&t->cond);
-  pthread_mutex_unlock(&t->lock);
-  // Thread is detached; give it a moment to notice the delete flag and exit.
-  struct timespec delay = {0, 1000000L}; // 1 ms
-  nanosleep(&delay, NULL);
-  pthread_mutex_destroy(&t->lock);
-  pthread_cond_destroy(&t->cond);
-  free(t);
+  pthread_mutex_unlock(&WHEEL.lock);
+}
+
+// (Re)start a timer a full period from now, with the wheel lock held.
+static void timer_restart(PosixTimer *t) {
+  if (t->pprev) {
+    timer_remove(t);
+  }
+  t->expiry_ms = monotonic_ms() + t->period_ms;
+  timer_add(t);
+  pthread_cond_signal(&WHEEL.cond);
 }
 
 BmErr bm_timer_reset(BmTimer timer, uint32_t timeout_ms) {
@@ -630,29 +1465,16 @@ BmErr bm_timer_reset(BmTimer timer, uint32_t timeout_ms) {
   if (!t) {
     return BmEINVAL;
   }
-  if (timed_mutex_lock(&t->lock, timeout_ms) != 0) {
+  if (timed_mutex_lock(&WHEEL.lock, timeout_ms) != 0) {
     return BmETIMEDOUT;
   }
-  t->running = true;
-  t->needs_reset = true;
-  pthread_cond_signal(&t->cond);
-  pthread_mutex_unlock(&t->lock);
+  timer_restart(t);
+  pthread_mutex_unlock(&WHEEL.lock);
   return BmOK;
 }
 
 BmErr bm_timer_start(BmTimer timer, uint32_t timeout_ms) {
-  PosixTimer *t = (PosixTimer *)timer;
-  if (!t) {
-    return BmEINVAL;
-  }
-  if (timed_mutex_lock(&t->lock, timeout_ms) != 0) {
-    return BmETIMEDOUT;
-  }
-  t->running = true;
-  t->needs_reset = true;
-  pthread_cond_signal(&t->cond);
-  pthread_mutex_unlock(&t->lock);
-  return BmOK;
+  return bm_timer_reset(timer, timeout_ms);
 }
 
 BmErr bm_timer_stop(BmTimer timer, uint32_t timeout_ms) {
@@ -660,12 +1482,13 @@ BmErr bm_timer_stop(BmTimer timer, uint32_t timeout_ms) {
   if (!t) {
     return BmEINVAL;
   }
-  if (timed_mutex_lock(&t->lock, timeout_ms) != 0) {
+  if (timed_mutex_lock(&WHEEL.lock, timeout_ms) != 0) {
     return BmETIMEDOUT;
   }
-  t->running = false;
-  pthread_cond_signal(&t->cond);
-  pthread_mutex_unlock(&t->lock);
+  if (t->pprev) {
+    timer_remove(t);
+  }
+  pthread_mutex_unlock(&WHEEL.lock);
   return BmOK;
 }
 
@@ -675,17 +1498,26 @@ BmErr bm_timer_change_period(BmTimer timer, uint32_t period_ms,
   if (!t) {
     return BmEINVAL;
   }
-  if (timed_mutex_lock(&t->lock, timeout_ms) != 0) {
+  if (timed_mutex_lock(&WHEEL.lock, timeout_ms) != 0) {
     return BmETIMEDOUT;
   }
   t->period_ms = period_ms;
-  t->running = true;
-  t->needs_reset = true;
-  pthread_cond_signal(&t->cond);
-  pthread_mutex_unlock(&t->lock);
+  timer_restart(t);
+  pthread_mutex_unlock(&WHEEL.lock);
   return BmOK;
 }
 
+BmErr bm_timer_is_timer_active(BmTimer timer) {
+  PosixTimer *t = (PosixTimer *)timer;
+  if (!t) {
+    return BmEINVAL;
+  }
+  pthread_mutex_lock(&WHEEL.lock);
+  const bool active = t->pprev != NULL;
+  pthread_mutex_unlock(&WHEEL.lock);
+  return active ? BmOK : BmETIME;
+}
+
 uint32_t bm_timer_get_id(BmTimer timer) {
   PosixTimer *t = (PosixTimer *)timer;
   if (!t) {
@@ -705,7 +1537,12 @@ uint32_t bm_get_tick_count(void) {
 uint32_t bm_get_tick_count_from_isr(void) { return bm_get_tick_count(); }
 uint32_t bm_ms_to_ticks(uint32_t ms) { return ms; }
 uint32_t bm_ticks_to_ms(uint32_t ticks) { return ticks; }
-void bm_delay(uint32_t ms) {
-  struct timespec delay = {ms / 1000, (ms % 1000) * 1000000L};
-  nanosleep(&delay, NULL);
+/// Monotonic time in microseconds, for timestamps finer than a tick
+uint64_t bm_get_time_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
 }
+/// Monotonic time in nanoseconds, for interval measurement below 1 us
+uint64_t bm_get_time_ns(void) { return monotonic_ns(); }
+void bm_delay(uint32_t ms) { sleep_ns((uint64_t)ms * 1000000ULL); }
@@ -0,0 +1,54 @@
+#pragma once
+
+/// @file bm_posix.h
+/// @brief POSIX-only extensions to bm_os.h for hosted builds (bm_sbc).
+///
+/// bm_task_create takes a FreeRTOS style priority. On POSIX each bm priority
+/// maps to a scheduling policy, a policy priority and an optional CPU set,
+/// so datapath tasks (L2, BCMP, middleware) can run under SCHED_FIFO or
+/// SCHED_RR on dedicated cores while application load stays elsewhere.
+///
+/// Scheduling is best effort. When the process lacks the privilege to use a
+/// real-time policy (no CAP_SYS_NICE or RLIMIT_RTPRIO) or the CPU set names
+/// cores that do not exist, the task still starts under the default policy
+/// and the failure is counted in BmPosixTaskStats.
+
+#include "bm_os.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Scheduling policy applied to tasks created at a bm priority
+typedef enum {
+  BmPosixSchedOther = 0,
+  BmPosixSchedFifo,
+  BmPosixSchedRr,
+} BmPosixSchedPolicy;
+
+typedef struct {
+  BmPosixSchedPolicy policy;
+  /// Policy priority for FIFO/RR, clamped to sched_get_priority_min/max.
+  /// Ignored for BmPosixSchedOther.
+  int sched_priority;
+  /// Bit n allows CPU n. 0 leaves the inherited affinity untouched.
+  /// Only applied on Linux.
+  uint64_t cpu_mask;
+} BmPosixTaskSched;
+
+typedef struct {
+  /// Tasks that asked for FIFO/RR but run under the default policy
+  uint32_t sched_denied;
+  /// Tasks whose CPU set could not be applied
+  uint32_t affinity_denied;
+} BmPosixTaskStats;
+
+BmErr bm_posix_task_sched_set(uint32_t priority, const BmPosixTaskSched *sched);
+BmErr bm_posix_task_sched_get(uint32_t priority, BmPosixTaskSched *sched);
+void bm_posix_task_stats(BmPosixTaskStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
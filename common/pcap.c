@@ -1,11 +1,13 @@
 #include "pcap.h"
 #include "bm_os.h"
+#include <stdio.h>
 #include <string.h>
 
 /*
 References:
 - https://wiki.wireshark.org/Development/LibpcapFileFormat
 - https://datatracker.ietf.org/doc/draft-ietf-opsawg-pcap/
+- https://datatracker.ietf.org/doc/draft-ietf-opsawg-pcapng/
 
 File Header diagram from IETF draft, corresponding to PcapHeader struct:
 
@@ -40,6 +42,41 @@ Packet Record diagram from IETF draft, corresponding to PcapRecordHeader struct:
       /                          Packet Data                          /
       /                  variable length, not padded                  /
       /                                                               /
+
+pcapng Enhanced Packet Block diagram from IETF draft, corresponding to
+PcapngPacketHeader followed by the padded packet data and PcapngPacketTrailer:
+
+                           1                   2                   3
+       0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+      +---------------------------------------------------------------+
+    0 |                    Block Type = 0x00000006                    |
+      +---------------------------------------------------------------+
+    4 |                      Block Total Length                       |
+      +---------------------------------------------------------------+
+    8 |                         Interface ID                          |
+      +---------------------------------------------------------------+
+   12 |                        Timestamp (High)                       |
+      +---------------------------------------------------------------+
+   16 |                        Timestamp (Low)                        |
+      +---------------------------------------------------------------+
+   20 |                    Captured Packet Length                     |
+      +---------------------------------------------------------------+
+   24 |                    Original Packet Length                     |
+      +---------------------------------------------------------------+
+   28 /                                                               /
+      /                          Packet Data                          /
+      /              variable length, padded to 32 bits               /
+      /                                                               /
+      +---------------------------------------------------------------+
+      /                                                               /
+      /                      Options (variable)                       /
+      /                                                               /
+      +---------------------------------------------------------------+
+      |                      Block Total Length                       |
+      +---------------------------------------------------------------+
+
+One Interface Description Block is written per L2 port, interface ID
+port_num - 1, with a microsecond timestamp resolution.
 */
 
 typedef struct {
@@ -59,8 +96,87 @@ typedef struct {
   uint32_t orig_len;
 } __attribute__((packed)) PcapRecordHeader;
 
+#define pcapng_block_type_shb (0x0A0D0D0AU)
+#define pcapng_block_type_idb (0x00000001U)
+#define pcapng_block_type_epb (0x00000006U)
+#define pcapng_byte_order_magic (0x1A2B3C4DU)
+#define pcapng_opt_endofopt (0U)
+#define pcapng_opt_if_name (2U)
+#define pcapng_opt_if_tsresol (9U)
+#define pcapng_opt_epb_flags (2U)
+#define pcapng_epb_flags_inbound (1U)
+#define pcapng_epb_flags_outbound (2U)
+#define pcapng_tsresol_us (6U)
+#define pcapng_pad(len) (((len) + 3U) & ~3U)
+
+typedef struct {
+  uint32_t block_type;
+  uint32_t block_total_length;
+  uint32_t byte_order_magic;
+  uint16_t major_version;
+  uint16_t minor_version;
+  int64_t section_length;
+  uint32_t block_total_length_trailer;
+} __attribute__((packed)) PcapngSectionHeader;
+
+typedef struct {
+  uint32_t block_type;
+  uint32_t block_total_length;
+  uint16_t link_type;
+  uint16_t reserved;
+  uint32_t snap_len;
+} __attribute__((packed)) PcapngInterfaceHeader;
+
+typedef struct {
+  uint16_t code;
+  uint16_t length;
+} __attribute__((packed)) PcapngOption;
+
+typedef struct {
+  uint32_t block_type;
+  uint32_t block_total_length;
+  uint32_t interface_id;
+  uint32_t ts_high;
+  uint32_t ts_low;
+  uint32_t captured_len;
+  uint32_t original_len;
+} __attribute__((packed)) PcapngPacketHeader;
+
+typedef struct {
+  PcapngOption flags_option;
+  uint32_t flags;
+  PcapngOption end_option;
+  uint32_t block_total_length;
+} __attribute__((packed)) PcapngPacketTrailer;
+
+_Static_assert((pcap_async_ring_size & (pcap_async_ring_size - 1)) == 0,
+               "pcap_async_ring_size must be a power of two");
+_Static_assert(pcap_async_ring_size >=
+                   sizeof(PcapngPacketHeader) +
+                       pcapng_pad(pcap_async_snap_len) +
+                       sizeof(PcapngPacketTrailer),
+               "pcap_async_ring_size must hold at least one record");
+
+#define ring_mask (pcap_async_ring_size - 1)
+
+// Single-producer, single-consumer byte ring holding formatted pcapng
+// Enhanced Packet Blocks.
+// head and tail are free running, only the producer moves head and only the
+// drain task moves tail. A record is published by moving head past it, so
+// the bytes between tail and head are always whole records.
+typedef struct {
+  uint8_t *buf;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t captured;
+  uint32_t dropped;
+} PcapRing;
+
 static PcapWriteCb s_write_cb;
 static void *s_write_ctx;
+static uint8_t s_num_ports;
+static PcapRing s_rings[PcapDirectionCount];
+static BmTaskHandle s_drain_task;
 
 void pcap_init(PcapWriteCb write_cb, void *ctx) {
   s_write_cb = write_cb;
@@ -84,11 +200,11 @@ void pcap_write_packet(const uint8_t *frame, size_t len) {
     return;
   }
 
-  uint32_t ms = bm_ticks_to_ms(bm_get_tick_count());
+  uint64_t us = bm_get_time_us();
 
   PcapRecordHeader rec = {
-      .ts_sec = ms / 1000,
-      .ts_usec = (ms % 1000) * 1000,
+      .ts_sec = (uint32_t)(us / 1000000U),
+      .ts_usec = (uint32_t)(us % 1000000U),
       .incl_len = (uint32_t)len,
       .orig_len = (uint32_t)len,
   };
@@ -96,3 +212,260 @@ void pcap_write_packet(const uint8_t *frame, size_t len) {
   s_write_cb((const uint8_t *)&rec, sizeof(rec), s_write_ctx);
   s_write_cb(frame, len, s_write_ctx);
 }
+
+static void pcapng_write_interface(uint8_t port_num) {
+  // Header, if_name "portNN" padded, if_tsresol padded, endofopt, length
+  uint8_t block[sizeof(PcapngInterfaceHeader) + sizeof(PcapngOption) + 8 +
+                sizeof(PcapngOption) + 4 + sizeof(PcapngOption) +
+                sizeof(uint32_t)] = {0};
+  char name[8];
+  const uint16_t name_len =
+      (uint16_t)snprintf(name, sizeof(name), "port%u", port_num);
+  size_t offset = sizeof(PcapngInterfaceHeader);
+
+  PcapngOption option = {.code = pcapng_opt_if_name, .length = name_len};
+  memcpy(&block[offset], &option, sizeof(option));
+  offset += sizeof(option);
+  memcpy(&block[offset], name, name_len);
+  offset += pcapng_pad(name_len);
+
+  option = (PcapngOption){.code = pcapng_opt_if_tsresol, .length = 1};
+  memcpy(&block[offset], &option, sizeof(option));
+  offset += sizeof(option);
+  block[offset] = pcapng_tsresol_us;
+  offset += pcapng_pad(1U);
+
+  option = (PcapngOption){.code = pcapng_opt_endofopt, .length = 0};
+  memcpy(&block[offset], &option, sizeof(option));
+  offset += sizeof(option);
+
+  const uint32_t total_len = (uint32_t)(offset + sizeof(uint32_t));
+  const PcapngInterfaceHeader header = {
+      .block_type = pcapng_block_type_idb,
+      .block_total_length = total_len,
+      .link_type = 1, // LINKTYPE_ETHERNET
+      .reserved = 0,
+      .snap_len = 65535,
+  };
+  memcpy(block, &header, sizeof(header));
+  memcpy(&block[offset], &total_len, sizeof(total_len));
+
+  s_write_cb(block, total_len, s_write_ctx);
+}
+
+void pcapng_init(PcapWriteCb write_cb, void *ctx, uint8_t num_ports) {
+  s_write_cb = write_cb;
+  s_write_ctx = ctx;
+  s_num_ports = num_ports;
+
+  static const PcapngSectionHeader header = {
+      .block_type = pcapng_block_type_shb,
+      .block_total_length = sizeof(PcapngSectionHeader),
+      .byte_order_magic = pcapng_byte_order_magic,
+      .major_version = 1,
+      .minor_version = 0,
+      .section_length = -1, // not specified
+      .block_total_length_trailer = sizeof(PcapngSectionHeader),
+  };
+
+  s_write_cb((const uint8_t *)&header, sizeof(header), s_write_ctx);
+  for (uint8_t port_num = 1; port_num <= num_ports; port_num++) {
+    pcapng_write_interface(port_num);
+  }
+}
+
+// Fills in everything around the packet data of an Enhanced Packet Block and
+// returns the total block length.
+static uint32_t pcapng_packet_block(PcapngPacketHeader *header,
+                                    PcapngPacketTrailer *trailer,
+                                    uint8_t port_num, PcapDirection dir,
+                                    uint32_t captured_len,
+                                    uint32_t original_len) {
+  const uint32_t total_len = (uint32_t)(sizeof(PcapngPacketHeader) +
+                                        pcapng_pad(captured_len) +
+                                        sizeof(PcapngPacketTrailer));
+  const uint64_t us = bm_get_time_us();
+
+  *header = (PcapngPacketHeader){
+      .block_type = pcapng_block_type_epb,
+      .block_total_length = total_len,
+      .interface_id = port_num - 1U,
+      .ts_high = (uint32_t)(us >> 32),
+      .ts_low = (uint32_t)us,
+      .captured_len = captured_len,
+      .original_len = original_len,
+  };
+  *trailer = (PcapngPacketTrailer){
+      .flags_option = {.code = pcapng_opt_epb_flags, .length = 4},
+      .flags = dir == PcapDirectionInbound ? pcapng_epb_flags_inbound
+                                           : pcapng_epb_flags_outbound,
+      .end_option = {.code = pcapng_opt_endofopt, .length = 0},
+      .block_total_length = total_len,
+  };
+
+  return total_len;
+}
+
+void pcapng_write_packet(const uint8_t *frame, size_t len, uint8_t port_num,
+                         PcapDirection dir) {
+  static const uint8_t padding[3] = {0};
+  if (!s_write_cb || !frame || len == 0 || port_num == 0 ||
+      port_num > s_num_ports || dir >= PcapDirectionCount) {
+    return;
+  }
+
+  PcapngPacketHeader header;
+  PcapngPacketTrailer trailer;
+  pcapng_packet_block(&header, &trailer, port_num, dir, (uint32_t)len,
+                      (uint32_t)len);
+
+  s_write_cb((const uint8_t *)&header, sizeof(header), s_write_ctx);
+  s_write_cb(frame, len, s_write_ctx);
+  if (pcapng_pad(len) != len) {
+    s_write_cb(padding, pcapng_pad(len) - len, s_write_ctx);
+  }
+  s_write_cb((const uint8_t *)&trailer, sizeof(trailer), s_write_ctx);
+}
+
+static void ring_write(PcapRing *ring, uint32_t pos, const void *data,
+                       uint32_t len) {
+  const uint32_t offset = pos & ring_mask;
+  const uint32_t first =
+      len < pcap_async_ring_size - offset ? len : pcap_async_ring_size - offset;
+  memcpy(&ring->buf[offset], data, first);
+  memcpy(ring->buf, (const uint8_t *)data + first, len - first);
+}
+
+static void pcap_async_task(void *arg) {
+  (void)arg;
+  while (true) {
+    pcap_async_drain();
+    bm_delay(pcap_async_drain_period_ms);
+  }
+}
+
+BmErr pcap_async_init(PcapWriteCb write_cb, void *ctx, uint8_t num_ports) {
+  if (!write_cb) {
+    return BmEINVAL;
+  }
+  if (s_rings[0].buf) {
+    return BmEALREADY;
+  }
+
+  for (uint8_t i = 0; i < PcapDirectionCount; i++) {
+    s_rings[i] = (PcapRing){0};
+    s_rings[i].buf = (uint8_t *)bm_malloc(pcap_async_ring_size);
+    if (!s_rings[i].buf) {
+      pcap_async_deinit();
+      return BmENOMEM;
+    }
+  }
+
+  pcapng_init(write_cb, ctx, num_ports);
+  if (bm_task_create(pcap_async_task, "pcap", 1024, NULL,
+                     pcap_async_task_priority, &s_drain_task) != BmOK) {
+    pcap_async_deinit();
+    return BmENOMEM;
+  }
+
+  return BmOK;
+}
+
+void pcap_async_deinit(void) {
+  if (s_drain_task) {
+    bm_task_delete(s_drain_task);
+    s_drain_task = NULL;
+  }
+  for (uint8_t i = 0; i < PcapDirectionCount; i++) {
+    if (s_rings[i].buf) {
+      bm_free(s_rings[i].buf);
+    }
+    s_rings[i] = (PcapRing){0};
+  }
+}
+
+void pcap_async_capture(const uint8_t *frame, size_t len, uint8_t port_num,
+                        PcapDirection dir) {
+  static const uint8_t padding[3] = {0};
+  if (dir >= PcapDirectionCount || !frame || len == 0 || port_num == 0 ||
+      port_num > s_num_ports) {
+    return;
+  }
+  PcapRing *ring = &s_rings[dir];
+  if (!ring->buf) {
+    return;
+  }
+
+  const uint32_t incl_len =
+      len > pcap_async_snap_len ? pcap_async_snap_len : (uint32_t)len;
+  const uint32_t record_len = sizeof(PcapngPacketHeader) +
+                              pcapng_pad(incl_len) +
+                              sizeof(PcapngPacketTrailer);
+  uint32_t head = ring->head;
+  const uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  if (pcap_async_ring_size - (head - tail) < record_len) {
+    __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  PcapngPacketHeader header;
+  PcapngPacketTrailer trailer;
+  pcapng_packet_block(&header, &trailer, port_num, dir, incl_len,
+                      (uint32_t)len);
+  const uint32_t start = head;
+  ring_write(ring, head, &header, sizeof(header));
+  head += sizeof(header);
+  ring_write(ring, head, frame, incl_len);
+  head += incl_len;
+  ring_write(ring, head, padding, pcapng_pad(incl_len) - incl_len);
+  head += pcapng_pad(incl_len) - incl_len;
+  ring_write(ring, head, &trailer, sizeof(trailer));
+
+  __atomic_store_n(&ring->head, start + record_len, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&ring->captured, 1, __ATOMIC_RELAXED);
+}
+
+size_t pcap_async_drain(void) {
+  size_t written = 0;
+
+  for (uint8_t i = 0; i < PcapDirectionCount && s_write_cb; i++) {
+    PcapRing *ring = &s_rings[i];
+    if (!ring->buf) {
+      continue;
+    }
+
+    const uint32_t tail = ring->tail;
+    const uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    const uint32_t len = head - tail;
+    if (len == 0) {
+      continue;
+    }
+
+    // At most two writes, the second one only when the run wraps around
+    const uint32_t offset = tail & ring_mask;
+    const uint32_t first = len < pcap_async_ring_size - offset
+                               ? len
+                               : pcap_async_ring_size - offset;
+    s_write_cb(&ring->buf[offset], first, s_write_ctx);
+    if (len > first) {
+      s_write_cb(ring->buf, len - first, s_write_ctx);
+    }
+
+    __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+    written += len;
+  }
+
+  return written;
+}
+
+void pcap_async_get_stats(PcapAsyncStats *stats) {
+  if (!stats) {
+    return;
+  }
+
+  *stats = (PcapAsyncStats){0};
+  for (uint8_t i = 0; i < PcapDirectionCount; i++) {
+    stats->captured += __atomic_load_n(&s_rings[i].captured, __ATOMIC_RELAXED);
+    stats->dropped += __atomic_load_n(&s_rings[i].dropped, __ATOMIC_RELAXED);
+  }
+}
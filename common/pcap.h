@@ -3,14 +3,24 @@
 /// @file pcap.h
 /// @brief Sink-agnostic pcap stream formatter.
 ///
-/// Formats L2 Ethernet frames as pcap records and pushes the raw bytes
-/// through a caller-supplied write callback.  The callback can target a
-/// file, serial port, ring buffer, or any other byte sink.
+/// Formats L2 Ethernet frames as classic pcap or pcapng records and pushes
+/// the raw bytes through a caller-supplied write callback.  The callback can
+/// target a file, serial port, ring buffer, or any other byte sink.
+///
+/// pcapng output records the L2 port (one interface per port), the
+/// direction and microsecond timestamps, which is enough to measure the
+/// forwarding delay of each hop from captures alone.
 ///
 /// Thread safety is the caller's responsibility — if the write callback
 /// can be invoked from multiple threads (e.g. separate RX and TX paths),
 /// the callback itself must synchronise access to its sink.
+///
+/// pcap_write_packet and pcapng_write_packet run the write callback
+/// synchronously.  For capturing
+/// from the datapath use the pcap_async_* functions, which only copy the
+/// frame into a ring and leave the writes to a background task.
 
+#include "util.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -18,6 +28,42 @@
 extern "C" {
 #endif
 
+/// Size in bytes of each asynchronous capture ring, must be a power of two.
+#ifndef pcap_async_ring_size
+#define pcap_async_ring_size (8192U)
+#endif
+
+/// Frames longer than this are truncated in asynchronous captures, which
+/// bounds the copy made on the datapath.
+#ifndef pcap_async_snap_len
+#define pcap_async_snap_len (1518U)
+#endif
+
+/// How often the drain task flushes the capture rings to the sink.
+#ifndef pcap_async_drain_period_ms
+#define pcap_async_drain_period_ms (10U)
+#endif
+
+#ifndef pcap_async_task_priority
+#define pcap_async_task_priority (2U)
+#endif
+
+/// Whether a frame was received or sent, written as the pcapng EPB flags.
+///
+/// For asynchronous capture each direction has its own single-producer
+/// ring, so all captures of one direction must come from the same thread
+/// (L2 captures RX in the driver callback, TX in the L2 thread).
+typedef enum {
+  PcapDirectionInbound,
+  PcapDirectionOutbound,
+  PcapDirectionCount,
+} PcapDirection;
+
+typedef struct {
+  uint32_t captured; ///< Records placed in the rings.
+  uint32_t dropped;  ///< Records dropped because a ring was full.
+} PcapAsyncStats;
+
 /// Callback invoked by the pcap formatter to emit raw bytes.
 ///
 /// @param data  Pointer to the bytes to write.
@@ -36,12 +82,82 @@ void pcap_init(PcapWriteCb write_cb, void *ctx);
 
 /// Write one L2 Ethernet frame as a pcap packet record.
 ///
-/// Timestamps are derived from bm_get_tick_count() / bm_ticks_to_ms().
+/// Timestamps are derived from bm_get_time_us().
 ///
 /// @param frame  Pointer to the raw L2 Ethernet frame.
 /// @param len    Length of the frame in bytes.
 void pcap_write_packet(const uint8_t *frame, size_t len);
 
+/// Initialise a pcapng stream.
+///
+/// Stores the write callback and immediately writes a Section Header Block
+/// followed by one Interface Description Block per L2 port.  Interface IDs
+/// are port_num - 1, named "port<n>", with microsecond timestamps.
+///
+/// @param write_cb   Byte-sink callback.
+/// @param ctx        Opaque context forwarded to every @p write_cb call.
+/// @param num_ports  Number of L2 ports, see bm_l2_get_port_count().
+void pcapng_init(PcapWriteCb write_cb, void *ctx, uint8_t num_ports);
+
+/// Write one L2 Ethernet frame as a pcapng Enhanced Packet Block.
+///
+/// Timestamps are derived from bm_get_time_us().
+///
+/// @param frame     Pointer to the raw L2 Ethernet frame.
+/// @param len       Length of the frame in bytes.
+/// @param port_num  L2 port the frame was received or sent on, 1-15.
+/// @param dir       Direction, written as the EPB flags.
+void pcapng_write_packet(const uint8_t *frame, size_t len, uint8_t port_num,
+                         PcapDirection dir);
+
+/// Initialise asynchronous capture.
+///
+/// Writes the pcapng section and interface headers through @p write_cb like
+/// pcapng_init, then
+/// allocates one lock-free single-producer, single-consumer ring per
+/// direction and starts a low priority task that periodically drains them.
+/// Records are stored in the rings already formatted, so the drain task
+/// hands the sink large contiguous runs of records instead of two writes
+/// per frame.
+///
+/// @param write_cb   Byte-sink callback, only invoked from the drain task
+///                   after the headers have been written.
+/// @param ctx        Opaque context forwarded to every @p write_cb call.
+/// @param num_ports  Number of L2 ports, see bm_l2_get_port_count().
+///
+/// @return BmOK on success, BmEALREADY if already initialised, BmENOMEM if
+///         the rings or the drain task could not be created.
+BmErr pcap_async_init(PcapWriteCb write_cb, void *ctx, uint8_t num_ports);
+
+/// Stop asynchronous capture and free the rings, pending records are lost.
+void pcap_async_deinit(void);
+
+/// Capture one L2 Ethernet frame as a pcapng Enhanced Packet Block without
+/// blocking.
+///
+/// Costs one bounded copy into the ring of @p dir.  When the ring does not
+/// have room for the block it is dropped and counted.
+///
+/// @param frame     Pointer to the raw L2 Ethernet frame.
+/// @param len       Length of the frame in bytes.
+/// @param port_num  L2 port the frame was received or sent on, 1-15.
+/// @param dir       Direction, selects the ring (see PcapDirection).
+void pcap_async_capture(const uint8_t *frame, size_t len, uint8_t port_num,
+                        PcapDirection dir);
+
+/// Write everything currently in the rings to the sink.
+///
+/// Called periodically by the drain task, may also be called directly to
+/// flush, but never concurrently with the drain task.
+///
+/// @return Number of bytes handed to the sink.
+size_t pcap_async_drain(void);
+
+/// Read the asynchronous capture counters.
+///
+/// @param stats  Filled with the current counters.
+void pcap_async_get_stats(PcapAsyncStats *stats);
+
 #ifdef __cplusplus
 }
 #endif
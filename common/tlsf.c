@@ -0,0 +1,305 @@
+/// @file tlsf.c
+/// @brief Two-level segregated fit allocator.
+///
+/// The first level splits block sizes by power of two and the second level
+/// splits each power of two into tlsf_sl_count linear ranges. A bitmap per
+/// level finds the smallest non-empty list that fits a request in constant
+/// time. Free physical neighbours are merged on free, so no two free blocks
+/// are ever adjacent.
+
+#include "tlsf.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Payloads are aligned to two pointers, which is also the header size
+#define tlsf_align (2U * sizeof(void *))
+#define tlsf_align_log2 (sizeof(void *) == 8 ? 4U : 3U)
+
+#define tlsf_sl_log2 4U
+#define tlsf_sl_count (1U << tlsf_sl_log2)
+// Sizes below this share first level 0, split linearly in tlsf_align steps
+#define tlsf_fl_shift (tlsf_sl_log2 + tlsf_align_log2)
+#define tlsf_small_block (1U << tlsf_fl_shift)
+// Blocks are kept below 1 GiB
+#define tlsf_fl_max 30U
+#define tlsf_fl_count (tlsf_fl_max - tlsf_fl_shift + 1U)
+
+#define tlsf_block_free 0x1U
+#define tlsf_prev_free 0x2U
+#define tlsf_flags (tlsf_block_free | tlsf_prev_free)
+
+/// Physical block header. prev_phys is only valid while the previous block
+/// is free. size is the payload size with the flag bits above.
+typedef struct TlsfBlock {
+  struct TlsfBlock *prev_phys;
+  size_t size;
+} TlsfBlock;
+
+/// Free list links, stored in the payload of free blocks
+typedef struct {
+  TlsfBlock *next;
+  TlsfBlock *prev;
+} TlsfLinks;
+
+#define tlsf_header sizeof(TlsfBlock)
+#define tlsf_block_min sizeof(TlsfLinks)
+#define tlsf_block_max (((size_t)1 << tlsf_fl_max) - tlsf_align)
+
+struct BmTlsf {
+  uint32_t fl_bitmap;
+  uint32_t sl_bitmap[tlsf_fl_count];
+  TlsfBlock *blocks[tlsf_fl_count][tlsf_sl_count];
+  size_t total_bytes;
+  size_t live_bytes;
+  size_t high_water;
+  uint32_t failed;
+  uint32_t alloc_count[bm_heap_size_classes];
+};
+
+static size_t align_up(size_t x) {
+  return (x + tlsf_align - 1) & ~(size_t)(tlsf_align - 1);
+}
+
+static uint32_t fls_size(size_t x) {
+  return 63U - (uint32_t)__builtin_clzll((unsigned long long)x);
+}
+
+static uint32_t fls_u32(uint32_t x) { return 31U - (uint32_t)__builtin_clz(x); }
+
+static uint32_t ffs_u32(uint32_t x) { return (uint32_t)__builtin_ctz(x); }
+
+static size_t block_size(const TlsfBlock *block) {
+  return block->size & ~(size_t)tlsf_flags;
+}
+
+static void *block_payload(const TlsfBlock *block) {
+  return (uint8_t *)block + tlsf_header;
+}
+
+static TlsfBlock *block_from_payload(const void *ptr) {
+  return (TlsfBlock *)((uint8_t *)ptr - tlsf_header);
+}
+
+static TlsfLinks *block_links(const TlsfBlock *block) {
+  return (TlsfLinks *)block_payload(block);
+}
+
+static TlsfBlock *block_next(const TlsfBlock *block) {
+  return (TlsfBlock *)((uint8_t *)block_payload(block) + block_size(block));
+}
+
+/// List that holds free blocks of exactly this size
+static void mapping_insert(size_t size, uint32_t *fl, uint32_t *sl) {
+  if (size < tlsf_small_block) {
+    *fl = 0;
+    *sl = (uint32_t)(size / tlsf_align);
+  } else {
+    uint32_t f = fls_size(size);
+    *sl = (uint32_t)(size >> (f - tlsf_sl_log2)) ^ tlsf_sl_count;
+    *fl = f - (tlsf_fl_shift - 1U);
+  }
+}
+
+/// First list whose blocks are all at least size bytes
+static void mapping_search(size_t size, uint32_t *fl, uint32_t *sl) {
+  if (size >= tlsf_small_block) {
+    size += ((size_t)1 << (fls_size(size) - tlsf_sl_log2)) - 1U;
+  }
+  mapping_insert(size, fl, sl);
+}
+
+static TlsfBlock *search_suitable(const BmTlsf *tlsf, uint32_t *fl,
+                                  uint32_t *sl) {
+  uint32_t sl_map = tlsf->sl_bitmap[*fl] & (~0U << *sl);
+  if (!sl_map) {
+    uint32_t fl_map = tlsf->fl_bitmap & (~0U << (*fl + 1U));
+    if (!fl_map) {
+      return NULL;
+    }
+    *fl = ffs_u32(fl_map);
+    sl_map = tlsf->sl_bitmap[*fl];
+  }
+  *sl = ffs_u32(sl_map);
+  return tlsf->blocks[*fl][*sl];
+}
+
+static void insert_free(BmTlsf *tlsf, TlsfBlock *block) {
+  uint32_t fl, sl;
+  mapping_insert(block_size(block), &fl, &sl);
+  TlsfBlock *head = tlsf->blocks[fl][sl];
+  block_links(block)->next = head;
+  block_links(block)->prev = NULL;
+  if (head) {
+    block_links(head)->prev = block;
+  }
+  tlsf->blocks[fl][sl] = block;
+  tlsf->fl_bitmap |= 1U << fl;
+  tlsf->sl_bitmap[fl] |= 1U << sl;
+}
+
+static void remove_free(BmTlsf *tlsf, TlsfBlock *block) {
+  uint32_t fl, sl;
+  mapping_insert(block_size(block), &fl, &sl);
+  TlsfLinks *links = block_links(block);
+  if (links->next) {
+    block_links(links->next)->prev = links->prev;
+  }
+  if (links->prev) {
+    block_links(links->prev)->next = links->next;
+  } else {
+    tlsf->blocks[fl][sl] = links->next;
+    if (!links->next) {
+      tlsf->sl_bitmap[fl] &= ~(1U << sl);
+      if (!tlsf->sl_bitmap[fl]) {
+        tlsf->fl_bitmap &= ~(1U << fl);
+      }
+    }
+  }
+}
+
+/// Return the tail of a free block beyond size to the free lists
+static void block_trim(BmTlsf *tlsf, TlsfBlock *block, size_t size) {
+  size_t total = block_size(block);
+  if (total < size + tlsf_header + tlsf_block_min) {
+    return;
+  }
+  TlsfBlock *rest = (TlsfBlock *)((uint8_t *)block_payload(block) + size);
+  rest->prev_phys = block;
+  rest->size = (total - size - tlsf_header) | tlsf_block_free;
+  block->size = size | (block->size & tlsf_flags);
+  TlsfBlock *next = block_next(rest);
+  next->prev_phys = rest;
+  next->size |= tlsf_prev_free;
+  insert_free(tlsf, rest);
+}
+
+static uint32_t size_class(size_t size) {
+  uint32_t n = 0;
+  while (n < bm_heap_size_classes - 1U && size > ((size_t)16U << n)) {
+    n++;
+  }
+  return n;
+}
+
+static uint32_t saturate_u32(size_t x) {
+  return x > UINT32_MAX ? UINT32_MAX : (uint32_t)x;
+}
+
+BmTlsf *bm_tlsf_create(void *mem, size_t bytes) {
+  if (!mem) {
+    return NULL;
+  }
+  uintptr_t start = (uintptr_t)align_up((uintptr_t)mem);
+  uintptr_t end = ((uintptr_t)mem + bytes) & ~(uintptr_t)(tlsf_align - 1);
+  size_t control = align_up(sizeof(BmTlsf));
+  if (end < start ||
+      end - start < control + 2U * tlsf_header + tlsf_block_min) {
+    return NULL;
+  }
+
+  BmTlsf *tlsf = (BmTlsf *)start;
+  memset(tlsf, 0, sizeof(*tlsf));
+
+  // One free block spanning the pool, closed by a zero sized used sentinel
+  TlsfBlock *first = (TlsfBlock *)(start + control);
+  size_t size = end - (uintptr_t)first - 2U * tlsf_header;
+  if (size > tlsf_block_max) {
+    size = tlsf_block_max;
+  }
+  first->prev_phys = NULL;
+  first->size = size | tlsf_block_free;
+  TlsfBlock *sentinel = block_next(first);
+  sentinel->prev_phys = first;
+  sentinel->size = tlsf_prev_free;
+  insert_free(tlsf, first);
+  tlsf->total_bytes = size;
+  return tlsf;
+}
+
+void *bm_tlsf_malloc(BmTlsf *tlsf, size_t size) {
+  if (!tlsf || !size) {
+    return NULL;
+  }
+  TlsfBlock *block = NULL;
+  size_t adjusted = 0;
+  uint32_t fl = 0, sl = 0;
+  if (size <= tlsf_block_max) {
+    adjusted = align_up(size);
+    if (adjusted < tlsf_block_min) {
+      adjusted = tlsf_block_min;
+    }
+    mapping_search(adjusted, &fl, &sl);
+    if (fl < tlsf_fl_count) {
+      block = search_suitable(tlsf, &fl, &sl);
+    }
+  }
+  if (!block) {
+    tlsf->failed++;
+    return NULL;
+  }
+
+  remove_free(tlsf, block);
+  block_trim(tlsf, block, adjusted);
+  block->size &= ~(size_t)tlsf_block_free;
+  block_next(block)->size &= ~(size_t)tlsf_prev_free;
+
+  tlsf->live_bytes += block_size(block);
+  if (tlsf->live_bytes > tlsf->high_water) {
+    tlsf->high_water = tlsf->live_bytes;
+  }
+  tlsf->alloc_count[size_class(size)]++;
+  return block_payload(block);
+}
+
+void bm_tlsf_free(BmTlsf *tlsf, void *ptr) {
+  if (!tlsf || !ptr) {
+    return;
+  }
+  TlsfBlock *block = block_from_payload(ptr);
+  if (block->size & tlsf_block_free) {
+    return;
+  }
+  tlsf->live_bytes -= block_size(block);
+  block->size |= tlsf_block_free;
+
+  if (block->size & tlsf_prev_free) {
+    TlsfBlock *prev = block->prev_phys;
+    remove_free(tlsf, prev);
+    prev->size += tlsf_header + block_size(block);
+    block = prev;
+  }
+  TlsfBlock *next = block_next(block);
+  if (next->size & tlsf_block_free) {
+    remove_free(tlsf, next);
+    block->size += tlsf_header + block_size(next);
+    next = block_next(block);
+  }
+  next->prev_phys = block;
+  next->size |= tlsf_prev_free;
+  insert_free(tlsf, block);
+}
+
+void bm_tlsf_stats(const BmTlsf *tlsf, BmHeapStats *stats) {
+  if (!tlsf || !stats) {
+    return;
+  }
+  // The largest free block sits in the highest non-empty list
+  size_t largest = 0;
+  if (tlsf->fl_bitmap) {
+    uint32_t fl = fls_u32(tlsf->fl_bitmap);
+    uint32_t sl = fls_u32(tlsf->sl_bitmap[fl]);
+    for (const TlsfBlock *b = tlsf->blocks[fl][sl]; b;
+         b = block_links(b)->next) {
+      if (block_size(b) > largest) {
+        largest = block_size(b);
+      }
+    }
+  }
+  stats->total_bytes = saturate_u32(tlsf->total_bytes);
+  stats->live_bytes = saturate_u32(tlsf->live_bytes);
+  stats->high_water = saturate_u32(tlsf->high_water);
+  stats->largest_free = saturate_u32(largest);
+  stats->failed = tlsf->failed;
+  memcpy(stats->alloc_count, tlsf->alloc_count, sizeof(stats->alloc_count));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+/// @file tlsf.h
+/// @brief Two-level segregated fit allocator over a caller supplied pool.
+///
+/// Free blocks are kept in size segregated lists indexed by a two level
+/// bitmap, so malloc and free run in constant time and fragmentation stays
+/// bounded. This makes TLSF a good fit for long running nodes.
+///
+/// The allocator does no locking. bm_malloc serializes calls when
+/// bm_heap_tlsf selects it.
+
+#include "bm_os.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct BmTlsf BmTlsf;
+
+/// Lay out an allocator at the start of mem. Returns NULL when the region
+/// is too small for the control structure and one block.
+BmTlsf *bm_tlsf_create(void *mem, size_t bytes);
+void *bm_tlsf_malloc(BmTlsf *tlsf, size_t size);
+void bm_tlsf_free(BmTlsf *tlsf, void *ptr);
+void bm_tlsf_stats(const BmTlsf *tlsf, BmHeapStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -10,6 +10,12 @@
 #define MAX_FRAME_BUF_SIZE (MAX_FRAME_SIZE + 4 + 2)
 #define DMA_ALIGN_SIZE (4)
 
+// Maximum number of RX buffers loaned to the stack at once, the remainder
+// stay in the driver's RX queue so reception never fully stalls
+#ifndef adin2111_rx_loan_budget
+#define adin2111_rx_loan_budget (RX_QUEUE_NUM_ENTRIES / 2)
+#endif
+
 struct LinkChange {
   void *device_handle;
   uint8_t port_mask;
@@ -33,6 +39,11 @@ static adin2111_DriverConfig_t DRIVER_CONFIG = {
     .tsCaptPin = ADIN2111_TS_CAPT_MUX_NA,
 };
 static adi_eth_BufDesc_t RX_BUFFERS[RX_QUEUE_NUM_ENTRIES];
+static NetworkDeviceRxLoan RX_LOANS[RX_QUEUE_NUM_ENTRIES];
+// Bit per RX buffer, only modified from driver context
+static uint32_t RX_LOANS_OUTSTANDING = 0;
+// Bit per RX buffer, set by the stack from any thread on release
+static uint32_t RX_LOANS_RETURNED = 0;
 static HAL_Callback_t ADIN2111_MAC_INT_CALLBACK = NULL;
 static void *ADIN2111_MAC_INT_CALLBACK_PARAM = NULL;
 static struct LinkChange LINK_CHANGE = {NULL, ADIN2111_PORT_1};
@@ -318,6 +329,10 @@ static BmErr adin2111_netdevice_enable(void) {
       err = BmENODEV;
       goto end;
     }
+    // Buffers still loaned to the stack are re-submitted once released
+    if (RX_LOANS_OUTSTANDING & (1U << i)) {
+      continue;
+    }
     result = adin2111_SubmitRxBuffer(&DEVICE_STRUCT, buffer_description);
     if (result != ADI_ETH_SUCCESS) {
       err = BmENODEV;
@@ -563,11 +578,85 @@ static inline BmErr adin2111_netdevice_send_(void *self, uint8_t *data,
   return adin2111_netdevice_send(data, length, port);
 }
 
+/*!
+  @brief Re-submit an RX buffer into ADIN's RX queue
+
+  @param buffer_description RX buffer to hand back to the driver
+ */
+static void resubmit_rx_buffer(adi_eth_BufDesc_t *buffer_description) {
+  adi_eth_Result_e result =
+      adin2111_SubmitRxBuffer(&DEVICE_STRUCT, buffer_description);
+  if (result != ADI_ETH_SUCCESS) {
+    bm_debug("Unable to re-submit RX Buffer\n");
+  }
+}
+
+/*!
+  @brief Release hook for RX buffers loaned to the stack
+
+  @details May be called from any thread, so the buffer is only flagged
+           here and handed back to the driver from driver context in
+           resubmit_returned_rx_buffers
+
+  @param loan loan that the stack is done with
+ */
+static void release_rx_loan(NetworkDeviceRxLoan *loan) {
+  const uint32_t idx = (uint32_t)(loan - RX_LOANS);
+  __atomic_fetch_or(&RX_LOANS_RETURNED, 1U << idx, __ATOMIC_RELEASE);
+}
+
+/*!
+  @brief Re-submit RX buffers that the stack has released
+ */
+static void resubmit_returned_rx_buffers(void) {
+  uint32_t returned =
+      __atomic_exchange_n(&RX_LOANS_RETURNED, 0, __ATOMIC_ACQ_REL);
+  for (uint32_t i = 0; returned && i < RX_QUEUE_NUM_ENTRIES; i++) {
+    if (returned & (1U << i)) {
+      returned &= ~(1U << i);
+      RX_LOANS_OUTSTANDING &= ~(1U << i);
+      resubmit_rx_buffer(&RX_BUFFERS[i]);
+    }
+  }
+}
+
+/*!
+  @brief Attempt to loan an RX buffer to the stack without copying
+
+  @param port_num ingress port number 1-15
+  @param buffer_description RX buffer holding the received frame
+
+  @return true if the stack now owns the buffer
+  @return false if the buffer must be handled by the driver
+ */
+static bool loan_rx_buffer(uint8_t port_num,
+                           adi_eth_BufDesc_t *buffer_description) {
+  const uint32_t idx = (uint32_t)(buffer_description - RX_BUFFERS);
+  if (!NETWORK_DEVICE.callbacks->receive_loan || idx >= RX_QUEUE_NUM_ENTRIES ||
+      __builtin_popcount(RX_LOANS_OUTSTANDING) >= adin2111_rx_loan_budget) {
+    return false;
+  }
+
+  RX_LOANS[idx].data = buffer_description->pBuf;
+  RX_LOANS[idx].length = buffer_description->trxSize;
+  RX_LOANS[idx].release = release_rx_loan;
+  RX_LOANS_OUTSTANDING |= 1U << idx;
+  if (NETWORK_DEVICE.callbacks->receive_loan(port_num, &RX_LOANS[idx]) !=
+      BmOK) {
+    RX_LOANS_OUTSTANDING &= ~(1U << idx);
+    return false;
+  }
+
+  return true;
+}
+
 /*!
   @brief ADIN2111 driver receive callback
 
   @details Called by the driver on received data,
-           if the user has registered a callback, call it
+           if the user has registered a callback, call it.
+           The buffer is loaned to the stack when possible, otherwise the
+           stack copies it out and the buffer is immediately re-submitted.
 
   @param device unused
   @param event unused
@@ -580,24 +669,25 @@ static void receive_callback(void *device, uint32_t event,
   adi_eth_BufDesc_t *buffer_description =
       (adi_eth_BufDesc_t *)buffer_description_param;
 
-  if (NETWORK_DEVICE.callbacks->receive) {
-    // Driver gives us zero or one. Bristlemouth spec ingress port is 1-15.
-    uint8_t port_num = buffer_description->port + 1;
-    NETWORK_DEVICE.callbacks->receive(port_num, buffer_description->pBuf,
-                                      buffer_description->trxSize);
-  }
+  resubmit_returned_rx_buffers();
 
   if (NETWORK_DEVICE.callbacks->debug_packet_dump) {
     NETWORK_DEVICE.callbacks->debug_packet_dump(buffer_description->pBuf,
                                                 buffer_description->trxSize);
   }
 
-  // Re-submit buffer into ADIN's RX queue
-  adi_eth_Result_e result =
-      adin2111_SubmitRxBuffer(&DEVICE_STRUCT, buffer_description);
-  if (result != ADI_ETH_SUCCESS) {
-    bm_debug("Unable to re-submit RX Buffer\n");
+  // Driver gives us zero or one. Bristlemouth spec ingress port is 1-15.
+  uint8_t port_num = buffer_description->port + 1;
+  if (loan_rx_buffer(port_num, buffer_description)) {
+    return;
   }
+
+  if (NETWORK_DEVICE.callbacks->receive) {
+    NETWORK_DEVICE.callbacks->receive(port_num, buffer_description->pBuf,
+                                      buffer_description->trxSize);
+  }
+
+  resubmit_rx_buffer(buffer_description);
 }
 
 /*!
@@ -708,6 +798,7 @@ static BmErr adin2111_handle_interrupt(void *self) {
   (void)self;
   BmErr err = BmENODEV;
   if (ADIN2111_MAC_INT_CALLBACK) {
+    resubmit_returned_rx_buffers();
     ADIN2111_MAC_INT_CALLBACK(ADIN2111_MAC_INT_CALLBACK_PARAM, 0, NULL);
     if (LINK_CHANGE.device_handle) {
       for (uint8_t i = 0; i < ADIN2111_PORT_NUM; i++) {
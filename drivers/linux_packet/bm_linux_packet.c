@@ -0,0 +1,531 @@
+#define _GNU_SOURCE
+
+#include "bm_linux_packet.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define stop_event_id (UINT32_MAX)
+
+typedef struct {
+  char ifname[IF_NAMESIZE];
+  int ifindex;
+  int fd;
+  bool enabled;
+  LinuxPacketPortStats stats;
+  // Frames waiting for the next sendmmsg, only touched by the L2 thread
+  uint8_t tx_count;
+  uint8_t tx_frames[linux_packet_batch_len][linux_packet_frame_size];
+  struct iovec tx_iov[linux_packet_batch_len];
+  struct mmsghdr tx_msgs[linux_packet_batch_len];
+} LinuxPacketPort;
+
+typedef struct {
+  LinuxPacketPort ports[linux_packet_max_ports];
+  uint8_t num_ports;
+  int epoll_fd;
+  int stop_fd;
+  pthread_t rx_thread;
+  bool running;
+  uint64_t last_link_poll_ms;
+  // Only touched by the RX thread
+  uint8_t rx_frames[linux_packet_batch_len][linux_packet_frame_size];
+  struct iovec rx_iov[linux_packet_batch_len];
+  struct sockaddr_ll rx_addrs[linux_packet_batch_len];
+  struct mmsghdr rx_msgs[linux_packet_batch_len];
+} LinuxPacketCtx;
+
+static LinuxPacketCtx CTX = {.epoll_fd = -1, .stop_fd = -1};
+static NetworkDevice NETWORK_DEVICE;
+
+static uint64_t monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U;
+}
+
+static inline LinuxPacketPort *get_port(uint8_t port_num) {
+  if (port_num == 0 || port_num > CTX.num_ports) {
+    return NULL;
+  }
+  return &CTX.ports[port_num - 1];
+}
+
+/*!
+  @brief Hand Queued Frames Of A Port To The Kernel
+
+  @details Everything queued since the last flush goes out with as few
+           sendmmsg calls as possible. Frames the kernel refuses are
+           counted and dropped.
+
+  @param port port to flush
+ */
+static void flush_port(LinuxPacketPort *port) {
+  uint32_t sent = 0;
+
+  while (sent < port->tx_count) {
+    int n = sendmmsg(port->fd, &port->tx_msgs[sent], port->tx_count - sent, 0);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      port->stats.tx_errors += port->tx_count - sent;
+      break;
+    }
+    port->stats.tx_batches++;
+    for (int i = 0; i < n; i++) {
+      port->stats.tx_frames++;
+      port->stats.tx_bytes += port->tx_iov[sent + i].iov_len;
+    }
+    sent += (uint32_t)n;
+  }
+
+  port->tx_count = 0;
+}
+
+static void queue_tx(LinuxPacketPort *port, const uint8_t *data,
+                     size_t length) {
+  memcpy(port->tx_frames[port->tx_count], data, length);
+  port->tx_iov[port->tx_count].iov_len = length;
+  port->tx_count++;
+  if (port->tx_count == linux_packet_batch_len) {
+    flush_port(port);
+  }
+}
+
+/*!
+  @brief Queue A Frame For Transmission
+
+  @details The frame is copied, so the caller may reuse the buffer as soon
+           as this returns. Frames go out when a port's batch is full or on
+           the next flush, which L2 performs after every pass over its
+           queues. Errors from the kernel are counted in the port stats.
+
+  @param self unused
+  @param data frame to send
+  @param length frame length in bytes
+  @param port_num port to send on, 0 for every enabled port
+
+  @return BmOK if the frame was queued
+  @return BmErr on failure
+ */
+static BmErr linux_packet_send(void *self, uint8_t *data, size_t length,
+                               uint8_t port_num) {
+  (void)self;
+  if (!data || length == 0 || length > linux_packet_frame_size ||
+      !CTX.running) {
+    return BmEINVAL;
+  }
+
+  if (port_num == 0) {
+    for (uint8_t i = 0; i < CTX.num_ports; i++) {
+      if (CTX.ports[i].enabled) {
+        queue_tx(&CTX.ports[i], data, length);
+      }
+    }
+    return BmOK;
+  }
+
+  LinuxPacketPort *port = get_port(port_num);
+  if (!port) {
+    return BmEINVAL;
+  }
+  if (!port->enabled) {
+    return BmENETDOWN;
+  }
+  queue_tx(port, data, length);
+  return BmOK;
+}
+
+static BmErr linux_packet_flush(void *self) {
+  (void)self;
+  for (uint8_t i = 0; i < CTX.num_ports; i++) {
+    if (CTX.ports[i].tx_count) {
+      flush_port(&CTX.ports[i]);
+    }
+  }
+  return BmOK;
+}
+
+/*!
+  @brief Receive A Batch Of Frames From A Port
+
+  @details One recvmmsg call per wakeup and port, so a busy port can not
+           starve the others. Frames are handed to the receive callback
+           one by one, which copies them.
+
+  @param port_idx index of the port that has frames waiting
+ */
+static void receive_batch(uint8_t port_idx) {
+  LinuxPacketPort *port = &CTX.ports[port_idx];
+
+  for (uint32_t i = 0; i < linux_packet_batch_len; i++) {
+    CTX.rx_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_ll);
+    CTX.rx_msgs[i].msg_hdr.msg_flags = 0;
+  }
+
+  int n = recvmmsg(port->fd, CTX.rx_msgs, linux_packet_batch_len,
+                   MSG_DONTWAIT | MSG_TRUNC, NULL);
+  for (int i = 0; i < n; i++) {
+    const struct mmsghdr *msg = &CTX.rx_msgs[i];
+    if (CTX.rx_addrs[i].sll_pkttype == PACKET_OUTGOING || !port->enabled) {
+      continue;
+    }
+    if (msg->msg_len > linux_packet_frame_size) {
+      port->stats.rx_truncated++;
+      continue;
+    }
+    port->stats.rx_frames++;
+    port->stats.rx_bytes += msg->msg_len;
+    if (NETWORK_DEVICE.callbacks->receive) {
+      NETWORK_DEVICE.callbacks->receive(port_idx + 1, CTX.rx_frames[i],
+                                        msg->msg_len);
+    }
+  }
+}
+
+static bool interface_running(const LinuxPacketPort *port) {
+  struct ifreq ifr = {0};
+  snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", port->ifname);
+  if (ioctl(port->fd, SIOCGIFFLAGS, &ifr) < 0) {
+    return false;
+  }
+  return (ifr.ifr_flags & IFF_UP) && (ifr.ifr_flags & IFF_RUNNING);
+}
+
+static void poll_link_state(void) {
+  const uint64_t now = monotonic_ms();
+  if (now - CTX.last_link_poll_ms < linux_packet_link_poll_ms) {
+    return;
+  }
+  CTX.last_link_poll_ms = now;
+
+  for (uint8_t i = 0; i < CTX.num_ports; i++) {
+    LinuxPacketPort *port = &CTX.ports[i];
+    const bool up = interface_running(port);
+    if (up != port->stats.link_up) {
+      port->stats.link_up = up;
+      if (NETWORK_DEVICE.callbacks->link_change) {
+        NETWORK_DEVICE.callbacks->link_change(i, up);
+      }
+    }
+  }
+}
+
+static void *rx_thread(void *arg) {
+  (void)arg;
+  struct epoll_event events[linux_packet_max_ports + 1];
+
+  while (true) {
+    int n = epoll_wait(CTX.epoll_fd, events, (int)array_size(events),
+                       linux_packet_link_poll_ms);
+    if (n < 0 && errno != EINTR) {
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.u32 == stop_event_id) {
+        return NULL;
+      }
+      receive_batch((uint8_t)events[i].data.u32);
+    }
+    poll_link_state();
+  }
+
+  return NULL;
+}
+
+static void close_sockets(void) {
+  for (uint8_t i = 0; i < CTX.num_ports; i++) {
+    if (CTX.ports[i].fd >= 0) {
+      close(CTX.ports[i].fd);
+      CTX.ports[i].fd = -1;
+    }
+    CTX.ports[i].tx_count = 0;
+    CTX.ports[i].stats.link_up = false;
+  }
+  if (CTX.epoll_fd >= 0) {
+    close(CTX.epoll_fd);
+    CTX.epoll_fd = -1;
+  }
+  if (CTX.stop_fd >= 0) {
+    close(CTX.stop_fd);
+    CTX.stop_fd = -1;
+  }
+}
+
+/*!
+  @brief Open A Raw Socket Bound To A Port's Interface
+
+  @details The socket only receives IPv6 frames and puts the interface in
+           promiscuous mode, Bristlemouth unicast frames are addressed to
+           the node's MAC address, not the interface's.
+
+  @param port port to open
+
+  @return BmOK on success
+  @return BmErr on failure
+ */
+static BmErr open_socket(LinuxPacketPort *port) {
+  port->fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_IPV6));
+  if (port->fd < 0) {
+    return errno == EPERM ? BmEPERM : BmEIO;
+  }
+
+  struct sockaddr_ll addr = {
+      .sll_family = AF_PACKET,
+      .sll_protocol = htons(ETH_P_IPV6),
+      .sll_ifindex = port->ifindex,
+  };
+  struct packet_mreq mreq = {
+      .mr_ifindex = port->ifindex,
+      .mr_type = PACKET_MR_PROMISC,
+  };
+  if (bind(port->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      setsockopt(port->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq,
+                 sizeof(mreq)) < 0) {
+    return BmEIO;
+  }
+
+  for (uint32_t i = 0; i < linux_packet_batch_len; i++) {
+    port->tx_iov[i].iov_base = port->tx_frames[i];
+    port->tx_msgs[i] = (struct mmsghdr){
+        .msg_hdr = {.msg_iov = &port->tx_iov[i], .msg_iovlen = 1}};
+  }
+  port->tx_count = 0;
+  return BmOK;
+}
+
+/*!
+  @brief Open The Port Sockets And Start The RX Thread
+
+  @param self unused
+
+  @return BmOK on success
+  @return BmErr on failure
+ */
+static BmErr linux_packet_enable(void *self) {
+  (void)self;
+  if (CTX.running) {
+    return BmOK;
+  }
+
+  BmErr err = BmEIO;
+  CTX.epoll_fd = epoll_create1(0);
+  CTX.stop_fd = eventfd(0, EFD_NONBLOCK);
+  if (CTX.epoll_fd < 0 || CTX.stop_fd < 0) {
+    goto error;
+  }
+
+  struct epoll_event event = {.events = EPOLLIN,
+                              .data.u32 = stop_event_id};
+  if (epoll_ctl(CTX.epoll_fd, EPOLL_CTL_ADD, CTX.stop_fd, &event) < 0) {
+    goto error;
+  }
+  for (uint8_t i = 0; i < CTX.num_ports; i++) {
+    err = open_socket(&CTX.ports[i]);
+    if (err != BmOK) {
+      goto error;
+    }
+    event.data.u32 = i;
+    if (epoll_ctl(CTX.epoll_fd, EPOLL_CTL_ADD, CTX.ports[i].fd, &event) < 0) {
+      err = BmEIO;
+      goto error;
+    }
+  }
+
+  for (uint32_t i = 0; i < linux_packet_batch_len; i++) {
+    CTX.rx_iov[i] = (struct iovec){.iov_base = CTX.rx_frames[i],
+                                   .iov_len = linux_packet_frame_size};
+    CTX.rx_msgs[i] = (struct mmsghdr){
+        .msg_hdr = {.msg_name = &CTX.rx_addrs[i],
+                    .msg_namelen = sizeof(struct sockaddr_ll),
+                    .msg_iov = &CTX.rx_iov[i],
+                    .msg_iovlen = 1}};
+  }
+
+  // Report the initial link state on the first poll
+  CTX.last_link_poll_ms = 0;
+  CTX.running = true;
+  if (pthread_create(&CTX.rx_thread, NULL, rx_thread, NULL) != 0) {
+    CTX.running = false;
+    err = BmENOMEM;
+    goto error;
+  }
+  return BmOK;
+
+error:
+  close_sockets();
+  return err;
+}
+
+/*!
+  @brief Stop The RX Thread And Close The Port Sockets
+
+  @details Frames still queued for transmission are dropped
+
+  @param self unused
+
+  @return BmOK on success
+ */
+static BmErr linux_packet_disable(void *self) {
+  (void)self;
+  if (!CTX.running) {
+    return BmOK;
+  }
+
+  const uint64_t stop = 1;
+  if (write(CTX.stop_fd, &stop, sizeof(stop)) == sizeof(stop)) {
+    pthread_join(CTX.rx_thread, NULL);
+  } else {
+    pthread_cancel(CTX.rx_thread);
+    pthread_join(CTX.rx_thread, NULL);
+  }
+  CTX.running = false;
+  close_sockets();
+  return BmOK;
+}
+
+static BmErr linux_packet_enable_port(void *self, uint8_t port_num) {
+  (void)self;
+  LinuxPacketPort *port = get_port(port_num);
+  if (!port) {
+    return BmEINVAL;
+  }
+  port->enabled = true;
+  return BmOK;
+}
+
+static BmErr linux_packet_disable_port(void *self, uint8_t port_num) {
+  (void)self;
+  LinuxPacketPort *port = get_port(port_num);
+  if (!port) {
+    return BmEINVAL;
+  }
+  port->enabled = false;
+  return BmOK;
+}
+
+static uint8_t linux_packet_num_ports(void) { return CTX.num_ports; }
+
+/*!
+  @brief Obtain The Counters Of A Port
+
+  @param self unused
+  @param port_index index of the port, 0 based
+  @param stats LinuxPacketPortStats to fill in
+
+  @return BmOK on success
+  @return BmErr on failure
+ */
+static BmErr linux_packet_port_stats(void *self, uint8_t port_index,
+                                     void *stats) {
+  (void)self;
+  if (port_index >= CTX.num_ports || !stats) {
+    return BmEINVAL;
+  }
+
+  LinuxPacketPort *port = &CTX.ports[port_index];
+  if (port->fd >= 0) {
+    struct tpacket_stats kernel_stats = {0};
+    socklen_t len = sizeof(kernel_stats);
+    // Reading the statistics resets them in the kernel
+    if (getsockopt(port->fd, SOL_PACKET, PACKET_STATISTICS, &kernel_stats,
+                   &len) == 0) {
+      port->stats.rx_kernel_drops += kernel_stats.tp_drops;
+    }
+  }
+  memcpy(stats, &port->stats, sizeof(LinuxPacketPortStats));
+  return BmOK;
+}
+
+static BmErr linux_packet_handle_interrupt(void *self) {
+  (void)self;
+  return BmOK;
+}
+
+/*!
+  @brief Create a Linux packet socket network device with required traits
+         and callbacks
+ */
+static void create_network_device(void) {
+  static NetworkDeviceTrait const trait = {
+      .send = linux_packet_send,
+      .enable = linux_packet_enable,
+      .disable = linux_packet_disable,
+      .enable_port = linux_packet_enable_port,
+      .disable_port = linux_packet_disable_port,
+      .num_ports = linux_packet_num_ports,
+      .port_stats = linux_packet_port_stats,
+      .handle_interrupt = linux_packet_handle_interrupt,
+      .flush = linux_packet_flush};
+  static NetworkDeviceCallbacks callbacks = {0};
+  NETWORK_DEVICE.self = NULL;
+  NETWORK_DEVICE.trait = &trait;
+  NETWORK_DEVICE.callbacks = &callbacks;
+}
+
+/**************** Public API Functions ****************/
+/*!
+  @brief Initialize A Network Device Over Linux Network Interfaces
+
+  @details Each interface becomes one Bristlemouth port, port 1 is the
+           first interface. Interfaces can be physical Ethernet ports, TAP
+           devices or veth pairs. Opening the sockets requires CAP_NET_RAW
+           and happens when L2 enables the device. The interfaces should not
+           carry an IP configuration of their own, or the host's IPv6 stack
+           will answer Bristlemouth traffic as well.
+
+  @param ifnames names of the interfaces
+  @param num_ports number of interfaces, at most linux_packet_max_ports
+
+  @return BmOK on success
+  @return BmENODEV if an interface does not exist
+  @return BmErr on failure
+ */
+BmErr linux_packet_init(const char *const *ifnames, uint8_t num_ports) {
+  if (!ifnames || num_ports == 0 || num_ports > linux_packet_max_ports ||
+      CTX.running) {
+    return BmEINVAL;
+  }
+
+  for (uint8_t i = 0; i < num_ports; i++) {
+    LinuxPacketPort *port = &CTX.ports[i];
+    if (!ifnames[i] || strlen(ifnames[i]) >= IF_NAMESIZE) {
+      return BmEINVAL;
+    }
+    const unsigned int ifindex = if_nametoindex(ifnames[i]);
+    if (ifindex == 0) {
+      return BmENODEV;
+    }
+    memset(port, 0, sizeof(LinuxPacketPort));
+    snprintf(port->ifname, sizeof(port->ifname), "%s", ifnames[i]);
+    port->ifindex = (int)ifindex;
+    port->fd = -1;
+    port->enabled = true;
+  }
+  CTX.num_ports = num_ports;
+
+  create_network_device();
+  return BmOK;
+}
+
+/*!
+  @brief Get a generic NetworkDevice for the Linux interfaces
+
+  @return Linux packet socket network device
+ */
+NetworkDevice linux_packet_network_device(void) {
+  create_network_device();
+  return NETWORK_DEVICE;
+}
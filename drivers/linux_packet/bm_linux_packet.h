@@ -0,0 +1,53 @@
+#ifndef __BM_LINUX_PACKET_H__
+#define __BM_LINUX_PACKET_H__
+
+#include "network_device.h"
+#include "util.h"
+
+// Maximum number of Linux interfaces mapped to Bristlemouth ports
+#ifndef linux_packet_max_ports
+#define linux_packet_max_ports (4U)
+#endif
+
+// Frames moved per recvmmsg/sendmmsg call
+#ifndef linux_packet_batch_len
+#define linux_packet_batch_len (16U)
+#endif
+
+// Largest frame sent or received, Ethernet header included
+#ifndef linux_packet_frame_size
+#define linux_packet_frame_size (1536U)
+#endif
+
+// How often the RX thread checks the interfaces' link state
+#ifndef linux_packet_link_poll_ms
+#define linux_packet_link_poll_ms (500U)
+#endif
+
+typedef struct {
+  uint32_t rx_frames;
+  uint32_t rx_bytes;
+  // Frames that did not fit in linux_packet_frame_size
+  uint32_t rx_truncated;
+  // Frames the kernel dropped because the socket buffer was full
+  uint32_t rx_kernel_drops;
+  uint32_t tx_frames;
+  uint32_t tx_bytes;
+  uint32_t tx_errors;
+  // sendmmsg calls, tx_frames / tx_batches is the average batch size
+  uint32_t tx_batches;
+  bool link_up;
+} LinuxPacketPortStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+BmErr linux_packet_init(const char *const *ifnames, uint8_t num_ports);
+NetworkDevice linux_packet_network_device(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __BM_LINUX_PACKET_H__
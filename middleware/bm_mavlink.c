@@ -157,6 +157,12 @@ BmErr bm_mavlink_init(BmMavLinkInfo info, MAV_STATE init_state,
     return err;
   }
 
+  // Vehicle commands and telemetry go out ahead of bulk traffic
+  err = bm_l2_register_realtime_udp_port(mavlink_port);
+  if (err != BmOK) {
+    return err;
+  }
+
   return bm_middleware_add_application(mavlink_port, link_local_mavlink_addr,
                                        mavlink_rx_cb, mavlink_routing_cb);
 }
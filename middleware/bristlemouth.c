@@ -4,7 +4,9 @@
 #include "bm_config.h"
 #include "bm_ip.h"
 #include "bm_service.h"
+#include "heap_metrics.h"
 #include "l2.h"
+#include "l2_metrics.h"
 #include "metrics_service.h"
 #include "middleware.h"
 #include "topology.h"
@@ -23,6 +25,8 @@ BmErr bristlemouth_init(NetworkDevicePowerCallback net_power_cb) {
   bm_err_check(err, bm_pubsub_init());
   bm_err_check(err, bm_middleware_init());
 #if (bm_metrics_enabled != 0)
+  bm_err_check(err, l2_metrics_init());
+  bm_err_check(err, heap_metrics_init());
   bm_err_check(err, metrics_service_init());
 #endif
   return err;
@@ -0,0 +1,76 @@
+#include "heap_metrics.h"
+#include "bm_messages_helper.h"
+#include "bm_os.h"
+#include "metrics_service.h"
+#include "util.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Heap usage, fragmentation and allocation sizes, reported when the
+// platform heap keeps statistics (bm_heap_tlsf)
+static const char *const heap_component_key = "heap";
+
+typedef struct {
+  const char *name;
+  BmField type;
+  size_t offset; // location of the value within BmHeapStats
+} HeapFieldDesc;
+
+#define alloc_field(name, n)                                                   \
+  {name, BM_FIELD_UINT32,                                                      \
+   offsetof(BmHeapStats, alloc_count) + (n) * sizeof(uint32_t)}
+
+static const HeapFieldDesc heap_fields[] = {
+    {"total", BM_FIELD_UINT32, offsetof(BmHeapStats, total_bytes)},
+    {"live", BM_FIELD_UINT32, offsetof(BmHeapStats, live_bytes)},
+    {"hw", BM_FIELD_UINT32, offsetof(BmHeapStats, high_water)},
+    {"lfree", BM_FIELD_UINT32, offsetof(BmHeapStats, largest_free)},
+    {"failed", BM_FIELD_UINT32, offsetof(BmHeapStats, failed)},
+    alloc_field("a16", 0),
+    alloc_field("a32", 1),
+    alloc_field("a64", 2),
+    alloc_field("a128", 3),
+    alloc_field("a256", 4),
+    alloc_field("a512", 5),
+    alloc_field("a1k", 6),
+    alloc_field("abig", 7),
+};
+
+_Static_assert(bm_heap_size_classes == 8,
+               "heap_fields needs one alloc field per size class");
+
+#define HEAP_FIELDS array_size(heap_fields)
+
+static BmHeapStats heap_values;
+static BmEncoderTableEntry heap_lut[HEAP_FIELDS];
+
+static BmErr heap_metrics_data(const char *metric_key,
+                               const BmEncoderTableEntry **lut,
+                               size_t *num_fields) {
+  if (strcmp(metric_key, heap_component_key) != 0) {
+    return BmEINVAL;
+  }
+  BmErr err = bm_heap_stats(&heap_values);
+  if (err != BmOK) {
+    return err;
+  }
+  *lut = heap_lut;
+  *num_fields = HEAP_FIELDS;
+  return BmOK;
+}
+
+BmErr heap_metrics_init(void) {
+  // Nothing to publish from a heap that keeps no statistics
+  if (bm_heap_stats(&heap_values) != BmOK) {
+    return BmOK;
+  }
+  for (size_t f = 0; f < HEAP_FIELDS; f++) {
+    heap_lut[f].key = heap_fields[f].name;
+    heap_lut[f].type = heap_fields[f].type;
+    heap_lut[f].value_source =
+        (const uint8_t *)&heap_values + heap_fields[f].offset;
+  }
+  return metrics_service_add_component(heap_component_key, heap_metrics_data,
+                                       HEAP_FIELDS);
+}
@@ -0,0 +1,161 @@
+#include "l2_metrics.h"
+#include "bm_config.h"
+#include "bm_ip.h"
+#include "bm_messages_helper.h"
+#include "l2.h"
+#include "metrics_service.h"
+#include "util.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef l2_metrics_max_ports
+#define l2_metrics_max_ports (2)
+#endif
+
+// One metrics component per L2 port plus one for counters shared by all ports
+// and one for the IP receive pool
+static const char *const l2_component_key = "l2_stats";
+static const char *const ip_rx_component_key = "ip_rx_pool";
+static char port_component_keys[l2_metrics_max_ports]
+                              [sizeof("l2_port_stats_15")];
+
+typedef struct {
+  const char *name;
+  BmField type;
+  size_t offset; // location of the value within the counters struct
+} L2FieldDesc;
+
+static const L2FieldDesc port_fields[] = {
+    {"rxfrm", BM_FIELD_UINT32, offsetof(BmL2PortCounters, rx_frames)},
+    {"rxbytes", BM_FIELD_UINT32, offsetof(BmL2PortCounters, rx_bytes)},
+    {"txfrm", BM_FIELD_UINT32, offsetof(BmL2PortCounters, tx_frames)},
+    {"txbytes", BM_FIELD_UINT32, offsetof(BmL2PortCounters, tx_bytes)},
+    {"fwd", BM_FIELD_UINT32, offsetof(BmL2PortCounters, forwarded_frames)},
+    {"dropnomem", BM_FIELD_UINT32, offsetof(BmL2PortCounters, drop_rx_no_mem)},
+    {"droprxq", BM_FIELD_UINT32,
+     offsetof(BmL2PortCounters, drop_rx_queue_full)},
+    {"dropegq", BM_FIELD_UINT32,
+     offsetof(BmL2PortCounters, drop_egress_queue_full)},
+    {"dropsend", BM_FIELD_UINT32,
+     offsetof(BmL2PortCounters, drop_send_failed)},
+    {"dropsubmit", BM_FIELD_UINT32,
+     offsetof(BmL2PortCounters, drop_submit_failed)},
+    {"dropdup", BM_FIELD_UINT32,
+     offsetof(BmL2PortCounters, drop_flood_duplicate)},
+    {"egqhw", BM_FIELD_UINT32,
+     offsetof(BmL2PortCounters, egress_queue_high_water)},
+};
+
+static const L2FieldDesc l2_fields[] = {
+    {"droptxq", BM_FIELD_UINT32, offsetof(BmL2Counters, drop_tx_queue_full)},
+    {"evtqhw", BM_FIELD_UINT32, offsetof(BmL2Counters, evt_queue_high_water)},
+    {"floodhit", BM_FIELD_UINT32, offsetof(BmL2Counters, flood_cache_hits)},
+    {"floodmiss", BM_FIELD_UINT32, offsetof(BmL2Counters, flood_cache_misses)},
+};
+
+static const L2FieldDesc ip_rx_fields[] = {
+    {"cap", BM_FIELD_UINT32, offsetof(BmIpRxPoolStats, capacity)},
+    {"inuse", BM_FIELD_UINT32, offsetof(BmIpRxPoolStats, in_use)},
+    {"hw", BM_FIELD_UINT32, offsetof(BmIpRxPoolStats, high_water)},
+    {"exhausted", BM_FIELD_UINT32, offsetof(BmIpRxPoolStats, exhausted)},
+};
+
+#define L2_PORT_FIELDS array_size(port_fields)
+#define L2_FIELDS array_size(l2_fields)
+#define IP_RX_FIELDS array_size(ip_rx_fields)
+
+static uint8_t num_ports;
+static BmL2PortCounters port_values[l2_metrics_max_ports];
+static BmL2Counters l2_values;
+static BmEncoderTableEntry port_lut[l2_metrics_max_ports][L2_PORT_FIELDS];
+static BmEncoderTableEntry l2_lut[L2_FIELDS];
+static BmIpRxPoolStats ip_rx_values;
+static BmEncoderTableEntry ip_rx_lut[IP_RX_FIELDS];
+
+static int port_from_key(const char *metric_key) {
+  for (uint8_t p = 0; p < num_ports; p++) {
+    if (strcmp(metric_key, port_component_keys[p]) == 0) {
+      return p;
+    }
+  }
+  return -1;
+}
+
+static BmErr l2_metrics_data(const char *metric_key,
+                             const BmEncoderTableEntry **lut,
+                             size_t *num_fields) {
+  if (strcmp(metric_key, l2_component_key) == 0) {
+    BmErr err = bm_l2_get_counters(&l2_values);
+    if (err != BmOK) {
+      return err;
+    }
+    *lut = l2_lut;
+    *num_fields = L2_FIELDS;
+    return BmOK;
+  }
+
+  if (strcmp(metric_key, ip_rx_component_key) == 0) {
+    bm_ip_get_rx_pool_stats(&ip_rx_values);
+    *lut = ip_rx_lut;
+    *num_fields = IP_RX_FIELDS;
+    return BmOK;
+  }
+
+  int p = port_from_key(metric_key);
+  if (p < 0) {
+    return BmEINVAL;
+  }
+  if (bm_l2_get_port_counters(p + 1, &port_values[p]) != BmOK) {
+    bm_debug("metrics: l2 counters failed for port %d; reporting zeros\n",
+             p + 1);
+    memset(&port_values[p], 0, sizeof(port_values[p]));
+  }
+
+  *lut = port_lut[p];
+  *num_fields = L2_PORT_FIELDS;
+  return BmOK;
+}
+
+BmErr l2_metrics_init(void) {
+  BmErr err = BmOK;
+  uint8_t nports = bm_l2_get_port_count();
+  if (nports > l2_metrics_max_ports) {
+    nports = l2_metrics_max_ports;
+  }
+  num_ports = nports;
+
+  for (size_t f = 0; f < L2_FIELDS; f++) {
+    l2_lut[f].key = l2_fields[f].name;
+    l2_lut[f].type = l2_fields[f].type;
+    l2_lut[f].value_source = (const uint8_t *)&l2_values + l2_fields[f].offset;
+  }
+  bm_err_check(err, metrics_service_add_component(l2_component_key,
+                                                  l2_metrics_data, L2_FIELDS));
+
+  for (size_t f = 0; f < IP_RX_FIELDS; f++) {
+    ip_rx_lut[f].key = ip_rx_fields[f].name;
+    ip_rx_lut[f].type = ip_rx_fields[f].type;
+    ip_rx_lut[f].value_source =
+        (const uint8_t *)&ip_rx_values + ip_rx_fields[f].offset;
+  }
+  bm_err_check(err,
+               metrics_service_add_component(ip_rx_component_key,
+                                             l2_metrics_data, IP_RX_FIELDS));
+
+  for (uint8_t p = 0; p < nports; p++) {
+    snprintf(port_component_keys[p], sizeof(port_component_keys[p]),
+             "l2_port_stats_%u", p + 1);
+    for (size_t f = 0; f < L2_PORT_FIELDS; f++) {
+      port_lut[p][f].key = port_fields[f].name;
+      port_lut[p][f].type = port_fields[f].type;
+      port_lut[p][f].value_source =
+          (const uint8_t *)&port_values[p] + port_fields[f].offset;
+    }
+    bm_err_check(err, metrics_service_add_component(port_component_keys[p],
+                                                    l2_metrics_data,
+                                                    L2_PORT_FIELDS));
+  }
+  return err;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "util.h"
+
+BmErr l2_metrics_init(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -9,8 +9,6 @@
 
 #define middleware_task_size 512
 #define net_queue_len 64
-#define udp_header_size 8
-#define max_payload_len_udp (max_payload_len - udp_header_size)
 
 typedef struct {
   void *pcb;
@@ -20,9 +18,25 @@ typedef struct {
   BmIpAddr dest;
 } MiddlewareApplication;
 
+typedef struct {
+  BmIpAddr dest;
+  BmIpAddr src;
+  uint32_t generation;
+  uint16_t egress_ports;
+  uint8_t ingress_port;
+  bool should_handle;
+} RoutingCacheEntry;
+
 typedef struct {
   LL applications;
   BmQueue net_queue;
+  // Routing decisions by destination, source and ingress port, only touched
+  // from the L2 thread. Entries from an older generation are stale.
+  RoutingCacheEntry routing_cache[middleware_routing_cache_len];
+  uint32_t routing_generation;
+  // Read from any thread
+  uint32_t routing_cache_hits;
+  uint32_t routing_cache_misses;
 } MiddlewareCtx;
 
 typedef struct {
@@ -34,9 +48,39 @@ typedef struct {
 
 static MiddlewareCtx CTX = {0};
 
-static bool handle_middleware_routing(uint8_t ingress_port,
-                                      uint16_t *egress_ports, BmIpAddr *src,
-                                      const BmIpAddr *dest) {
+static RoutingCacheEntry *routing_cache_slot(uint8_t ingress_port,
+                                             const BmIpAddr *src,
+                                             const BmIpAddr *dest) {
+  // Link local multicast groups differ in their last bytes, link local
+  // sources in the node id that ends the address
+  uint32_t hash = ingress_port;
+  for (uint8_t i = 12; i < sizeof(BmIpAddr); i++) {
+    hash = hash * 31U + ((const uint8_t *)dest)[i];
+  }
+  for (uint8_t i = 8; i < sizeof(BmIpAddr); i++) {
+    hash = hash * 31U + ((const uint8_t *)src)[i];
+  }
+  return &CTX.routing_cache[hash % middleware_routing_cache_len];
+}
+
+/*!
+  @brief Invalidate Every Cached Routing Decision
+
+  @details Safe to call from any thread, entries are invalidated by bumping
+           the generation they were cached under
+ */
+void bm_middleware_routing_cache_invalidate(void) {
+  __atomic_fetch_add(&CTX.routing_generation, 1, __ATOMIC_RELEASE);
+}
+
+static void routing_link_change(uint8_t port, bool state) {
+  (void)port;
+  (void)state;
+  bm_middleware_routing_cache_invalidate();
+}
+
+static bool route_by_application(uint8_t ingress_port, uint16_t *egress_ports,
+                                 BmIpAddr *src, const BmIpAddr *dest) {
   bool should_handle = true;
 
   CTX.applications.cursor = CTX.applications.head;
@@ -58,6 +102,73 @@ static bool handle_middleware_routing(uint8_t ingress_port,
   return should_handle;
 }
 
+/*!
+  @brief Link Local Routing Callback Registered With L2
+
+  @details Finding the application for a destination means walking the
+           application list and running its routing callback, so decisions
+           are cached by destination, source and ingress port, the inputs of
+           the routing callback. The cache is
+           invalidated when an application is added or a link changes state,
+           applications whose routing changes for any other reason must call
+           bm_middleware_routing_cache_invalidate.
+
+  @param ingress_port port the frame was received on
+  @param egress_ports ports to forward the frame to
+  @param src source address of the frame
+  @param dest destination address of the frame
+
+  @return true if the frame should be handled by this node
+ */
+static bool handle_middleware_routing(uint8_t ingress_port,
+                                      uint16_t *egress_ports, BmIpAddr *src,
+                                      const BmIpAddr *dest) {
+  // Read before the decision is made, an invalidation while it is being
+  // made leaves the new entry stale
+  const uint32_t generation =
+      __atomic_load_n(&CTX.routing_generation, __ATOMIC_ACQUIRE);
+  RoutingCacheEntry *entry = routing_cache_slot(ingress_port, src, dest);
+
+  if (entry->generation == generation && entry->ingress_port == ingress_port &&
+      memcmp(&entry->dest, dest, sizeof(BmIpAddr)) == 0 &&
+      memcmp(&entry->src, src, sizeof(BmIpAddr)) == 0) {
+    __atomic_fetch_add(&CTX.routing_cache_hits, 1, __ATOMIC_RELAXED);
+    *egress_ports |= entry->egress_ports;
+    return entry->should_handle;
+  }
+
+  __atomic_fetch_add(&CTX.routing_cache_misses, 1, __ATOMIC_RELAXED);
+  uint16_t egress = 0;
+  const bool should_handle =
+      route_by_application(ingress_port, &egress, src, dest);
+  *entry = (RoutingCacheEntry){
+      .dest = *dest,
+      .src = *src,
+      .generation = generation,
+      .egress_ports = egress,
+      .ingress_port = ingress_port,
+      .should_handle = should_handle,
+  };
+  *egress_ports |= egress;
+
+  return should_handle;
+}
+
+/*!
+  @brief Read The Routing Cache Counters
+
+  @param hits routing decisions served from the cache
+  @param misses routing decisions that walked the application list
+ */
+void bm_middleware_routing_cache_stats(uint32_t *hits, uint32_t *misses) {
+  if (hits) {
+    *hits = __atomic_load_n(&CTX.routing_cache_hits, __ATOMIC_RELAXED);
+  }
+  if (misses) {
+    *misses = __atomic_load_n(&CTX.routing_cache_misses, __ATOMIC_RELAXED);
+  }
+}
+
 /*!
   @brief Middleware Receiving Callback Bound To UDP Interface
 
@@ -134,10 +245,16 @@ static void middleware_net_task(void *arg) {
 BmErr bm_middleware_init(void) {
   BmErr err = BmEINVAL;
 
+  // Zeroed cache entries are never valid
+  bm_middleware_routing_cache_invalidate();
   err = bm_l2_register_link_local_routing_callback(handle_middleware_routing);
   if (err != BmOK) {
     return err;
   }
+  err = bm_l2_register_link_change_callback(routing_link_change);
+  if (err != BmOK) {
+    return err;
+  }
 
   err = BmENOMEM;
   CTX.net_queue = bm_queue_create(net_queue_len, sizeof(NetQueueItem));
@@ -190,7 +307,9 @@ BmErr bm_middleware_add_application(uint16_t port, BmIpAddr dest,
     return BmENOMEM;
   }
 
-  return ll_item_add(&CTX.applications, item);
+  BmErr err = ll_item_add(&CTX.applications, item);
+  bm_middleware_routing_cache_invalidate();
+  return err;
 }
 
 /*!
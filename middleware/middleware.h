@@ -1,13 +1,23 @@
 #pragma once
 
+#include "bcmp.h"
 #include "util.h"
 #include <stdbool.h>
 #include <stdint.h>
 
+#define udp_header_size 8
+// Largest UDP payload bm_middleware_net_tx sends
+#define max_payload_len_udp (max_payload_len - udp_header_size)
+
 #ifndef middleware_net_task_priority
 #define middleware_net_task_priority 4
 #endif
 
+// Number of cached link local routing decisions
+#ifndef middleware_routing_cache_len
+#define middleware_routing_cache_len 8
+#endif
+
 typedef void (*BmMiddlewareRxCb)(uint64_t node_id, void *buf, uint32_t size);
 typedef bool (*BmMiddlewareRoutingCb)(uint8_t ingress_port,
                                       uint16_t *egress_ports, BmIpAddr *src);
@@ -19,3 +29,5 @@ BmErr bm_middleware_add_application(uint16_t port, BmIpAddr dest,
                                     BmMiddlewareRxCb rx_cb,
                                     BmMiddlewareRoutingCb routing_cb);
 BmErr bm_middleware_net_tx(uint16_t port, void *buf, uint32_t size);
+void bm_middleware_routing_cache_invalidate(void);
+void bm_middleware_routing_cache_stats(uint32_t *hits, uint32_t *misses);
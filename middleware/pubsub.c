@@ -5,15 +5,21 @@
 #include "messages/resource_discovery.h"
 #include "middleware.h"
 #include "util.h"
+#include <inttypes.h>
 #include <string.h>
 
 #define max_sub_str_len 256
 #define resource_port 4321
 
-// Used for callback linked-list
+// Reassembled streams reach BmPubSubCb, whose data_len is 16 bits
+_Static_assert(BM_PUBSUB_STREAM_MAX_LEN <= UINT16_MAX,
+               "BM_PUBSUB_STREAM_MAX_LEN must fit in a uint16_t data_len");
+
+// Used for callback linked-list, one of the callbacks is set
 typedef struct BmPubSubNode {
   struct BmPubSubNode *next;
   BmPubSubCb callback_fn;
+  BmPubSubStreamCb stream_fn;
 } BmPubSubNode;
 
 typedef struct {
@@ -27,8 +33,20 @@ typedef struct BmSubNode {
   struct BmSubNode *next;
 } BmSubNode;
 
+// Stream being reassembled for subscribers that take whole messages
+typedef struct {
+  uint8_t *buf;
+  uint64_t node_id;
+  uint16_t stream_id;
+  uint32_t total_len;
+  uint32_t received;
+  uint32_t timestamp_ms;
+} PubSubStream;
+
 typedef struct {
   BmSubNode subscription_list;
+  PubSubStream streams[BM_PUBSUB_STREAM_SLOTS];
+  uint16_t stream_id;
 } PubSubCtx;
 
 static void bm_handle_msg(uint64_t node_id, void *buf, uint32_t size);
@@ -37,6 +55,15 @@ static BmSubNode *get_sub(const char *topic, uint16_t topic_len,
                           bool wildcard_search);
 static BmSubNode *get_last_sub(void);
 static BmErr publish_data_locally(void *buf, uint32_t size);
+static BmErr subscribe(const char *topic, uint16_t topic_len,
+                       BmPubSubCb callback, BmPubSubStreamCb stream_callback);
+static BmErr unsubscribe(const char *topic, uint16_t topic_len,
+                         BmPubSubCb callback, BmPubSubStreamCb stream_callback);
+static BmErr publish(const char *topic, uint16_t topic_len, uint8_t flags,
+                     const void *prefix, uint16_t prefix_len, const void *data,
+                     uint16_t len, uint8_t type, uint8_t version);
+static void publish_done(const char *topic, uint16_t topic_len, BmErr err);
+static void stream_header_endianness(BmPubSubStreamHeader *header);
 static PubSubCtx CTX;
 
 /*!
@@ -76,6 +103,11 @@ BmErr bm_sub(const char *topic, const BmPubSubCb callback) {
   return err;
 }
 
+static bool callback_matches(const BmPubSubNode *node, BmPubSubCb callback,
+                             BmPubSubStreamCb stream_callback) {
+  return node->callback_fn == callback && node->stream_fn == stream_callback;
+}
+
 /*!
   @brief Subscribe to a specific string topic with callback (while providing topic_len)
 
@@ -88,12 +120,68 @@ BmErr bm_sub(const char *topic, const BmPubSubCb callback) {
 */
 BmErr bm_sub_wl(const char *topic, uint16_t topic_len,
                 const BmPubSubCb callback) {
+  return callback ? subscribe(topic, topic_len, callback, NULL) : BmEINVAL;
+}
+
+/*!
+  @brief Subscribe to a topic, receiving streams in chunks
+
+  @details Streamed messages are handed to the callback segment by segment as
+           they arrive, instead of being reassembled. Messages that were not
+           streamed arrive as a single chunk.
+
+  @param *topic topic string to subscribe to
+  @param callback callback function to call with every chunk received
+
+  @return BmOK if we've successfully subscribed
+  @return BmErr if failure
+*/
+BmErr bm_sub_stream(const char *topic, const BmPubSubStreamCb callback) {
+  BmErr err = BmEINVAL;
+
+  uint16_t topic_len = bm_strnlen(topic, BM_TOPIC_MAX_LEN);
+
+  if (topic_len && (topic_len < BM_TOPIC_MAX_LEN)) {
+    err = bm_sub_stream_wl(topic, topic_len, callback);
+  }
+
+  return err;
+}
+
+/*!
+  @brief Subscribe to a topic, receiving streams in chunks (while providing topic_len)
+
+  @param *topic topic string to subscribe to
+  @param topic_len length of topic string
+  @param callback callback function to call with every chunk received
+
+  @return BmOK if we've successfully subscribed
+  @return BmErr if failure
+*/
+BmErr bm_sub_stream_wl(const char *topic, uint16_t topic_len,
+                       const BmPubSubStreamCb callback) {
+  return callback ? subscribe(topic, topic_len, NULL, callback) : BmEINVAL;
+}
+
+/*!
+  @brief Add A Callback To A Topic's Subscription
+
+  @param *topic topic string to subscribe to
+  @param topic_len length of topic string
+  @param callback whole message callback, or NULL
+  @param stream_callback chunked callback, or NULL
+
+  @return BmOK if we've successfully subscribed
+  @return BmErr if failure
+*/
+static BmErr subscribe(const char *topic, uint16_t topic_len,
+                       BmPubSubCb callback, BmPubSubStreamCb stream_callback) {
   BmErr err = BmEINVAL;
 
   do {
     // TODO - validate topic name if needed
 
-    if (!topic || !topic_len || !callback) {
+    if (!topic || !topic_len) {
       break;
     }
 
@@ -112,12 +200,12 @@ BmErr bm_sub_wl(const char *topic, uint16_t topic_len,
       BmPubSubNode *last_cb_node = ptr->sub.callbacks;
 
       // Go to last node (but stop if one already matches the requested callback)
-      while ((ptr->sub.callbacks->callback_fn != callback) &&
+      while (!callback_matches(last_cb_node, callback, stream_callback) &&
              last_cb_node->next) {
         last_cb_node = last_cb_node->next;
       }
 
-      if (ptr->sub.callbacks->callback_fn == callback) {
+      if (callback_matches(last_cb_node, callback, stream_callback)) {
         // Callback already subscribed to this topic!
         err = BmOK;
         break;
@@ -129,6 +217,7 @@ BmErr bm_sub_wl(const char *topic, uint16_t topic_len,
       if (cb_node) {
         cb_node->next = NULL;
         cb_node->callback_fn = callback;
+        cb_node->stream_fn = stream_callback;
         last_cb_node->next = cb_node;
 
         err = BmOK;
@@ -164,6 +253,7 @@ BmErr bm_sub_wl(const char *topic, uint16_t topic_len,
       if (cb_node) {
         cb_node->next = NULL;
         cb_node->callback_fn = callback;
+        cb_node->stream_fn = stream_callback;
         ptr->next->sub.callbacks = cb_node;
 
         err = BmOK;
@@ -223,11 +313,64 @@ BmErr bm_unsub(const char *topic, const BmPubSubCb callback) {
 */
 BmErr bm_unsub_wl(const char *topic, uint16_t topic_len,
                   const BmPubSubCb callback) {
+  return callback ? unsubscribe(topic, topic_len, callback, NULL) : BmEINVAL;
+}
+
+/*!
+  @brief Unsubscribe chunked callback from specific string topic
+
+  @param *topic topic string to unsubscribe from
+  @param callback callback function to unsubscribe from topic
+
+  @return BmOK if we've successfully unsubscribed
+  @return BmErr if failure
+*/
+BmErr bm_unsub_stream(const char *topic, const BmPubSubStreamCb callback) {
+  BmErr err = BmEINVAL;
+
+  uint16_t topic_len = bm_strnlen(topic, BM_TOPIC_MAX_LEN);
+
+  if (topic_len && (topic_len < BM_TOPIC_MAX_LEN)) {
+    err = bm_unsub_stream_wl(topic, topic_len, callback);
+  }
+
+  return err;
+}
+
+/*!
+  @brief Unsubscribe chunked callback from specific string topic (while providing topic len)
+
+  @param *topic topic string to unsubscribe from
+  @param topic_len length of topic string
+  @param callback callback function to unsubscribe from topic
+
+  @return BmOK if we've successfully unsubscribed
+  @return BmErr if failure
+*/
+BmErr bm_unsub_stream_wl(const char *topic, uint16_t topic_len,
+                         const BmPubSubStreamCb callback) {
+  return callback ? unsubscribe(topic, topic_len, NULL, callback) : BmEINVAL;
+}
+
+/*!
+  @brief Remove A Callback From A Topic's Subscription
+
+  @param *topic topic string to unsubscribe from
+  @param topic_len length of topic string
+  @param callback whole message callback, or NULL
+  @param stream_callback chunked callback, or NULL
+
+  @return BmOK if we've successfully unsubscribed
+  @return BmErr if failure
+*/
+static BmErr unsubscribe(const char *topic, uint16_t topic_len,
+                         BmPubSubCb callback,
+                         BmPubSubStreamCb stream_callback) {
 
   BmErr err = BmEINVAL;
 
   do {
-    if (!topic || !topic_len || !callback) {
+    if (!topic || !topic_len) {
       break;
     }
 
@@ -245,13 +388,14 @@ BmErr bm_unsub_wl(const char *topic, uint16_t topic_len,
       BmPubSubNode *prev_node = NULL;
 
       // Check nodes for matching callback
-      while ((cb_node->callback_fn != callback) && cb_node->next) {
+      while (!callback_matches(cb_node, callback, stream_callback) &&
+             cb_node->next) {
         prev_node = cb_node;
         cb_node = cb_node->next;
       }
 
       // Didn't find a matching callback to unsubscribe :'(
-      if (cb_node->callback_fn != callback) {
+      if (!callback_matches(cb_node, callback, stream_callback)) {
         err = BmENOENT;
         break;
       }
@@ -339,62 +483,200 @@ BmErr bm_pub_wl(const char *topic, uint16_t topic_len, const void *data,
       break;
     }
 
-    uint16_t message_size = sizeof(BmPubSubData) + topic_len + len;
-    void *buf = bm_udp_new(message_size);
-    if (!buf) {
-      err = BmENOMEM;
-      break;
-    }
+    err = publish(topic, topic_len, 0, NULL, 0, data, len, type, version);
+  } while (0);
+
+  publish_done(topic, topic_len, err);
+
+  return err;
+}
 
-    BmPubSubData *header = (BmPubSubData *)bm_udp_get_payload(buf);
-    // TODO actually set the type here
-    header->type = 0;
-    header->flags = 0;
-    header->topic_len = topic_len;
-    header->ext_header.type = type;
-    header->ext_header.version = version;
+/*!
+  @brief Publish a large buffer to specific string topic as a stream
 
-    memcpy((void *)header->topic, topic, topic_len);
+  @param *topic topic string to publish to
+  @param *data pointer to data to publish
+  @param len length of data to publish
+  @param type of data to publish
+  @param version of data to publish
+
+  @return BmOK if every segment has been queued to be published
+  @return BmErr otherwise
+*/
+BmErr bm_pub_stream(const char *topic, const void *data, uint32_t len,
+                    uint8_t type, uint8_t version) {
+  BmErr err = BmEINVAL;
 
-    if (data && len) {
-      memcpy((void *)&header->topic[header->topic_len], data, len);
+  uint16_t topic_len = bm_strnlen(topic, BM_TOPIC_MAX_LEN);
+
+  if (topic_len && (topic_len < BM_TOPIC_MAX_LEN)) {
+    err = bm_pub_stream_wl(topic, topic_len, data, len, type, version);
+  }
+
+  return err;
+}
+
+/*!
+  @brief Publish a large buffer to specific string topic as a stream (while providing topic len)
+
+  @details The buffer is split into segments that each fit one frame, sent
+           in order BM_PUBSUB_STREAM_PACE_MS apart. Every segment carries a
+           BmPubSubStreamHeader after the topic, subscribers either get the
+           reassembled message or each segment, see bm_sub_stream.
+
+  @param[in] *topic topic string to publish to
+  @param[in] topic_len length of topic string
+  @param[in] *data pointer to data to publish
+  @param[in] len length of data to publish
+  @param[in] type of data to publish
+  @param[in] version of data to publish
+
+  @return BmOK if every segment has been queued to be published
+  @return BmErr otherwise
+*/
+BmErr bm_pub_stream_wl(const char *topic, uint16_t topic_len, const void *data,
+                       uint32_t len, uint8_t type, uint8_t version) {
+  BmErr err = BmEINVAL;
+
+  do {
+    if (!topic || !topic_len || !data || !len) {
+      break;
     }
 
-    // If we have a local subscription, submit it to the local queue as well
-    if (get_sub(topic, topic_len, true)) {
-      // Submit to local queue as well.
-      // Caller must create a seperate buf than the IP stack send b/c
-      // sending a buf to the IP stack must have a 1 reference count.
-      // See: LWIP_IP_CHECK_PBUF_REF_COUNT_FOR_TX
-      do {
-        void *buf_local = bm_udp_new(message_size);
-        if (!buf_local) {
-          err = BmENOMEM;
-          break;
-        }
-        BmPubSubData *local_header =
-            (BmPubSubData *)bm_udp_get_payload(buf_local);
-        // TODO actually set the type here
-        local_header->type = 0;
-        local_header->flags = 0;
-        local_header->topic_len = topic_len;
-        local_header->ext_header.type = type;
-        local_header->ext_header.version = version;
-
-        memcpy((void *)local_header->topic, topic, topic_len);
-        memcpy((void *)&local_header->topic[local_header->topic_len], data,
-               len);
-        // The reason why we push back to the middleware queue instead of running the callbacks here
-        // is so they don't run in the current task context, which will depend on the caller.
-        publish_data_locally(buf_local, message_size);
-        bm_udp_cleanup(buf_local);
-      } while (0);
+    if (topic_len >= BM_TOPIC_MAX_LEN) {
+      err = BmEMSGSIZE;
+      // Invalid topic len
+      break;
     }
 
-    err = bm_middleware_net_tx(resource_port, buf, message_size);
-    bm_udp_cleanup(buf);
+    const uint32_t segment_len = max_payload_len_udp - sizeof(BmPubSubData) -
+                                 topic_len - sizeof(BmPubSubStreamHeader);
+    BmPubSubStreamHeader stream = {
+        .stream_id = CTX.stream_id++,
+        .total_len = len,
+    };
+
+    err = BmOK;
+    for (uint32_t offset = 0; offset < len && err == BmOK;
+         offset += segment_len) {
+      const uint32_t chunk_len =
+          len - offset < segment_len ? len - offset : segment_len;
+      BmPubSubStreamHeader header = stream;
+      header.offset = offset;
+      stream_header_endianness(&header);
+
+      err = publish(topic, topic_len, BM_PUBSUB_FLAG_STREAM, &header,
+                    sizeof(header), (const uint8_t *)data + offset, chunk_len,
+                    type, version);
+      if (err == BmOK && offset + chunk_len < len && BM_PUBSUB_STREAM_PACE_MS) {
+        bm_delay(BM_PUBSUB_STREAM_PACE_MS);
+      }
+    }
   } while (0);
 
+  publish_done(topic, topic_len, err);
+
+  return err;
+}
+
+/*!
+  @brief Fill In A Pub Sub Message
+
+  @param *payload buffer payload to fill in
+  @param *topic topic string
+  @param topic_len length of topic string
+  @param flags BmPubSubData flags
+  @param *prefix bytes placed between the topic and data, or NULL
+  @param prefix_len length of prefix
+  @param *data data to publish, or NULL
+  @param len length of data
+  @param type of data to publish
+  @param version of data to publish
+*/
+static void fill_message(void *payload, const char *topic, uint16_t topic_len,
+                         uint8_t flags, const void *prefix, uint16_t prefix_len,
+                         const void *data, uint16_t len, uint8_t type,
+                         uint8_t version) {
+  BmPubSubData *header = (BmPubSubData *)payload;
+  // TODO actually set the type here
+  header->type = 0;
+  header->flags = flags;
+  header->topic_len = topic_len;
+  header->ext_header.type = type;
+  header->ext_header.version = version;
+
+  memcpy((void *)header->topic, topic, topic_len);
+
+  uint8_t *body = (uint8_t *)&header->topic[header->topic_len];
+  if (prefix && prefix_len) {
+    memcpy(body, prefix, prefix_len);
+  }
+  if (data && len) {
+    memcpy(body + prefix_len, data, len);
+  }
+}
+
+/*!
+  @brief Send One Pub Sub Message To The Network And Local Subscribers
+
+  @param *topic topic string
+  @param topic_len length of topic string
+  @param flags BmPubSubData flags
+  @param *prefix bytes placed between the topic and data, or NULL
+  @param prefix_len length of prefix
+  @param *data data to publish, or NULL
+  @param len length of data
+  @param type of data to publish
+  @param version of data to publish
+
+  @return BmOK on success
+  @return BmErr on failure
+*/
+static BmErr publish(const char *topic, uint16_t topic_len, uint8_t flags,
+                     const void *prefix, uint16_t prefix_len, const void *data,
+                     uint16_t len, uint8_t type, uint8_t version) {
+  uint16_t message_size = sizeof(BmPubSubData) + topic_len + prefix_len + len;
+  void *buf = bm_udp_new(message_size);
+  if (!buf) {
+    return BmENOMEM;
+  }
+
+  fill_message(bm_udp_get_payload(buf), topic, topic_len, flags, prefix,
+               prefix_len, data, len, type, version);
+
+  // If we have a local subscription, submit it to the local queue as well
+  if (get_sub(topic, topic_len, true)) {
+    // Submit to local queue as well.
+    // Caller must create a seperate buf than the IP stack send b/c
+    // sending a buf to the IP stack must have a 1 reference count.
+    // See: LWIP_IP_CHECK_PBUF_REF_COUNT_FOR_TX
+    void *buf_local = bm_udp_new(message_size);
+    if (buf_local) {
+      fill_message(bm_udp_get_payload(buf_local), topic, topic_len, flags,
+                   prefix, prefix_len, data, len, type, version);
+      // The reason why we push back to the middleware queue instead of running the callbacks here
+      // is so they don't run in the current task context, which will depend on the caller.
+      publish_data_locally(buf_local, message_size);
+      bm_udp_cleanup(buf_local);
+    } else {
+      bm_debug("Unable to publish to local subscribers\n");
+    }
+  }
+
+  BmErr err = bm_middleware_net_tx(resource_port, buf, message_size);
+  bm_udp_cleanup(buf);
+
+  return err;
+}
+
+/*!
+  @brief Log The Result Of A Publish And Add The Topic To The Resource Table
+
+  @param *topic topic string
+  @param topic_len length of topic string
+  @param err result of the publish
+*/
+static void publish_done(const char *topic, uint16_t topic_len, BmErr err) {
   if (err != BmOK) {
     bm_debug("Unable to publish to topic, err: %d\n", err);
   } else {
@@ -403,40 +685,207 @@ BmErr bm_pub_wl(const char *topic, uint16_t topic_len, const void *data,
       bm_debug("Added topic %.*s to BCMP resource table.\n", topic_len, topic);
     }
   }
+}
 
-  return err;
+/*!
+  @brief Place A Stream Header In Little Endian Form, Or Back
+
+  @param *header header to swap in place
+*/
+static void stream_header_endianness(BmPubSubStreamHeader *header) {
+  if (!is_little_endian()) {
+    swap_16bit(&header->stream_id);
+    swap_32bit(&header->offset);
+    swap_32bit(&header->total_len);
+  }
 }
 
 /*!
-  @brief Handle incoming data that we are subscribed to
+  @brief Invoke The Callbacks Subscribed To A Message's Topic
 
   @param node_id node id for sender
-  @param *buf buf with incoming data
+  @param *header header of the message
+  @param *data data to deliver
+  @param data_len length of data
+  @param offset offset of data in the whole message
+  @param total_len length of the whole message
+  @param whole deliver to callbacks that take whole messages
+  @param chunked deliver to callbacks that take chunks
 */
-static void bm_handle_msg(uint64_t node_id, void *buf, uint32_t size) {
-  BmPubSubData *header = (BmPubSubData *)bm_udp_get_payload(buf);
-  uint16_t data_len = size - sizeof(BmPubSubData) - header->topic_len;
+static void deliver(uint64_t node_id, const BmPubSubData *header,
+                    const uint8_t *data, uint32_t data_len, uint32_t offset,
+                    uint32_t total_len, bool whole, bool chunked) {
+  BmSubNode *node = CTX.subscription_list.next;
+
+  while (node != NULL) {
+    if (bm_wildcard_match(header->topic, header->topic_len, node->sub.topic,
+                          node->sub.topic_len)) {
+      BmPubSubNode *cb_node = node->sub.callbacks;
 
-  // TODO check header type and flags and do something about it
+      while (cb_node) {
+        if (whole && cb_node->callback_fn) {
+          cb_node->callback_fn(node_id, header->topic, header->topic_len, data,
+                               data_len, header->ext_header.type,
+                               header->ext_header.version);
+        }
+        if (chunked && cb_node->stream_fn) {
+          cb_node->stream_fn(node_id, header->topic, header->topic_len, data,
+                             data_len, offset, total_len,
+                             header->ext_header.type,
+                             header->ext_header.version);
+        }
+        cb_node = cb_node->next;
+      }
+    }
+    node = node->next;
+  }
+}
+
+/*!
+  @brief Check For Subscribers That Take Whole Messages On A Topic
+
+  @param *header header of the message
+
+  @return true if a whole message subscriber matches the topic
+*/
+static bool has_whole_subscriber(const BmPubSubData *header) {
   BmSubNode *node = CTX.subscription_list.next;
 
   while (node != NULL) {
     if (bm_wildcard_match(header->topic, header->topic_len, node->sub.topic,
                           node->sub.topic_len)) {
-      if (node->sub.callbacks) {
-        BmPubSubNode *cb_node = node->sub.callbacks;
-
-        while (cb_node) {
-          cb_node->callback_fn(
-              node_id, header->topic, header->topic_len,
-              (const uint8_t *)&header->topic[header->topic_len], data_len,
-              header->ext_header.type, header->ext_header.version);
-          cb_node = cb_node->next;
+      for (BmPubSubNode *cb_node = node->sub.callbacks; cb_node;
+           cb_node = cb_node->next) {
+        if (cb_node->callback_fn) {
+          return true;
         }
       }
     }
     node = node->next;
   }
+
+  return false;
+}
+
+static void release_stream(PubSubStream *stream) {
+  bm_free(stream->buf);
+  memset(stream, 0, sizeof(PubSubStream));
+}
+
+/*!
+  @brief Add A Stream Segment To Its Reassembly Buffer
+
+  @details Segments have to arrive in order, a stream that skips or repeats
+           a segment, or whose next segment takes longer than
+           BM_PUBSUB_STREAM_TIMEOUT_MS, is dropped. Streams are only
+           reassembled from their first segment and only while a slot is
+           free.
+
+  @param node_id node id for sender
+  @param *header header of the segment
+  @param *stream stream header of the segment, host order
+  @param *data segment data
+  @param data_len length of the segment data
+*/
+static void reassemble_stream(uint64_t node_id, const BmPubSubData *header,
+                              const BmPubSubStreamHeader *stream,
+                              const uint8_t *data, uint32_t data_len) {
+  const uint32_t now_ms = bm_ticks_to_ms(bm_get_tick_count());
+  PubSubStream *slot = NULL;
+  PubSubStream *free_slot = NULL;
+
+  for (uint8_t i = 0; i < BM_PUBSUB_STREAM_SLOTS; i++) {
+    PubSubStream *candidate = &CTX.streams[i];
+    if (candidate->buf &&
+        now_ms - candidate->timestamp_ms > BM_PUBSUB_STREAM_TIMEOUT_MS) {
+      bm_debug("Stream %u from %016" PRIx64 " timed out\n",
+               candidate->stream_id, candidate->node_id);
+      release_stream(candidate);
+    }
+    if (!candidate->buf) {
+      free_slot = free_slot ? free_slot : candidate;
+    } else if (candidate->node_id == node_id &&
+               candidate->stream_id == stream->stream_id) {
+      slot = candidate;
+    }
+  }
+
+  if (!slot) {
+    if (stream->offset != 0) {
+      return;
+    }
+    if (stream->total_len > BM_PUBSUB_STREAM_MAX_LEN || !free_slot) {
+      bm_debug("Unable to reassemble stream of %" PRIu32 " bytes on %.*s\n",
+               stream->total_len, header->topic_len, header->topic);
+      return;
+    }
+    free_slot->buf = (uint8_t *)bm_malloc(stream->total_len);
+    if (!free_slot->buf) {
+      return;
+    }
+    free_slot->node_id = node_id;
+    free_slot->stream_id = stream->stream_id;
+    free_slot->total_len = stream->total_len;
+    slot = free_slot;
+  }
+
+  if (stream->offset != slot->received ||
+      stream->total_len != slot->total_len) {
+    bm_debug("Stream %u from %016" PRIx64 " lost a segment\n",
+             slot->stream_id, slot->node_id);
+    release_stream(slot);
+    return;
+  }
+
+  memcpy(&slot->buf[slot->received], data, data_len);
+  slot->received += data_len;
+  slot->timestamp_ms = now_ms;
+
+  if (slot->received == slot->total_len) {
+    deliver(node_id, header, slot->buf, slot->total_len, 0, slot->total_len,
+            true, false);
+    release_stream(slot);
+  }
+}
+
+/*!
+  @brief Handle incoming data that we are subscribed to
+
+  @details Stream segments go to chunked subscribers as they arrive and are
+           reassembled for subscribers that take whole messages
+
+  @param node_id node id for sender
+  @param *buf buf with incoming data
+*/
+static void bm_handle_msg(uint64_t node_id, void *buf, uint32_t size) {
+  BmPubSubData *header = (BmPubSubData *)bm_udp_get_payload(buf);
+  const uint8_t *data = (const uint8_t *)&header->topic[header->topic_len];
+  uint16_t data_len = size - sizeof(BmPubSubData) - header->topic_len;
+
+  // TODO check header type and do something about it
+  if (!(header->flags & BM_PUBSUB_FLAG_STREAM)) {
+    deliver(node_id, header, data, data_len, 0, data_len, true, true);
+    return;
+  }
+
+  BmPubSubStreamHeader stream;
+  if (data_len < sizeof(stream)) {
+    return;
+  }
+  memcpy(&stream, data, sizeof(stream));
+  stream_header_endianness(&stream);
+  data += sizeof(stream);
+  data_len -= sizeof(stream);
+  if (stream.offset > stream.total_len ||
+      data_len > stream.total_len - stream.offset) {
+    return;
+  }
+
+  deliver(node_id, header, data, data_len, stream.offset, stream.total_len,
+          false, true);
+  if (has_whole_subscriber(header)) {
+    reassemble_stream(node_id, header, &stream, data, data_len);
+  }
 }
 
 /*!
@@ -14,6 +14,31 @@ extern "C" {
 
 #define BM_TOPIC_MAX_LEN (255)
 
+// Largest stream reassembled for subscribers that take whole messages,
+// streams delivered in chunks have no limit
+#ifndef BM_PUBSUB_STREAM_MAX_LEN
+#define BM_PUBSUB_STREAM_MAX_LEN (16384)
+#endif // BM_PUBSUB_STREAM_MAX_LEN
+
+// Streams reassembled at the same time, each holds a buffer of up to
+// BM_PUBSUB_STREAM_MAX_LEN bytes
+#ifndef BM_PUBSUB_STREAM_SLOTS
+#define BM_PUBSUB_STREAM_SLOTS (2)
+#endif // BM_PUBSUB_STREAM_SLOTS
+
+// A stream is dropped when its next segment doesn't arrive within this time
+#ifndef BM_PUBSUB_STREAM_TIMEOUT_MS
+#define BM_PUBSUB_STREAM_TIMEOUT_MS (1000)
+#endif // BM_PUBSUB_STREAM_TIMEOUT_MS
+
+// Delay between the segments of a stream, so receivers keep up
+#ifndef BM_PUBSUB_STREAM_PACE_MS
+#define BM_PUBSUB_STREAM_PACE_MS (2)
+#endif // BM_PUBSUB_STREAM_PACE_MS
+
+// BmPubSubData flags
+#define BM_PUBSUB_FLAG_STREAM (1 << 0)
+
 // Add data structures published through pub sub must have this header.
 typedef struct {
   uint8_t type;       // Type of data.
@@ -29,21 +54,46 @@ typedef struct {
   const char topic[0];
 } __attribute__((packed)) BmPubSubData;
 
+// Follows the topic of every segment of a stream (BM_PUBSUB_FLAG_STREAM),
+// little endian
+typedef struct {
+  uint16_t stream_id; // Per publisher, increments with every stream
+  uint32_t offset;    // Offset of this segment's data in the stream
+  uint32_t total_len; // Length of the whole stream
+} __attribute__((packed)) BmPubSubStreamHeader;
+
 typedef void (*BmPubSubCb)(uint64_t node_id, const char *topic,
                            uint16_t topic_len, const uint8_t *data,
                            uint16_t data_len, uint8_t type, uint8_t version);
+// Chunked delivery, data is the part of a total_len message at offset.
+// Messages that were not streamed arrive as a single chunk.
+typedef void (*BmPubSubStreamCb)(uint64_t node_id, const char *topic,
+                                 uint16_t topic_len, const uint8_t *data,
+                                 uint16_t data_len, uint32_t offset,
+                                 uint32_t total_len, uint8_t type,
+                                 uint8_t version);
 
 BmErr bm_pubsub_init(void);
 BmErr bm_pub(const char *topic, const void *data, uint16_t len, uint8_t type,
              uint8_t version);
 BmErr bm_pub_wl(const char *topic, uint16_t topic_len, const void *data,
                 uint16_t len, uint8_t type, uint8_t version);
+BmErr bm_pub_stream(const char *topic, const void *data, uint32_t len,
+                    uint8_t type, uint8_t version);
+BmErr bm_pub_stream_wl(const char *topic, uint16_t topic_len, const void *data,
+                       uint32_t len, uint8_t type, uint8_t version);
 BmErr bm_sub(const char *topic, const BmPubSubCb callback);
 BmErr bm_sub_wl(const char *topic, uint16_t topic_len,
                 const BmPubSubCb callback);
+BmErr bm_sub_stream(const char *topic, const BmPubSubStreamCb callback);
+BmErr bm_sub_stream_wl(const char *topic, uint16_t topic_len,
+                       const BmPubSubStreamCb callback);
 BmErr bm_unsub(const char *topic, const BmPubSubCb callback);
 BmErr bm_unsub_wl(const char *topic, uint16_t topic_len,
                   const BmPubSubCb callback);
+BmErr bm_unsub_stream(const char *topic, const BmPubSubStreamCb callback);
+BmErr bm_unsub_stream_wl(const char *topic, uint16_t topic_len,
+                         const BmPubSubStreamCb callback);
 void bm_print_subs(void);
 char *bm_get_subs(void);
 
@@ -1,8 +1,20 @@
 #include "util.h"
 #include <stdint.h>
 
+typedef struct BmIpRxPoolStats {
+  // Packets the receive pool can hold, currently held and the most ever held
+  // at once
+  uint32_t capacity;
+  uint32_t in_use;
+  uint32_t high_water;
+  // Packets dropped because the pool was exhausted
+  uint32_t exhausted;
+} BmIpRxPoolStats;
+
 BmErr bm_ip_init(void);
 void *bm_l2_new(uint32_t size);
+void *bm_l2_new_ref(uint8_t *data, uint32_t size, void (*release)(void *),
+                    void *arg);
 void *bm_l2_get_payload(void *buf);
 void bm_l2_tx_prep(void *buf, uint32_t size);
 void bm_l2_free(void *buf);
@@ -11,6 +23,7 @@ BmErr bm_l2_set_netif(bool up);
 const char *bm_ip_get_str(uint8_t idx);
 const BmIpAddr *bm_ip_get(uint8_t idx);
 void bm_ip_rx_cleanup(void *payload);
+void bm_ip_get_rx_pool_stats(BmIpRxPoolStats *stats);
 void *bm_ip_tx_new(const BmIpAddr *dst, uint32_t size);
 BmErr bm_ip_tx_copy(void *payload, const void *data, uint32_t size,
                     uint32_t offset);
@@ -2,17 +2,19 @@
 /// @brief Linux hosted IP stack implementation of bm_ip.h APIs for bm_sbc.
 ///
 /// Replaces lwIP with a pure-software IP stack that manually constructs and
-/// parses Ethernet + IPv6 frames in malloc'd buffers.  Actual wire I/O is
-/// delegated to the L2 layer (l2.c) via bm_l2_link_output().
+/// parses Ethernet + IPv6 frames in buffers from frame_pool.h.  Actual wire
+/// I/O is delegated to the L2 layer (l2.c) via bm_l2_link_output().
 
 #include "bcmp.h"
 #include "bm_config.h"
 #include "bm_ip.h"
 #include "bm_os.h"
+#include "checksum.h"
 #include "device.h"
+#include "frame_pool.h"
 #include "l2.h"
-#include "ll.h"
 #include "packet.h"
+#include "udp_port_table.h"
 #include "util.h"
 
 #include <stdbool.h>
@@ -26,14 +28,19 @@
 // Data structures
 // ---------------------------------------------------------------------------
 
-/// Malloc-based buffer with reference counting.  Replaces lwIP's struct pbuf.
-/// A single allocation holds the header and payload contiguously thanks to the
-/// flexible array member.
+/// Pooled buffer with reference counting.  Replaces lwIP's struct pbuf.
+/// A single frame_pool block holds the header and payload contiguously thanks
+/// to the flexible array member.  Buffers created with bm_l2_new_ref() instead point
+/// data at externally owned memory and hand it back through release.
 typedef struct {
   uint32_t ref;        ///< Reference count (starts at 1 on allocation).
   uint32_t alloc_size; ///< Total allocated payload capacity in bytes.
   uint32_t len;        ///< Current valid data length in bytes (<= alloc_size).
-  uint8_t payload[];   ///< Frame data (flexible array member).
+  uint32_t headroom;   ///< Bytes reserved in front of data for headers.
+  uint8_t *data;       ///< Frame data, payload unless wrapping external memory.
+  void (*release)(void *); ///< Called on last free for external memory.
+  void *release_arg;       ///< Argument passed to release.
+  uint8_t payload[];       ///< Frame data (flexible array member).
 } LinuxBuf;
 
 /// Opaque handle returned by bm_udp_bind_port().  Stores the bound local port
@@ -42,12 +49,25 @@ typedef struct {
   uint16_t port; ///< Bound local UDP port number.
 } LinuxUdpPcb;
 
-/// Callback holder stored in the UDP linked list (CTX.udp_list).
-/// Keyed by port number (uint32_t) — avoids the 64-bit pointer truncation
-/// issue present in the lwIP implementation's (uint32_t)pcb cast.
+/// Number of cached frame header templates (direct mapped).
+#ifndef bm_linux_header_templates
+#define bm_linux_header_templates 16
+#endif
+
+/// Pre-built Ethernet + IPv6 (+ UDP) header for one destination, stamped
+/// into outgoing frames with a single copy.  Only the length fields and the
+/// UDP checksum are filled in per packet.  Guarded by a sequence lock: seq is
+/// odd while the template is being rewritten, readers retry the slow path if
+/// it changed under them.
 typedef struct {
-  BmErr (*udp_cb)(uint16_t, void *, uint64_t, uint32_t);
-} UdpCb;
+  uint32_t seq;         ///< Sequence lock, 0 means never written.
+  BmIpAddr dst;         ///< Destination address the template is for.
+  uint8_t next_header;  ///< ip_proto_udp or ip_proto_bcmp.
+  uint16_t src_port;    ///< UDP source port, 0 for BCMP.
+  uint16_t dst_port;    ///< UDP destination port, 0 for BCMP.
+  uint32_t pseudo_sum;  ///< Partial checksum of the constant fields.
+  uint8_t header[62];   ///< Ethernet + IPv6 + UDP header, lengths zeroed.
+} LinuxHeaderTemplate;
 
 // ---------------------------------------------------------------------------
 // Static context — global state for the Linux IP stack
@@ -57,9 +77,10 @@ static struct {
   BmIpAddr ll_addr;        ///< Link-local address:  fe80::<node_id>
   BmIpAddr unicast_addr;   ///< Unique-local address: fd00::<node_id>
   BmIpAddr multicast_addr; ///< Global multicast:     ff03::1
-  LL udp_list;             ///< Linked list of UdpCb entries, keyed by port.
+  UdpPortTable udp_ports;  ///< UDP callbacks, keyed by bound port.
   char ip_str[2][40];      ///< Pre-formatted address strings (0=ll, 1=unicast).
   bool link_up;            ///< Network interface up/down state.
+  LinuxHeaderTemplate header_templates[bm_linux_header_templates];
 } CTX;
 
 // ---------------------------------------------------------------------------
@@ -152,44 +173,16 @@ BM_LINUX_STATIC void format_ipv6(char *out, const BmIpAddr *addr) {
 
 /// RFC 2460 IPv6 pseudo-header checksum.  One's complement sum of:
 ///   16-byte src + 16-byte dst + 32-bit length + (24 zero bits + 8-bit
-///   next_header) + upper-layer data.  Returns one's complement of the sum.
-/// Must produce the same value as lwIP's ip6_chksum_pseudo for BCMP
-/// checksum validation to work.
+///   next_header) + upper-layer data, see checksum.h.  Returns one's
+///   complement of the sum in network order, as lwIP's ip6_chksum_pseudo
+///   does, for BCMP checksum validation to work.
 BM_LINUX_STATIC uint16_t ipv6_pseudo_checksum(const BmIpAddr *src,
                                               const BmIpAddr *dst,
                                               uint8_t next_header,
                                               uint32_t length,
                                               const void *data) {
-  uint32_t sum = 0;
-  const uint8_t *p;
-  /* Source address (16 bytes). */
-  p = src->addr;
-  for (int i = 0; i < 16; i += 2) {
-    sum += ((uint16_t)p[i] << 8) | p[i + 1];
-  }
-  /* Destination address (16 bytes). */
-  p = dst->addr;
-  for (int i = 0; i < 16; i += 2) {
-    sum += ((uint16_t)p[i] << 8) | p[i + 1];
-  }
-  /* Upper-layer packet length (32-bit, network order). */
-  sum += (length >> 16) & 0xFFFF;
-  sum += length & 0xFFFF;
-  /* Next header (preceded by 3 zero bytes — only the byte contributes). */
-  sum += next_header;
-  /* Upper-layer data. */
-  p = (const uint8_t *)data;
-  for (uint32_t i = 0; i + 1 < length; i += 2) {
-    sum += ((uint16_t)p[i] << 8) | p[i + 1];
-  }
-  if (length & 1) {
-    sum += (uint16_t)p[length - 1] << 8;
-  }
-  /* Fold carry bits and return one's complement. */
-  while (sum >> 16) {
-    sum = (sum & 0xFFFF) + (sum >> 16);
-  }
-  return ntohs((uint16_t)~sum);
+  uint32_t sum = checksum_ipv6_pseudo(src, dst, next_header, length);
+  return ntohs(checksum_fold(checksum_add(sum, data, length)));
 }
 
 /// Derive a 6-byte locally-administered MAC address from node_id.
@@ -257,6 +250,102 @@ BM_LINUX_STATIC uint16_t message_get_checksum(void *payload, uint32_t size) {
                               message_get_data(payload));
 }
 
+// ---------------------------------------------------------------------------
+// Frame header templates
+// ---------------------------------------------------------------------------
+
+/// Build the Ethernet + IPv6 (+ UDP for ip_proto_udp) header field by field,
+/// with the length fields and UDP checksum left zero.
+static void build_header(uint8_t *frame, const BmIpAddr *dst,
+                         uint8_t next_header, uint16_t src_port,
+                         uint16_t dst_port) {
+  /* --- Ethernet header (14 bytes) --- */
+  if (is_multicast(dst)) {
+    multicast_mac_from_ipv6(frame, dst);
+  } else {
+    memset(frame, 0xFF, 6); /* broadcast */
+  }
+  mac_from_nodeid(frame + 6, node_id());
+  frame[12] = (uint8_t)(ethernet_type_ipv6 >> 8);
+  frame[13] = (uint8_t)(ethernet_type_ipv6);
+
+  /* --- IPv6 header (40 bytes at offset 14) --- */
+  uint8_t *ip = frame + ETH_HDR_LEN;
+  ip[0] = 0x60; /* version 6, traffic class 0 */
+  ip[1] = 0x00;
+  ip[2] = 0x00;
+  ip[3] = 0x00; /* flow label 0 */
+  ip[4] = 0x00;
+  ip[5] = 0x00;        /* payload length, filled in per packet */
+  ip[6] = next_header; /* next header */
+  ip[7] = 64;          /* hop limit */
+  memcpy(ip + 8, CTX.ll_addr.addr, 16);
+  memcpy(ip + 24, dst->addr, 16);
+
+  /* --- UDP header (8 bytes at offset 54) --- */
+  if (next_header == ip_proto_udp) {
+    uint8_t *udp = frame + FRAME_HDR_LEN;
+    udp[0] = (uint8_t)(src_port >> 8);
+    udp[1] = (uint8_t)(src_port); /* src port */
+    udp[2] = (uint8_t)(dst_port >> 8);
+    udp[3] = (uint8_t)(dst_port); /* dst port */
+    memset(udp + 4, 0, 4);        /* length and checksum, per packet */
+  }
+}
+
+/// Write the header for dst into frame, from the cached template when there
+/// is one.  Returns the partial UDP checksum of the fields that do not change
+/// from packet to packet: the pseudo-header addresses and next header, and
+/// the UDP ports.  The caller adds the lengths and the payload.
+BM_LINUX_STATIC uint32_t stamp_header(uint8_t *frame, const BmIpAddr *dst,
+                                      uint8_t next_header, uint16_t src_port,
+                                      uint16_t dst_port) {
+  const size_t len = next_header == ip_proto_udp ? FRAME_HDR_LEN + UDP_HDR_LEN
+                                                 : FRAME_HDR_LEN;
+  uint32_t tail;
+  memcpy(&tail, &dst->addr[12], sizeof(tail));
+  LinuxHeaderTemplate *t =
+      &CTX.header_templates[(tail ^ (tail >> 16) ^ next_header ^ src_port ^
+                             ((uint32_t)dst_port << 4)) %
+                            bm_linux_header_templates];
+
+  uint32_t seq = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE);
+  if (seq && !(seq & 1) && t->next_header == next_header &&
+      t->src_port == src_port && t->dst_port == dst_port &&
+      memcmp(&t->dst, dst, sizeof(BmIpAddr)) == 0) {
+    memcpy(frame, t->header, len);
+    const uint32_t sum = t->pseudo_sum;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&t->seq, __ATOMIC_RELAXED) == seq) {
+      return sum;
+    }
+  }
+
+  /* Slow path, build the header in place and cache it. */
+  BmIpAddr dst_copy;
+  memcpy(&dst_copy, dst, sizeof(dst_copy));
+  build_header(frame, &dst_copy, next_header, src_port, dst_port);
+  uint32_t sum = checksum_ipv6_pseudo(&CTX.ll_addr, &dst_copy, next_header, 0);
+  if (next_header == ip_proto_udp) {
+    sum = checksum_add(sum, frame + FRAME_HDR_LEN, 4);
+  }
+
+  /* Skip caching if another thread is rewriting this template. */
+  if (!(seq & 1) &&
+      __atomic_compare_exchange_n(&t->seq, &seq, seq + 1, false,
+                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&t->dst, &dst_copy, sizeof(BmIpAddr));
+    t->next_header = next_header;
+    t->src_port = src_port;
+    t->dst_port = dst_port;
+    t->pseudo_sum = sum;
+    memcpy(t->header, frame, len);
+    __atomic_store_n(&t->seq, seq + 2, __ATOMIC_RELEASE);
+  }
+  return sum;
+}
+
 // ---------------------------------------------------------------------------
 // Initialization
 // ---------------------------------------------------------------------------
@@ -278,8 +367,11 @@ BmErr bm_ip_init(void) {
   format_ipv6(CTX.ip_str[0], &CTX.ll_addr);
   format_ipv6(CTX.ip_str[1], &CTX.unicast_addr);
 
-  /* UDP list starts empty (zero-initialized). */
-  memset(&CTX.udp_list, 0, sizeof(CTX.udp_list));
+  /* Port table starts empty (zero-initialized). */
+  memset(&CTX.udp_ports, 0, sizeof(CTX.udp_ports));
+
+  /* Templates embed the addresses, rebuild them on first use. */
+  memset(CTX.header_templates, 0, sizeof(CTX.header_templates));
 
   /* Register BCMP packet accessor callbacks. */
   return packet_init(message_get_src_ip, message_get_dst_ip, message_get_data,
@@ -287,20 +379,55 @@ BmErr bm_ip_init(void) {
 }
 
 void *bm_l2_new(uint32_t size) {
-  LinuxBuf *b = (LinuxBuf *)bm_malloc(sizeof(LinuxBuf) + size);
+  LinuxBuf *b = (LinuxBuf *)frame_pool_alloc(sizeof(LinuxBuf) + size);
   if (b) {
     b->ref = 1;
     b->alloc_size = size;
     b->len = size;
+    b->headroom = 0;
+    b->data = b->payload;
+    b->release = NULL;
+    b->release_arg = NULL;
   }
   return b;
 }
 
+void *bm_l2_new_ref(uint8_t *data, uint32_t size, void (*release)(void *),
+                    void *arg) {
+  if (!data || !release) {
+    return NULL;
+  }
+  LinuxBuf *b = (LinuxBuf *)frame_pool_alloc(sizeof(LinuxBuf));
+  if (b) {
+    b->ref = 1;
+    b->alloc_size = size;
+    b->len = size;
+    b->headroom = 0;
+    b->data = data;
+    b->release = release;
+    b->release_arg = arg;
+  }
+  return b;
+}
+
+/// Create a buffer that is a window of size bytes at offset into parent's
+/// data, without copying.  The view takes over the caller's reference to
+/// parent and drops it when the view itself is freed, so the frame lives as
+/// long as either is referenced.  On failure the caller keeps its reference.
+BM_LINUX_STATIC void *bm_l2_new_view(void *parent, uint32_t offset,
+                                     uint32_t size) {
+  LinuxBuf *p = (LinuxBuf *)parent;
+  if (!p || offset > p->len || size > p->len - offset) {
+    return NULL;
+  }
+  return bm_l2_new_ref(p->data + offset, size, bm_l2_free, parent);
+}
+
 void *bm_l2_get_payload(void *buf) {
   if (!buf) {
     return NULL;
   }
-  return ((LinuxBuf *)buf)->payload;
+  return ((LinuxBuf *)buf)->data;
 }
 
 void bm_l2_tx_prep(void *buf, uint32_t size) {
@@ -311,8 +438,12 @@ void bm_l2_tx_prep(void *buf, uint32_t size) {
 }
 
 void bm_l2_free(void *buf) {
-  if (buf && __sync_sub_and_fetch(&((LinuxBuf *)buf)->ref, 1) == 0) {
-    bm_free(buf);
+  LinuxBuf *b = (LinuxBuf *)buf;
+  if (b && __sync_sub_and_fetch(&b->ref, 1) == 0) {
+    if (b->release) {
+      b->release(b->release_arg);
+    }
+    frame_pool_free(b);
   }
 }
 
@@ -372,27 +503,21 @@ BmErr bm_l2_submit(void *buf, uint32_t size) {
     }
     uint16_t udp_payload_len = udp_length - UDP_HDR_LEN;
 
-    void *udp_buf = bm_l2_new(udp_payload_len);
-    if (!udp_buf) {
-      return BmENOMEM;
+    UdpPortCb cb = udp_port_table_find(&CTX.udp_ports, dst_port);
+    if (cb == NULL) {
+      /* No listener — we own the original buf, free it. */
+      bm_l2_free(buf);
+      return BmOK;
     }
 
-    if (udp_payload_len > 0) {
-      memcpy(bm_l2_get_payload(udp_buf), frame + FRAME_HDR_LEN + UDP_HDR_LEN,
-             udp_payload_len);
-    }
-
-    UdpCb *cb = NULL;
-    if (ll_get_item(&CTX.udp_list, (uint32_t)dst_port, (void **)&cb) == BmOK &&
-        cb != NULL) {
-      cb->udp_cb(src_port, udp_buf, ip_to_nodeid(&src_addr), udp_payload_len);
-    } else {
-      /* No listener — discard the copied payload. */
-      bm_l2_free(udp_buf);
+    /* Hand the listener a view of the payload, it takes over our reference
+       to the frame. */
+    void *udp_buf =
+        bm_l2_new_view(buf, FRAME_HDR_LEN + UDP_HDR_LEN, udp_payload_len);
+    if (!udp_buf) {
+      return BmENOMEM;
     }
-
-    /* Success — we own the original buf, free it. */
-    bm_l2_free(buf);
+    cb(src_port, udp_buf, ip_to_nodeid(&src_addr), udp_payload_len);
     return BmOK;
   }
 
@@ -423,6 +548,24 @@ const BmIpAddr *bm_ip_get(uint8_t idx) {
 
 void bm_ip_rx_cleanup(void *payload) { bm_l2_free(payload); }
 
+/// Received packets are queued as the frame_pool buffer they arrived in, so
+/// the receive pool is the frame pool.  Exhaustion counts frames that found
+/// their size class empty and came from the heap instead.
+void bm_ip_get_rx_pool_stats(BmIpRxPoolStats *stats) {
+  if (!stats) {
+    return;
+  }
+  FramePoolStats pool;
+  frame_pool_get_stats(&pool);
+  *stats = (BmIpRxPoolStats){0};
+  for (uint8_t i = 0; i < FramePoolClassCount; i++) {
+    stats->capacity += pool.classes[i].blocks;
+    stats->in_use += pool.classes[i].in_use;
+    stats->high_water += pool.classes[i].high_water;
+    stats->exhausted += pool.classes[i].misses;
+  }
+}
+
 void *bm_ip_tx_new(const BmIpAddr *dst, uint32_t size) {
   if (!dst) {
     return NULL;
@@ -464,31 +607,11 @@ BmErr bm_ip_tx_perform(void *payload, const BmIpAddr *dst) {
   uint8_t *frame = (uint8_t *)bm_l2_get_payload(buf);
   uint16_t data_size = buf->len - FRAME_HDR_LEN;
 
-  /* --- Ethernet header (14 bytes) --- */
-  if (is_multicast(effective_dst)) {
-    multicast_mac_from_ipv6(frame, effective_dst);
-  } else {
-    memset(frame, 0xFF, 6); /* broadcast */
-  }
-  mac_from_nodeid(frame + 6, node_id());
-  frame[12] = (uint8_t)(ethernet_type_ipv6 >> 8);
-  frame[13] = (uint8_t)(ethernet_type_ipv6);
-
-  /* --- IPv6 header (40 bytes at offset 14) --- */
+  /* --- Ethernet + IPv6 header (54 bytes) from the template --- */
+  stamp_header(frame, effective_dst, ip_proto_bcmp, 0, 0);
   uint8_t *ip = frame + ETH_HDR_LEN;
-  ip[0] = 0x60; /* version 6, traffic class 0 */
-  ip[1] = 0x00;
-  ip[2] = 0x00;
-  ip[3] = 0x00; /* flow label 0 */
   ip[4] = (uint8_t)(data_size >> 8);
   ip[5] = (uint8_t)(data_size); /* payload length */
-  ip[6] = ip_proto_bcmp;        /* next header */
-  ip[7] = 64;                   /* hop limit */
-
-  // Update dst address if needed
-  if (dst) {
-    memcpy(ip + 24, effective_dst->addr, 16);
-  }
 
   err = bm_l2_link_output(buf, buf->len);
   if (err != BmOK) {
@@ -510,27 +633,32 @@ void *bm_udp_bind_port(const BmIpAddr *addr, uint16_t port,
   (void)addr; /* multicast group — L2 handles forwarding, no MLD needed */
 
   LinuxUdpPcb *pcb = NULL;
-  LLItem *item = NULL;
 
   if (cb) {
     pcb = (LinuxUdpPcb *)bm_malloc(sizeof(LinuxUdpPcb));
-    UdpCb udp_cb = {cb};
-    item = ll_create_item(NULL, &udp_cb, sizeof(udp_cb), (uint32_t)port);
 
-    if (pcb && item && ll_item_add(&CTX.udp_list, item) == BmOK) {
+    if (pcb && udp_port_table_add(&CTX.udp_ports, port, cb) == BmOK) {
       pcb->port = port;
     } else {
       bm_free(pcb);
-      if (item) {
-        ll_delete_item(item);
-      }
       pcb = NULL;
     }
   }
   return (void *)pcb;
 }
 
-void *bm_udp_new(uint32_t size) { return bm_l2_new(size); }
+/// UDP buffers reserve room for the Ethernet, IPv6 and UDP headers in front
+/// of the payload, so bm_udp_tx_perform can build the frame in place.
+void *bm_udp_new(uint32_t size) {
+  const uint32_t headroom = FRAME_HDR_LEN + UDP_HDR_LEN;
+  LinuxBuf *b = (LinuxBuf *)bm_l2_new(headroom + size);
+  if (b) {
+    b->data += headroom;
+    b->len = size;
+    b->headroom = headroom;
+  }
+  return b;
+}
 
 void *bm_udp_get_payload(void *buf) { return bm_l2_get_payload(buf); }
 
@@ -553,64 +681,56 @@ BmErr bm_udp_tx_perform(void *pcb, void *buf, uint32_t size,
   }
 
   LinuxUdpPcb *udp_pcb = (LinuxUdpPcb *)pcb;
+  LinuxBuf *udp_buf = (LinuxBuf *)buf;
   uint32_t udp_total = UDP_HDR_LEN + size; /* UDP header + payload */
   uint32_t frame_size = FRAME_HDR_LEN + udp_total;
-
-  void *l2_buf = bm_l2_new(frame_size);
-  if (!l2_buf) {
-    return BmENOMEM;
+  void *l2_buf = NULL;
+
+  /* Like lwIP, build the headers in front of the payload when the buffer
+     has the headroom and nobody else holds a reference to it.  The buffer
+     then holds the frame, which is what L2 queues and sends. */
+  if (udp_buf->headroom >= FRAME_HDR_LEN + UDP_HDR_LEN && size <= udp_buf->len &&
+      __atomic_load_n(&udp_buf->ref, __ATOMIC_ACQUIRE) == 1) {
+    udp_buf->data -= FRAME_HDR_LEN + UDP_HDR_LEN;
+    udp_buf->headroom -= FRAME_HDR_LEN + UDP_HDR_LEN;
+    udp_buf->len = frame_size;
+    /* Our own reference, dropped below like the copy's */
+    bm_l2_tx_prep(buf, 0);
+    l2_buf = buf;
+  } else {
+    l2_buf = bm_l2_new(frame_size);
+    if (!l2_buf) {
+      return BmENOMEM;
+    }
   }
 
   uint8_t *frame = (uint8_t *)bm_l2_get_payload(l2_buf);
 
-  /* --- Ethernet header (14 bytes) --- */
-  if (is_multicast(dest_addr)) {
-    multicast_mac_from_ipv6(frame, dest_addr);
-  } else {
-    memset(frame, 0xFF, 6); /* broadcast */
-  }
-  mac_from_nodeid(frame + 6, node_id());
-  frame[12] = (uint8_t)(ethernet_type_ipv6 >> 8);
-  frame[13] = (uint8_t)(ethernet_type_ipv6);
-
-  /* --- IPv6 header (40 bytes at offset 14) --- */
+  /* --- Ethernet + IPv6 + UDP header (62 bytes) from the template --- */
+  uint32_t sum =
+      stamp_header(frame, dest_addr, ip_proto_udp, udp_pcb->port, port);
   uint8_t *ip = frame + ETH_HDR_LEN;
-  ip[0] = 0x60;
-  ip[1] = 0x00;
-  ip[2] = 0x00;
-  ip[3] = 0x00;
   ip[4] = (uint8_t)(udp_total >> 8);
   ip[5] = (uint8_t)(udp_total); /* payload length = UDP hdr + data */
-  ip[6] = ip_proto_udp;         /* next header */
-  ip[7] = 64;                   /* hop limit */
-  memcpy(ip + 8, CTX.ll_addr.addr, 16);
-  memcpy(ip + 24, dest_addr->addr, 16);
-
-  /* --- UDP header (8 bytes at offset 54) --- */
   uint8_t *udp = frame + FRAME_HDR_LEN;
-  udp[0] = (uint8_t)(udp_pcb->port >> 8);
-  udp[1] = (uint8_t)(udp_pcb->port); /* src port */
-  udp[2] = (uint8_t)(port >> 8);
-  udp[3] = (uint8_t)(port); /* dst port */
   udp[4] = (uint8_t)(udp_total >> 8);
   udp[5] = (uint8_t)(udp_total); /* length */
-  udp[6] = 0;
-  udp[7] = 0; /* zeroed before checksum computation */
 
   /* --- UDP payload (at offset 62) --- */
-  if (size > 0) {
+  if (size > 0 && l2_buf != buf) {
     memcpy(frame + FRAME_HDR_LEN + UDP_HDR_LEN, bm_udp_get_payload(buf), size);
   }
 
-  /* --- UDP checksum (mandatory for IPv6, RFC 2460 §8.1) --- */
-  {
-    BmIpAddr src_addr;
-    memcpy(src_addr.addr, ip + 8, 16);
-    uint16_t cksum = ipv6_pseudo_checksum(&src_addr, dest_addr, ip_proto_udp,
-                                          udp_total, udp);
-    udp[6] = (uint8_t)(cksum >> 8);
-    udp[7] = (uint8_t)(cksum);
+  /* --- UDP checksum (mandatory for IPv6, RFC 2460 §8.1) ---
+     Pseudo-header length and UDP length are both udp_total. */
+  sum += 2 * udp_total;
+  sum = checksum_add(sum, frame + FRAME_HDR_LEN + UDP_HDR_LEN, size);
+  uint16_t cksum = checksum_fold(sum);
+  if (cksum == 0) {
+    cksum = 0xFFFF; /* zero means no checksum, send all ones instead */
   }
+  udp[6] = (uint8_t)(cksum >> 8);
+  udp[7] = (uint8_t)(cksum);
 
   // Increments the ref count of l2_buf, if fails must free twice
   err = bm_l2_link_output(l2_buf, frame_size);
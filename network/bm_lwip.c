@@ -4,11 +4,11 @@
 #include "bm_os.h"
 #include "device.h"
 #include "l2.h"
-#include "ll.h"
 #include "lwip/ethip6.h"
 #include "lwip/inet.h"
 #include "lwip/inet_chksum.h"
 #include "lwip/init.h"
+#include "lwip/memp.h"
 #include "lwip/mld6.h"
 #include "lwip/prot/ethernet.h"
 #include "lwip/raw.h"
@@ -16,6 +16,7 @@
 #include "lwip/tcpip.h"
 #include "lwip/udp.h"
 #include "packet.h"
+#include "udp_port_table.h"
 #include "util.h"
 #include <string.h>
 
@@ -32,14 +33,10 @@
 
 static struct netif netif;
 
-typedef struct {
-  BmErr (*udp_cb)(uint16_t, void *, uint64_t, uint32_t);
-} UdpCb;
-
 struct LwipCtx {
   struct netif *netif;
   struct raw_pcb *raw_pcb;
-  LL udp_list;
+  UdpPortTable udp_ports;
 };
 typedef struct {
   struct pbuf *pbuf;
@@ -49,6 +46,58 @@ typedef struct {
 
 static struct LwipCtx CTX;
 
+// Received BCMP packets waiting for, or being handled by, the BCMP task.
+// Packets arriving while the pool is exhausted are dropped. No more than the
+// BCMP event queue length plus the packet in hand can be in flight, a pool
+// larger than that only wastes memory.
+#ifndef bm_ip_rx_pool_count
+#define bm_ip_rx_pool_count 16
+#endif
+
+// A received packet together with copies of its addresses, the addresses in
+// the pbuf are overwritten once the header is removed
+typedef struct {
+  LwipLayout layout;
+  BmIpAddr src;
+  BmIpAddr dst;
+} LwipRxLayout;
+
+LWIP_MEMPOOL_DECLARE(BM_IP_RX, bm_ip_rx_pool_count, sizeof(LwipRxLayout),
+                     "BM IP rx");
+
+static BmIpRxPoolStats RX_POOL_STATS = {.capacity = bm_ip_rx_pool_count};
+
+#ifndef bm_l2_ref_pbuf_count
+#define bm_l2_ref_pbuf_count 8
+#endif
+
+#if LWIP_SUPPORT_CUSTOM_PBUF
+typedef struct {
+  struct pbuf_custom custom;
+  void (*release)(void *);
+  void *arg;
+} LwipRefPbuf;
+
+LWIP_MEMPOOL_DECLARE(BM_L2_REF_PBUF, bm_l2_ref_pbuf_count, sizeof(LwipRefPbuf),
+                     "BM L2 ref pbuf");
+
+/*!
+ @brief Free A Pbuf Wrapping Memory Loaned To The Stack
+
+ @details Called by lwIP when the last reference to a pbuf created with
+          bm_l2_new_ref is dropped, hands the memory back to its owner
+
+ @param p pbuf being freed
+*/
+static void ref_pbuf_free(struct pbuf *p) {
+  LwipRefPbuf *ref = (LwipRefPbuf *)p;
+  void (*release)(void *) = ref->release;
+  void *arg = ref->arg;
+  LWIP_MEMPOOL_FREE(BM_L2_REF_PBUF, ref);
+  release(arg);
+}
+#endif
+
 /*!
  @brief Translate BmIpAddr Address Format To ip_addr_t IP Address Format
 
@@ -122,6 +171,34 @@ static uint16_t message_get_checksum(void *payload, uint32_t size) {
   return ret;
 }
 
+/*!
+  @brief Take A Receive Layout From The Pool
+
+  @details Pool exhaustion is counted rather than falling back to the heap,
+           the packet is dropped and BCMP recovers as it does from any loss
+
+  @return layout to fill in
+  @return NULL if the pool is exhausted
+*/
+static LwipRxLayout *rx_layout_alloc(void) {
+  LwipRxLayout *rx = (LwipRxLayout *)LWIP_MEMPOOL_ALLOC(BM_IP_RX);
+  if (!rx) {
+    __atomic_add_fetch(&RX_POOL_STATS.exhausted, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+
+  const uint32_t in_use =
+      __atomic_add_fetch(&RX_POOL_STATS.in_use, 1, __ATOMIC_RELAXED);
+  uint32_t high_water =
+      __atomic_load_n(&RX_POOL_STATS.high_water, __ATOMIC_RELAXED);
+  while (in_use > high_water &&
+         !__atomic_compare_exchange_n(&RX_POOL_STATS.high_water, &high_water,
+                                      in_use, true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+  }
+  return rx;
+}
+
 /*!
   @brief LWIP raw_recv Callback For BCMP Packets
 
@@ -154,20 +231,19 @@ static uint8_t ip_recv(void *arg, struct raw_pcb *pcb, struct pbuf *pbuf,
     // Make a copy of the IP address since we'll be modifying it later when we
     // remove the src/dest ports (and since it might not be in the pbuf so someone
     // else is managing that memory)
-    BmIpAddr *src_ref = (BmIpAddr *)bm_malloc(sizeof(BmIpAddr));
-    BmIpAddr *dst_ref = (BmIpAddr *)bm_malloc(sizeof(BmIpAddr));
-    LwipLayout *layout = (LwipLayout *)bm_malloc(sizeof(LwipLayout));
-    memcpy(dst_ref, ip6_hdr->dest.addr, sizeof(BmIpAddr));
-    memcpy(src_ref, src, sizeof(BmIpAddr));
-    *layout = (LwipLayout){pbuf, src_ref, dst_ref};
-
-    BcmpQueueItem item = {BcmpEventRx, (void *)layout, layout->pbuf->len};
-    if (bm_queue_send(queue, &item, 0) != BmOK) {
-      bm_debug("Error sending to Queue\n");
+    LwipRxLayout *rx = rx_layout_alloc();
+    if (rx) {
+      memcpy(&rx->dst, ip6_hdr->dest.addr, sizeof(BmIpAddr));
+      memcpy(&rx->src, src, sizeof(BmIpAddr));
+      rx->layout = (LwipLayout){pbuf, &rx->src, &rx->dst};
+
+      BcmpQueueItem item = {BcmpEventRx, (void *)rx, pbuf->len};
+      if (bm_queue_send(queue, &item, 0) != BmOK) {
+        bm_debug("Error sending to Queue\n");
+        bm_ip_rx_cleanup(rx);
+      }
+    } else {
       pbuf_free(pbuf);
-      bm_free(src_ref);
-      bm_free(dst_ref);
-      bm_free(layout);
     }
 
     // Eat the packet
@@ -180,9 +256,9 @@ static uint8_t ip_recv(void *arg, struct raw_pcb *pcb, struct pbuf *pbuf,
 /*!
   @brief Lwip UDP Receive Callback
 
-  @details This requests an item from a linked list in accordance to the pcb
-           of the interface and invokes the associated callback this allows for
-           multiple pcbs to be utilized, example middleware and stress
+  @details This looks up the callback bound to the local port of the pcb
+           and invokes it, this allows for multiple pcbs to be utilized,
+           example middleware and stress
 
   @param *arg unused
   @param *pcb UDP PCB
@@ -194,10 +270,9 @@ static void udp_recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *pbuf,
                         const ip_addr_t *addr, u16_t port) {
 
   (void)arg;
-  UdpCb *cb = NULL;
-  if (ll_get_item(&CTX.udp_list, (uint32_t)pcb, (void **)&cb) == BmOK &&
-      cb != NULL) {
-    cb->udp_cb(port, pbuf, ip_to_nodeid((void *)addr), pbuf->len);
+  UdpPortCb cb = udp_port_table_find(&CTX.udp_ports, pcb->local_port);
+  if (cb != NULL) {
+    cb(port, pbuf, ip_to_nodeid((void *)addr), pbuf->len);
   }
 }
 
@@ -276,6 +351,10 @@ BmErr bm_ip_init(void) {
 
   CTX.netif = &netif;
 
+#if LWIP_SUPPORT_CUSTOM_PBUF
+  LWIP_MEMPOOL_INIT(BM_L2_REF_PBUF);
+#endif
+  LWIP_MEMPOOL_INIT(BM_IP_RX);
   tcpip_init(NULL, NULL);
   mac_address(CTX.netif->hwaddr, sizeof(CTX.netif->hwaddr));
   CTX.netif->hwaddr_len = sizeof(CTX.netif->hwaddr);
@@ -329,6 +408,48 @@ BmErr bm_ip_init(void) {
 */
 void *bm_l2_new(uint32_t size) { return pbuf_alloc(PBUF_RAW, size, PBUF_RAM); }
 
+/*!
+  @brief Wrap Externally Owned Memory In An L2 Buffer Without Copying
+
+  @details The memory is referenced by a custom pbuf taken from a fixed pool,
+           release is invoked once lwIP frees the last reference to it.
+           Returns NULL when custom pbufs are disabled or the pool is
+           exhausted so callers can fall back to bm_l2_new and a copy.
+
+  @param data memory to wrap
+  @param size size of data in bytes
+  @param release function to call when the stack is done with data
+  @param arg argument passed to release
+
+  @return pointer to created buffer
+  @return NULL on failure
+*/
+void *bm_l2_new_ref(uint8_t *data, uint32_t size, void (*release)(void *),
+                    void *arg) {
+  struct pbuf *ret = NULL;
+#if LWIP_SUPPORT_CUSTOM_PBUF
+  if (data && release) {
+    LwipRefPbuf *ref = (LwipRefPbuf *)LWIP_MEMPOOL_ALLOC(BM_L2_REF_PBUF);
+    if (ref) {
+      ref->custom.custom_free_function = ref_pbuf_free;
+      ref->release = release;
+      ref->arg = arg;
+      ret = pbuf_alloced_custom(PBUF_RAW, size, PBUF_REF, &ref->custom, data,
+                                size);
+      if (!ret) {
+        LWIP_MEMPOOL_FREE(BM_L2_REF_PBUF, ref);
+      }
+    }
+  }
+#else
+  (void)data;
+  (void)size;
+  (void)release;
+  (void)arg;
+#endif
+  return ret;
+}
+
 /*!
   @brief Obtain The Raw Payload From An L2 Buffer
 
@@ -450,19 +571,30 @@ const BmIpAddr *bm_ip_get(uint8_t idx) {
  @param payload abstracted payload object to be handled
  */
 void bm_ip_rx_cleanup(void *payload) {
-  LwipLayout *layout = NULL;
+  LwipRxLayout *rx = NULL;
   if (payload) {
-    layout = (LwipLayout *)payload;
-    if (layout->pbuf) {
-      pbuf_free(layout->pbuf);
-    }
-    if (layout->dst) {
-      bm_free((void *)layout->dst);
-    }
-    if (layout->src) {
-      bm_free((void *)layout->src);
+    rx = (LwipRxLayout *)payload;
+    if (rx->layout.pbuf) {
+      pbuf_free(rx->layout.pbuf);
     }
-    bm_free(layout);
+    LWIP_MEMPOOL_FREE(BM_IP_RX, rx);
+    __atomic_sub_fetch(&RX_POOL_STATS.in_use, 1, __ATOMIC_RELAXED);
+  }
+}
+
+/*!
+ @brief Get Statistics Of The Receive Pool
+
+ @param stats filled in with the current statistics
+ */
+void bm_ip_get_rx_pool_stats(BmIpRxPoolStats *stats) {
+  if (stats) {
+    stats->capacity = RX_POOL_STATS.capacity;
+    stats->in_use = __atomic_load_n(&RX_POOL_STATS.in_use, __ATOMIC_RELAXED);
+    stats->high_water =
+        __atomic_load_n(&RX_POOL_STATS.high_water, __ATOMIC_RELAXED);
+    stats->exhausted =
+        __atomic_load_n(&RX_POOL_STATS.exhausted, __ATOMIC_RELAXED);
   }
 }
 
@@ -576,15 +708,11 @@ void *bm_udp_bind_port(const BmIpAddr *addr, uint16_t port,
                        BmErr (*cb)(uint16_t, void *, uint64_t, uint32_t)) {
 
   struct udp_pcb *pcb = udp_new_ip_type(IPADDR_TYPE_V6);
-  LLItem *item = NULL;
-  UdpCb udp_cb = {cb};
-
-  // Utilize pointer to pcb to be the id of LL item and add it to list
-  item = ll_create_item(item, &udp_cb, sizeof(udp_cb), (uint32_t)pcb);
-  if (pcb && item && ll_item_add(&CTX.udp_list, item) == BmOK) {
-    // Bind UDP layer to created pcb
-    udp_bind(pcb, IP_ANY_TYPE, port);
 
+  // Bind UDP layer to created pcb, received datagrams find the callback by
+  // the port the pcb is bound to
+  if (pcb && udp_bind(pcb, IP_ANY_TYPE, port) == ERR_OK &&
+      udp_port_table_add(&CTX.udp_ports, pcb->local_port, cb) == BmOK) {
     const ip_addr_t *multicast_addr = bm_ip_to_lwip_ip(addr);
     if (!mld6_lookfor_group(CTX.netif, multicast_addr)) {
       mld6_joingroup_netif(CTX.netif, multicast_addr);
@@ -595,9 +723,6 @@ void *bm_udp_bind_port(const BmIpAddr *addr, uint16_t port,
     if (pcb) {
       udp_remove(pcb);
     }
-    if (item) {
-      ll_delete_item(item);
-    }
     pcb = NULL;
   }
   return (void *)pcb;
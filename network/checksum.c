@@ -0,0 +1,200 @@
+#include "checksum.h"
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Vector kernels add 16-bit words into 32-bit lanes, each lane grows by at
+// most 2 * 0xFFFF per iteration, so they are spilled to the 64-bit
+// accumulator well before they can overflow
+#define vector_spill_iterations (16384U)
+
+static inline uint16_t fold64(uint64_t sum) {
+  sum = (sum & 0xFFFFFFFFU) + (sum >> 32);
+  sum = (sum & 0xFFFFFFFFU) + (sum >> 32);
+  sum = (sum & 0xFFFFU) + (sum >> 16);
+  sum = (sum & 0xFFFFU) + (sum >> 16);
+  sum = (sum & 0xFFFFU) + (sum >> 16);
+  return (uint16_t)sum;
+}
+
+static inline uint64_t load64(const uint8_t *p) {
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+/*!
+  @brief Sum Data In Native Byte Order
+
+  @details One's complement sums are byte order independent (RFC 1071), so
+           the data is summed as native words and the result swapped once.
+           Words are added 32 bits at a time into a 64-bit accumulator, which
+           cannot overflow for any length that fits in memory.
+
+  @param data data to sum
+  @param len length of data in bytes
+
+  @return 16-bit one's complement sum in native byte order
+ */
+static uint16_t sum_native(const uint8_t *data, size_t len) {
+  uint64_t acc = 0;
+
+#if defined(__AVX2__)
+  const __m256i zero = _mm256_setzero_si256();
+  while (len >= 32) {
+    __m256i lanes = _mm256_setzero_si256();
+    for (uint32_t i = 0; i < vector_spill_iterations && len >= 32; i++) {
+      const __m256i v = _mm256_loadu_si256((const __m256i *)data);
+      lanes = _mm256_add_epi32(lanes, _mm256_unpacklo_epi16(v, zero));
+      lanes = _mm256_add_epi32(lanes, _mm256_unpackhi_epi16(v, zero));
+      data += 32;
+      len -= 32;
+    }
+    uint32_t spill[8];
+    _mm256_storeu_si256((__m256i *)spill, lanes);
+    for (uint8_t i = 0; i < 8; i++) {
+      acc += spill[i];
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  while (len >= 16) {
+    __m128i lanes = _mm_setzero_si128();
+    for (uint32_t i = 0; i < vector_spill_iterations && len >= 16; i++) {
+      const __m128i v = _mm_loadu_si128((const __m128i *)data);
+      lanes = _mm_add_epi32(lanes, _mm_unpacklo_epi16(v, zero));
+      lanes = _mm_add_epi32(lanes, _mm_unpackhi_epi16(v, zero));
+      data += 16;
+      len -= 16;
+    }
+    uint32_t spill[4];
+    _mm_storeu_si128((__m128i *)spill, lanes);
+    acc += (uint64_t)spill[0] + spill[1] + spill[2] + spill[3];
+  }
+#elif defined(__ARM_NEON)
+  while (len >= 16) {
+    uint32x4_t lanes = vdupq_n_u32(0);
+    for (uint32_t i = 0; i < vector_spill_iterations && len >= 16; i++) {
+      lanes = vpadalq_u16(lanes, vreinterpretq_u16_u8(vld1q_u8(data)));
+      data += 16;
+      len -= 16;
+    }
+    acc += vgetq_lane_u32(lanes, 0);
+    acc += vgetq_lane_u32(lanes, 1);
+    acc += vgetq_lane_u32(lanes, 2);
+    acc += vgetq_lane_u32(lanes, 3);
+  }
+#endif
+
+  while (len >= 32) {
+    const uint64_t w0 = load64(data);
+    const uint64_t w1 = load64(data + 8);
+    const uint64_t w2 = load64(data + 16);
+    const uint64_t w3 = load64(data + 24);
+    acc += (w0 & 0xFFFFFFFFU) + (w0 >> 32) + (w1 & 0xFFFFFFFFU) + (w1 >> 32);
+    acc += (w2 & 0xFFFFFFFFU) + (w2 >> 32) + (w3 & 0xFFFFFFFFU) + (w3 >> 32);
+    data += 32;
+    len -= 32;
+  }
+  while (len >= 8) {
+    const uint64_t w = load64(data);
+    acc += (w & 0xFFFFFFFFU) + (w >> 32);
+    data += 8;
+    len -= 8;
+  }
+  while (len >= 2) {
+    uint16_t w;
+    memcpy(&w, data, sizeof(w));
+    acc += w;
+    data += 2;
+    len -= 2;
+  }
+  if (len) {
+    // The last byte is the first byte of a zero padded word
+    const uint8_t pad[2] = {data[0], 0};
+    uint16_t w;
+    memcpy(&w, pad, sizeof(w));
+    acc += w;
+  }
+
+  return fold64(acc);
+}
+
+static inline uint16_t native_to_be(uint16_t sum) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return (uint16_t)((sum << 8) | (sum >> 8));
+#else
+  return sum;
+#endif
+}
+
+/*!
+  @brief Add Data To A Partial Checksum
+
+  @param sum partial sum to add to, 0 to start a new checksum
+  @param data data to add
+  @param len length of data in bytes
+
+  @return updated partial sum
+ */
+uint32_t checksum_add(uint32_t sum, const void *data, size_t len) {
+  if (!data || !len) {
+    return sum;
+  }
+  return sum + native_to_be(sum_native((const uint8_t *)data, len));
+}
+
+/*!
+  @brief Partial Checksum Of The IPv6 Pseudo-Header
+
+  @details RFC 8200 section 8.1, source and destination addresses, the
+           32-bit upper layer packet length and the next header
+
+  @param src source address
+  @param dst destination address
+  @param next_header upper layer protocol
+  @param length upper layer packet length in bytes
+
+  @return partial sum to add the upper layer packet to
+ */
+uint32_t checksum_ipv6_pseudo(const BmIpAddr *src, const BmIpAddr *dst,
+                              uint8_t next_header, uint32_t length) {
+  uint32_t sum = checksum_add(0, src->addr, sizeof(src->addr));
+  sum = checksum_add(sum, dst->addr, sizeof(dst->addr));
+  return sum + (length >> 16) + (length & 0xFFFFU) + next_header;
+}
+
+/*!
+  @brief Fold A Partial Sum Into A Checksum
+
+  @param sum partial sum
+
+  @return one's complement of the sum, to be written big-endian
+ */
+uint16_t checksum_fold(uint32_t sum) { return (uint16_t)~fold64(sum); }
+
+/*!
+  @brief Update A Checksum For A Changed 16-bit Word
+
+  @details RFC 1624 equation 3, HC' = ~(~HC + ~m + m'). Call once per
+           changed word, a changed byte is the word that contains it.
+
+  @param checksum current checksum, as read big-endian from the packet
+  @param old_word covered word before the change, big-endian
+  @param new_word covered word after the change, big-endian
+
+  @return checksum matching the packet with new_word in place of old_word
+ */
+uint16_t checksum_update(uint16_t checksum, uint16_t old_word,
+                         uint16_t new_word) {
+  uint32_t sum = (uint16_t)~checksum;
+  sum += (uint16_t)~old_word;
+  sum += new_word;
+  return (uint16_t)~fold64(sum);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "util.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Internet checksum (RFC 1071) for IPv6 upper layer protocols.
+ *
+ * A checksum is built from partial sums: start from 0 (or the pseudo-header
+ * sum), add data with checksum_add and finish with checksum_fold. Partial
+ * sums are the one's complement sum of the data as big-endian 16-bit words,
+ * so the checksum returned by checksum_fold is written to the frame most
+ * significant byte first. Data added with checksum_add must start on a 16-bit
+ * word boundary of the checksummed stream, only the last chunk may have an
+ * odd length.
+ *
+ * The sum is computed with a 64-bit accumulator, or SSE2, AVX2 or NEON when
+ * the compiler targets them.
+ *
+ * checksum_update applies RFC 1624 incremental updates, so a field covered
+ * by a checksum can be rewritten without summing the whole packet again.
+ */
+uint32_t checksum_add(uint32_t sum, const void *data, size_t len);
+uint32_t checksum_ipv6_pseudo(const BmIpAddr *src, const BmIpAddr *dst,
+                              uint8_t next_header, uint32_t length);
+uint16_t checksum_fold(uint32_t sum);
+uint16_t checksum_update(uint16_t checksum, uint16_t old_word,
+                         uint16_t new_word);
+
+#ifdef __cplusplus
+}
+#endif
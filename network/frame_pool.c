@@ -0,0 +1,184 @@
+#include "frame_pool.h"
+#include "bm_os.h"
+#include <stdbool.h>
+
+// Free list heads pack a generation tag in the upper half and the index of
+// the top block plus one in the lower half, zero being an empty list
+#define head_index_mask (0xFFFFFFFFULL)
+#define head_tag_shift (32)
+
+typedef struct {
+  uint8_t *const storage;
+  uint32_t *const next;
+  const uint32_t block_size;
+  const uint32_t blocks;
+  uint64_t head;
+  uint32_t carved;
+  FramePoolClassStats stats;
+} FramePoolSlab;
+
+#define frame_pool_slab_storage(name, size, count)                             \
+  static uint8_t name##_storage[(size) * (count)]                             \
+      __attribute__((aligned(16)));                                           \
+  static uint32_t name##_next[(count)]
+
+frame_pool_slab_storage(small, frame_pool_small_size, frame_pool_small_count);
+frame_pool_slab_storage(medium, frame_pool_medium_size,
+                        frame_pool_medium_count);
+frame_pool_slab_storage(large, frame_pool_large_size, frame_pool_large_count);
+
+#define frame_pool_slab(name, size, count)                                     \
+  {                                                                            \
+    .storage = name##_storage, .next = name##_next, .block_size = (size),      \
+    .blocks = (count),                                                         \
+  }
+
+static FramePoolSlab SLABS[FramePoolClassCount] = {
+    frame_pool_slab(small, frame_pool_small_size, frame_pool_small_count),
+    frame_pool_slab(medium, frame_pool_medium_size, frame_pool_medium_count),
+    frame_pool_slab(large, frame_pool_large_size, frame_pool_large_count),
+};
+static uint32_t OVERSIZE;
+
+static inline void counter_add(uint32_t *counter, uint32_t value) {
+  __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static inline void counter_max(uint32_t *counter, uint32_t value) {
+  uint32_t current = __atomic_load_n(counter, __ATOMIC_RELAXED);
+  while (value > current &&
+         !__atomic_compare_exchange_n(counter, &current, value, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+/*!
+  @brief Take A Block Off A Slab
+
+  @details The free list is tried first, then a block that was never handed
+           out is carved off the slab. The generation tag changes on every
+           push and pop, so a head that was popped and pushed back between
+           reading it and swapping it is not mistaken for unchanged.
+
+  @param slab slab to allocate from
+
+  @return block on success
+  @return NULL if the slab is exhausted
+ */
+static void *slab_pop(FramePoolSlab *slab) {
+  uint64_t head = __atomic_load_n(&slab->head, __ATOMIC_ACQUIRE);
+  while (head & head_index_mask) {
+    const uint32_t index = (uint32_t)(head & head_index_mask) - 1;
+    const uint64_t next = __atomic_load_n(&slab->next[index], __ATOMIC_RELAXED);
+    const uint64_t tag = (head >> head_tag_shift) + 1;
+    if (__atomic_compare_exchange_n(&slab->head, &head,
+                                    (tag << head_tag_shift) | next, true,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+      return &slab->storage[(size_t)index * slab->block_size];
+    }
+  }
+
+  uint32_t carved = __atomic_load_n(&slab->carved, __ATOMIC_RELAXED);
+  while (carved < slab->blocks) {
+    if (__atomic_compare_exchange_n(&slab->carved, &carved, carved + 1, true,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      return &slab->storage[(size_t)carved * slab->block_size];
+    }
+  }
+  return NULL;
+}
+
+static void slab_push(FramePoolSlab *slab, uint32_t index) {
+  uint64_t head = __atomic_load_n(&slab->head, __ATOMIC_RELAXED);
+  uint64_t new_head;
+  do {
+    __atomic_store_n(&slab->next[index], (uint32_t)(head & head_index_mask),
+                     __ATOMIC_RELAXED);
+    const uint64_t tag = (head >> head_tag_shift) + 1;
+    new_head = (tag << head_tag_shift) | (index + 1);
+  } while (!__atomic_compare_exchange_n(&slab->head, &head, new_head, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static inline bool slab_owns(const FramePoolSlab *slab, const uint8_t *block) {
+  return block >= slab->storage &&
+         block < slab->storage + (size_t)slab->blocks * slab->block_size;
+}
+
+/*!
+  @brief Allocate A Frame Buffer
+
+  @details Served by the smallest size class that fits, or by the heap if
+           that class is exhausted (counted as a miss of the class) or no
+           class fits (counted as oversize)
+
+  @param size bytes needed
+
+  @return buffer on success, free it with frame_pool_free
+  @return NULL if the heap fallback failed
+ */
+void *frame_pool_alloc(size_t size) {
+  for (uint8_t i = 0; i < FramePoolClassCount; i++) {
+    FramePoolSlab *slab = &SLABS[i];
+    if (size > slab->block_size) {
+      continue;
+    }
+    void *block = slab_pop(slab);
+    if (!block) {
+      counter_add(&slab->stats.misses, 1);
+      return bm_malloc(size);
+    }
+    counter_add(&slab->stats.allocs, 1);
+    const uint32_t in_use =
+        __atomic_add_fetch(&slab->stats.in_use, 1, __ATOMIC_RELAXED);
+    counter_max(&slab->stats.high_water, in_use);
+    return block;
+  }
+
+  counter_add(&OVERSIZE, 1);
+  return bm_malloc(size);
+}
+
+/*!
+  @brief Free A Frame Buffer
+
+  @param block buffer obtained from frame_pool_alloc, may be NULL
+ */
+void frame_pool_free(void *block) {
+  if (!block) {
+    return;
+  }
+  for (uint8_t i = 0; i < FramePoolClassCount; i++) {
+    FramePoolSlab *slab = &SLABS[i];
+    if (slab_owns(slab, (const uint8_t *)block)) {
+      const size_t offset = (size_t)((uint8_t *)block - slab->storage);
+      slab_push(slab, (uint32_t)(offset / slab->block_size));
+      __atomic_sub_fetch(&slab->stats.in_use, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  }
+  bm_free(block);
+}
+
+/*!
+  @brief Obtain The Pool Occupancy And Miss Counters
+
+  @param stats filled in with a snapshot of every size class
+ */
+void frame_pool_get_stats(FramePoolStats *stats) {
+  if (!stats) {
+    return;
+  }
+  for (uint8_t i = 0; i < FramePoolClassCount; i++) {
+    FramePoolSlab *slab = &SLABS[i];
+    FramePoolClassStats *out = &stats->classes[i];
+    out->block_size = slab->block_size;
+    out->blocks = slab->blocks;
+    out->in_use = __atomic_load_n(&slab->stats.in_use, __ATOMIC_RELAXED);
+    out->high_water =
+        __atomic_load_n(&slab->stats.high_water, __ATOMIC_RELAXED);
+    out->allocs = __atomic_load_n(&slab->stats.allocs, __ATOMIC_RELAXED);
+    out->misses = __atomic_load_n(&slab->stats.misses, __ATOMIC_RELAXED);
+  }
+  stats->oversize = __atomic_load_n(&OVERSIZE, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "util.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Block sizes and counts of the size classes, smallest first. Sizes include
+// whatever header the caller keeps in front of the frame, so the large class
+// fits a full Ethernet frame plus the IP stack's buffer header.
+#ifndef frame_pool_small_size
+#define frame_pool_small_size 192
+#endif
+
+#ifndef frame_pool_small_count
+#define frame_pool_small_count 64
+#endif
+
+#ifndef frame_pool_medium_size
+#define frame_pool_medium_size 640
+#endif
+
+#ifndef frame_pool_medium_count
+#define frame_pool_medium_count 32
+#endif
+
+#ifndef frame_pool_large_size
+#define frame_pool_large_size 1664
+#endif
+
+#ifndef frame_pool_large_count
+#define frame_pool_large_count 64
+#endif
+
+typedef enum {
+  FramePoolSmall,
+  FramePoolMedium,
+  FramePoolLarge,
+  FramePoolClassCount,
+} FramePoolClass;
+
+typedef struct {
+  uint32_t block_size;
+  uint32_t blocks;
+  // Blocks currently handed out and the most ever handed out at once
+  uint32_t in_use;
+  uint32_t high_water;
+  // Allocations served by this class, and allocations that fit this class
+  // but found it exhausted and fell back to the heap
+  uint32_t allocs;
+  uint32_t misses;
+} FramePoolClassStats;
+
+typedef struct {
+  FramePoolClassStats classes[FramePoolClassCount];
+  // Allocations larger than the large class, always served by the heap
+  uint32_t oversize;
+} FramePoolStats;
+
+/**
+ * Fixed-block pool for frame buffers of the hosted IP stack.
+ *
+ * Each size class is a static slab of equal blocks. Free blocks are kept on
+ * a lock-free stack guarded against ABA by a generation tag, and blocks that
+ * were never used are carved off the end of the slab, so the pool needs no
+ * initialization and any thread can allocate and free at any time.
+ * Requests are served by the smallest class that fits, falling back to
+ * bm_malloc when it is exhausted or the request is too large. frame_pool_free
+ * tells pool blocks and heap blocks apart by address.
+ */
+void *frame_pool_alloc(size_t size);
+void frame_pool_free(void *block);
+void frame_pool_get_stats(FramePoolStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,6 +3,9 @@
 #include "bm_config.h"
 #include "bm_ip.h"
 #include "bm_os.h"
+#include "checksum.h"
+#include "l2_capture_filter.h"
+#include "l2_flood_cache.h"
 #include "l2_policy.h"
 #include "ll.h"
 #include "network_frames.h"
@@ -43,6 +46,8 @@
 #define clear_egress_port(addr) (addr[ipv6_ingress_egress_ports_offset] &= 0xF0)
 
 #define evt_queue_len (32)
+#define bulk_queue_len (32)
+#define l2_max_ports (15)
 #define device_all_ports (0)
 #define renegotiate_wait_time_ms (100)
 
@@ -50,6 +55,8 @@ typedef enum {
   L2Tx,
   L2Rx,
   L2Irq,
+  // Bulk TX events are waiting in the bulk queue
+  L2TxBulk,
 } BmL2QueueType;
 
 typedef struct {
@@ -57,19 +64,63 @@ typedef struct {
   uint32_t length;
   void *buf;
   uint16_t port_mask;
+  BmL2TxClass tx_class;
 } L2QueueElement;
 
+typedef struct {
+  void *buf;
+  uint32_t length;
+} L2TxEntry;
+
+typedef struct {
+  L2TxEntry entries[bm_l2_tx_queue_len];
+  uint16_t head;
+  uint16_t count;
+  uint32_t drops;
+} L2TxQueue;
+
+typedef struct {
+  BmL2CaptureInsn prog[bm_l2_capture_filter_max_len];
+  uint8_t len;
+  // Datapath readers currently running this program
+  uint32_t readers;
+} L2CaptureFilter;
+
 typedef struct {
   NetworkDevice network_device;
   uint8_t num_ports;
   uint16_t all_ports_mask;
   uint16_t enabled_ports_mask;
   BmQueue evt_queue;
+  // Bulk TX events wait here instead of in evt_queue, so a burst never
+  // delays control or realtime frames and its senders block when it is full
+  BmQueue bulk_queue;
+  // Bulk event taken from bulk_queue that did not fit its egress queues yet
+  L2QueueElement bulk_held;
+  bool bulk_held_valid;
   BmTaskHandle task_handle;
   L2LinkLocalRoutingCb routing_cb;
   L2PcapCb pcap_cb;
+  // Published capture filter, NULL captures everything. Updates go to the
+  // slot not currently published so readers never see a partial program.
+  L2CaptureFilter *capture_filter;
+  L2CaptureFilter capture_filter_slots[2];
   LL link_change_callback_list;
   LL renegotiate_timer_list;
+  // Egress queues indexed by port number (0 = all ports) then class
+  L2TxQueue *tx_queues;
+  uint16_t tx_pending;
+  uint16_t realtime_udp_ports[bm_l2_realtime_udp_ports_max];
+  uint8_t realtime_udp_port_count;
+  // Only touched from the driver RX context
+  BmL2FloodCache flood_cache;
+  // Updated with relaxed atomics from the driver, ISR and L2 contexts
+  uint32_t evt_in_flight;
+  uint32_t bulk_in_flight;
+  // Set while an L2TxBulk event is on its way to the L2 thread
+  bool bulk_doorbell;
+  BmL2Counters counters;
+  BmL2PortCounters port_counters[l2_max_ports];
 } BmL2Ctx;
 
 typedef struct {
@@ -79,6 +130,57 @@ typedef struct {
 
 static BmL2Ctx CTX = {0};
 
+static inline void counter_add(uint32_t *counter, uint32_t value) {
+  __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static inline void counter_max(uint32_t *counter, uint32_t value) {
+  uint32_t current = __atomic_load_n(counter, __ATOMIC_RELAXED);
+  while (value > current &&
+         !__atomic_compare_exchange_n(counter, &current, value, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+/*!
+  @brief Obtain The Datapath Counters Of A Port
+
+  @param port_num port number 1-15
+
+  @return pointer to the port's counters
+  @return NULL if the port number is out of range
+ */
+static inline BmL2PortCounters *port_counters(uint8_t port_num) {
+  if (port_num == 0 || port_num > l2_max_ports) {
+    return NULL;
+  }
+  return &CTX.port_counters[port_num - 1];
+}
+
+/*!
+  @brief Queue An Event To The L2 Thread
+
+  @details Tracks the number of events in flight to record the event queue
+           high-water mark
+
+  @param evt event to queue
+  @param timeout_ms time to wait for space in the queue
+
+  @return BmOK on success
+  @return BmErr on failure
+ */
+static BmErr bm_l2_queue_evt(const L2QueueElement *evt, uint32_t timeout_ms) {
+  const uint32_t in_flight =
+      __atomic_add_fetch(&CTX.evt_in_flight, 1, __ATOMIC_RELAXED);
+  BmErr err = bm_queue_send(CTX.evt_queue, evt, timeout_ms);
+  if (err == BmOK) {
+    counter_max(&CTX.counters.evt_queue_high_water, in_flight);
+  } else {
+    __atomic_sub_fetch(&CTX.evt_in_flight, 1, __ATOMIC_RELAXED);
+  }
+  return err;
+}
+
 /*!
   @brief Trigger a renegotiation event on the requested port
  
@@ -176,10 +278,47 @@ static BmErr bm_l2_stop_renegotiate_check(uint8_t port_num) {
   return BmENODEV;
 }
 
+/*!
+  @brief Queue A Bulk TX Event
+
+  @details The L2 thread is woken with an L2TxBulk event only if one is not
+           already on its way. If that event can not be queued the thread is
+           busy with a full event queue and finds the bulk event on its next
+           pass through bulk_in_flight.
+
+  @param evt bulk tx event
+  @param timeout_ms time to wait for space in the bulk queue
+
+  @return BmOK on success
+  @return BmErr on failure
+ */
+static BmErr bm_l2_queue_bulk_evt(const L2QueueElement *evt,
+                                  uint32_t timeout_ms) {
+  __atomic_add_fetch(&CTX.bulk_in_flight, 1, __ATOMIC_RELAXED);
+  BmErr err = bm_queue_send(CTX.bulk_queue, evt, timeout_ms);
+  if (err != BmOK) {
+    __atomic_sub_fetch(&CTX.bulk_in_flight, 1, __ATOMIC_RELAXED);
+    return err;
+  }
+
+  if (!__atomic_exchange_n(&CTX.bulk_doorbell, true, __ATOMIC_ACQ_REL)) {
+    const L2QueueElement doorbell = {.type = L2TxBulk};
+    if (bm_l2_queue_evt(&doorbell, 0) != BmOK) {
+      __atomic_store_n(&CTX.bulk_doorbell, false, __ATOMIC_RELEASE);
+    }
+  }
+  return BmOK;
+}
+
 /*!
   @brief L2 TX Function
 
-  @details Queues buffer to be sent over the network
+  @details Queues buffer to be sent over the network. Frames are classified
+           here, in the sender's context. Control and realtime frames go
+           through the event queue and bulk frames through the bulk queue,
+           so a burst of bulk frames never sits in front of a heartbeat.
+           Either way the sender waits up to 10ms for room before the frame
+           is dropped.
 
   @param *buf buffer with frame/data to send out
   @param length size of buffer in bytes
@@ -196,8 +335,14 @@ static BmErr bm_l2_tx(void *buf, uint32_t length, uint16_t port_mask) {
                            .type = L2Tx,
                            .length = length,
                            .buf = buf};
+  tx_evt.tx_class = bm_l2_policy_tx_class(
+      (const uint8_t *)bm_l2_get_payload(buf), length, CTX.realtime_udp_ports,
+      __atomic_load_n(&CTX.realtime_udp_port_count, __ATOMIC_ACQUIRE));
 
-  if (bm_queue_send(CTX.evt_queue, &tx_evt, 10) != BmOK) {
+  err = tx_evt.tx_class == L2TxClassBulk ? bm_l2_queue_bulk_evt(&tx_evt, 10)
+                                         : bm_l2_queue_evt(&tx_evt, 10);
+  if (err != BmOK) {
+    counter_add(&CTX.counters.drop_tx_queue_full, 1);
     bm_l2_free(buf);
     err = BmENOMEM;
   }
@@ -205,6 +350,93 @@ static BmErr bm_l2_tx(void *buf, uint32_t length, uint16_t port_mask) {
   return err;
 }
 
+/*!
+  @brief Hand A Frame To The Packet Capture Callback
+
+  @details The capture filter runs over the frame headers first, so frames
+           that are not of interest never reach the capture callback
+
+  @param frame frame received or sent
+  @param length frame length in bytes
+  @param port_num port the frame was received or sent on
+  @param egress true if the frame was sent
+ */
+static void bm_l2_capture(const uint8_t *frame, size_t length,
+                          uint8_t port_num, bool egress) {
+  // Claim the slot, then check it is still the published one. Either this
+  // sees a newer program or the writer sees the claim, so a slot is never
+  // rewritten while it is being run.
+  L2CaptureFilter *filter;
+  while ((filter = __atomic_load_n(&CTX.capture_filter, __ATOMIC_SEQ_CST))) {
+    __atomic_fetch_add(&filter->readers, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&CTX.capture_filter, __ATOMIC_SEQ_CST) == filter) {
+      break;
+    }
+    __atomic_fetch_sub(&filter->readers, 1, __ATOMIC_RELEASE);
+  }
+
+  bool accept = !filter || bm_l2_capture_filter_run(filter->prog, filter->len,
+                                                    frame, length, port_num,
+                                                    egress);
+  if (accept) {
+    CTX.pcap_cb(frame, length, port_num, egress);
+  }
+  if (filter) {
+    __atomic_fetch_sub(&filter->readers, 1, __ATOMIC_RELEASE);
+  }
+}
+
+/*!
+  @brief Count A Received Frame And Hand It To The Packet Capture Callback
+
+  @param port_num ingress port number 1-15
+  @param port_num ingress port number 1-15
+  @param counters counters of the ingress port
+  @param data received frame
+  @param length frame length in bytes
+ */
+static void bm_l2_rx_account(uint8_t port_num, BmL2PortCounters *counters,
+                             const uint8_t *data, size_t length) {
+  counter_add(&counters->rx_frames, 1);
+  counter_add(&counters->rx_bytes, length);
+  if (CTX.pcap_cb) {
+    bm_l2_capture(data, length, port_num, false);
+  }
+}
+
+/*!
+  @brief Check If A Received Frame Is A Flooded Duplicate
+
+  @details Global multicast frames are flooded out of every port, a loop in
+           the network brings them back in. Frames seen within
+           bm_l2_flood_cache_window_ms are dropped here, before they are
+           copied or queued.
+
+  @param counters counters of the ingress port
+  @param data received frame
+  @param length frame length in bytes
+
+  @return true if the frame should be dropped
+ */
+static bool bm_l2_rx_is_flood_duplicate(uint8_t port_num,
+                                        BmL2PortCounters *counters,
+                                        const uint8_t *data, size_t length) {
+  const size_t min_len =
+      ipv6_destination_address_offset + ipv6_destination_address_size_bytes;
+  if (length < min_len || ethernet_get_type(data) != ethernet_type_ipv6 ||
+      !is_global_multicast(
+          (const BmIpAddr *)&data[ipv6_destination_address_offset])) {
+    return false;
+  }
+
+  if (bm_l2_flood_cache_seen(&CTX.flood_cache, data, length, port_num,
+                             bm_ticks_to_ms(bm_get_tick_count()))) {
+    counter_add(&counters->drop_flood_duplicate, 1);
+    return true;
+  }
+  return false;
+}
+
 /*!
   @brief L2 RX Function - called by low level driver when new data is available
 
@@ -217,16 +449,21 @@ static void bm_l2_rx(uint8_t port_num, uint8_t *data, size_t length) {
   L2QueueElement rx_evt = {
       .type = L2Rx, .length = length, .buf = NULL, .port_mask = port_mask};
 
-  if (data) {
-    if (CTX.pcap_cb) {
-      CTX.pcap_cb(data, length);
+  BmL2PortCounters *counters = port_counters(port_num);
+
+  if (data && counters) {
+    bm_l2_rx_account(port_num, counters, data, length);
+    if (bm_l2_rx_is_flood_duplicate(port_num, counters, data, length)) {
+      return;
     }
     rx_evt.buf = bm_l2_new(length);
     if (rx_evt.buf == NULL) {
+      counter_add(&counters->drop_rx_no_mem, 1);
       bm_debug("No mem for buf in RX pathway\n");
     } else {
       memcpy(bm_l2_get_payload(rx_evt.buf), data, length);
-      if (bm_queue_send(CTX.evt_queue, &rx_evt, 0) != BmOK) {
+      if (bm_l2_queue_evt(&rx_evt, 0) != BmOK) {
+        counter_add(&counters->drop_rx_queue_full, 1);
         bm_l2_free(rx_evt.buf);
       }
     }
@@ -234,70 +471,149 @@ static void bm_l2_rx(uint8_t port_num, uint8_t *data, size_t length) {
 }
 
 /*!
-  @brief Revert The Checksum From The Payload
+  @brief Return A Loaned RX Buffer To The Network Device
 
-  @details This must be called whenever there is a message being
-           transmitted on multiple ports. This ensures the checksum
-           is clean before the next port is utilized.
+  @details Invoked by the IP stack abstraction when the last reference to a
+           buffer created with bm_l2_new_ref is freed
 
-  @param payload payload that was just sent over a port
-  @param port_num port which the payload was sent
+  @param arg loan handed to bm_l2_rx_loan
  */
-static inline void network_revert_checksum(uint8_t *payload, uint8_t port_num) {
-  if (ethernet_get_type(payload) == ethernet_type_ipv6) {
-    if (ipv6_get_next_header(payload) == ip_proto_udp) {
-      payload[udp_checksum_offset] ^= 0xFFFF;
-      payload[udp_checksum_offset] -= port_num;
-      payload[udp_checksum_offset] ^= 0xFFFF;
-    } else if (ipv6_get_next_header(payload) == ip_proto_bcmp) {
-      BcmpHeader *header = (BcmpHeader *)&payload[bcmp_packet_offset];
-      header->checksum ^= 0xFFFF;
-      header->checksum -= port_num;
-      header->checksum ^= 0xFFFF;
-    }
+static void bm_l2_rx_loan_release(void *arg) {
+  NetworkDeviceRxLoan *loan = (NetworkDeviceRxLoan *)arg;
+  loan->release(loan);
+}
+
+/*!
+  @brief L2 Zero-Copy RX Function - called by low level driver when new data
+         is available in a buffer it is able to loan to the stack
+
+  @details The driver buffer is wrapped without copying and queued exactly
+           like bm_l2_rx. Once this returns BmOK the loan is released when
+           the last reference to the wrapped buffer is freed, including when
+           the frame is dropped.
+
+  @param port_num ingress port number 1-15
+  @param loan driver buffer being loaned to the stack
+
+  @return BmOK if the stack took ownership of the loan
+  @return BmErr if the driver still owns the buffer
+ */
+static BmErr bm_l2_rx_loan(uint8_t port_num, NetworkDeviceRxLoan *loan) {
+  BmL2PortCounters *counters = port_counters(port_num);
+  if (!loan || !loan->data || !loan->release || !counters) {
+    return BmEINVAL;
+  }
+
+  // Wrapped before the flood check, so a frame the driver falls back to
+  // copying through bm_l2_rx is not mistaken for its own duplicate
+  void *buf = bm_l2_new_ref(loan->data, loan->length, bm_l2_rx_loan_release,
+                            loan);
+  if (buf == NULL) {
+    return BmENOMEM;
+  }
+
+  bm_l2_rx_account(port_num, counters, loan->data, loan->length);
+  if (bm_l2_rx_is_flood_duplicate(port_num, counters, loan->data,
+                                  loan->length)) {
+    // Freeing the wrapper releases the loan back to the driver
+    bm_l2_free(buf);
+    return BmOK;
   }
+
+  L2QueueElement rx_evt = {.type = L2Rx,
+                           .length = loan->length,
+                           .buf = buf,
+                           .port_mask = 1U << (port_num - 1)};
+  if (bm_l2_queue_evt(&rx_evt, 0) != BmOK) {
+    // Freeing the wrapper releases the loan back to the driver
+    counter_add(&counters->drop_rx_queue_full, 1);
+    bm_l2_free(buf);
+  }
+
+  return BmOK;
+}
+
+/*!
+  @brief Locate The Transport Checksum Of A Frame
+
+  @param payload buffer with frame
+
+  @return pointer to the big-endian UDP or BCMP checksum
+  @return NULL if the frame carries neither
+ */
+static inline uint8_t *transport_checksum(uint8_t *payload) {
+  if (ethernet_get_type(payload) != ethernet_type_ipv6) {
+    return NULL;
+  }
+  if (ipv6_get_next_header(payload) == ip_proto_udp) {
+    return &payload[udp_checksum_offset];
+  }
+  if (ipv6_get_next_header(payload) == ip_proto_bcmp) {
+    return &payload[bcmp_packet_offset + offsetof(BcmpHeader, checksum)];
+  }
+  return NULL;
 }
 
 /*!
   @brief Add egress port to source IP address and update UDP checksum
 
   @details Updates the payload with the egress port according to the Bristlemouth spec.
-           After modifying the source IP address, the UDP checksum must be updated.
+           The ports byte is covered by the UDP and BCMP checksums, which are
+           updated incrementally (RFC 1624) for the changed word.
 
   @param payload buffer with frame
+  @param checksum transport checksum of the frame, NULL if it has none
   @param port_num egress port (1-15) that the frame will be sent out
 */
-static inline void network_add_egress_port(uint8_t *payload, uint8_t port_num) {
+static inline void network_add_egress_port(uint8_t *payload, uint8_t *checksum,
+                                           uint8_t port_num) {
+  // The ports byte is the most significant byte of a checksummed word
+  uint8_t *word = &payload[ipv6_ingress_egress_ports_offset];
+  const uint16_t old_word = uint8_to_uint16(word);
+
   // Modify egress port byte in IP address
   add_egress_port(payload, port_num);
 
-  // Update the checksum to account for the change in source IP address
-  if (ethernet_get_type(payload) == ethernet_type_ipv6) {
-    if (ipv6_get_next_header(payload) == ip_proto_udp) {
-      // Undo 1's complement
-      payload[udp_checksum_offset] ^= 0xFFFF;
+  if (checksum) {
+    uint16_t updated =
+        checksum_update(uint8_to_uint16(checksum), old_word,
+                        uint8_to_uint16(word));
+    // A computed UDP checksum of zero is transmitted as all ones
+    if (updated == 0 && ipv6_get_next_header(payload) == ip_proto_udp) {
+      updated = 0xFFFF;
+    }
+    checksum[0] = (uint8_t)(updated >> 8);
+    checksum[1] = (uint8_t)updated;
+  }
+}
 
-      // Add port to checksum (we can only do this because the value was previously 0)
-      // Since udp checksum is sum of uint16_t bytes
-      payload[udp_checksum_offset] += port_num;
+/*!
+  @brief Account For A Frame Handed To The Network Device
 
-      // Do 1's complement again
-      payload[udp_checksum_offset] ^= 0xFFFF;
-    } else if (ipv6_get_next_header(payload) == ip_proto_bcmp) {
-      BcmpHeader *header = (BcmpHeader *)&payload[bcmp_packet_offset];
-      header->checksum ^= 0xFFFF;
-      header->checksum += port_num;
-      header->checksum ^= 0xFFFF;
-    }
+  @param port_num egress port 1-15
+  @param length size of the frame in bytes
+  @param err result of the network device send
+ */
+static void count_tx(uint8_t port_num, size_t length, BmErr err) {
+  BmL2PortCounters *counters = port_counters(port_num);
+  if (!counters) {
+    return;
+  }
+  if (err == BmOK) {
+    counter_add(&counters->tx_frames, 1);
+    counter_add(&counters->tx_bytes, length);
+  } else {
+    counter_add(&counters->drop_send_failed, 1);
   }
 }
 
 static void send_to_port(uint8_t port_num, uint8_t *payload, size_t length) {
   if (CTX.pcap_cb) {
-    CTX.pcap_cb(payload, length);
+    bm_l2_capture(payload, length, port_num, true);
   }
   BmErr err = CTX.network_device.trait->send(CTX.network_device.self, payload,
                                              length, port_num);
+  count_tx(port_num, length, err);
   if (err != BmOK) {
     bm_debug("Failed to send packet to port %d. err=%d\n", port_num, err);
   }
@@ -306,11 +622,16 @@ static void send_to_port(uint8_t port_num, uint8_t *payload, size_t length) {
 static void send_global_multicast_packet(uint8_t *payload, size_t length,
                                          uint16_t port_mask) {
   if (port_mask == CTX.all_ports_mask) {
-    if (CTX.pcap_cb) {
-      CTX.pcap_cb(payload, length);
+    // The frame goes out of every port, capture it once per port
+    for (uint8_t port_num = 1; port_num <= CTX.num_ports && CTX.pcap_cb;
+         port_num++) {
+      bm_l2_capture(payload, length, port_num, true);
     }
     BmErr err = CTX.network_device.trait->send(CTX.network_device.self, payload,
                                                length, device_all_ports);
+    for (uint8_t port_num = 1; port_num <= CTX.num_ports; port_num++) {
+      count_tx(port_num, length, err);
+    }
     if (err != BmOK) {
       bm_debug("Failed to send global multicast packet to all ports. err=%d\n",
                err);
@@ -326,38 +647,271 @@ static void send_global_multicast_packet(uint8_t *payload, size_t length,
 }
 
 /*!
-  @brief Process TX Event
+  @brief Send A TX Frame Out Of A Single Port
 
-  @details Receive message from L2 queue and send to the network device,
-           the specific ports to use are stored in the tx_evt data structure
+  @details Link local multicast frames carry the egress port in the source
+           address, so the nibble and checksum are patched before the send
+           and the saved bytes restored afterwards so the same buffer can go
+           out the next port untouched.
 
-  @param *tx_evt tx event with buffer, port, and other information
-*/
-static void bm_l2_process_tx_evt(L2QueueElement *tx_evt) {
-  if (tx_evt == NULL) {
-    return;
-  }
-
-  uint8_t *payload = (uint8_t *)bm_l2_get_payload(tx_evt->buf);
+  @param payload frame to send
+  @param length size of the frame in bytes
+  @param port_num egress port (1-15)
+ */
+static void send_tx_frame_to_port(uint8_t *payload, size_t length,
+                                  uint8_t port_num) {
   const BmIpAddr *dst_ip =
       (BmIpAddr *)&payload[ipv6_destination_address_offset];
   if (is_global_multicast(dst_ip)) {
-    send_global_multicast_packet(payload, tx_evt->length, tx_evt->port_mask);
+    send_to_port(port_num, payload, length);
   } else if (is_link_local_multicast(dst_ip)) {
-    for (uint8_t port_idx = 0; port_idx < CTX.num_ports; port_idx++) {
-      if (tx_evt->port_mask & (1U << port_idx)) {
-        uint8_t port_num = port_idx + 1;
-        network_add_egress_port(payload, port_num);
-        send_to_port(port_num, payload, tx_evt->length);
-        clear_ports(payload);
-        network_revert_checksum(payload, port_num);
+    uint8_t *checksum = transport_checksum(payload);
+    const uint8_t ports = payload[ipv6_ingress_egress_ports_offset];
+    uint8_t saved_checksum[udp_checksum_size_bytes] = {0};
+    if (checksum) {
+      memcpy(saved_checksum, checksum, sizeof(saved_checksum));
+    }
+    network_add_egress_port(payload, checksum, port_num);
+    send_to_port(port_num, payload, length);
+    payload[ipv6_ingress_egress_ports_offset] = ports;
+    if (checksum) {
+      memcpy(checksum, saved_checksum, sizeof(saved_checksum));
+    }
+  }
+}
+
+/*!
+  @brief Obtain The Egress Queue For A Port And Traffic Class
+
+  @param port_num egress port (1-15), or device_all_ports for frames that
+                  are flooded to every port in a single device call
+  @param tx_class traffic class of the queue
+
+  @return pointer to the queue
+ */
+static inline L2TxQueue *tx_queue(uint8_t port_num, BmL2TxClass tx_class) {
+  return &CTX.tx_queues[(port_num * L2TxClassCount) + tx_class];
+}
+
+/*!
+  @brief Push A Frame Onto An Egress Queue
+
+  @details The queue takes over one reference to buf on success
+
+  @param port_num egress port (1-15), or device_all_ports
+  @param tx_class traffic class of the frame
+  @param buf buffer holding the frame
+  @param length size of the frame in bytes
+
+  @return true if the frame was queued
+  @return false if the queue is full, the frame is counted as a drop
+ */
+static bool tx_queue_push(uint8_t port_num, BmL2TxClass tx_class, void *buf,
+                          uint32_t length) {
+  L2TxQueue *queue = tx_queue(port_num, tx_class);
+  const uint8_t first = port_num == device_all_ports ? 1 : port_num;
+  const uint8_t last = port_num == device_all_ports ? CTX.num_ports : port_num;
+
+  if (queue->count >= bm_l2_tx_queue_len) {
+    queue->drops++;
+    for (uint8_t port = first; port <= last; port++) {
+      counter_add(&port_counters(port)->drop_egress_queue_full, 1);
+    }
+    return false;
+  }
+
+  const uint16_t tail = (queue->head + queue->count) % bm_l2_tx_queue_len;
+  queue->entries[tail].buf = buf;
+  queue->entries[tail].length = length;
+  queue->count++;
+  CTX.tx_pending++;
+  for (uint8_t port = first; port <= last; port++) {
+    counter_max(&port_counters(port)->egress_queue_high_water, queue->count);
+  }
+  return true;
+}
+
+/*!
+  @brief Check Whether A TX Event Goes Into The All Ports Queue
+
+  @param tx_evt tx event with buffer, port, and other information
+
+  @return true if the frame is global multicast to every port
+ */
+static bool is_all_ports_evt(const L2QueueElement *tx_evt) {
+  const uint8_t *payload = (const uint8_t *)bm_l2_get_payload(tx_evt->buf);
+  const BmIpAddr *dst_ip =
+      (const BmIpAddr *)&payload[ipv6_destination_address_offset];
+  return is_global_multicast(dst_ip) &&
+         tx_evt->port_mask == CTX.all_ports_mask;
+}
+
+/*!
+  @brief Check Whether Every Egress Queue Of A TX Event Has Room
+
+  @param tx_evt tx event with buffer, port, and other information
+
+  @return true if the frame can be queued without a drop
+ */
+static bool tx_evt_fits(const L2QueueElement *tx_evt) {
+  if (is_all_ports_evt(tx_evt)) {
+    return tx_queue(device_all_ports, tx_evt->tx_class)->count <
+           bm_l2_tx_queue_len;
+  }
+  for (uint8_t port_idx = 0; port_idx < CTX.num_ports; port_idx++) {
+    if ((tx_evt->port_mask & (1U << port_idx)) &&
+        tx_queue(port_idx + 1, tx_evt->tx_class)->count >=
+            bm_l2_tx_queue_len) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*!
+  @brief Sort A TX Event Into The Egress Queues
+
+  @details Frames were classified by bm_l2_tx, global multicast frames
+           destined to every port go into the all ports queue so they are
+           handed to the network device in a single call, every other frame
+           is queued on each of its egress ports sharing the same buffer.
+
+  @param tx_evt tx event with buffer, port, and other information
+*/
+static void bm_l2_enqueue_tx_evt(L2QueueElement *tx_evt) {
+  const BmL2TxClass tx_class = tx_evt->tx_class;
+  if (is_all_ports_evt(tx_evt)) {
+    if (!tx_queue_push(device_all_ports, tx_class, tx_evt->buf,
+                       tx_evt->length)) {
+      bm_l2_free(tx_evt->buf);
+    }
+    return;
+  }
+
+  for (uint8_t port_idx = 0; port_idx < CTX.num_ports; port_idx++) {
+    if (tx_evt->port_mask & (1U << port_idx)) {
+      bm_l2_tx_prep(tx_evt->buf, tx_evt->length);
+      if (!tx_queue_push(port_idx + 1, tx_class, tx_evt->buf,
+                         tx_evt->length)) {
+        bm_l2_free(tx_evt->buf);
       }
     }
   }
 
+  // Each queue holds its own reference, release the one from the event
   bm_l2_free(tx_evt->buf);
 }
 
+/*!
+  @brief Move Bulk TX Events Into The Egress Queues
+
+  @details Events are only taken while their egress queues have room. The
+           rest stay in the bulk queue, so bulk senders block in bm_l2_tx
+           rather than having their frames dropped.
+*/
+static void bm_l2_drain_bulk(void) {
+  while (true) {
+    if (!CTX.bulk_held_valid) {
+      if (bm_queue_receive(CTX.bulk_queue, &CTX.bulk_held, 0) != BmOK) {
+        return;
+      }
+      __atomic_sub_fetch(&CTX.bulk_in_flight, 1, __ATOMIC_RELAXED);
+      CTX.bulk_held_valid = true;
+    }
+    if (!tx_evt_fits(&CTX.bulk_held)) {
+      return;
+    }
+    bm_l2_enqueue_tx_evt(&CTX.bulk_held);
+    CTX.bulk_held_valid = false;
+  }
+}
+
+/*!
+  @brief Feed Queued Frames To The Network Device
+
+  @details Strict priority scheduler, a class is only serviced once every
+           queue of all higher priority classes is empty. Within a class
+           each port's queue is drained back to back so the device services
+           one port at a time. At most bm_l2_tx_sched_budget frames are sent
+           per pass, leaving the thread free to pick up newly queued higher
+           priority frames before the rest of a bulk burst goes out.
+*/
+static void bm_l2_tx_schedule(void) {
+  uint32_t budget = bm_l2_tx_sched_budget;
+
+  for (uint8_t tx_class = 0; tx_class < L2TxClassCount && budget; tx_class++) {
+    for (uint8_t port_num = device_all_ports;
+         port_num <= CTX.num_ports && budget; port_num++) {
+      L2TxQueue *queue = tx_queue(port_num, (BmL2TxClass)tx_class);
+      while (queue->count && budget) {
+        L2TxEntry *entry = &queue->entries[queue->head];
+        uint8_t *payload = (uint8_t *)bm_l2_get_payload(entry->buf);
+        if (port_num == device_all_ports) {
+          send_global_multicast_packet(payload, entry->length,
+                                       CTX.all_ports_mask);
+        } else {
+          send_tx_frame_to_port(payload, entry->length, port_num);
+        }
+        bm_l2_free(entry->buf);
+        queue->head = (queue->head + 1) % bm_l2_tx_queue_len;
+        queue->count--;
+        CTX.tx_pending--;
+        budget--;
+      }
+    }
+  }
+}
+
+/*!
+  @brief Queue A Received Frame For Forwarding
+
+  @details Forwarded frames are classified and go through the egress queues
+           like locally sent ones, so forwarded bulk traffic can not delay
+           control frames. The ports byte of the source address must go out
+           on the wire cleared. A frame that is only forwarded is cleared in
+           place and its buffer shared between the egress queues. A frame
+           that is also submitted up the stack keeps its ingress nibble, so
+           a copy is forwarded instead.
+
+  @param buf received frame with the RX policy applied
+  @param length size of the frame in bytes
+  @param egress_mask ports to forward the frame out of
+  @param submit true if buf is also submitted up the stack
+ */
+static void bm_l2_forward(void *buf, uint32_t length, uint16_t egress_mask,
+                          bool submit) {
+  void *forward = buf;
+  if (submit) {
+    forward = bm_l2_new(length);
+    if (!forward) {
+      bm_debug("No mem to forward frame\n");
+      return;
+    }
+    memcpy(bm_l2_get_payload(forward), bm_l2_get_payload(buf), length);
+  } else {
+    // The event below holds its own reference, the caller still frees buf
+    bm_l2_tx_prep(buf, length);
+  }
+
+  uint8_t *payload = (uint8_t *)bm_l2_get_payload(forward);
+  bm_l2_policy_prepare_forwarded_copy(payload, length);
+
+  for (uint8_t port_idx = 0; port_idx < CTX.num_ports; port_idx++) {
+    if (egress_mask & (1U << port_idx)) {
+      counter_add(&CTX.port_counters[port_idx].forwarded_frames, 1);
+    }
+  }
+
+  L2QueueElement tx_evt = {.type = L2Tx,
+                           .length = length,
+                           .buf = forward,
+                           .port_mask = egress_mask};
+  tx_evt.tx_class =
+      bm_l2_policy_tx_class(payload, length, CTX.realtime_udp_ports,
+                            CTX.realtime_udp_port_count);
+  bm_l2_enqueue_tx_evt(&tx_evt);
+}
+
 /*!
   @brief Process RX event
 
@@ -383,20 +937,12 @@ static void bm_l2_process_rx_evt(L2QueueElement *rx_evt) {
       bm_l2_policy_rx_apply(payload, rx_evt->length, rx_evt->port_mask,
                             CTX.all_ports_mask, CTX.routing_cb);
 
-  // Forwarding: create a copy and prepare it for on-wire transmission.
-  if (policy_result.egress_mask) {
-    void *fwd_buf = bm_l2_new(rx_evt->length);
-    if (fwd_buf != NULL) {
-      uint8_t *fwd_payload = (uint8_t *)bm_l2_get_payload(fwd_buf);
-      memcpy(fwd_payload, payload, rx_evt->length);
-
-      // Ensure forwarded copy has ingress and egress ports cleared.
-      bm_l2_policy_prepare_forwarded_copy(fwd_payload, rx_evt->length);
-
-      bm_l2_tx(fwd_buf, rx_evt->length, policy_result.egress_mask);
-    } else {
-      bm_debug("L2 dropped forward, no mem for buf\n");
-    }
+  // Forwarding: queued on the egress ports by traffic class
+  const uint16_t egress_mask =
+      policy_result.egress_mask & CTX.enabled_ports_mask;
+  if (egress_mask) {
+    bm_l2_forward(rx_evt->buf, rx_evt->length, egress_mask,
+                  policy_result.should_submit);
   }
 
   BmErr err = BmENODEV;
@@ -405,6 +951,11 @@ static void bm_l2_process_rx_evt(L2QueueElement *rx_evt) {
   // Upper level RX callback frees packet.
   if (policy_result.should_submit) {
     err = bm_l2_submit(rx_evt->buf, rx_evt->length);
+    BmL2PortCounters *counters =
+        port_counters((uint8_t)__builtin_ffs(rx_evt->port_mask));
+    if (err != BmOK && counters) {
+      counter_add(&counters->drop_submit_failed, 1);
+    }
   }
 
   if (err != BmOK) {
@@ -412,6 +963,44 @@ static void bm_l2_process_rx_evt(L2QueueElement *rx_evt) {
   }
 }
 
+/*!
+  @brief Process A Batch Of L2 Events
+
+  @details Events are handled in the order they were queued, TX events are
+           sorted into the egress queues and sent by bm_l2_tx_schedule. Bulk
+           TX events are picked up from the bulk queue afterwards by
+           bm_l2_drain_bulk.
+
+  @param events events drained from the L2 queue
+  @param count number of events in the batch
+ */
+static void bm_l2_process_evts(L2QueueElement *events, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    switch (events[i].type) {
+    case L2Tx: {
+      bm_l2_enqueue_tx_evt(&events[i]);
+      break;
+    }
+    case L2Rx: {
+      bm_l2_process_rx_evt(&events[i]);
+      break;
+    }
+    case L2Irq: {
+      CTX.network_device.trait->handle_interrupt(CTX.network_device.self);
+      break;
+    }
+    case L2TxBulk: {
+      // Later bulk events ring again, this pass drains what is queued now
+      __atomic_store_n(&CTX.bulk_doorbell, false, __ATOMIC_RELEASE);
+      break;
+    }
+    default: {
+      break;
+    }
+    }
+  }
+}
+
 /*!
   @brief L2 thread which handles both tx and rx events
 
@@ -430,25 +1019,23 @@ static void bm_l2_thread(void *parameters) {
   }
 
   while (true) {
-    L2QueueElement event;
-    if (bm_queue_receive(CTX.evt_queue, &event, UINT32_MAX) == BmOK) {
-      switch (event.type) {
-      case L2Tx: {
-        bm_l2_process_tx_evt(&event);
-        break;
-      }
-      case L2Rx: {
-        bm_l2_process_rx_evt(&event);
-        break;
-      }
-      case L2Irq: {
-        CTX.network_device.trait->handle_interrupt(CTX.network_device.self);
-        break;
-      }
-      default: {
-        break;
-      }
-      }
+    L2QueueElement events[bm_l2_evt_batch_len];
+    uint32_t count = 0;
+    // Only block when nothing is waiting in the egress or bulk queues
+    const bool pending =
+        CTX.tx_pending || CTX.bulk_held_valid ||
+        __atomic_load_n(&CTX.bulk_in_flight, __ATOMIC_RELAXED);
+    const uint32_t timeout_ms = pending ? 0 : UINT32_MAX;
+    if (bm_queue_receive_many(CTX.evt_queue, events, bm_l2_evt_batch_len,
+                              &count, timeout_ms) == BmOK) {
+      __atomic_sub_fetch(&CTX.evt_in_flight, count, __ATOMIC_RELAXED);
+      bm_l2_process_evts(events, count);
+    }
+    bm_l2_drain_bulk();
+    bm_l2_tx_schedule();
+    // Devices that batch transmissions send everything queued this pass
+    if (CTX.network_device.trait->flush) {
+      CTX.network_device.trait->flush(CTX.network_device.self);
     }
   }
 }
@@ -522,7 +1109,15 @@ BmErr bm_l2_handle_device_interrupt(void) {
       .type = L2Irq, .length = 0, .buf = NULL, .port_mask = 0};
 
   if (CTX.evt_queue) {
-    return bm_queue_send_to_front_from_isr(CTX.evt_queue, &int_evt);
+    const uint32_t in_flight =
+        __atomic_add_fetch(&CTX.evt_in_flight, 1, __ATOMIC_RELAXED);
+    BmErr err = bm_queue_send_to_front_from_isr(CTX.evt_queue, &int_evt);
+    if (err == BmOK) {
+      counter_max(&CTX.counters.evt_queue_high_water, in_flight);
+    } else {
+      __atomic_sub_fetch(&CTX.evt_in_flight, 1, __ATOMIC_RELAXED);
+    }
+    return err;
   }
 
   return BmENOMEM;
@@ -537,12 +1132,28 @@ void bm_l2_deinit(void) {
   if (CTX.evt_queue) {
     bm_queue_delete(CTX.evt_queue);
   }
+  if (CTX.bulk_queue) {
+    bm_queue_delete(CTX.bulk_queue);
+  }
   if (CTX.task_handle) {
     bm_task_delete(CTX.task_handle);
   }
+  if (CTX.bulk_held_valid) {
+    bm_l2_free(CTX.bulk_held.buf);
+  }
   for (uint8_t port_num = 1; port_num <= CTX.num_ports; port_num++) {
     bm_l2_stop_renegotiate_check(port_num);
   }
+  if (CTX.tx_queues) {
+    for (uint32_t i = 0; i < (CTX.num_ports + 1U) * L2TxClassCount; i++) {
+      L2TxQueue *queue = &CTX.tx_queues[i];
+      for (; queue->count; queue->count--) {
+        bm_l2_free(queue->entries[queue->head].buf);
+        queue->head = (queue->head + 1) % bm_l2_tx_queue_len;
+      }
+    }
+    bm_free(CTX.tx_queues);
+  }
   memset(&CTX, 0, sizeof(BmL2Ctx));
 }
 
@@ -557,12 +1168,21 @@ void bm_l2_deinit(void) {
 BmErr bm_l2_init(NetworkDevice network_device) {
   BmErr err = BmEINVAL;
   network_device.callbacks->receive = bm_l2_rx;
+  network_device.callbacks->receive_loan = bm_l2_rx_loan;
   network_device.callbacks->link_change = link_change;
   CTX.network_device = network_device;
   CTX.num_ports = network_device.trait->num_ports();
   CTX.all_ports_mask = (1U << CTX.num_ports) - 1;
+  bm_l2_flood_cache_init(&CTX.flood_cache);
+  const size_t tx_queues_size =
+      sizeof(L2TxQueue) * (CTX.num_ports + 1U) * L2TxClassCount;
+  CTX.tx_queues = (L2TxQueue *)bm_malloc(tx_queues_size);
+  if (CTX.tx_queues) {
+    memset(CTX.tx_queues, 0, tx_queues_size);
+  }
   CTX.evt_queue = bm_queue_create(evt_queue_len, sizeof(L2QueueElement));
-  if (CTX.evt_queue) {
+  CTX.bulk_queue = bm_queue_create(bulk_queue_len, sizeof(L2QueueElement));
+  if (CTX.evt_queue && CTX.bulk_queue && CTX.tx_queues) {
     err = bm_task_create(bm_l2_thread, "L2", 2048, NULL, bm_l2_tx_task_priority,
                          &CTX.task_handle);
   } else {
@@ -720,3 +1340,145 @@ BmErr bm_l2_register_pcap_callback(L2PcapCb cb) {
   CTX.pcap_cb = cb;
   return BmOK;
 }
+
+/*!
+  @brief Set The Packet Capture Filter
+
+  @details Frames are only handed to the capture callback when the filter
+           program accepts them, see l2_capture_filter.h. The program is
+           copied, so the caller's array can go out of scope. Updates must
+           not be made from more than one thread at a time. The program is
+           written to the slot that is not published, which is refused
+           while a frame captured before the previous update is still
+           running it.
+
+  @param prog filter program, NULL to capture every frame
+  @param len number of instructions in the program
+
+  @return BmOK on success
+  @return BmEINVAL if the program is not valid
+  @return BmEAGAIN if the free slot is still in use, retry later
+ */
+BmErr bm_l2_set_capture_filter(const BmL2CaptureInsn *prog, size_t len) {
+  if (!prog) {
+    __atomic_store_n(&CTX.capture_filter, NULL, __ATOMIC_RELEASE);
+    return BmOK;
+  }
+
+  BmErr err = bm_l2_capture_filter_validate(prog, len);
+  if (err == BmOK) {
+    L2CaptureFilter *filter =
+        CTX.capture_filter == &CTX.capture_filter_slots[0]
+            ? &CTX.capture_filter_slots[1]
+            : &CTX.capture_filter_slots[0];
+    if (__atomic_load_n(&filter->readers, __ATOMIC_SEQ_CST)) {
+      return BmEAGAIN;
+    }
+    memcpy(filter->prog, prog, len * sizeof(BmL2CaptureInsn));
+    filter->len = (uint8_t)len;
+    __atomic_store_n(&CTX.capture_filter, filter, __ATOMIC_RELEASE);
+  }
+  return err;
+}
+
+/*!
+ @brief Map A UDP Destination Port To The Realtime Egress Class
+
+ @details Frames sent to this port are scheduled ahead of bulk traffic,
+          BCMP is always scheduled as control traffic
+
+ @param port UDP destination port
+
+ @return BmOK on success
+ @return BmENOMEM if bm_l2_realtime_udp_ports_max ports are already mapped
+ */
+BmErr bm_l2_register_realtime_udp_port(uint16_t port) {
+  for (uint8_t i = 0; i < CTX.realtime_udp_port_count; i++) {
+    if (CTX.realtime_udp_ports[i] == port) {
+      return BmOK;
+    }
+  }
+  if (CTX.realtime_udp_port_count >= bm_l2_realtime_udp_ports_max) {
+    return BmENOMEM;
+  }
+  // Published after the port so senders classifying frames never read an
+  // unset slot
+  CTX.realtime_udp_ports[CTX.realtime_udp_port_count] = port;
+  __atomic_store_n(&CTX.realtime_udp_port_count,
+                   (uint8_t)(CTX.realtime_udp_port_count + 1),
+                   __ATOMIC_RELEASE);
+  return BmOK;
+}
+
+/*!
+ @brief Obtain The Statistics Of An Egress Queue
+
+ @param port_num egress port (1-15), or 0 for the queue of frames flooded to
+                 all ports in a single device call
+ @param tx_class traffic class of the queue
+ @param stats current depth and number of frames dropped because the queue
+              was full
+
+ @return BmOK on success
+ @return BmEINVAL if the port, class or stats are invalid
+ */
+BmErr bm_l2_get_tx_queue_stats(uint8_t port_num, BmL2TxClass tx_class,
+                               BmL2TxQueueStats *stats) {
+  if (!stats || !CTX.tx_queues || port_num > CTX.num_ports ||
+      tx_class >= L2TxClassCount) {
+    return BmEINVAL;
+  }
+
+  const L2TxQueue *queue = tx_queue(port_num, tx_class);
+  stats->depth = queue->count;
+  stats->drops = queue->drops;
+  return BmOK;
+}
+
+/*!
+ @brief Obtain The Datapath Counters Of A Port
+
+ @details Counters are cumulative since bm_l2_init and wrap on overflow
+
+ @param port_num port number 1-15
+ @param counters copy of the port's counters
+
+ @return BmOK on success
+ @return BmEINVAL if the port or counters are invalid
+ */
+BmErr bm_l2_get_port_counters(uint8_t port_num, BmL2PortCounters *counters) {
+  if (!counters || port_num == 0 || port_num > CTX.num_ports) {
+    return BmEINVAL;
+  }
+
+  const uint32_t *src = (const uint32_t *)port_counters(port_num);
+  uint32_t *dst = (uint32_t *)counters;
+  for (size_t i = 0; i < sizeof(BmL2PortCounters) / sizeof(uint32_t); i++) {
+    dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+  }
+  return BmOK;
+}
+
+/*!
+ @brief Obtain The Datapath Counters That Are Not Tied To A Port
+
+ @param counters copy of the counters
+
+ @return BmOK on success
+ @return BmEINVAL if counters is NULL
+ */
+BmErr bm_l2_get_counters(BmL2Counters *counters) {
+  if (!counters) {
+    return BmEINVAL;
+  }
+
+  counters->drop_tx_queue_full =
+      __atomic_load_n(&CTX.counters.drop_tx_queue_full, __ATOMIC_RELAXED);
+  counters->evt_queue_high_water =
+      __atomic_load_n(&CTX.counters.evt_queue_high_water, __ATOMIC_RELAXED);
+  counters->flood_cache_hits =
+      __atomic_load_n(&CTX.flood_cache.hits, __ATOMIC_RELAXED);
+  counters->flood_cache_misses =
+      __atomic_load_n(&CTX.flood_cache.misses, __ATOMIC_RELAXED);
+  return BmOK;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "l2_capture_filter.h"
 #include "l2_policy.h"
 #include "network_device.h"
 #include "util.h"
@@ -15,8 +16,65 @@ extern "C" {
 #define bm_l2_tx_task_priority 7
 #endif
 
+// Maximum number of events drained from the L2 queue per wakeup
+#ifndef bm_l2_evt_batch_len
+#define bm_l2_evt_batch_len 8
+#endif
+
+// Depth of each per-port, per-class egress queue
+#ifndef bm_l2_tx_queue_len
+#define bm_l2_tx_queue_len 8
+#endif
+
+// Maximum number of frames handed to the network device per scheduler pass
+#ifndef bm_l2_tx_sched_budget
+#define bm_l2_tx_sched_budget 8
+#endif
+
+// Maximum number of UDP destination ports mapped to the realtime class
+#ifndef bm_l2_realtime_udp_ports_max
+#define bm_l2_realtime_udp_ports_max 4
+#endif
+
 typedef void (*L2LinkChangeCb)(uint8_t port, bool state);
-typedef void (*L2PcapCb)(const uint8_t *frame, size_t len);
+// Called for every frame received (egress false) and sent (egress true) on
+// port_num, RX from the network device callback context and TX from the L2
+// thread. Runs on the datapath, so it must not block, see pcap_async_capture.
+typedef void (*L2PcapCb)(const uint8_t *frame, size_t len, uint8_t port_num,
+                         bool egress);
+
+typedef struct {
+  uint32_t depth;
+  uint32_t drops;
+} BmL2TxQueueStats;
+
+typedef struct {
+  uint32_t rx_frames;
+  uint32_t rx_bytes;
+  uint32_t tx_frames;
+  uint32_t tx_bytes;
+  uint32_t forwarded_frames;
+  // Frames dropped, by reason
+  uint32_t drop_rx_no_mem;
+  uint32_t drop_rx_queue_full;
+  uint32_t drop_egress_queue_full;
+  uint32_t drop_send_failed;
+  uint32_t drop_submit_failed;
+  uint32_t drop_flood_duplicate;
+  // Deepest any egress queue of this port has been
+  uint32_t egress_queue_high_water;
+} BmL2PortCounters;
+
+typedef struct {
+  // TX frames dropped because the L2 event queue was full
+  uint32_t drop_tx_queue_full;
+  // Most events ever waiting in the L2 event queue
+  uint32_t evt_queue_high_water;
+  // Global multicast frames found (hits) and not found (misses) in the
+  // flood-loop suppression cache, each hit is a frame that was not forwarded
+  uint32_t flood_cache_hits;
+  uint32_t flood_cache_misses;
+} BmL2Counters;
 
 BmErr bm_l2_handle_device_interrupt(void);
 BmErr bm_l2_link_output(void *buf, uint32_t length);
@@ -29,6 +87,12 @@ BmErr bm_l2_netif_set_power(bool on);
 BmErr bm_l2_netif_enable_disable_port(uint8_t port_num, bool enable);
 BmErr bm_l2_register_link_local_routing_callback(L2LinkLocalRoutingCb cb);
 BmErr bm_l2_register_pcap_callback(L2PcapCb cb);
+BmErr bm_l2_set_capture_filter(const BmL2CaptureInsn *prog, size_t len);
+BmErr bm_l2_register_realtime_udp_port(uint16_t port);
+BmErr bm_l2_get_tx_queue_stats(uint8_t port_num, BmL2TxClass tx_class,
+                               BmL2TxQueueStats *stats);
+BmErr bm_l2_get_port_counters(uint8_t port_num, BmL2PortCounters *counters);
+BmErr bm_l2_get_counters(BmL2Counters *counters);
 
 #ifdef __cplusplus
 }
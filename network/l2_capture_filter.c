@@ -0,0 +1,131 @@
+#include "l2_capture_filter.h"
+#include "network_frames.h"
+
+#define ipv6_payload_offset                                                    \
+  (ipv6_destination_address_offset + ipv6_destination_address_size_bytes)
+#define udp_destination_port_offset (ipv6_payload_offset + 2)
+#define bcmp_type_offset (ipv6_payload_offset)
+
+/*!
+  @brief Load A Field From A Frame
+
+  @param field field to load
+  @param frame frame being filtered
+  @param frame_len frame length in bytes
+  @param port_num port the frame was received or sent on
+  @param egress true if the frame was sent
+  @param value loaded value
+
+  @return true if the frame has the field
+ */
+static bool load_field(BmL2CaptureField field, const uint8_t *frame,
+                       size_t frame_len, uint8_t port_num, bool egress,
+                       uint32_t *value) {
+  const bool is_ipv6 = frame_len >= ipv6_payload_offset &&
+                       ethernet_get_type(frame) == ethernet_type_ipv6;
+
+  switch (field) {
+  case L2CaptureFieldEthertype:
+    if (frame_len < ethernet_type_offset + ethernet_type_size_bytes) {
+      return false;
+    }
+    *value = ethernet_get_type(frame);
+    return true;
+  case L2CaptureFieldNextHeader:
+    if (!is_ipv6) {
+      return false;
+    }
+    *value = frame[ipv6_next_header_offset];
+    return true;
+  case L2CaptureFieldUdpDstPort:
+    if (!is_ipv6 || frame[ipv6_next_header_offset] != ip_proto_udp ||
+        frame_len < udp_destination_port_offset + sizeof(uint16_t)) {
+      return false;
+    }
+    *value = uint8_to_uint16((uint8_t *)&frame[udp_destination_port_offset]);
+    return true;
+  case L2CaptureFieldBcmpType:
+    if (!is_ipv6 || frame[ipv6_next_header_offset] != ip_proto_bcmp ||
+        frame_len < bcmp_type_offset + sizeof(uint16_t)) {
+      return false;
+    }
+    // BCMP headers are little endian
+    *value = (uint32_t)frame[bcmp_type_offset] |
+             ((uint32_t)frame[bcmp_type_offset + 1] << 8);
+    return true;
+  case L2CaptureFieldPort:
+    *value = port_num;
+    return true;
+  case L2CaptureFieldEgress:
+    *value = egress;
+    return true;
+  default:
+    return false;
+  }
+}
+
+BmErr bm_l2_capture_filter_validate(const BmL2CaptureInsn *prog, size_t len) {
+  if (!prog || len == 0 || len > bm_l2_capture_filter_max_len) {
+    return BmEINVAL;
+  }
+
+  for (size_t pc = 0; pc < len; pc++) {
+    const BmL2CaptureInsn *insn = &prog[pc];
+    if (insn->op >= L2CaptureOpCount) {
+      return BmEINVAL;
+    }
+    if (insn->op == L2CaptureOpRet) {
+      continue;
+    }
+    // Both branches have to land on an instruction, which also means the
+    // last instruction is always a return
+    if (insn->field >= L2CaptureFieldCount || pc + 1 + insn->jt >= len ||
+        pc + 1 + insn->jf >= len) {
+      return BmEINVAL;
+    }
+  }
+
+  return BmOK;
+}
+
+bool bm_l2_capture_filter_run(const BmL2CaptureInsn *prog, size_t len,
+                              const uint8_t *frame, size_t frame_len,
+                              uint8_t port_num, bool egress) {
+  if (!prog || !frame) {
+    return false;
+  }
+
+  size_t pc = 0;
+  while (pc < len) {
+    const BmL2CaptureInsn *insn = &prog[pc];
+    if (insn->op == L2CaptureOpRet) {
+      return insn->k != 0;
+    }
+
+    uint32_t value = 0;
+    bool match = load_field((BmL2CaptureField)insn->field, frame, frame_len,
+                            port_num, egress, &value);
+    if (match) {
+      switch (insn->op) {
+      case L2CaptureOpJeq:
+        match = value == insn->k;
+        break;
+      case L2CaptureOpJgt:
+        match = value > insn->k;
+        break;
+      case L2CaptureOpJge:
+        match = value >= insn->k;
+        break;
+      case L2CaptureOpJset:
+        match = (value & insn->k) != 0;
+        break;
+      default:
+        match = false;
+        break;
+      }
+    }
+    pc += 1U + (match ? insn->jt : insn->jf);
+  }
+
+  return false;
+}
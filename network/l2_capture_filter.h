@@ -0,0 +1,93 @@
+#pragma once
+
+#include "util.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of instructions in a capture filter program
+#ifndef bm_l2_capture_filter_max_len
+#define bm_l2_capture_filter_max_len 16
+#endif
+
+// Frame fields a capture filter instruction can test
+typedef enum {
+  L2CaptureFieldEthertype,
+  // IPv6 next header, absent on non IPv6 frames
+  L2CaptureFieldNextHeader,
+  // UDP destination port, absent on non UDP frames
+  L2CaptureFieldUdpDstPort,
+  // BCMP message type, absent on non BCMP frames
+  L2CaptureFieldBcmpType,
+  // Port the frame was received (RX) or sent (TX) on, 1-15
+  L2CaptureFieldPort,
+  // 0 for received frames, 1 for sent frames
+  L2CaptureFieldEgress,
+  L2CaptureFieldCount,
+} BmL2CaptureField;
+
+typedef enum {
+  // Stop and accept the frame if k is non zero, otherwise reject it
+  L2CaptureOpRet,
+  // Compare field with k, continue jt instructions ahead when true and jf
+  // instructions ahead when false. A field absent from the frame is false.
+  L2CaptureOpJeq,
+  L2CaptureOpJgt,
+  L2CaptureOpJge,
+  // True if (field & k) != 0
+  L2CaptureOpJset,
+  L2CaptureOpCount,
+} BmL2CaptureOp;
+
+/**
+ * One capture filter instruction, modeled on classic BPF.
+ *
+ * A program is an array of these run from the first instruction, jumps only
+ * go forward so every program finishes in at most as many steps as it has
+ * instructions. Jump offsets are relative to the next instruction, i.e. 0
+ * continues with the next one.
+ *
+ * Example, capture UDP frames to port 4321 received on port 2:
+ *   {L2CaptureOpJeq, L2CaptureFieldUdpDstPort, 0, 3, 4321},
+ *   {L2CaptureOpJeq, L2CaptureFieldPort, 0, 2, 2},
+ *   {L2CaptureOpJeq, L2CaptureFieldEgress, 0, 1, 0},
+ *   {L2CaptureOpRet, 0, 0, 0, 1},
+ *   {L2CaptureOpRet, 0, 0, 0, 0},
+ */
+typedef struct {
+  uint8_t op;    // BmL2CaptureOp
+  uint8_t field; // BmL2CaptureField
+  uint8_t jt;
+  uint8_t jf;
+  uint32_t k;
+} BmL2CaptureInsn;
+
+/**
+ * Check a capture filter program before it is run.
+ *
+ * Rejects unknown opcodes and fields, jumps past the end of the program and
+ * programs that can run off the end without returning.
+ *
+ * @return BmOK if the program can be run with bm_l2_capture_filter_run
+ *         BmEINVAL otherwise
+ */
+BmErr bm_l2_capture_filter_validate(const BmL2CaptureInsn *prog, size_t len);
+
+/**
+ * Run a validated capture filter program against a frame.
+ *
+ * Reads only the frame headers, nothing is copied.
+ *
+ * @return true if the frame should be captured
+ */
+bool bm_l2_capture_filter_run(const BmL2CaptureInsn *prog, size_t len,
+                              const uint8_t *frame, size_t frame_len,
+                              uint8_t port_num, bool egress);
+
+#ifdef __cplusplus
+}
+#endif
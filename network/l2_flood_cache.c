@@ -0,0 +1,93 @@
+#include "l2_flood_cache.h"
+#include "network_frames.h"
+#include <string.h>
+
+// Bytes of the IPv6 payload folded into the fingerprint. Covers the whole UDP
+// header, or the BCMP header up to and including the fragment fields.
+#define fingerprint_payload_bytes (12)
+#define fnv_offset_basis (2166136261U)
+#define fnv_prime (16777619U)
+
+static inline uint32_t fnv1a(uint32_t hash, const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    hash ^= data[i];
+    hash *= fnv_prime;
+  }
+  return hash;
+}
+
+static uint32_t frame_fingerprint(const uint8_t *frame, size_t frame_len) {
+  const size_t payload_offset =
+      ipv6_destination_address_offset + ipv6_destination_address_size_bytes;
+  uint8_t src[ipv6_source_address_size_bytes];
+
+  memcpy(src, &frame[ipv6_source_address_offset], sizeof(src));
+  // Ingress/egress ports are rewritten hop by hop, keep them out of the key
+  src[ipv6_ingress_egress_ports_offset - ipv6_source_address_offset] = 0;
+
+  uint32_t hash = fnv1a(fnv_offset_basis, src, sizeof(src));
+  hash = fnv1a(hash, &frame[ipv6_payload_length_offset],
+               ipv6_payload_length_size_bytes + ipv6_next_header_size_bytes);
+  if (frame_len > payload_offset) {
+    size_t len = frame_len - payload_offset;
+    if (len > fingerprint_payload_bytes) {
+      len = fingerprint_payload_bytes;
+    }
+    hash = fnv1a(hash, &frame[payload_offset], len);
+  }
+
+  // Zero marks an empty entry
+  return hash ? hash : 1;
+}
+
+void bm_l2_flood_cache_init(BmL2FloodCache *cache) {
+  if (cache) {
+    memset(cache, 0, sizeof(BmL2FloodCache));
+  }
+}
+
+bool bm_l2_flood_cache_seen(BmL2FloodCache *cache, const uint8_t *frame,
+                            size_t frame_len, uint8_t port, uint32_t now_ms) {
+  const size_t min_len =
+      ipv6_destination_address_offset + ipv6_destination_address_size_bytes;
+  if (!cache || !frame || frame_len < min_len ||
+      ethernet_get_type(frame) != ethernet_type_ipv6) {
+    return false;
+  }
+
+  const uint32_t fingerprint = frame_fingerprint(frame, frame_len);
+  BmL2FloodCacheEntry *set =
+      cache->sets[fingerprint % bm_l2_flood_cache_sets];
+  BmL2FloodCacheEntry *victim = &set[0];
+
+  for (uint8_t way = 0; way < bm_l2_flood_cache_ways; way++) {
+    BmL2FloodCacheEntry *entry = &set[way];
+    const bool live = entry->fingerprint &&
+                      (uint32_t)(now_ms - entry->seen_ms) <
+                          bm_l2_flood_cache_window_ms;
+    if (live && entry->fingerprint == fingerprint) {
+      if (entry->port == port) {
+        // Same frame again on the same port, not a loop
+        entry->seen_ms = now_ms;
+        cache->misses++;
+        return false;
+      }
+      cache->hits++;
+      return true;
+    }
+    // Prefer an empty or expired slot, otherwise evict the oldest entry
+    if (!live) {
+      victim = entry;
+    } else if (victim->fingerprint &&
+               (uint32_t)(now_ms - entry->seen_ms) >
+                   (uint32_t)(now_ms - victim->seen_ms)) {
+      victim = entry;
+    }
+  }
+
+  victim->fingerprint = fingerprint;
+  victim->seen_ms = now_ms;
+  victim->port = port;
+  cache->misses++;
+  return false;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "util.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of sets in the cache, each set holds bm_l2_flood_cache_ways entries
+#ifndef bm_l2_flood_cache_sets
+#define bm_l2_flood_cache_sets 8
+#endif
+
+#ifndef bm_l2_flood_cache_ways
+#define bm_l2_flood_cache_ways 4
+#endif
+
+// How long a frame is remembered, a loop has to bring a frame back within
+// this window for it to be suppressed
+#ifndef bm_l2_flood_cache_window_ms
+#define bm_l2_flood_cache_window_ms 100
+#endif
+
+typedef struct {
+  uint32_t fingerprint;
+  uint32_t seen_ms;
+  uint8_t port; // ingress port of the first copy
+} BmL2FloodCacheEntry;
+
+typedef struct {
+  BmL2FloodCacheEntry sets[bm_l2_flood_cache_sets][bm_l2_flood_cache_ways];
+  uint32_t hits;
+  uint32_t misses;
+} BmL2FloodCache;
+
+/**
+ * Recently-seen table used to suppress flooded frames that come back around
+ * a loop in the network.
+ *
+ * Frames are identified by a 32-bit fingerprint over the IPv6 source address
+ * (ports byte masked out), payload length, next header and the first bytes
+ * of the IPv6 payload, which cover the UDP checksum or the BCMP checksum and
+ * sequence number. Only the fingerprint, the ingress port of the first copy
+ * and a timestamp are stored.
+ *
+ * A frame is a duplicate only when it comes back in on a different port than
+ * the first copy. A repeat on the same port is a retransmission or a frame
+ * that happens to look identical, and is passed on.
+ *
+ * Like l2_policy this has no RTOS dependencies, the caller provides time.
+ */
+void bm_l2_flood_cache_init(BmL2FloodCache *cache);
+bool bm_l2_flood_cache_seen(BmL2FloodCache *cache, const uint8_t *frame,
+                            size_t frame_len, uint8_t port, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,10 +1,15 @@
 #include "l2_policy.h"
+#include "messages.h"
 #include "network_frames.h"
 #include "util.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#define ip_proto_icmpv6 (58)
+#define udp_destination_port_offset                                            \
+  (ipv6_destination_address_offset + ipv6_destination_address_size_bytes + 2)
+
 // Conservative bounds check: ensure we can read/write src/dst addresses and ports byte.
 static inline bool frame_has_ipv6_addrs(const uint8_t *frame,
                                         size_t frame_len) {
@@ -119,9 +124,57 @@ void bm_l2_policy_prepare_forwarded_copy(uint8_t *frame, size_t frame_len) {
     return;
   }
 
-  // Clear ingress and egress nibbles copied from received packet.
-  // Applied only to this forwarded copy.
-  // Original buffer's ports info is left intact for submitting up to app.
+  // Clear ingress and egress nibbles from the received packet.
+  // The caller restores the ports info before submitting up to app.
   clear_ingress_nibble(pb);
   clear_egress_nibble(pb);
 }
+
+// DFU sessions and messages split into fragments are bulk, the rest of BCMP
+// (heartbeats, neighbor and time traffic, requests and replies) is control.
+// The header is serialized little endian.
+static BmL2TxClass bcmp_tx_class(const uint8_t *frame, size_t frame_len) {
+  if (frame_len < min_bcmp_frame_size) {
+    return L2TxClassControl;
+  }
+  const uint8_t *header = &frame[bcmp_header_offset];
+  const uint16_t type =
+      (uint16_t)(header[offsetof(BcmpHeader, type)] |
+                 (header[offsetof(BcmpHeader, type) + 1] << 8));
+  if ((type >= BcmpDFUStartMessage && type <= BcmpDFULastMessageMessage) ||
+      header[offsetof(BcmpHeader, frag_total)] > 1) {
+    return L2TxClassBulk;
+  }
+  return L2TxClassControl;
+}
+
+BmL2TxClass bm_l2_policy_tx_class(const uint8_t *frame, size_t frame_len,
+                                  const uint16_t *realtime_udp_ports,
+                                  size_t realtime_udp_port_count) {
+  if (!frame_has_ipv6_addrs(frame, frame_len) ||
+      ethernet_get_type(frame) != ethernet_type_ipv6) {
+    return L2TxClassBulk;
+  }
+
+  const uint8_t next_header = frame[ipv6_next_header_offset];
+  if (next_header == ip_proto_bcmp) {
+    return bcmp_tx_class(frame, frame_len);
+  }
+  if (next_header == ip_proto_icmpv6) {
+    return L2TxClassControl;
+  }
+
+  if (next_header == ip_proto_udp && realtime_udp_ports &&
+      frame_len >= udp_destination_port_offset + sizeof(uint16_t)) {
+    const uint16_t dst_port =
+        (uint16_t)((frame[udp_destination_port_offset] << 8) |
+                   frame[udp_destination_port_offset + 1]);
+    for (size_t i = 0; i < realtime_udp_port_count; i++) {
+      if (realtime_udp_ports[i] == dst_port) {
+        return L2TxClassRealtime;
+      }
+    }
+  }
+
+  return L2TxClassBulk;
+}
@@ -46,6 +46,14 @@ typedef struct {
   uint8_t ingress_port_num;
 } BmL2PolicyRxResult;
 
+// Egress traffic classes, ordered from highest to lowest priority.
+typedef enum {
+  L2TxClassControl,
+  L2TxClassRealtime,
+  L2TxClassBulk,
+  L2TxClassCount,
+} BmL2TxClass;
+
 /**
  * Apply L2 RX policy to an Ethernet+IPv6 frame in place:
  *   - encodes ingress port number (1-15) into src IPv6 address nibble
@@ -65,14 +73,29 @@ BmL2PolicyRxResult bm_l2_policy_rx_apply(uint8_t *frame, size_t frame_len,
                                          L2LinkLocalRoutingCb routing_cb);
 
 /**
- * Prepare a forwarded *copy* for on-wire transmission:
+ * Prepare a forwarded frame for on-wire transmission:
  *   - clears ingress nibble (on-wire ingress bits must be zero)
- *   - leaves egress nibble intact
+ *   - clears egress nibble (set per egress port at send time)
  *
- * Call this only on the forwarded copy, not the original RX buffer.
+ * L2 applies this to the buffer it queues for forwarding, which is a copy
+ * when the received frame is also submitted up the stack, so the submitted
+ * frame keeps its ingress nibble.
  */
 void bm_l2_policy_prepare_forwarded_copy(uint8_t *frame, size_t frame_len);
 
+/**
+ * Classify an outgoing Ethernet+IPv6 frame into an egress traffic class:
+ *   - BCMP DFU messages and fragments of large BCMP messages => bulk
+ *   - all other BCMP, and ICMPv6 => control
+ *   - UDP with a destination port found in realtime_udp_ports => realtime
+ *   - everything else (including malformed/short frames) => bulk
+ *
+ * Like bm_l2_policy_rx_apply this is side-effect free and unit-testable.
+ */
+BmL2TxClass bm_l2_policy_tx_class(const uint8_t *frame, size_t frame_len,
+                                  const uint16_t *realtime_udp_ports,
+                                  size_t realtime_udp_port_count);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -3,12 +3,26 @@
 
 #include "util.h"
 
+// A received frame loaned from the network device to the stack.
+// The device fills data/length/release, the stack calls release exactly once
+// when it no longer references data, possibly from another thread.
+typedef struct NetworkDeviceRxLoan NetworkDeviceRxLoan;
+struct NetworkDeviceRxLoan {
+  uint8_t *data;
+  size_t length;
+  void (*release)(NetworkDeviceRxLoan *loan);
+};
+
 typedef struct {
   void (*power)(bool on);
   void (*link_change)(uint8_t port_index, bool is_up);
 
   // Bristlemouth spec ingress port_num is an integer 1-15
   void (*receive)(uint8_t port_num, uint8_t *data, size_t length);
+  // Zero-copy alternative to receive. BmOK means the stack took ownership of
+  // the loan, any other return means the device still owns the buffer and
+  // should fall back to receive.
+  BmErr (*receive_loan)(uint8_t port_num, NetworkDeviceRxLoan *loan);
   void (*debug_packet_dump)(const uint8_t *data, size_t length);
 } NetworkDeviceCallbacks;
 
@@ -23,6 +37,9 @@ typedef struct {
   uint8_t (*const num_ports)(void);
   BmErr (*const port_stats)(void *self, uint8_t port_index, void *stats);
   BmErr (*const handle_interrupt)(void *self);
+  // Optional, NULL if send hands frames to the hardware right away. Devices
+  // that batch transmissions push out everything queued by send.
+  BmErr (*const flush)(void *self);
 } NetworkDeviceTrait;
 
 typedef struct {
@@ -0,0 +1,76 @@
+#include "udp_port_table.h"
+
+static inline uint32_t port_slot(uint16_t port) {
+  // Knuth's multiplicative hash, 2^16 / golden ratio, top bits of the product
+  return (uint16_t)(port * 0x9E37U) >> (16 - udp_port_table_bits);
+}
+
+/*!
+  @brief Bind A Callback To A UDP Port
+
+  @param table table to add to
+  @param port port to bind, must not be 0
+  @param cb callback for datagrams received on the port
+
+  @return BmOK on success
+  @return BmEINVAL if an argument is invalid
+  @return BmEALREADY if the port is already bound
+  @return BmENOMEM if the table is full
+ */
+BmErr udp_port_table_add(UdpPortTable *table, uint16_t port, UdpPortCb cb) {
+  if (!table || !port || !cb) {
+    return BmEINVAL;
+  }
+  if (__atomic_add_fetch(&table->count, 1, __ATOMIC_RELAXED) >
+      udp_port_table_max_ports) {
+    __atomic_sub_fetch(&table->count, 1, __ATOMIC_RELAXED);
+    return BmENOMEM;
+  }
+
+  uint32_t slot = port_slot(port);
+  for (uint32_t i = 0; i < udp_port_table_size; i++) {
+    UdpPortEntry *entry = &table->entries[slot];
+    uint16_t current = 0;
+    if (__atomic_compare_exchange_n(&entry->port, &current, port, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      __atomic_store_n(&entry->cb, cb, __ATOMIC_RELEASE);
+      return BmOK;
+    }
+    if (current == port) {
+      break;
+    }
+    slot = (slot + 1) & (udp_port_table_size - 1);
+  }
+
+  __atomic_sub_fetch(&table->count, 1, __ATOMIC_RELAXED);
+  return BmEALREADY;
+}
+
+/*!
+  @brief Find The Callback Bound To A UDP Port
+
+  @param table table to search
+  @param port destination port of a received datagram
+
+  @return callback bound to the port
+  @return NULL if nothing is bound to it
+ */
+UdpPortCb udp_port_table_find(const UdpPortTable *table, uint16_t port) {
+  if (!table || !port) {
+    return NULL;
+  }
+
+  uint32_t slot = port_slot(port);
+  for (uint32_t i = 0; i < udp_port_table_size; i++) {
+    const UdpPortEntry *entry = &table->entries[slot];
+    const uint16_t current = __atomic_load_n(&entry->port, __ATOMIC_ACQUIRE);
+    if (current == port) {
+      return __atomic_load_n(&entry->cb, __ATOMIC_ACQUIRE);
+    }
+    if (current == 0) {
+      break;
+    }
+    slot = (slot + 1) & (udp_port_table_size - 1);
+  }
+  return NULL;
+}
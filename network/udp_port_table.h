@@ -0,0 +1,49 @@
+#pragma once
+
+#include "util.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Log2 of the number of slots. The table holds up to three quarters of its
+// slots so probe sequences stay short.
+#ifndef udp_port_table_bits
+#define udp_port_table_bits 5
+#endif
+
+#define udp_port_table_size (1U << udp_port_table_bits)
+#define udp_port_table_max_ports (udp_port_table_size * 3 / 4)
+
+typedef BmErr (*UdpPortCb)(uint16_t, void *, uint64_t, uint32_t);
+
+typedef struct {
+  uint16_t port;
+  UdpPortCb cb;
+} UdpPortEntry;
+
+typedef struct {
+  UdpPortEntry entries[udp_port_table_size];
+  uint32_t count;
+} UdpPortTable;
+
+/**
+ * Demultiplexes received UDP datagrams to the callback bound to their
+ * destination port.
+ *
+ * An open-addressed table with linear probing, the port hashed with
+ * Fibonacci hashing so neighbouring ports spread across the table. Port 0
+ * marks an empty slot. Bindings are never removed, which lets lookups run
+ * without a lock alongside a bind from another thread: a slot is claimed by
+ * its port first and the callback published after, a lookup that finds the
+ * port before the callback treats it as not bound yet.
+ *
+ * A zeroed table is empty.
+ */
+BmErr udp_port_table_add(UdpPortTable *table, uint16_t port, UdpPortCb cb);
+UdpPortCb udp_port_table_find(const UdpPortTable *table, uint16_t port);
+
+#ifdef __cplusplus
+}
+#endif
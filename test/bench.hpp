@@ -0,0 +1,30 @@
+#ifndef __TEST_BENCH_HPP__
+#define __TEST_BENCH_HPP__
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+
+// Micro-benchmark helpers.
+//
+// Benchmarks are gtest binaries built and run by the opt-in bench target,
+// they are not part of the default build or of ctest. They only check that
+// the code under test gives the right answer, the timings they report depend
+// on the host and build flags (test builds are unoptimized and instrumented
+// for coverage).
+
+// Average wall clock time of one call to fn, in nanoseconds
+template <typename F> static double ns_per_call(F fn, uint32_t iterations) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         iterations;
+}
+
+// Print one line of results next to the gtest output
+#define bench_report(fmt, ...) printf("[ BENCH    ] " fmt "\n", ##__VA_ARGS__)
+
+#endif // __TEST_BENCH_HPP__
@@ -3,9 +3,13 @@
 #include "util.h"
 
 typedef BmErr (*BmUdpPortBindCb)(void *, uint64_t, uint32_t);
+typedef void (*BmL2RefReleaseCb)(void *);
+typedef struct BmIpRxPoolStats BmIpRxPoolStats;
 
 DECLARE_FAKE_VALUE_FUNC(BmErr, bm_ip_init);
 DECLARE_FAKE_VALUE_FUNC(void *, bm_l2_new, uint32_t);
+DECLARE_FAKE_VALUE_FUNC(void *, bm_l2_new_ref, uint8_t *, uint32_t,
+                        BmL2RefReleaseCb, void *);
 DECLARE_FAKE_VALUE_FUNC(void *, bm_l2_get_payload, void *);
 DECLARE_FAKE_VOID_FUNC(bm_l2_tx_prep, void *, uint32_t);
 DECLARE_FAKE_VOID_FUNC(bm_l2_free, void *);
@@ -14,6 +18,7 @@ DECLARE_FAKE_VALUE_FUNC(BmErr, bm_l2_set_netif, bool);
 DECLARE_FAKE_VALUE_FUNC(const char *, bm_ip_get_str, uint8_t);
 DECLARE_FAKE_VALUE_FUNC(const BmIpAddr *, bm_ip_get, uint8_t);
 DECLARE_FAKE_VOID_FUNC(bm_ip_rx_cleanup, void *);
+DECLARE_FAKE_VOID_FUNC(bm_ip_get_rx_pool_stats, BmIpRxPoolStats *);
 DECLARE_FAKE_VALUE_FUNC(void *, bm_ip_tx_new, const BmIpAddr *, uint32_t);
 DECLARE_FAKE_VALUE_FUNC(BmErr, bm_ip_tx_copy, void *, const void *, uint32_t,
                         uint32_t);
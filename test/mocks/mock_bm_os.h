@@ -14,6 +14,7 @@ typedef void *BmTaskHandle;
 typedef void *BmBuffer;
 typedef void (*BmTimerCb)(void *);
 typedef void (*BmTaskCb)(void *);
+typedef struct BmHeapStats BmHeapStats;
 
 DECLARE_FAKE_VALUE_FUNC(void *, bm_malloc, size_t);
 DECLARE_FAKE_VOID_FUNC(bm_free, void *);
@@ -26,6 +27,9 @@ DECLARE_FAKE_VOID_FUNC(bm_delay, uint32_t);
 DECLARE_FAKE_VALUE_FUNC(uint32_t, bm_get_tick_count);
 DECLARE_FAKE_VALUE_FUNC(uint32_t, bm_ms_to_ticks, uint32_t);
 DECLARE_FAKE_VALUE_FUNC(uint32_t, bm_ticks_to_ms, uint32_t);
+DECLARE_FAKE_VALUE_FUNC(uint64_t, bm_get_time_us);
+DECLARE_FAKE_VALUE_FUNC(uint64_t, bm_get_time_ns);
+DECLARE_FAKE_VALUE_FUNC(BmErr, bm_heap_stats, BmHeapStats *);
 DECLARE_FAKE_VALUE_FUNC(BmTimer, bm_timer_create, const char *, uint32_t, bool,
                         void *, BmTimerCb);
 DECLARE_FAKE_VOID_FUNC(bm_timer_delete, BmTimer, uint32_t);
@@ -39,6 +43,8 @@ DECLARE_FAKE_VALUE_FUNC(uint32_t, bm_timer_get_id, BmTimer);
 DECLARE_FAKE_VALUE_FUNC(BmQueue, bm_queue_create, uint32_t, uint32_t);
 DECLARE_FAKE_VOID_FUNC(bm_queue_delete, BmQueue);
 DECLARE_FAKE_VALUE_FUNC(BmErr, bm_queue_receive, BmQueue, void *, uint32_t);
+DECLARE_FAKE_VALUE_FUNC(BmErr, bm_queue_receive_many, BmQueue, void *, uint32_t,
+                        uint32_t *, uint32_t);
 DECLARE_FAKE_VALUE_FUNC(BmErr, bm_queue_send, BmQueue, const void *, uint32_t);
 DECLARE_FAKE_VALUE_FUNC(BmErr, bm_queue_send_to_front_from_isr, BmQueue,
                         const void *);
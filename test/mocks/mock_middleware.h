@@ -7,5 +7,6 @@ DECLARE_FAKE_VALUE_FUNC(BmErr, bm_middleware_rx, uint16_t, void *, uint64_t,
 DECLARE_FAKE_VALUE_FUNC(BmErr, bm_middleware_init);
 DECLARE_FAKE_VALUE_FUNC(BmErr, bm_middleware_net_tx, uint16_t, void *,
                         uint32_t);
+DECLARE_FAKE_VOID_FUNC(bm_middleware_routing_cache_invalidate);
 void bm_middleware_invoke_cb(uint16_t port, uint64_t node_id, void *buf,
                              uint32_t size);
@@ -9,6 +9,12 @@ DECLARE_FAKE_VALUE_FUNC(uint16_t, packet_checksum, void *, uint32_t);
 DECLARE_FAKE_VALUE_FUNC(BmErr, process_received_message, void *, uint32_t);
 DECLARE_FAKE_VALUE_FUNC(BmErr, serialize, void *, void *, uint32_t,
                         BcmpMessageType, uint32_t, BcmpSequencedRequestCb);
+DECLARE_FAKE_VALUE_FUNC(BmErr, serialize_header, BcmpHeader *, void *,
+                        BcmpMessageType, uint32_t, BcmpSequencedRequestCb);
+DECLARE_FAKE_VALUE_FUNC(BmErr, serialize_fragment, void *, const BcmpHeader *,
+                        const void *, uint32_t);
+DECLARE_FAKE_VOID_FUNC(serialize_message_id, BcmpHeader *, const void *,
+                       uint32_t);
 DECLARE_FAKE_VALUE_FUNC(BmErr, packet_remove, BcmpMessageType);
 void packet_add_fail(uint32_t count);
 BmErr packet_process_invoke(BcmpMessageType type, BcmpProcessData data);
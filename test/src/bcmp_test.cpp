@@ -123,20 +123,81 @@ TEST_F(Bcmp, bcmp_tx) {
   // Test improper inputs
   ASSERT_EQ(bcmp_tx(NULL, type, data, size, seq_num, bcmp_tx_fake_cb),
             BmEINVAL);
-  ASSERT_EQ(bcmp_tx(&dst, type, data, size + max_payload_len, seq_num,
+  ASSERT_EQ(bcmp_tx(&dst, type, data, bcmp_max_message_len + 1, seq_num,
                     bcmp_tx_fake_cb),
             BmEINVAL);
 
   bm_free(data);
 }
 
+TEST_F(Bcmp, bcmp_tx_fragments) {
+  BmIpAddr dst = {0};
+  const uint16_t size = 2 * bcmp_fragment_payload_len + 100;
+  uint8_t *data = (uint8_t *)bm_malloc(size);
+  uint8_t frame[max_payload_len];
+
+  RESET_FAKE(serialize);
+  RESET_FAKE(serialize_header);
+  RESET_FAKE(serialize_fragment);
+  RESET_FAKE(serialize_message_id);
+  RESET_FAKE(bm_ip_tx_new);
+  RESET_FAKE(bm_ip_tx_perform);
+  RESET_FAKE(bm_ip_tx_cleanup);
+
+  // Sent back-to-back as three frames, the header serialized once
+  bm_ip_tx_new_fake.return_val = frame;
+  serialize_header_fake.return_val = BmOK;
+  serialize_fragment_fake.return_val = BmOK;
+  bm_ip_tx_perform_fake.return_val = BmOK;
+  ASSERT_EQ(bcmp_tx(&dst, BcmpConfigValueMessage, data, size, 0, NULL), BmOK);
+  EXPECT_EQ(serialize_fake.call_count, 0);
+  EXPECT_EQ(serialize_header_fake.call_count, 1);
+  // Tagged once with the id and CRC of the whole message
+  ASSERT_EQ(serialize_message_id_fake.call_count, 1);
+  EXPECT_EQ(serialize_message_id_fake.arg1_val, data);
+  EXPECT_EQ(serialize_message_id_fake.arg2_val, size);
+  ASSERT_EQ(serialize_fragment_fake.call_count, 3);
+  EXPECT_EQ(bm_ip_tx_perform_fake.call_count, 3);
+  EXPECT_EQ(bm_ip_tx_cleanup_fake.call_count, 3);
+  EXPECT_EQ(bm_ip_tx_new_fake.arg1_history[0], max_payload_len);
+  EXPECT_EQ(bm_ip_tx_new_fake.arg1_history[2], 100 + sizeof(BcmpHeader));
+  EXPECT_EQ(serialize_fragment_fake.arg2_history[1],
+            &data[bcmp_fragment_payload_len]);
+  EXPECT_EQ(serialize_fragment_fake.arg3_history[2], 100U);
+
+  // A failed fragment stops the rest
+  RESET_FAKE(serialize_fragment);
+  RESET_FAKE(bm_ip_tx_perform);
+  RESET_FAKE(bm_ip_tx_cleanup);
+  serialize_fragment_fake.return_val = BmOK;
+  bm_ip_tx_perform_fake.return_val = BmEBADMSG;
+  ASSERT_EQ(bcmp_tx(&dst, BcmpConfigValueMessage, data, size, 0, NULL),
+            BmEBADMSG);
+  EXPECT_EQ(bm_ip_tx_perform_fake.call_count, 1);
+  EXPECT_EQ(bm_ip_tx_cleanup_fake.call_count, 1);
+
+  // Nothing is sent if the header can't be serialized
+  RESET_FAKE(serialize_fragment);
+  RESET_FAKE(bm_ip_tx_new);
+  serialize_header_fake.return_val = BmENODEV;
+  ASSERT_EQ(bcmp_tx(&dst, BcmpConfigValueMessage, data, size, 0, NULL),
+            BmENODEV);
+  EXPECT_EQ(bm_ip_tx_new_fake.call_count, 0);
+
+  RESET_FAKE(serialize_header);
+  RESET_FAKE(bm_ip_tx_new);
+  RESET_FAKE(bm_ip_tx_perform);
+  RESET_FAKE(bm_ip_tx_cleanup);
+  bm_free(data);
+}
+
 TEST_F(Bcmp, bcmp_ll_forward) {
   // Forwarding requires knowing how many ports there are
   netdevice_num_ports_fake.return_val = 2;
   bcmp_init(adin2111_network_device());
 
   BcmpHeader header = {};
-  const uint16_t size = RND.rnd_int(max_payload_len, UINT8_MAX);
+  const uint16_t size = RND.rnd_int(bcmp_fragment_payload_len, UINT8_MAX);
   uint8_t *data = (uint8_t *)bm_malloc(size);
   uint8_t ingress_port = RND.rnd_int(2, 1);
 
@@ -175,6 +236,50 @@ TEST_F(Bcmp, bcmp_ll_forward) {
   bm_free(data);
 }
 
+TEST_F(Bcmp, bcmp_ll_forward_fragments) {
+  netdevice_num_ports_fake.return_val = 2;
+  bcmp_init(adin2111_network_device());
+
+  // A reassembled message goes back out as fragments
+  BcmpHeader header = {};
+  header.frag_total = 2;
+  header.frag_id = 1;
+  header.flags = 0x34;
+  header.reserved = 0x12;
+  header.next_header = 9;
+  const uint32_t size = bcmp_fragment_payload_len + 10;
+  uint8_t *data = (uint8_t *)bm_malloc(size);
+  uint8_t frame[max_payload_len];
+
+  RESET_FAKE(bm_ip_tx_new);
+  RESET_FAKE(bm_ip_tx_copy);
+  RESET_FAKE(bm_ip_tx_perform);
+  RESET_FAKE(bm_ip_tx_cleanup);
+  bm_ip_tx_new_fake.return_val = frame;
+  bm_ip_tx_perform_fake.return_val = BmOK;
+  ASSERT_EQ(bcmp_ll_forward(&header, data, size, 1), BmOK);
+  ASSERT_EQ(bm_ip_tx_new_fake.call_count, 2);
+  EXPECT_EQ(bm_ip_tx_new_fake.arg1_history[0], max_payload_len);
+  EXPECT_EQ(bm_ip_tx_new_fake.arg1_history[1], 10 + sizeof(BcmpHeader));
+  EXPECT_EQ(bm_ip_tx_cleanup_fake.call_count, 2);
+  EXPECT_EQ(header.frag_total, 2);
+  EXPECT_EQ(header.frag_id, 1);
+  // Message id and CRC go out as they arrived
+  EXPECT_EQ(header.flags, 0x34);
+  EXPECT_EQ(header.reserved, 0x12);
+  EXPECT_EQ(header.next_header, 9);
+
+  // Too large to forward
+  ASSERT_EQ(bcmp_ll_forward(&header, data, bcmp_max_message_len + 1, 1),
+            BmEINVAL);
+
+  RESET_FAKE(bm_ip_tx_new);
+  RESET_FAKE(bm_ip_tx_copy);
+  RESET_FAKE(bm_ip_tx_perform);
+  RESET_FAKE(bm_ip_tx_cleanup);
+  bm_free(data);
+}
+
 // Testing a private function, not in the header, but also not static linkage
 extern "C" void bcmp_link_change(uint8_t port, bool state);
 
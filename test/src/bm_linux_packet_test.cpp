@@ -0,0 +1,222 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+#include "bm_linux_packet.h"
+#include <linux/if_ether.h>
+}
+
+// Every port is mapped to the loopback interface, so a frame sent on one
+// port is received on all of them
+static const char *const loopback_ports[] = {"lo", "lo"};
+// Test frames start with a marker holding the process ID, so test processes
+// sharing the loopback interface under ctest -j ignore each other's frames
+static uint8_t marker[8] = {'b', 'm', 'p', 'k'};
+
+static std::mutex rx_lock;
+static std::vector<std::pair<uint8_t, std::vector<uint8_t>>> rx_frames;
+static std::atomic<uint32_t> link_up_reports;
+
+static void receive(uint8_t port_num, uint8_t *data, size_t length) {
+  // Ignore any other IPv6 traffic on the loopback interface, including
+  // frames from other test processes
+  if (length < ETH_HLEN + sizeof(marker) ||
+      memcmp(&data[ETH_HLEN], marker, sizeof(marker)) != 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(rx_lock);
+  rx_frames.push_back({port_num, std::vector<uint8_t>(data, data + length)});
+}
+
+static void link_change(uint8_t port_index, bool is_up) {
+  (void)port_index;
+  if (is_up) {
+    link_up_reports++;
+  }
+}
+
+static bool raw_sockets_available(void) {
+  int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_IPV6));
+  if (fd < 0) {
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
+static bool wait_for(std::function<bool(void)> done) {
+  for (int i = 0; i < 200; i++) {
+    if (done()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return false;
+}
+
+class LinuxPacket : public ::testing::Test {
+protected:
+  NetworkDevice device;
+
+  void SetUp() override {
+    uint32_t pid = (uint32_t)getpid();
+    memcpy(&marker[4], &pid, sizeof(pid));
+    rx_frames.clear();
+    link_up_reports = 0;
+  }
+  void TearDown() override {
+    if (device.trait) {
+      device.trait->disable(device.self);
+    }
+  }
+
+  void make_frame(uint8_t *frame, size_t length) {
+    memset(frame, 0, length);
+    memset(frame, 0xFF, ETH_ALEN);
+    frame[12] = ETH_P_IPV6 >> 8;
+    frame[13] = ETH_P_IPV6 & 0xFF;
+    memcpy(&frame[ETH_HLEN], marker, sizeof(marker));
+    for (size_t i = ETH_HLEN + sizeof(marker); i < length; i++) {
+      frame[i] = (uint8_t)i;
+    }
+  }
+};
+
+TEST_F(LinuxPacket, init) {
+  device = {};
+  EXPECT_EQ(linux_packet_init(NULL, 1), BmEINVAL);
+  EXPECT_EQ(linux_packet_init(loopback_ports, 0), BmEINVAL);
+  EXPECT_EQ(linux_packet_init(loopback_ports, linux_packet_max_ports + 1),
+            BmEINVAL);
+  const char *const missing[] = {"bmnotanif0"};
+  EXPECT_EQ(linux_packet_init(missing, 1), BmENODEV);
+
+  ASSERT_EQ(linux_packet_init(loopback_ports, 2), BmOK);
+  device = linux_packet_network_device();
+  EXPECT_EQ(device.trait->num_ports(), 2);
+  EXPECT_NE(device.trait->flush, nullptr);
+  EXPECT_EQ(device.trait->enable_port(device.self, 3), BmEINVAL);
+  EXPECT_EQ(device.trait->disable_port(device.self, 0), BmEINVAL);
+
+  LinuxPacketPortStats stats;
+  EXPECT_EQ(device.trait->port_stats(device.self, 0, &stats), BmOK);
+  EXPECT_EQ(device.trait->port_stats(device.self, 2, &stats), BmEINVAL);
+
+  // Sending before the device is enabled fails
+  uint8_t frame[64];
+  make_frame(frame, sizeof(frame));
+  EXPECT_EQ(device.trait->send(device.self, frame, sizeof(frame), 1),
+            BmEINVAL);
+}
+
+TEST_F(LinuxPacket, send_receive) {
+  if (!raw_sockets_available()) {
+    GTEST_SKIP() << "AF_PACKET sockets require CAP_NET_RAW";
+  }
+  ASSERT_EQ(linux_packet_init(loopback_ports, 2), BmOK);
+  device = linux_packet_network_device();
+  device.callbacks->receive = receive;
+  device.callbacks->link_change = link_change;
+  ASSERT_EQ(device.trait->enable(device.self), BmOK);
+
+  // The initial link state of both ports is reported
+  EXPECT_TRUE(wait_for([] { return link_up_reports == 2; }));
+
+  uint8_t frame[128];
+  make_frame(frame, sizeof(frame));
+  EXPECT_EQ(device.trait->send(device.self, frame, sizeof(frame), 1), BmOK);
+  // Nothing leaves before the batch is flushed
+  LinuxPacketPortStats stats;
+  ASSERT_EQ(device.trait->port_stats(device.self, 0, &stats), BmOK);
+  EXPECT_EQ(stats.tx_frames, 0U);
+  EXPECT_EQ(device.trait->flush(device.self), BmOK);
+  ASSERT_EQ(device.trait->port_stats(device.self, 0, &stats), BmOK);
+  EXPECT_EQ(stats.tx_frames, 1U);
+  EXPECT_EQ(stats.tx_bytes, sizeof(frame));
+  EXPECT_EQ(stats.tx_batches, 1U);
+
+  ASSERT_TRUE(wait_for([] {
+    std::lock_guard<std::mutex> guard(rx_lock);
+    return rx_frames.size() == 2;
+  }));
+  {
+    std::lock_guard<std::mutex> guard(rx_lock);
+    bool ports_seen[2] = {false, false};
+    for (auto &rx : rx_frames) {
+      ASSERT_GE(rx.first, 1);
+      ASSERT_LE(rx.first, 2);
+      ports_seen[rx.first - 1] = true;
+      ASSERT_EQ(rx.second.size(), sizeof(frame));
+      EXPECT_EQ(memcmp(rx.second.data(), frame, sizeof(frame)), 0);
+    }
+    EXPECT_TRUE(ports_seen[0]);
+    EXPECT_TRUE(ports_seen[1]);
+    rx_frames.clear();
+  }
+
+  // A disabled port neither sends nor receives
+  EXPECT_EQ(device.trait->disable_port(device.self, 1), BmOK);
+  EXPECT_EQ(device.trait->send(device.self, frame, sizeof(frame), 1),
+            BmENETDOWN);
+  EXPECT_EQ(device.trait->send(device.self, frame, sizeof(frame), 2), BmOK);
+  EXPECT_EQ(device.trait->flush(device.self), BmOK);
+  ASSERT_TRUE(wait_for([] {
+    std::lock_guard<std::mutex> guard(rx_lock);
+    return rx_frames.size() == 1;
+  }));
+  {
+    std::lock_guard<std::mutex> guard(rx_lock);
+    EXPECT_EQ(rx_frames[0].first, 2);
+  }
+  EXPECT_EQ(device.trait->enable_port(device.self, 1), BmOK);
+
+  EXPECT_EQ(device.trait->disable(device.self), BmOK);
+}
+
+TEST_F(LinuxPacket, batched_send) {
+  if (!raw_sockets_available()) {
+    GTEST_SKIP() << "AF_PACKET sockets require CAP_NET_RAW";
+  }
+  ASSERT_EQ(linux_packet_init(loopback_ports, 1), BmOK);
+  device = linux_packet_network_device();
+  device.callbacks->receive = receive;
+  device.callbacks->link_change = link_change;
+  ASSERT_EQ(device.trait->enable(device.self), BmOK);
+
+  // A full batch goes out without waiting for a flush
+  uint8_t frame[96];
+  make_frame(frame, sizeof(frame));
+  for (uint32_t i = 0; i < linux_packet_batch_len + 1; i++) {
+    EXPECT_EQ(device.trait->send(device.self, frame, sizeof(frame), 0), BmOK);
+  }
+  LinuxPacketPortStats stats;
+  ASSERT_EQ(device.trait->port_stats(device.self, 0, &stats), BmOK);
+  EXPECT_EQ(stats.tx_frames, linux_packet_batch_len);
+  EXPECT_EQ(device.trait->flush(device.self), BmOK);
+  ASSERT_EQ(device.trait->port_stats(device.self, 0, &stats), BmOK);
+  EXPECT_EQ(stats.tx_frames, linux_packet_batch_len + 1);
+  EXPECT_GE(stats.tx_batches, 2U);
+
+  ASSERT_TRUE(wait_for([] {
+    std::lock_guard<std::mutex> guard(rx_lock);
+    return rx_frames.size() == linux_packet_batch_len + 1;
+  }));
+
+  // Frames larger than the device supports are refused
+  uint8_t jumbo[linux_packet_frame_size + 1];
+  make_frame(jumbo, sizeof(jumbo));
+  EXPECT_EQ(device.trait->send(device.self, jumbo, sizeof(jumbo), 1),
+            BmEINVAL);
+
+  EXPECT_EQ(device.trait->disable(device.self), BmOK);
+}
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <vector>
 
 #include "fff.h"
 
@@ -24,6 +25,9 @@ uint16_t ipv6_pseudo_checksum(const BmIpAddr *src, const BmIpAddr *dst,
 void mac_from_nodeid(uint8_t *mac, uint64_t id);
 void multicast_mac_from_ipv6(uint8_t *mac, const BmIpAddr *dst);
 bool is_multicast(const BmIpAddr *addr);
+void *bm_l2_new_view(void *parent, uint32_t offset, uint32_t size);
+uint32_t stamp_header(uint8_t *frame, const BmIpAddr *dst, uint8_t next_header,
+                      uint16_t src_port, uint16_t dst_port);
 
 /* Public API under test */
 #include "bm_ip.h"
@@ -306,6 +310,112 @@ TEST_F(BmLinuxBuf, l2_ref_counting) {
   bm_l2_free(buf);
 }
 
+static int ref_release_count;
+static void *ref_release_arg;
+static void ref_release(void *arg) {
+  ref_release_count++;
+  ref_release_arg = arg;
+}
+
+TEST_F(BmLinuxBuf, l2_new_ref_wraps_external_memory) {
+  uint8_t frame[48] = {0};
+  int cookie = 0;
+  ref_release_count = 0;
+  ref_release_arg = NULL;
+
+  void *buf = bm_l2_new_ref(frame, sizeof(frame), ref_release, &cookie);
+  ASSERT_NE(buf, nullptr);
+  /* Payload is the caller's memory, not a copy */
+  EXPECT_EQ(bm_l2_get_payload(buf), (void *)frame);
+
+  /* Release only fires once the last reference is dropped */
+  bm_l2_tx_prep(buf, 0);
+  bm_l2_free(buf);
+  EXPECT_EQ(ref_release_count, 0);
+  bm_l2_free(buf);
+  EXPECT_EQ(ref_release_count, 1);
+  EXPECT_EQ(ref_release_arg, (void *)&cookie);
+}
+
+TEST_F(BmLinuxBuf, l2_new_ref_invalid) {
+  uint8_t frame[8];
+  EXPECT_EQ(bm_l2_new_ref(NULL, sizeof(frame), ref_release, NULL), nullptr);
+  EXPECT_EQ(bm_l2_new_ref(frame, sizeof(frame), NULL, NULL), nullptr);
+}
+
+TEST_F(BmLinuxBuf, l2_new_view_shares_parent) {
+  uint8_t frame[64] = {0};
+  ref_release_count = 0;
+
+  void *parent = bm_l2_new_ref(frame, sizeof(frame), ref_release, NULL);
+  ASSERT_NE(parent, nullptr);
+  EXPECT_EQ(bm_l2_new_view(parent, 60, 8), nullptr);
+  EXPECT_EQ(bm_l2_new_view(parent, 65, 0), nullptr);
+
+  /* The view takes over the reference to the parent */
+  void *view = bm_l2_new_view(parent, 16, 48);
+  ASSERT_NE(view, nullptr);
+  EXPECT_EQ(bm_l2_get_payload(view), (void *)&frame[16]);
+  EXPECT_EQ(bm_udp_reference_update(view), BmOK);
+  bm_l2_free(view);
+  EXPECT_EQ(ref_release_count, 0);
+  bm_l2_free(view);
+  EXPECT_EQ(ref_release_count, 1);
+}
+
+static void *udp_rx_buf;
+static uint32_t udp_rx_len;
+static uint16_t udp_rx_src_port;
+static BmErr udp_rx_cb(uint16_t port, void *buf, uint64_t node_id,
+                       uint32_t len) {
+  (void)node_id;
+  udp_rx_src_port = port;
+  udp_rx_buf = buf;
+  udp_rx_len = len;
+  return BmOK;
+}
+
+TEST_F(BmLinuxBuf, submit_udp_without_copy) {
+  const uint16_t port = 4242;
+  const uint8_t payload[] = {'h', 'e', 'l', 'l', 'o'};
+  uint8_t frame[54 + 8 + sizeof(payload)] = {0};
+  frame[12] = 0x86;
+  frame[13] = 0xDD;
+  frame[19] = 8 + sizeof(payload);
+  frame[20] = 17;
+  frame[54] = 0x12;
+  frame[55] = 0x34;
+  frame[56] = port >> 8;
+  frame[57] = port & 0xFF;
+  frame[59] = 8 + sizeof(payload);
+  memcpy(&frame[62], payload, sizeof(payload));
+
+  void *pcb = bm_udp_bind_port(NULL, port, udp_rx_cb);
+  ASSERT_NE(pcb, nullptr);
+  ref_release_count = 0;
+  udp_rx_buf = NULL;
+  void *buf = bm_l2_new_ref(frame, sizeof(frame), ref_release, NULL);
+  ASSERT_NE(buf, nullptr);
+  EXPECT_EQ(bm_l2_submit(buf, sizeof(frame)), BmOK);
+
+  /* The listener sees the payload in place, the frame lives until it frees
+     the buffer it was handed */
+  ASSERT_NE(udp_rx_buf, nullptr);
+  EXPECT_EQ(udp_rx_src_port, 0x1234);
+  EXPECT_EQ(udp_rx_len, sizeof(payload));
+  EXPECT_EQ(bm_udp_get_payload(udp_rx_buf), (void *)&frame[62]);
+  EXPECT_EQ(ref_release_count, 0);
+  bm_udp_cleanup(udp_rx_buf);
+  EXPECT_EQ(ref_release_count, 1);
+
+  /* Frames for ports nobody listens on are freed right away */
+  frame[57]++;
+  buf = bm_l2_new_ref(frame, sizeof(frame), ref_release, NULL);
+  ASSERT_NE(buf, nullptr);
+  EXPECT_EQ(bm_l2_submit(buf, sizeof(frame)), BmOK);
+  EXPECT_EQ(ref_release_count, 2);
+}
+
 TEST_F(BmLinuxBuf, l2_free_null_safe) {
   /* Should not crash */
   bm_l2_free(NULL);
@@ -418,3 +528,166 @@ TEST_F(BmLinuxInit, registers_packet_callbacks) {
   EXPECT_NE(packet_init_fake.arg2_val, nullptr); /* get_data     */
   EXPECT_NE(packet_init_fake.arg3_val, nullptr); /* get_checksum */
 }
+
+// ============================================================================
+// Frame header template tests
+// ============================================================================
+
+static std::vector<std::vector<uint8_t>> sent_frames;
+static std::vector<uint8_t *> sent_frame_ptrs;
+static BmErr capture_link_output(void *buf, uint32_t length) {
+  uint8_t *frame = (uint8_t *)bm_l2_get_payload(buf);
+  sent_frame_ptrs.push_back(frame);
+  sent_frames.push_back(std::vector<uint8_t>(frame, frame + length));
+  return BmOK;
+}
+
+class BmLinuxTx : public ::testing::Test {
+protected:
+  void SetUp() override {
+    RESET_FAKE(node_id);
+    RESET_FAKE(packet_init);
+    RESET_FAKE(bm_l2_link_output);
+    node_id_fake.return_val = 0x0000000000010002ULL;
+    bm_ip_init();
+    bm_l2_link_output_fake.custom_fake = capture_link_output;
+    sent_frames.clear();
+    sent_frame_ptrs.clear();
+  }
+
+  void send_udp(void *pcb, const BmIpAddr *dst, uint16_t port,
+                const char *text) {
+    const uint32_t size = strlen(text);
+    void *buf = bm_udp_new(size);
+    ASSERT_NE(buf, nullptr);
+    memcpy(bm_udp_get_payload(buf), text, size);
+    EXPECT_EQ(bm_udp_tx_perform(pcb, buf, size, dst, port), BmOK);
+    bm_udp_cleanup(buf);
+  }
+
+  // Sum over the pseudo-header and the whole UDP datagram, checksum field
+  // included, which is zero for a valid datagram
+  uint16_t verify_udp(const std::vector<uint8_t> &frame) {
+    BmIpAddr src, dst;
+    memcpy(src.addr, &frame[22], 16);
+    memcpy(dst.addr, &frame[38], 16);
+    const uint32_t udp_len = frame.size() - 54;
+    EXPECT_EQ(uint8_to_uint16((uint8_t *)&frame[18]), udp_len);
+    EXPECT_EQ(uint8_to_uint16((uint8_t *)&frame[58]), udp_len);
+    return ipv6_pseudo_checksum(&src, &dst, ip_proto_udp, udp_len,
+                                &frame[54]);
+  }
+};
+
+TEST_F(BmLinuxTx, udp_header_from_template) {
+  void *pcb = bm_udp_bind_port(NULL, 2222, udp_rx_cb);
+  ASSERT_NE(pcb, nullptr);
+
+  send_udp(pcb, &multicast_global_addr, 3333, "first");
+  send_udp(pcb, &multicast_global_addr, 3333, "second datagram");
+  send_udp(pcb, &multicast_global_addr, 4444, "other port");
+  ASSERT_EQ(sent_frames.size(), 3U);
+
+  for (auto &frame : sent_frames) {
+    /* Multicast MAC, source MAC from the node id, IPv6 */
+    EXPECT_EQ(frame[0], 0x33);
+    EXPECT_EQ(frame[1], 0x33);
+    EXPECT_EQ(frame[12], 0x86);
+    EXPECT_EQ(frame[13], 0xDD);
+    EXPECT_EQ(frame[14], 0x60);
+    EXPECT_EQ(frame[20], ip_proto_udp);
+    EXPECT_EQ(frame[21], 64);
+    EXPECT_EQ(memcmp(&frame[22], bm_ip_get(0)->addr, 16), 0);
+    EXPECT_EQ(memcmp(&frame[38], multicast_global_addr.addr, 16), 0);
+    EXPECT_EQ(uint8_to_uint16(&frame[54]), 2222);
+    EXPECT_EQ(verify_udp(frame), 0);
+  }
+  /* The cached header is the one that was built */
+  EXPECT_EQ(memcmp(sent_frames[0].data(), sent_frames[1].data(), 18), 0);
+  EXPECT_EQ(memcmp(&sent_frames[0][20], &sent_frames[1][20], 36), 0);
+  EXPECT_EQ(uint8_to_uint16(&sent_frames[1][56]), 3333);
+  EXPECT_EQ(uint8_to_uint16(&sent_frames[2][56]), 4444);
+  EXPECT_EQ(memcmp(&sent_frames[1][62], "second datagram", 15), 0);
+}
+
+TEST_F(BmLinuxTx, ip_header_from_template) {
+  const uint8_t data[] = {1, 2, 3, 4, 5, 6};
+  BmIpAddr unicast;
+  memcpy(&unicast, bm_ip_get(1), sizeof(unicast));
+  unicast.addr[15] ^= 0x55;
+
+  for (int i = 0; i < 2; i++) {
+    void *buf = bm_ip_tx_new(&unicast, sizeof(data) + i);
+    ASSERT_NE(buf, nullptr);
+    EXPECT_EQ(bm_ip_tx_copy(buf, data, sizeof(data), 0), BmOK);
+    EXPECT_EQ(bm_ip_tx_perform(buf, NULL), BmOK);
+    bm_ip_tx_cleanup(buf);
+  }
+  ASSERT_EQ(sent_frames.size(), 2U);
+  for (size_t i = 0; i < sent_frames.size(); i++) {
+    auto &frame = sent_frames[i];
+    /* Unicast goes to the broadcast MAC */
+    for (int j = 0; j < 6; j++) {
+      EXPECT_EQ(frame[j], 0xFF);
+    }
+    EXPECT_EQ(uint8_to_uint16(&frame[18]), sizeof(data) + i);
+    EXPECT_EQ(frame[20], ip_proto_bcmp);
+    EXPECT_EQ(memcmp(&frame[38], unicast.addr, 16), 0);
+    EXPECT_EQ(memcmp(&frame[54], data, sizeof(data)), 0);
+  }
+}
+
+TEST_F(BmLinuxTx, template_hit_matches_build) {
+  uint8_t built[62], cached[62];
+  memset(built, 0xAA, sizeof(built));
+  memset(cached, 0x55, sizeof(cached));
+  const uint32_t built_sum =
+      stamp_header(built, &multicast_global_addr, ip_proto_udp, 10, 20);
+  const uint32_t cached_sum =
+      stamp_header(cached, &multicast_global_addr, ip_proto_udp, 10, 20);
+  EXPECT_EQ(built_sum, cached_sum);
+  EXPECT_EQ(memcmp(built, cached, sizeof(built)), 0);
+
+  /* Re-initializing drops the templates, the node id may have changed */
+  node_id_fake.return_val = 0x0000000000030004ULL;
+  bm_ip_init();
+  stamp_header(cached, &multicast_global_addr, ip_proto_udp, 10, 20);
+  EXPECT_NE(memcmp(built, cached, sizeof(built)), 0);
+  EXPECT_EQ(memcmp(&cached[22], bm_ip_get(0)->addr, 16), 0);
+}
+
+TEST_F(BmLinuxTx, udp_frame_built_in_place) {
+  void *pcb = bm_udp_bind_port(NULL, 2223, udp_rx_cb);
+  ASSERT_NE(pcb, nullptr);
+
+  /* Headers go in the headroom in front of the payload, no copy */
+  void *buf = bm_udp_new(32);
+  ASSERT_NE(buf, nullptr);
+  uint8_t *payload = (uint8_t *)bm_udp_get_payload(buf);
+  memcpy(payload, "in place", 8);
+  bm_ip_buf_shrink(buf, 8);
+  EXPECT_EQ(bm_udp_tx_perform(pcb, buf, 8, &multicast_global_addr, 5555),
+            BmOK);
+  ASSERT_EQ(sent_frame_ptrs.size(), 1U);
+  EXPECT_EQ(sent_frame_ptrs[0], payload - 62);
+  EXPECT_EQ(sent_frames[0].size(), 62U + 8U);
+  EXPECT_EQ(memcmp(&sent_frames[0][62], "in place", 8), 0);
+  EXPECT_EQ(verify_udp(sent_frames[0]), 0);
+  bm_udp_cleanup(buf);
+
+  /* A buffer someone else still references is copied */
+  buf = bm_udp_new(8);
+  ASSERT_NE(buf, nullptr);
+  payload = (uint8_t *)bm_udp_get_payload(buf);
+  memcpy(payload, "shared!!", 8);
+  EXPECT_EQ(bm_udp_reference_update(buf), BmOK);
+  EXPECT_EQ(bm_udp_tx_perform(pcb, buf, 8, &multicast_global_addr, 5555),
+            BmOK);
+  ASSERT_EQ(sent_frame_ptrs.size(), 2U);
+  EXPECT_NE(sent_frame_ptrs[1], payload - 62);
+  EXPECT_EQ(bm_udp_get_payload(buf), (void *)payload);
+  EXPECT_EQ(memcmp(&sent_frames[1][62], "shared!!", 8), 0);
+  EXPECT_EQ(verify_udp(sent_frames[1]), 0);
+  bm_udp_cleanup(buf);
+  bm_udp_cleanup(buf);
+}
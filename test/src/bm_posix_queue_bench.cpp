@@ -0,0 +1,78 @@
+#include <bench.hpp>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "bm_os.h"
+}
+
+// Contention on bm_queue on the POSIX port, several producers feeding one
+// consumer as the L2, BCMP and middleware queues do. Built once per queue
+// backend, compare the lines of the two binaries.
+
+#if defined(bm_posix_queue_lockfree) && !bm_posix_queue_lockfree
+static const char *backend = "mutex";
+#else
+static const char *backend = "lock-free";
+#endif
+
+static constexpr uint32_t items_per_run = 200000;
+
+typedef struct {
+  uint32_t producer;
+  uint32_t seq;
+  uint8_t payload[24];
+} BenchItem;
+
+static double run(uint32_t producers, uint32_t queue_len, bool batch) {
+  BmQueue queue = bm_queue_create(queue_len, sizeof(BenchItem));
+  const uint32_t per_producer = items_per_run / producers;
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (uint32_t p = 0; p < producers; p++) {
+    threads.emplace_back([queue, p, per_producer] {
+      BenchItem item = {p, 0, {0}};
+      for (uint32_t i = 0; i < per_producer; i++) {
+        item.seq = i;
+        bm_queue_send(queue, &item, UINT32_MAX);
+      }
+    });
+  }
+
+  BenchItem items[16];
+  for (uint32_t n = 0; n < per_producer * producers;) {
+    uint32_t received = 1;
+    if (batch) {
+      bm_queue_receive_many(queue, items, 16, &received, UINT32_MAX);
+    } else {
+      bm_queue_receive(queue, items, UINT32_MAX);
+    }
+    n += received;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  bm_queue_delete(queue);
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         (per_producer * producers);
+}
+
+TEST(PosixQueueBench, producers) {
+  const uint32_t producer_counts[] = {1, 2, 4, 8};
+  const uint32_t queue_lens[] = {8, 64};
+  for (uint32_t queue_len : queue_lens) {
+    for (uint32_t producers : producer_counts) {
+      const double single = run(producers, queue_len, false);
+      const double batch = run(producers, queue_len, true);
+      bench_report("%-9s queue %2u producers %u %8.1f ns/item "
+                   "%8.1f ns/item batched",
+                   backend, queue_len, producers, single, batch);
+    }
+  }
+}
@@ -0,0 +1,545 @@
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "bm_os.h"
+#include "bm_posix.h"
+}
+
+using namespace std::chrono;
+
+static uint64_t elapsed_ms(steady_clock::time_point start) {
+  return duration_cast<milliseconds>(steady_clock::now() - start).count();
+}
+
+// Poll until the condition holds or the timeout expires
+template <typename F> static bool wait_for(F done, uint32_t timeout_ms) {
+  auto start = steady_clock::now();
+  while (!done()) {
+    if (elapsed_ms(start) > timeout_ms) {
+      return false;
+    }
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  return true;
+}
+
+struct Fired {
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint64_t> at_ms{0};
+  steady_clock::time_point start = steady_clock::now();
+};
+
+class PosixTimers : public ::testing::Test {};
+
+// Timer IDs are 32 bits wide through bm_timer_get_id, so callbacks find their
+// state through a table rather than a pointer
+static Fired FIRED[4096];
+static void fired_cb(BmTimer timer) {
+  Fired &fired = FIRED[bm_timer_get_id(timer)];
+  if (fired.count.fetch_add(1) == 0) {
+    fired.at_ms = elapsed_ms(fired.start);
+  }
+}
+
+static BmTimer create(uint32_t id, uint32_t period_ms, bool auto_reload) {
+  FIRED[id].count = 0;
+  FIRED[id].at_ms = 0;
+  FIRED[id].start = steady_clock::now();
+  return bm_timer_create("test", period_ms, auto_reload,
+                         (void *)(uintptr_t)id, fired_cb);
+}
+
+TEST_F(PosixTimers, one_shot) {
+  BmTimer timer = create(0, 20, false);
+  ASSERT_NE(timer, nullptr);
+  EXPECT_EQ(bm_timer_get_id(timer), 0U);
+  EXPECT_EQ(bm_timer_is_timer_active(timer), BmETIME);
+
+  ASSERT_EQ(bm_timer_start(timer, 10), BmOK);
+  EXPECT_EQ(bm_timer_is_timer_active(timer), BmOK);
+  ASSERT_TRUE(wait_for([] { return FIRED[0].count == 1; }, 1000));
+  EXPECT_GE(FIRED[0].at_ms, 19U);
+  EXPECT_EQ(bm_timer_is_timer_active(timer), BmETIME);
+
+  // Stays dormant once fired
+  std::this_thread::sleep_for(milliseconds(60));
+  EXPECT_EQ(FIRED[0].count, 1U);
+  bm_timer_delete(timer, 10);
+}
+
+TEST_F(PosixTimers, auto_reload_and_stop) {
+  BmTimer timer = create(1, 10, true);
+  ASSERT_EQ(bm_timer_start(timer, 10), BmOK);
+  ASSERT_TRUE(wait_for([] { return FIRED[1].count >= 5; }, 2000));
+  EXPECT_GE(FIRED[1].at_ms, 9U);
+
+  ASSERT_EQ(bm_timer_stop(timer, 10), BmOK);
+  EXPECT_EQ(bm_timer_is_timer_active(timer), BmETIME);
+  // A callback may have been running while it was stopped
+  std::this_thread::sleep_for(milliseconds(20));
+  const uint32_t stopped_at = FIRED[1].count;
+  std::this_thread::sleep_for(milliseconds(50));
+  EXPECT_EQ(FIRED[1].count, stopped_at);
+  bm_timer_delete(timer, 10);
+}
+
+TEST_F(PosixTimers, reset_postpones) {
+  BmTimer timer = create(2, 40, false);
+  ASSERT_EQ(bm_timer_start(timer, 10), BmOK);
+  for (int i = 0; i < 4; i++) {
+    std::this_thread::sleep_for(milliseconds(20));
+    ASSERT_EQ(bm_timer_reset(timer, 10), BmOK);
+  }
+  EXPECT_EQ(FIRED[2].count, 0U);
+  ASSERT_TRUE(wait_for([] { return FIRED[2].count == 1; }, 1000));
+  EXPECT_GE(FIRED[2].at_ms, 119U);
+  bm_timer_delete(timer, 10);
+}
+
+TEST_F(PosixTimers, change_period_starts) {
+  BmTimer timer = create(3, 1000, false);
+  ASSERT_EQ(bm_timer_change_period(timer, 15, 10), BmOK);
+  EXPECT_EQ(bm_timer_is_timer_active(timer), BmOK);
+  ASSERT_TRUE(wait_for([] { return FIRED[3].count == 1; }, 500));
+  bm_timer_delete(timer, 10);
+}
+
+// Timers spanning several wheel levels fire in order of expiry, and never
+// before their period
+TEST_F(PosixTimers, expiry_order_across_levels) {
+  const uint32_t periods[] = {3, 63, 64, 65, 130, 257, 700, 1300};
+  std::vector<BmTimer> timers;
+  for (uint32_t i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+    timers.push_back(create(100 + i, periods[i], false));
+  }
+  for (BmTimer timer : timers) {
+    ASSERT_EQ(bm_timer_start(timer, 10), BmOK);
+  }
+  ASSERT_TRUE(wait_for([] { return FIRED[107].count == 1; }, 3000));
+  for (uint32_t i = 0; i < timers.size(); i++) {
+    EXPECT_EQ(FIRED[100 + i].count, 1U) << periods[i];
+    EXPECT_GE(FIRED[100 + i].at_ms + 1, periods[i]) << periods[i];
+    if (i) {
+      EXPECT_GE(FIRED[100 + i].at_ms, FIRED[100 + i - 1].at_ms) << periods[i];
+    }
+    bm_timer_delete(timers[i], 10);
+  }
+}
+
+TEST_F(PosixTimers, thousands_of_timers) {
+  const uint32_t n = 4000;
+  std::vector<BmTimer> timers;
+  for (uint32_t i = 0; i < n; i++) {
+    BmTimer timer = create(i % 4096, 5 + i % 200, false);
+    ASSERT_NE(timer, nullptr);
+    timers.push_back(timer);
+  }
+  for (BmTimer timer : timers) {
+    ASSERT_EQ(bm_timer_start(timer, 100), BmOK);
+  }
+  // Stopping half of them keeps those from firing
+  for (uint32_t i = 0; i < n; i += 2) {
+    ASSERT_EQ(bm_timer_stop(timers[i], 100), BmOK);
+  }
+  ASSERT_TRUE(wait_for(
+      [] {
+        for (uint32_t i = 1; i < n; i += 2) {
+          if (FIRED[i].count != 1) {
+            return false;
+          }
+        }
+        return true;
+      },
+      3000));
+  for (uint32_t i = 0; i < n; i += 2) {
+    EXPECT_EQ(FIRED[i].count, 0U) << i;
+  }
+  for (BmTimer timer : timers) {
+    bm_timer_delete(timer, 100);
+  }
+}
+
+static BmTimer SELF_DELETING;
+static std::atomic<uint32_t> self_delete_calls;
+static void self_delete_cb(BmTimer timer) {
+  self_delete_calls++;
+  bm_timer_delete(timer, 10);
+}
+
+TEST_F(PosixTimers, delete_from_own_callback) {
+  self_delete_calls = 0;
+  SELF_DELETING = bm_timer_create("self", 5, true, NULL, self_delete_cb);
+  ASSERT_NE(SELF_DELETING, nullptr);
+  ASSERT_EQ(bm_timer_start(SELF_DELETING, 10), BmOK);
+  ASSERT_TRUE(wait_for([] { return self_delete_calls == 1; }, 500));
+  std::this_thread::sleep_for(milliseconds(30));
+  EXPECT_EQ(self_delete_calls, 1U);
+}
+
+static std::atomic<uint32_t> restart_calls;
+static void restart_cb(BmTimer timer) {
+  // Callbacks can restart their own timer, one-shot timers are dormant here
+  if (restart_calls++ < 3) {
+    EXPECT_EQ(bm_timer_is_timer_active(timer), BmETIME);
+    bm_timer_start(timer, 10);
+  }
+}
+
+TEST_F(PosixTimers, restart_from_own_callback) {
+  restart_calls = 0;
+  BmTimer timer = bm_timer_create("restart", 5, false, NULL, restart_cb);
+  ASSERT_EQ(bm_timer_start(timer, 10), BmOK);
+  ASSERT_TRUE(wait_for([] { return restart_calls == 4; }, 1000));
+  bm_timer_delete(timer, 10);
+}
+
+TEST_F(PosixTimers, invalid_arguments) {
+  EXPECT_EQ(bm_timer_create("null", 10, false, NULL, NULL), nullptr);
+  EXPECT_EQ(bm_timer_start(NULL, 10), BmEINVAL);
+  EXPECT_EQ(bm_timer_stop(NULL, 10), BmEINVAL);
+  EXPECT_EQ(bm_timer_reset(NULL, 10), BmEINVAL);
+  EXPECT_EQ(bm_timer_change_period(NULL, 10, 10), BmEINVAL);
+  EXPECT_EQ(bm_timer_is_timer_active(NULL), BmEINVAL);
+  EXPECT_EQ(bm_timer_get_id(NULL), 0U);
+  bm_timer_delete(NULL, 10);
+}
+
+class PosixQueue : public ::testing::Test {
+protected:
+  BmQueue queue = NULL;
+  void TearDown() override { bm_queue_delete(queue); }
+};
+
+TEST_F(PosixQueue, fifo_and_full) {
+  queue = bm_queue_create(5, sizeof(uint32_t));
+  ASSERT_NE(queue, nullptr);
+  for (uint32_t i = 0; i < 5; i++) {
+    ASSERT_EQ(bm_queue_send(queue, &i, 0), BmOK);
+  }
+  uint32_t item = 5;
+  EXPECT_EQ(bm_queue_send(queue, &item, 0), BmENOMEM);
+  auto start = steady_clock::now();
+  EXPECT_EQ(bm_queue_send(queue, &item, 20), BmETIMEDOUT);
+  EXPECT_GE(elapsed_ms(start), 19U);
+
+  // Wraps around the ring a few times
+  for (uint32_t i = 0; i < 50; i++) {
+    ASSERT_EQ(bm_queue_receive(queue, &item, 0), BmOK);
+    EXPECT_EQ(item, i);
+    const uint32_t next = i + 5;
+    ASSERT_EQ(bm_queue_send(queue, &next, 0), BmOK);
+  }
+  for (uint32_t i = 50; i < 55; i++) {
+    ASSERT_EQ(bm_queue_receive(queue, &item, 0), BmOK);
+    EXPECT_EQ(item, i);
+  }
+  EXPECT_EQ(bm_queue_receive(queue, &item, 0), BmETIMEDOUT);
+  start = steady_clock::now();
+  EXPECT_EQ(bm_queue_receive(queue, &item, 20), BmETIMEDOUT);
+  EXPECT_GE(elapsed_ms(start), 19U);
+}
+
+// A queue of one is full after one send, a second send must not overwrite
+// the item waiting to be received
+TEST_F(PosixQueue, single_item) {
+  queue = bm_queue_create(1, sizeof(uint32_t));
+  for (uint32_t lap = 0; lap < 3; lap++) {
+    uint32_t item = lap;
+    ASSERT_EQ(bm_queue_send(queue, &item, 0), BmOK);
+    item = 100 + lap;
+    EXPECT_EQ(bm_queue_send(queue, &item, 0), BmENOMEM);
+    EXPECT_EQ(bm_queue_send(queue, &item, 5), BmETIMEDOUT);
+    ASSERT_EQ(bm_queue_receive(queue, &item, 0), BmOK);
+    EXPECT_EQ(item, lap);
+    EXPECT_EQ(bm_queue_receive(queue, &item, 0), BmETIMEDOUT);
+  }
+}
+
+TEST_F(PosixQueue, send_to_front) {
+  queue = bm_queue_create(4, sizeof(uint32_t));
+  uint32_t item = 1;
+  ASSERT_EQ(bm_queue_send(queue, &item, 0), BmOK);
+  item = 2;
+  ASSERT_EQ(bm_queue_send(queue, &item, 0), BmOK);
+  item = 99;
+  ASSERT_EQ(bm_queue_send_to_front_from_isr(queue, &item), BmOK);
+
+  ASSERT_EQ(bm_queue_receive(queue, &item, 0), BmOK);
+  EXPECT_EQ(item, 99U);
+  ASSERT_EQ(bm_queue_receive(queue, &item, 0), BmOK);
+  EXPECT_EQ(item, 1U);
+  ASSERT_EQ(bm_queue_receive(queue, &item, 0), BmOK);
+  EXPECT_EQ(item, 2U);
+}
+
+TEST_F(PosixQueue, receive_many) {
+  queue = bm_queue_create(8, sizeof(uint16_t));
+  uint16_t items[8] = {0};
+  uint32_t received = 0;
+  EXPECT_EQ(bm_queue_receive_many(queue, items, 8, &received, 0), BmETIMEDOUT);
+  EXPECT_EQ(received, 0U);
+  for (uint16_t i = 0; i < 6; i++) {
+    ASSERT_EQ(bm_queue_send(queue, &i, 0), BmOK);
+  }
+  ASSERT_EQ(bm_queue_receive_many(queue, items, 4, &received, 0), BmOK);
+  ASSERT_EQ(received, 4U);
+  ASSERT_EQ(bm_queue_receive_many(queue, &items[4], 4, &received, 10), BmOK);
+  ASSERT_EQ(received, 2U);
+  for (uint16_t i = 0; i < 6; i++) {
+    EXPECT_EQ(items[i], i);
+  }
+}
+
+TEST_F(PosixQueue, blocking_receive_and_send) {
+  queue = bm_queue_create(1, sizeof(uint64_t));
+
+  // A blocked receiver is woken by a send
+  std::thread sender([this] {
+    std::this_thread::sleep_for(milliseconds(20));
+    uint64_t item = 0x1122334455667788;
+    EXPECT_EQ(bm_queue_send(queue, &item, 0), BmOK);
+  });
+  uint64_t item = 0;
+  ASSERT_EQ(bm_queue_receive(queue, &item, UINT32_MAX), BmOK);
+  EXPECT_EQ(item, 0x1122334455667788U);
+  sender.join();
+
+  // A blocked sender is woken by a receive
+  ASSERT_EQ(bm_queue_send(queue, &item, 0), BmOK);
+  std::thread receiver([this] {
+    std::this_thread::sleep_for(milliseconds(20));
+    uint64_t out = 0;
+    EXPECT_EQ(bm_queue_receive(queue, &out, 0), BmOK);
+  });
+  item = 7;
+  ASSERT_EQ(bm_queue_send(queue, &item, 1000), BmOK);
+  receiver.join();
+  ASSERT_EQ(bm_queue_receive(queue, &item, 0), BmOK);
+  EXPECT_EQ(item, 7U);
+}
+
+// Several producers block on a small queue, every item arrives once and in
+// the order each producer sent them
+TEST_F(PosixQueue, many_producers) {
+  constexpr uint32_t producers = 4;
+  constexpr uint32_t per_producer = 50000;
+  queue = bm_queue_create(16, sizeof(uint32_t[2]));
+
+  std::vector<std::thread> threads;
+  for (uint32_t p = 0; p < producers; p++) {
+    threads.emplace_back([this, p] {
+      for (uint32_t i = 0; i < per_producer; i++) {
+        uint32_t item[2] = {p, i};
+        ASSERT_EQ(bm_queue_send(queue, item, UINT32_MAX), BmOK);
+      }
+    });
+  }
+
+  uint32_t next[producers] = {0};
+  for (uint32_t n = 0; n < producers * per_producer;) {
+    uint32_t items[8][2];
+    uint32_t received = 0;
+    ASSERT_EQ(bm_queue_receive_many(queue, items, 8, &received, 1000), BmOK);
+    for (uint32_t i = 0; i < received; i++) {
+      ASSERT_LT(items[i][0], producers);
+      ASSERT_EQ(items[i][1], next[items[i][0]]++);
+    }
+    n += received;
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  uint32_t item[2];
+  EXPECT_EQ(bm_queue_receive(queue, item, 0), BmETIMEDOUT);
+}
+
+TEST_F(PosixQueue, invalid_arguments) {
+  EXPECT_EQ(bm_queue_create(0, 4), nullptr);
+  queue = bm_queue_create(2, 4);
+  uint32_t item = 0, received = 0;
+  EXPECT_EQ(bm_queue_send(NULL, &item, 0), BmEINVAL);
+  EXPECT_EQ(bm_queue_send(queue, NULL, 0), BmEINVAL);
+  EXPECT_EQ(bm_queue_send_to_front_from_isr(queue, NULL), BmEINVAL);
+  EXPECT_EQ(bm_queue_receive(queue, NULL, 0), BmEINVAL);
+  EXPECT_EQ(bm_queue_receive_many(queue, &item, 0, &received, 0), BmEINVAL);
+  EXPECT_EQ(bm_queue_receive_many(queue, &item, 1, NULL, 0), BmEINVAL);
+}
+
+TEST(PosixClock, time_ns_is_monotonic) {
+  uint64_t prev = bm_get_time_ns();
+  for (int i = 0; i < 1000; i++) {
+    uint64_t now = bm_get_time_ns();
+    EXPECT_GE(now, prev);
+    prev = now;
+  }
+  // Same clock as the microsecond variant
+  uint64_t us = bm_get_time_us();
+  uint64_t ns = bm_get_time_ns();
+  EXPECT_GE(ns / 1000U, us);
+  EXPECT_LT(ns / 1000U - us, 100000U);
+}
+
+TEST(PosixClock, delay_sleeps_at_least_requested) {
+  uint64_t start = bm_get_time_ns();
+  bm_delay(20);
+  EXPECT_GE(bm_get_time_ns() - start, 20000000U);
+}
+
+TEST(PosixClock, timed_waits_honor_timeout) {
+  BmSemaphore sem = bm_semaphore_create();
+  ASSERT_NE(sem, nullptr);
+  uint64_t start = bm_get_time_ns();
+  EXPECT_EQ(bm_semaphore_take(sem, 30), BmETIMEDOUT);
+  uint64_t waited_ms = (bm_get_time_ns() - start) / 1000000U;
+  EXPECT_GE(waited_ms, 30U);
+  EXPECT_LT(waited_ms, 1000U);
+
+  // A give from another thread wakes the waiter before the deadline
+  std::thread giver([sem] {
+    std::this_thread::sleep_for(milliseconds(10));
+    bm_semaphore_give(sem);
+  });
+  start = bm_get_time_ns();
+  EXPECT_EQ(bm_semaphore_take(sem, 5000), BmOK);
+  EXPECT_LT((bm_get_time_ns() - start) / 1000000U, 1000U);
+  giver.join();
+  bm_semaphore_delete(sem);
+}
+
+// What a task observed about its own thread
+struct TaskSeen {
+  std::atomic<bool> done{false};
+  size_t stack_bytes = 0;
+  int policy = -1;
+  int sched_priority = -1;
+  int cpus = 0;
+};
+
+static void task_observe(void *arg) {
+  TaskSeen *seen = (TaskSeen *)arg;
+  pthread_attr_t attr;
+  if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+    pthread_attr_getstacksize(&attr, &seen->stack_bytes);
+    pthread_attr_destroy(&attr);
+  }
+  struct sched_param param;
+  if (pthread_getschedparam(pthread_self(), &seen->policy, &param) == 0) {
+    seen->sched_priority = param.sched_priority;
+  }
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    seen->cpus = CPU_COUNT(&set);
+  }
+  seen->done = true;
+}
+
+class PosixTasks : public ::testing::Test {
+protected:
+  // Tasks pick a bm priority no other test touches
+  static constexpr uint32_t priority = 20;
+  void TearDown() override {
+    BmPosixTaskSched other = {BmPosixSchedOther, 0, 0};
+    bm_posix_task_sched_set(priority, &other);
+  }
+};
+
+TEST_F(PosixTasks, stack_size_is_honored) {
+  TaskSeen small, large;
+  ASSERT_EQ(bm_task_create(task_observe, "small", 128, &small, 1, NULL), BmOK);
+  ASSERT_EQ(bm_task_create(task_observe, "large", 256 * 1024, &large, 1, NULL),
+            BmOK);
+  ASSERT_TRUE(wait_for([&] { return small.done && large.done; }, 2000));
+  // Small FreeRTOS sized requests are raised to a hosted floor
+  EXPECT_GE(small.stack_bytes, 64U * 1024U);
+  EXPECT_GE(large.stack_bytes, 256U * 1024U * sizeof(void *));
+}
+
+TEST_F(PosixTasks, realtime_policy_or_fallback) {
+  BmPosixTaskSched fifo = {BmPosixSchedFifo, 5, 0};
+  ASSERT_EQ(bm_posix_task_sched_set(priority, &fifo), BmOK);
+  BmPosixTaskStats before, after;
+  bm_posix_task_stats(&before);
+
+  TaskSeen seen;
+  ASSERT_EQ(bm_task_create(task_observe, "rt", 1024, &seen, priority, NULL),
+            BmOK);
+  ASSERT_TRUE(wait_for([&] { return seen.done.load(); }, 2000));
+  bm_posix_task_stats(&after);
+  if (seen.policy == SCHED_FIFO) {
+    EXPECT_EQ(seen.sched_priority, 5);
+    EXPECT_EQ(after.sched_denied, before.sched_denied);
+  } else {
+    // Unprivileged runs start the task anyway and count the denial
+    EXPECT_EQ(seen.policy, SCHED_OTHER);
+    EXPECT_EQ(after.sched_denied, before.sched_denied + 1);
+  }
+}
+
+TEST_F(PosixTasks, affinity_is_applied) {
+  int cpu = sched_getcpu();
+  ASSERT_GE(cpu, 0);
+  ASSERT_LT(cpu, 64);
+  BmPosixTaskSched pinned = {BmPosixSchedOther, 0, 1ULL << cpu};
+  ASSERT_EQ(bm_posix_task_sched_set(priority, &pinned), BmOK);
+
+  TaskSeen seen;
+  ASSERT_EQ(bm_task_create(task_observe, "pinned", 1024, &seen, priority, NULL),
+            BmOK);
+  ASSERT_TRUE(wait_for([&] { return seen.done.load(); }, 2000));
+  EXPECT_EQ(seen.cpus, 1);
+}
+
+TEST_F(PosixTasks, sched_table) {
+  BmPosixTaskSched sched;
+  EXPECT_EQ(bm_posix_task_sched_get(3, &sched), BmOK);
+  EXPECT_EQ(sched.policy, BmPosixSchedOther);
+  EXPECT_EQ(sched.cpu_mask, 0U);
+
+  // Priorities past the table share its last entry
+  BmPosixTaskSched rr = {BmPosixSchedRr, 7, 0};
+  EXPECT_EQ(bm_posix_task_sched_set(1000, &rr), BmOK);
+  EXPECT_EQ(bm_posix_task_sched_get(2000, &sched), BmOK);
+  EXPECT_EQ(sched.policy, BmPosixSchedRr);
+  EXPECT_EQ(sched.sched_priority, 7);
+  BmPosixTaskSched other = {BmPosixSchedOther, 0, 0};
+  bm_posix_task_sched_set(1000, &other);
+
+  BmPosixTaskSched bad = {(BmPosixSchedPolicy)9, 0, 0};
+  EXPECT_EQ(bm_posix_task_sched_set(3, &bad), BmEINVAL);
+  EXPECT_EQ(bm_posix_task_sched_set(3, NULL), BmEINVAL);
+  EXPECT_EQ(bm_posix_task_sched_get(3, NULL), BmEINVAL);
+}
+
+TEST(PosixHeap, stats) {
+  BmHeapStats stats;
+  EXPECT_EQ(bm_heap_stats(NULL), BmEINVAL);
+#if bm_heap_tlsf
+  ASSERT_EQ(bm_heap_stats(&stats), BmOK);
+  uint32_t live = stats.live_bytes;
+  uint32_t count = stats.alloc_count[5];
+  EXPECT_GT(stats.total_bytes, 0U);
+
+  void *ptr = bm_malloc(300);
+  ASSERT_NE(ptr, nullptr);
+  ASSERT_EQ(bm_heap_stats(&stats), BmOK);
+  EXPECT_GE(stats.live_bytes, live + 300U);
+  EXPECT_GE(stats.high_water, stats.live_bytes);
+  EXPECT_EQ(stats.alloc_count[5], count + 1U); // 257 to 512 bytes
+
+  bm_free(ptr);
+  ASSERT_EQ(bm_heap_stats(&stats), BmOK);
+  EXPECT_EQ(stats.live_bytes, live);
+  EXPECT_EQ(bm_malloc(bm_heap_size), nullptr);
+  ASSERT_EQ(bm_heap_stats(&stats), BmOK);
+  EXPECT_GE(stats.failed, 1U);
+#else
+  // The libc heap keeps no statistics
+  EXPECT_EQ(bm_heap_stats(&stats), BmENODATA);
+#endif
+}
@@ -0,0 +1,59 @@
+#include <bench.hpp>
+#include <gtest/gtest.h>
+#include <helpers.hpp>
+#include <stdint.h>
+#include <string.h>
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+
+extern "C" {
+#include "checksum.h"
+#include "util.h"
+}
+
+// Checksum engine against the byte loop it replaced, across payload sizes
+
+static constexpr uint32_t bytes_per_size = 64 * 1024 * 1024;
+
+static uint16_t byte_loop_checksum(const uint8_t *p, size_t len) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i + 1 < len; i += 2) {
+    sum += ((uint16_t)p[i] << 8) | p[i + 1];
+  }
+  if (len & 1) {
+    sum += (uint16_t)p[len - 1] << 8;
+  }
+  while (sum >> 16) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+  return (uint16_t)~sum;
+}
+
+TEST(ChecksumBench, payload_sizes) {
+  rnd_gen RND;
+  static uint8_t data[1500];
+  RND.rnd_array(data, sizeof(data));
+  const size_t sizes[] = {20, 64, 128, 256, 512, 1024, 1500};
+
+  for (size_t size : sizes) {
+    const uint32_t iterations = bytes_per_size / size;
+    volatile uint16_t sink = 0;
+    const double engine = ns_per_call(
+        [&] { sink = checksum_fold(checksum_add(0, data, size)); },
+        iterations);
+    const double byte_loop =
+        ns_per_call([&] { sink = byte_loop_checksum(data, size); }, iterations);
+    EXPECT_EQ(checksum_fold(checksum_add(0, data, size)),
+              byte_loop_checksum(data, size));
+    bench_report("%4zu bytes %8.1f ns engine %8.1f ns byte loop %6.2f GB/s",
+                 size, engine, byte_loop, size / engine);
+    (void)sink;
+  }
+
+  // Patching one word of a frame, as L2 does per egress port
+  volatile uint16_t checksum = checksum_fold(checksum_add(0, data, 1500));
+  const double incremental = ns_per_call(
+      [&] { checksum = checksum_update(checksum, 0x1200, 0x1203); }, 1000000);
+  bench_report("incremental update %8.1f ns", incremental);
+}
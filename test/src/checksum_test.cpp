@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <helpers.hpp>
+#include <stdint.h>
+#include <string.h>
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+
+extern "C" {
+#include "checksum.h"
+#include "util.h"
+}
+
+// Straightforward RFC 1071 sum of big-endian words, the reference every
+// kernel has to agree with
+static uint16_t reference_checksum(uint32_t sum, const uint8_t *data,
+                                   size_t len) {
+  for (size_t i = 0; i + 1 < len; i += 2) {
+    sum += (uint32_t)(data[i] << 8 | data[i + 1]);
+  }
+  if (len & 1) {
+    sum += (uint32_t)data[len - 1] << 8;
+  }
+  while (sum >> 16) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+  return (uint16_t)~sum;
+}
+
+class Checksum : public ::testing::Test {
+protected:
+  rnd_gen RND;
+  uint8_t data[4096 + 64];
+
+  void SetUp() override { RND.rnd_array(data, sizeof(data)); }
+};
+
+TEST_F(Checksum, rfc1071_example) {
+  // RFC 1071 section 3 example, sum 0xDDF2
+  const uint8_t example[] = {0x00, 0x01, 0xF2, 0x03, 0xF4, 0xF5, 0xF6, 0xF7};
+  EXPECT_EQ(checksum_fold(checksum_add(0, example, sizeof(example))),
+            (uint16_t)~0xDDF2);
+  EXPECT_EQ(checksum_fold(0), 0xFFFF);
+  EXPECT_EQ(checksum_add(7, NULL, 16), 7U);
+}
+
+TEST_F(Checksum, matches_reference_for_all_lengths_and_alignments) {
+  for (size_t offset = 0; offset < 8; offset++) {
+    for (size_t len = 0; len <= 300; len++) {
+      ASSERT_EQ(checksum_fold(checksum_add(0, &data[offset], len)),
+                reference_checksum(0, &data[offset], len))
+          << "offset " << offset << " len " << len;
+    }
+  }
+  // Long enough to go through the vector kernels many times
+  EXPECT_EQ(checksum_fold(checksum_add(0, data, 4096)),
+            reference_checksum(0, data, 4096));
+  EXPECT_EQ(checksum_fold(checksum_add(0, &data[1], 4095)),
+            reference_checksum(0, &data[1], 4095));
+}
+
+TEST_F(Checksum, carries_are_folded) {
+  uint8_t ones[1500];
+  memset(ones, 0xFF, sizeof(ones));
+  EXPECT_EQ(checksum_fold(checksum_add(0, ones, sizeof(ones))),
+            reference_checksum(0, ones, sizeof(ones)));
+  EXPECT_EQ(checksum_fold(checksum_add(0xFFFF, ones, sizeof(ones))),
+            reference_checksum(0xFFFF, ones, sizeof(ones)));
+}
+
+TEST_F(Checksum, chunks_add_up) {
+  // Only the last chunk has an odd length
+  const size_t len = 1201;
+  uint32_t sum = checksum_add(0, data, 40);
+  sum = checksum_add(sum, &data[40], 8);
+  sum = checksum_add(sum, &data[48], len - 48 - 1);
+  sum = checksum_add(sum, &data[len - 1], 1);
+  EXPECT_EQ(checksum_fold(sum), reference_checksum(0, data, len));
+}
+
+TEST_F(Checksum, ipv6_pseudo_header) {
+  BmIpAddr src, dst;
+  memcpy(src.addr, data, sizeof(src.addr));
+  memcpy(dst.addr, &data[16], sizeof(dst.addr));
+  const uint32_t length = 0x12345;
+  const uint8_t *payload = &data[64];
+
+  uint8_t pseudo[40 + 0x2000] = {0};
+  memcpy(pseudo, src.addr, 16);
+  memcpy(&pseudo[16], dst.addr, 16);
+  pseudo[32] = (uint8_t)(length >> 24);
+  pseudo[33] = (uint8_t)(length >> 16);
+  pseudo[34] = (uint8_t)(length >> 8);
+  pseudo[35] = (uint8_t)length;
+  pseudo[39] = ip_proto_udp;
+  memcpy(&pseudo[40], payload, 1001);
+
+  uint32_t sum = checksum_ipv6_pseudo(&src, &dst, ip_proto_udp, length);
+  EXPECT_EQ(checksum_fold(checksum_add(sum, payload, 1001)),
+            reference_checksum(0, pseudo, 40 + 1001));
+}
+
+TEST_F(Checksum, incremental_update) {
+  // Rewriting any word and updating incrementally matches a full recompute
+  const size_t len = 200;
+  uint16_t checksum = checksum_fold(checksum_add(0, data, len));
+  for (size_t i = 0; i < len; i += 2) {
+    const uint16_t old_word = uint8_to_uint16(&data[i]);
+    const uint16_t new_word = (uint16_t)(old_word * 31 + i);
+    data[i] = (uint8_t)(new_word >> 8);
+    data[i + 1] = (uint8_t)new_word;
+    checksum = checksum_update(checksum, old_word, new_word);
+    const uint16_t full = checksum_fold(checksum_add(0, data, len));
+    // 0x0000 and 0xFFFF are both one's complement zero
+    if (full == 0xFFFF || full == 0) {
+      EXPECT_TRUE(checksum == 0xFFFF || checksum == 0) << "word " << i;
+    } else {
+      ASSERT_EQ(checksum, full) << "word " << i;
+    }
+  }
+
+  // Changing a word and changing it back restores the original checksum
+  const uint16_t original = checksum_fold(checksum_add(0, data, len));
+  const uint16_t old_word = uint8_to_uint16(&data[24]);
+  const uint16_t patched = checksum_update(original, old_word, old_word | 3);
+  EXPECT_EQ(checksum_update(patched, old_word | 3, old_word), original);
+}
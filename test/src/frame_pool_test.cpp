@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <helpers.hpp>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+
+extern "C" {
+#include "frame_pool.h"
+}
+
+// The pool is static, so tests compare counters before and after
+class FramePool : public ::testing::Test {
+protected:
+  FramePoolStats before;
+
+  void SetUp() override { frame_pool_get_stats(&before); }
+
+  FramePoolClassStats delta(FramePoolClass cls) {
+    FramePoolStats after;
+    frame_pool_get_stats(&after);
+    FramePoolClassStats d = after.classes[cls];
+    d.in_use -= before.classes[cls].in_use;
+    d.allocs -= before.classes[cls].allocs;
+    d.misses -= before.classes[cls].misses;
+    return d;
+  }
+};
+
+TEST_F(FramePool, size_classes) {
+  FramePoolStats stats;
+  frame_pool_get_stats(&stats);
+  EXPECT_EQ(stats.classes[FramePoolSmall].block_size, frame_pool_small_size);
+  EXPECT_EQ(stats.classes[FramePoolSmall].blocks, frame_pool_small_count);
+  EXPECT_EQ(stats.classes[FramePoolLarge].block_size, frame_pool_large_size);
+
+  void *small = frame_pool_alloc(frame_pool_small_size);
+  void *medium = frame_pool_alloc(frame_pool_small_size + 1);
+  void *large = frame_pool_alloc(frame_pool_large_size);
+  ASSERT_NE(small, nullptr);
+  ASSERT_NE(medium, nullptr);
+  ASSERT_NE(large, nullptr);
+  EXPECT_EQ(delta(FramePoolSmall).in_use, 1U);
+  EXPECT_EQ(delta(FramePoolMedium).in_use, 1U);
+  EXPECT_EQ(delta(FramePoolLarge).in_use, 1U);
+
+  // The whole block is usable
+  memset(small, 0xA5, frame_pool_small_size);
+  memset(large, 0x5A, frame_pool_large_size);
+
+  frame_pool_free(small);
+  frame_pool_free(medium);
+  frame_pool_free(large);
+  EXPECT_EQ(delta(FramePoolSmall).in_use, 0U);
+  EXPECT_EQ(delta(FramePoolMedium).in_use, 0U);
+  EXPECT_EQ(delta(FramePoolLarge).in_use, 0U);
+  EXPECT_EQ(delta(FramePoolSmall).allocs, 1U);
+
+  // Freed blocks are reused first
+  void *again = frame_pool_alloc(16);
+  EXPECT_EQ(again, small);
+  frame_pool_free(again);
+  frame_pool_free(NULL);
+}
+
+TEST_F(FramePool, exhaustion_falls_back_to_heap) {
+  std::vector<void *> blocks;
+  for (uint32_t i = 0; i < frame_pool_medium_count; i++) {
+    void *block = frame_pool_alloc(frame_pool_medium_size);
+    ASSERT_NE(block, nullptr);
+    blocks.push_back(block);
+  }
+  EXPECT_EQ(delta(FramePoolMedium).misses, 0U);
+  FramePoolStats stats;
+  frame_pool_get_stats(&stats);
+  EXPECT_EQ(stats.classes[FramePoolMedium].in_use, frame_pool_medium_count);
+  EXPECT_EQ(stats.classes[FramePoolMedium].high_water,
+            frame_pool_medium_count);
+
+  void *heap = frame_pool_alloc(frame_pool_medium_size);
+  ASSERT_NE(heap, nullptr);
+  memset(heap, 0, frame_pool_medium_size);
+  EXPECT_EQ(delta(FramePoolMedium).misses, 1U);
+  EXPECT_EQ(delta(FramePoolMedium).in_use, frame_pool_medium_count);
+  frame_pool_free(heap);
+  EXPECT_EQ(delta(FramePoolMedium).in_use, frame_pool_medium_count);
+
+  for (void *block : blocks) {
+    frame_pool_free(block);
+  }
+  EXPECT_EQ(delta(FramePoolMedium).in_use, 0U);
+
+  // Requests too large for any class always come from the heap
+  void *oversize = frame_pool_alloc(frame_pool_large_size + 1);
+  ASSERT_NE(oversize, nullptr);
+  frame_pool_free(oversize);
+  frame_pool_get_stats(&stats);
+  EXPECT_EQ(stats.oversize, before.oversize + 1);
+}
+
+TEST_F(FramePool, concurrent_alloc_free) {
+  constexpr int threads = 4;
+  constexpr int iterations = 20000;
+  std::vector<std::thread> workers;
+  std::vector<uint32_t> corrupted(threads, 0);
+
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([t, &corrupted] {
+      void *held[4] = {};
+      for (int i = 0; i < iterations; i++) {
+        const int slot = i % 4;
+        if (held[slot]) {
+          // Nobody else may have written to a block while it was held
+          uint8_t *block = (uint8_t *)held[slot];
+          for (int j = 0; j < 32; j++) {
+            if (block[j] != (uint8_t)t) {
+              corrupted[t]++;
+              break;
+            }
+          }
+          frame_pool_free(held[slot]);
+        }
+        held[slot] = frame_pool_alloc(64);
+        memset(held[slot], t, 32);
+      }
+      for (void *block : held) {
+        frame_pool_free(block);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  for (int t = 0; t < threads; t++) {
+    EXPECT_EQ(corrupted[t], 0U);
+  }
+  EXPECT_EQ(delta(FramePoolSmall).in_use, 0U);
+  EXPECT_EQ(delta(FramePoolSmall).allocs + delta(FramePoolSmall).misses,
+            (uint32_t)(threads * iterations));
+}
@@ -0,0 +1,69 @@
+#include <bench.hpp>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+
+extern "C" {
+#include "l2_capture_filter.h"
+#include "util.h"
+}
+
+// Capture filter cost per frame, for programs of growing length
+
+static constexpr uint32_t iterations = 1000000;
+static constexpr size_t FRAME_LEN = 128;
+
+TEST(L2CaptureFilterBench, per_frame_cost) {
+  uint8_t frame[FRAME_LEN] = {0};
+  frame[12] = 0x86;
+  frame[13] = 0xDD;
+  frame[20] = ip_proto_udp;
+  frame[56] = 4321 >> 8;
+  frame[57] = 4321 & 0xFF;
+
+  const BmL2CaptureInsn accept_all[] = {{L2CaptureOpRet, 0, 0, 0, 1}};
+  const BmL2CaptureInsn udp_port[] = {
+      {L2CaptureOpJeq, L2CaptureFieldUdpDstPort, 0, 1, 4321},
+      {L2CaptureOpRet, 0, 0, 0, 1},
+      {L2CaptureOpRet, 0, 0, 0, 0},
+  };
+  const BmL2CaptureInsn udp_port_on_port[] = {
+      {L2CaptureOpJeq, L2CaptureFieldEthertype, 0, 5, ethernet_type_ipv6},
+      {L2CaptureOpJeq, L2CaptureFieldNextHeader, 0, 4, ip_proto_udp},
+      {L2CaptureOpJeq, L2CaptureFieldUdpDstPort, 0, 3, 4321},
+      {L2CaptureOpJeq, L2CaptureFieldPort, 0, 2, 2},
+      {L2CaptureOpJeq, L2CaptureFieldEgress, 0, 1, 0},
+      {L2CaptureOpRet, 0, 0, 0, 1},
+      {L2CaptureOpRet, 0, 0, 0, 0},
+  };
+  const struct {
+    const char *name;
+    const BmL2CaptureInsn *prog;
+    size_t len;
+    uint32_t expected_accepted;
+  } cases[] = {
+      {"accept all", accept_all, array_size(accept_all), iterations},
+      {"udp dst port", udp_port, array_size(udp_port), iterations},
+      {"udp dst port on rx port 2", udp_port_on_port,
+       array_size(udp_port_on_port), iterations / 2},
+  };
+
+  for (const auto &c : cases) {
+    ASSERT_EQ(bm_l2_capture_filter_validate(c.prog, c.len), BmOK);
+    // Alternate the ingress port between frames
+    uint32_t accepted = 0;
+    uint32_t frames = 0;
+    const double ns = ns_per_call(
+        [&] {
+          accepted += bm_l2_capture_filter_run(c.prog, c.len, frame, FRAME_LEN,
+                                               (uint8_t)(1 + (frames++ & 1)),
+                                               false);
+        },
+        iterations);
+    EXPECT_EQ(accepted, c.expected_accepted);
+    bench_report("%-28s %2zu insns %8.1f ns/frame", c.name, c.len, ns);
+  }
+}
@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include <helpers.hpp>
+#include <stdint.h>
+#include <string.h>
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+
+extern "C" {
+#include "l2_capture_filter.h"
+#include "util.h"
+}
+
+// Ethernet + IPv6 header layout, see network_frames.h
+static constexpr size_t ETH_TYPE_OFFSET = 12;
+static constexpr size_t IPV6_NEXT_HEADER_OFFSET = 20;
+static constexpr size_t IPV6_PAYLOAD_OFFSET = 54;
+static constexpr size_t FRAME_LEN = IPV6_PAYLOAD_OFFSET + 16;
+
+static void make_frame(uint8_t *frame, uint8_t next_header) {
+  memset(frame, 0, FRAME_LEN);
+  frame[ETH_TYPE_OFFSET] = 0x86;
+  frame[ETH_TYPE_OFFSET + 1] = 0xDD;
+  frame[IPV6_NEXT_HEADER_OFFSET] = next_header;
+}
+
+static void make_udp_frame(uint8_t *frame, uint16_t dst_port) {
+  make_frame(frame, ip_proto_udp);
+  frame[IPV6_PAYLOAD_OFFSET + 2] = dst_port >> 8;
+  frame[IPV6_PAYLOAD_OFFSET + 3] = dst_port & 0xFF;
+}
+
+static void make_bcmp_frame(uint8_t *frame, uint16_t type) {
+  make_frame(frame, ip_proto_bcmp);
+  frame[IPV6_PAYLOAD_OFFSET] = type & 0xFF;
+  frame[IPV6_PAYLOAD_OFFSET + 1] = type >> 8;
+}
+
+TEST(L2CaptureFilter, validate) {
+  const BmL2CaptureInsn accept[] = {{L2CaptureOpRet, 0, 0, 0, 1}};
+  EXPECT_EQ(bm_l2_capture_filter_validate(accept, 1), BmOK);
+  EXPECT_EQ(bm_l2_capture_filter_validate(NULL, 1), BmEINVAL);
+  EXPECT_EQ(bm_l2_capture_filter_validate(accept, 0), BmEINVAL);
+  EXPECT_EQ(bm_l2_capture_filter_validate(accept,
+                                          bm_l2_capture_filter_max_len + 1),
+            BmEINVAL);
+
+  // Falls off the end
+  const BmL2CaptureInsn no_ret[] = {
+      {L2CaptureOpJeq, L2CaptureFieldPort, 0, 0, 1}};
+  EXPECT_EQ(bm_l2_capture_filter_validate(no_ret, 1), BmEINVAL);
+
+  // Jumps past the end
+  const BmL2CaptureInsn bad_jump[] = {
+      {L2CaptureOpJeq, L2CaptureFieldPort, 0, 1, 1},
+      {L2CaptureOpRet, 0, 0, 0, 1}};
+  EXPECT_EQ(bm_l2_capture_filter_validate(bad_jump, 2), BmEINVAL);
+
+  const BmL2CaptureInsn bad_op[] = {{L2CaptureOpCount, 0, 0, 0, 1}};
+  EXPECT_EQ(bm_l2_capture_filter_validate(bad_op, 1), BmEINVAL);
+
+  const BmL2CaptureInsn bad_field[] = {
+      {L2CaptureOpJeq, L2CaptureFieldCount, 0, 0, 1},
+      {L2CaptureOpRet, 0, 0, 0, 1}};
+  EXPECT_EQ(bm_l2_capture_filter_validate(bad_field, 2), BmEINVAL);
+}
+
+TEST(L2CaptureFilter, udp_port_on_ingress_port) {
+  const BmL2CaptureInsn prog[] = {
+      {L2CaptureOpJeq, L2CaptureFieldUdpDstPort, 0, 3, 4321},
+      {L2CaptureOpJeq, L2CaptureFieldPort, 0, 2, 2},
+      {L2CaptureOpJeq, L2CaptureFieldEgress, 0, 1, 0},
+      {L2CaptureOpRet, 0, 0, 0, 1},
+      {L2CaptureOpRet, 0, 0, 0, 0},
+  };
+  const size_t len = array_size(prog);
+  ASSERT_EQ(bm_l2_capture_filter_validate(prog, len), BmOK);
+
+  uint8_t frame[FRAME_LEN];
+  make_udp_frame(frame, 4321);
+  EXPECT_TRUE(
+      bm_l2_capture_filter_run(prog, len, frame, sizeof(frame), 2, false));
+  EXPECT_FALSE(
+      bm_l2_capture_filter_run(prog, len, frame, sizeof(frame), 1, false));
+  EXPECT_FALSE(
+      bm_l2_capture_filter_run(prog, len, frame, sizeof(frame), 2, true));
+
+  make_udp_frame(frame, 4322);
+  EXPECT_FALSE(
+      bm_l2_capture_filter_run(prog, len, frame, sizeof(frame), 2, false));
+
+  // Same bytes in a BCMP frame are not a UDP port
+  make_frame(frame, ip_proto_bcmp);
+  frame[IPV6_PAYLOAD_OFFSET + 2] = 4321 >> 8;
+  frame[IPV6_PAYLOAD_OFFSET + 3] = 4321 & 0xFF;
+  EXPECT_FALSE(
+      bm_l2_capture_filter_run(prog, len, frame, sizeof(frame), 2, false));
+
+  // Truncated frame
+  make_udp_frame(frame, 4321);
+  EXPECT_FALSE(bm_l2_capture_filter_run(prog, len, frame,
+                                        IPV6_PAYLOAD_OFFSET + 3, 2, false));
+}
+
+TEST(L2CaptureFilter, fields_and_ops) {
+  uint8_t frame[FRAME_LEN];
+  make_bcmp_frame(frame, 0x0102);
+
+  // BCMP type range
+  const BmL2CaptureInsn range[] = {
+      {L2CaptureOpJge, L2CaptureFieldBcmpType, 0, 2, 0x0100},
+      {L2CaptureOpJgt, L2CaptureFieldBcmpType, 1, 0, 0x01FF},
+      {L2CaptureOpRet, 0, 0, 0, 1},
+      {L2CaptureOpRet, 0, 0, 0, 0},
+  };
+  ASSERT_EQ(bm_l2_capture_filter_validate(range, array_size(range)), BmOK);
+  EXPECT_TRUE(bm_l2_capture_filter_run(range, array_size(range), frame,
+                                       sizeof(frame), 1, false));
+  make_bcmp_frame(frame, 0x0200);
+  EXPECT_FALSE(bm_l2_capture_filter_run(range, array_size(range), frame,
+                                        sizeof(frame), 1, false));
+
+  // Next header and ethertype
+  const BmL2CaptureInsn icmp[] = {
+      {L2CaptureOpJeq, L2CaptureFieldEthertype, 0, 2, ethernet_type_ipv6},
+      {L2CaptureOpJeq, L2CaptureFieldNextHeader, 0, 1, 58},
+      {L2CaptureOpRet, 0, 0, 0, 1},
+      {L2CaptureOpRet, 0, 0, 0, 0},
+  };
+  ASSERT_EQ(bm_l2_capture_filter_validate(icmp, array_size(icmp)), BmOK);
+  make_frame(frame, 58);
+  EXPECT_TRUE(bm_l2_capture_filter_run(icmp, array_size(icmp), frame,
+                                       sizeof(frame), 1, false));
+  frame[ETH_TYPE_OFFSET + 1] = 0x00;
+  EXPECT_FALSE(bm_l2_capture_filter_run(icmp, array_size(icmp), frame,
+                                        sizeof(frame), 1, false));
+
+  // Port set
+  const BmL2CaptureInsn ports[] = {
+      {L2CaptureOpJset, L2CaptureFieldPort, 0, 1, 0x6},
+      {L2CaptureOpRet, 0, 0, 0, 1},
+      {L2CaptureOpRet, 0, 0, 0, 0},
+  };
+  ASSERT_EQ(bm_l2_capture_filter_validate(ports, array_size(ports)), BmOK);
+  EXPECT_TRUE(bm_l2_capture_filter_run(ports, array_size(ports), frame,
+                                       sizeof(frame), 2, false));
+  EXPECT_FALSE(bm_l2_capture_filter_run(ports, array_size(ports), frame,
+                                        sizeof(frame), 1, false));
+  EXPECT_FALSE(bm_l2_capture_filter_run(ports, array_size(ports), NULL,
+                                        sizeof(frame), 2, false));
+}
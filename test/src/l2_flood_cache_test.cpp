@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <helpers.hpp>
+#include <stdint.h>
+#include <string.h>
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+
+extern "C" {
+#include "l2_flood_cache.h"
+#include "util.h"
+}
+
+// Ethernet + IPv6 header layout, see network_frames.h
+static constexpr size_t ETH_TYPE_OFFSET = 12;
+static constexpr size_t IPV6_PAYLOAD_LEN_OFFSET = 18;
+static constexpr size_t IPV6_SRC_OFFSET = 22;
+static constexpr size_t IPV6_DST_OFFSET = IPV6_SRC_OFFSET + 16;
+static constexpr size_t PORTS_BYTE_OFFSET = IPV6_SRC_OFFSET + 2;
+static constexpr size_t PAYLOAD_OFFSET = IPV6_DST_OFFSET + 16;
+static constexpr size_t FRAME_LEN = PAYLOAD_OFFSET + 16;
+
+class L2FloodCache : public ::testing::Test {
+protected:
+  BmL2FloodCache cache;
+  uint8_t frame[FRAME_LEN];
+
+  void SetUp() override {
+    bm_l2_flood_cache_init(&cache);
+    memset(frame, 0, sizeof(frame));
+    frame[ETH_TYPE_OFFSET] = 0x86;
+    frame[ETH_TYPE_OFFSET + 1] = 0xDD;
+    frame[IPV6_PAYLOAD_LEN_OFFSET + 1] = 16;
+    frame[IPV6_SRC_OFFSET] = 0xFE;
+    frame[IPV6_SRC_OFFSET + 1] = 0x80;
+    frame[IPV6_SRC_OFFSET + 15] = 0x01;
+    frame[IPV6_DST_OFFSET] = 0xFF;
+    frame[IPV6_DST_OFFSET + 1] = 0x03;
+    frame[IPV6_DST_OFFSET + 15] = 0x01;
+    for (size_t i = PAYLOAD_OFFSET; i < FRAME_LEN; i++) {
+      frame[i] = (uint8_t)i;
+    }
+  }
+};
+
+TEST_F(L2FloodCache, duplicate_within_window) {
+  EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, 1000));
+  EXPECT_TRUE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 2, 1010));
+  EXPECT_EQ(cache.hits, 1U);
+  EXPECT_EQ(cache.misses, 1U);
+
+  // The ports byte is rewritten on each hop and is not part of the key
+  frame[PORTS_BYTE_OFFSET] = 0x21;
+  EXPECT_TRUE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 2, 1020));
+  EXPECT_EQ(cache.hits, 2U);
+}
+
+TEST_F(L2FloodCache, same_port_is_not_a_loop) {
+  // Only a copy coming back in on another port is a duplicate
+  EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, 1000));
+  EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, 1010));
+  EXPECT_EQ(cache.hits, 0U);
+  EXPECT_EQ(cache.misses, 2U);
+
+  // The first copy's port is kept, the loop is still caught
+  EXPECT_TRUE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 2, 1020));
+  EXPECT_TRUE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 3, 1030));
+  EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, 1040));
+  EXPECT_EQ(cache.hits, 2U);
+}
+
+TEST_F(L2FloodCache, expires_after_window) {
+  EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, 1000));
+  EXPECT_FALSE(bm_l2_flood_cache_seen(
+      &cache, frame, sizeof(frame), 1, 1000 + bm_l2_flood_cache_window_ms));
+  EXPECT_TRUE(bm_l2_flood_cache_seen(
+      &cache, frame, sizeof(frame), 2, 1001 + bm_l2_flood_cache_window_ms));
+
+  // Tick counter wraparound
+  bm_l2_flood_cache_init(&cache);
+  EXPECT_FALSE(
+      bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, UINT32_MAX - 5));
+  EXPECT_TRUE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 2, 5));
+}
+
+TEST_F(L2FloodCache, distinct_frames) {
+  EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, 0));
+
+  // Different checksum/sequence number
+  frame[PAYLOAD_OFFSET + 6] ^= 0xFF;
+  EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, 0));
+
+  // Different source
+  frame[IPV6_SRC_OFFSET + 15] = 0x02;
+  EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, 0));
+  EXPECT_EQ(cache.hits, 0U);
+  EXPECT_EQ(cache.misses, 3U);
+
+  // Non IPv6 and short frames are never tracked
+  frame[ETH_TYPE_OFFSET + 1] = 0x00;
+  EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, 0));
+  EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, 0));
+  EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, PAYLOAD_OFFSET - 1, 1, 0));
+  EXPECT_FALSE(bm_l2_flood_cache_seen(NULL, frame, sizeof(frame), 1, 0));
+  EXPECT_EQ(cache.misses, 3U);
+}
+
+TEST_F(L2FloodCache, evicts_oldest) {
+  // Fill well past capacity, the most recent frames must still be found
+  const uint32_t capacity = bm_l2_flood_cache_sets * bm_l2_flood_cache_ways;
+  for (uint32_t i = 0; i < capacity * 4; i++) {
+    memcpy(&frame[PAYLOAD_OFFSET], &i, sizeof(i));
+    EXPECT_FALSE(bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 1, i));
+  }
+  uint32_t last = capacity * 4 - 1;
+  memcpy(&frame[PAYLOAD_OFFSET], &last, sizeof(last));
+  EXPECT_TRUE(
+      bm_l2_flood_cache_seen(&cache, frame, sizeof(frame), 2, capacity * 4));
+}
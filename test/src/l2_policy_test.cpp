@@ -8,6 +8,7 @@ DEFINE_FFF_GLOBALS;
 
 extern "C" {
 #include "l2_policy.h"
+#include "messages.h"
 #include "util.h"
 }
 
@@ -342,4 +343,83 @@ TEST_F(
 
   // Ingress nibble reflects ingress port
   EXPECT_EQ(ingress_nibble(frame), 3);
-}
\ No newline at end of file
+}
+static constexpr size_t NEXT_HEADER_OFFSET = IPV6_HEADER_OFFSET + 6;
+static constexpr size_t UDP_DST_PORT_OFFSET = MIN_FRAME_LEN + 2;
+static constexpr size_t UDP_FRAME_LEN = MIN_FRAME_LEN + 8;
+
+TEST_F(L2Policy, tx_class_bcmp_and_icmpv6_are_control) {
+  uint8_t frame[MIN_FRAME_LEN] = {0};
+  write_ethertype_ipv6(frame);
+
+  frame[NEXT_HEADER_OFFSET] = ip_proto_bcmp;
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, sizeof(frame), NULL, 0),
+            L2TxClassControl);
+
+  frame[NEXT_HEADER_OFFSET] = 58;
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, sizeof(frame), NULL, 0),
+            L2TxClassControl);
+}
+
+TEST_F(L2Policy, tx_class_bcmp_bulk_messages) {
+  uint8_t frame[MIN_FRAME_LEN + sizeof(BcmpHeader)] = {0};
+  BcmpHeader *header = (BcmpHeader *)&frame[MIN_FRAME_LEN];
+  write_ethertype_ipv6(frame);
+  frame[NEXT_HEADER_OFFSET] = ip_proto_bcmp;
+
+  // Heartbeats and neighbor traffic stay ahead of DFU transfers
+  header->type = BcmpHeartbeatMessage;
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, sizeof(frame), NULL, 0),
+            L2TxClassControl);
+  header->type = BcmpNeighborTableReplyMessage;
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, sizeof(frame), NULL, 0),
+            L2TxClassControl);
+
+  header->type = BcmpDFUPayloadMessage;
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, sizeof(frame), NULL, 0),
+            L2TxClassBulk);
+  header->type = BcmpDFUBootCompleteMessage;
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, sizeof(frame), NULL, 0),
+            L2TxClassBulk);
+
+  // Any message large enough to be fragmented
+  header->type = BcmpConfigValueMessage;
+  header->frag_total = 2;
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, sizeof(frame), NULL, 0),
+            L2TxClassBulk);
+}
+
+TEST_F(L2Policy, tx_class_udp_realtime_port_match) {
+  uint8_t frame[UDP_FRAME_LEN] = {0};
+  write_ethertype_ipv6(frame);
+  frame[NEXT_HEADER_OFFSET] = ip_proto_udp;
+  frame[UDP_DST_PORT_OFFSET] = 0x10;
+  frame[UDP_DST_PORT_OFFSET + 1] = 0xE1; // 4321
+
+  const uint16_t realtime_ports[] = {1234, 4321};
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, sizeof(frame), realtime_ports, 2),
+            L2TxClassRealtime);
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, sizeof(frame), realtime_ports, 1),
+            L2TxClassBulk);
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, sizeof(frame), NULL, 0),
+            L2TxClassBulk);
+
+  // Too short to hold the UDP destination port
+  EXPECT_EQ(
+      bm_l2_policy_tx_class(frame, MIN_FRAME_LEN + 3, realtime_ports, 2),
+      L2TxClassBulk);
+}
+
+TEST_F(L2Policy, tx_class_non_ipv6_or_short_is_bulk) {
+  uint8_t frame[MIN_FRAME_LEN] = {0};
+  frame[NEXT_HEADER_OFFSET] = ip_proto_bcmp;
+
+  // Not IPv6
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, sizeof(frame), NULL, 0),
+            L2TxClassBulk);
+
+  write_ethertype_ipv6(frame);
+  EXPECT_EQ(bm_l2_policy_tx_class(frame, MIN_FRAME_LEN - 1, NULL, 0),
+            L2TxClassBulk);
+  EXPECT_EQ(bm_l2_policy_tx_class(NULL, 0, NULL, 0), L2TxClassBulk);
+}
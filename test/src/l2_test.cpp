@@ -12,6 +12,7 @@ extern "C" {
 #include "mock_bm_adin2111.h"
 #include "mock_bm_ip.h"
 #include "mock_bm_os.h"
+#include "network_frames.h"
 }
 
 #define port_per_device 2
@@ -59,6 +60,11 @@ protected:
   NetworkDevice network_device;
 
   void SetUp() override {
+    RESET_FAKE(bm_l2_new);
+    RESET_FAKE(bm_l2_new_ref);
+    RESET_FAKE(bm_l2_free);
+    RESET_FAKE(bm_l2_get_payload);
+    RESET_FAKE(bm_queue_send);
     netdevice_enable_fake.return_val = BmOK;
     netdevice_disable_fake.return_val = BmOK;
     network_device = adin2111_network_device();
@@ -198,3 +204,330 @@ TEST_F(L2, register_link_local_routing_callback) {
   EXPECT_EQ(bm_l2_register_link_local_routing_callback(NULL), BmEINVAL);
   EXPECT_EQ(bm_l2_register_link_local_routing_callback(cb), BmOK);
 }
+
+static uint8_t loan_release_count;
+static void loan_release(NetworkDeviceRxLoan *loan) {
+  (void)loan;
+  loan_release_count++;
+}
+
+/*!
+ @brief Exercise the zero-copy receive loan handoff
+ */
+TEST_F(L2, receive_loan) {
+  uint8_t frame[64];
+  RND.rnd_array(frame, sizeof(frame));
+  NetworkDeviceRxLoan loan = {frame, sizeof(frame), loan_release};
+  void *wrapped = (void *)RND.rnd_int(UINT32_MAX, UINT16_MAX);
+  loan_release_count = 0;
+
+  ASSERT_NE(network_device.callbacks->receive_loan, nullptr);
+
+  // Invalid loans are rejected so the driver falls back to copying
+  EXPECT_EQ(network_device.callbacks->receive_loan(1, NULL), BmEINVAL);
+  NetworkDeviceRxLoan no_release = {frame, sizeof(frame), NULL};
+  EXPECT_EQ(network_device.callbacks->receive_loan(1, &no_release), BmEINVAL);
+
+  // Unable to wrap the buffer, driver keeps ownership
+  bm_l2_new_ref_fake.return_val = NULL;
+  EXPECT_EQ(network_device.callbacks->receive_loan(1, &loan), BmENOMEM);
+  RESET_FAKE(bm_l2_new_ref);
+
+  // Successful handoff, frame is wrapped in place and queued
+  bm_l2_new_ref_fake.return_val = wrapped;
+  bm_queue_send_fake.return_val = BmOK;
+  EXPECT_EQ(network_device.callbacks->receive_loan(2, &loan), BmOK);
+  EXPECT_EQ(bm_l2_new_ref_fake.arg0_val, frame);
+  EXPECT_EQ(bm_l2_new_ref_fake.arg1_val, sizeof(frame));
+  EXPECT_EQ(bm_queue_send_fake.call_count, 1);
+  EXPECT_EQ(bm_l2_free_fake.call_count, 0);
+
+  // The release hook handed to the IP stack returns the loan to the driver
+  bm_l2_new_ref_fake.arg2_val(bm_l2_new_ref_fake.arg3_val);
+  EXPECT_EQ(loan_release_count, 1);
+  RESET_FAKE(bm_queue_send);
+
+  // Queue full, the wrapper is freed which releases the loan
+  bm_queue_send_fake.return_val = BmENOMEM;
+  EXPECT_EQ(network_device.callbacks->receive_loan(2, &loan), BmOK);
+  EXPECT_EQ(bm_l2_free_fake.call_count, 1);
+  EXPECT_EQ(bm_l2_free_fake.arg0_val, wrapped);
+  RESET_FAKE(bm_queue_send);
+  RESET_FAKE(bm_l2_new_ref);
+  RESET_FAKE(bm_l2_free);
+}
+
+/*!
+ @brief Realtime UDP port registration and egress queue statistics
+ */
+TEST_F(L2, tx_queues) {
+  BmL2TxQueueStats stats = {UINT32_MAX, UINT32_MAX};
+
+  // Queues start empty for every port including the all ports queue
+  for (uint8_t port = 0; port <= port_per_device; port++) {
+    for (int tx_class = 0; tx_class < L2TxClassCount; tx_class++) {
+      EXPECT_EQ(
+          bm_l2_get_tx_queue_stats(port, (BmL2TxClass)tx_class, &stats),
+          BmOK);
+      EXPECT_EQ(stats.depth, 0);
+      EXPECT_EQ(stats.drops, 0);
+    }
+  }
+
+  // Invalid arguments
+  EXPECT_EQ(bm_l2_get_tx_queue_stats(port_per_device + 1, L2TxClassBulk,
+                                     &stats),
+            BmEINVAL);
+  EXPECT_EQ(bm_l2_get_tx_queue_stats(1, L2TxClassCount, &stats), BmEINVAL);
+  EXPECT_EQ(bm_l2_get_tx_queue_stats(1, L2TxClassBulk, NULL), BmEINVAL);
+
+  // Realtime ports are bounded, duplicates are accepted without using a slot
+  for (uint16_t i = 0; i < bm_l2_realtime_udp_ports_max; i++) {
+    EXPECT_EQ(bm_l2_register_realtime_udp_port(4000 + i), BmOK);
+  }
+  EXPECT_EQ(bm_l2_register_realtime_udp_port(4000), BmOK);
+  EXPECT_EQ(bm_l2_register_realtime_udp_port(5000), BmENOMEM);
+}
+
+/*!
+ @brief Bulk frames wait in their own queue instead of ahead of control frames
+ */
+TEST_F(L2, tx_class_queues) {
+  void *queues[] = {(void *)0x1000, (void *)0x2000};
+  void *const evt_queue = queues[0];
+  void *const bulk_queue = queues[1];
+  uint8_t frame[96] = {0};
+  BmL2Counters counters;
+
+  bm_l2_deinit();
+  SET_RETURN_SEQ(bm_queue_create, queues, 2);
+  ASSERT_EQ(bm_l2_init(network_device), BmOK);
+
+  frame[12] = 0x86;
+  frame[13] = 0xDD;
+  bm_l2_get_payload_fake.return_val = frame;
+  RESET_FAKE(bm_queue_send);
+  bm_queue_send_fake.return_val = BmOK;
+
+  // BCMP is control traffic, queued as an event like received frames
+  frame[ipv6_next_header_offset] = ip_proto_bcmp;
+  EXPECT_EQ(bm_l2_link_output(frame, sizeof(frame)), BmOK);
+  ASSERT_EQ(bm_queue_send_fake.call_count, 1);
+  EXPECT_EQ(bm_queue_send_fake.arg0_history[0], evt_queue);
+
+  // Bulk traffic goes to the bulk queue and rings the L2 thread once
+  frame[ipv6_next_header_offset] = ip_proto_udp;
+  EXPECT_EQ(bm_l2_link_output(frame, sizeof(frame)), BmOK);
+  EXPECT_EQ(bm_l2_link_output(frame, sizeof(frame)), BmOK);
+  ASSERT_EQ(bm_queue_send_fake.call_count, 4);
+  EXPECT_EQ(bm_queue_send_fake.arg0_history[1], bulk_queue);
+  EXPECT_EQ(bm_queue_send_fake.arg0_history[2], evt_queue);
+  EXPECT_EQ(bm_queue_send_fake.arg0_history[3], bulk_queue);
+  // Bulk senders wait for room like every other sender
+  EXPECT_EQ(bm_queue_send_fake.arg2_history[3], 10U);
+
+  // A full bulk queue drops the frame once the wait runs out
+  bm_queue_send_fake.return_val = BmENOMEM;
+  EXPECT_EQ(bm_l2_link_output(frame, sizeof(frame)), BmENOMEM);
+  ASSERT_EQ(bm_l2_get_counters(&counters), BmOK);
+  EXPECT_EQ(counters.drop_tx_queue_full, 1);
+
+  RESET_FAKE(bm_queue_create);
+  RESET_FAKE(bm_queue_send);
+  RESET_FAKE(bm_l2_get_payload);
+  bm_queue_create_fake.return_val = queues[0];
+}
+
+/*!
+ @brief Datapath counters track received frames and drops by reason
+ */
+TEST_F(L2, counters) {
+  uint8_t frame[64];
+  uint8_t rx_buf[64];
+  BmL2PortCounters port_counters;
+  BmL2Counters counters;
+  RND.rnd_array(frame, sizeof(frame));
+
+  EXPECT_EQ(bm_l2_get_port_counters(0, &port_counters), BmEINVAL);
+  EXPECT_EQ(bm_l2_get_port_counters(port_per_device + 1, &port_counters),
+            BmEINVAL);
+  EXPECT_EQ(bm_l2_get_port_counters(1, NULL), BmEINVAL);
+  EXPECT_EQ(bm_l2_get_counters(NULL), BmEINVAL);
+
+  // Received and queued
+  bm_l2_new_fake.return_val = rx_buf;
+  bm_l2_get_payload_fake.return_val = rx_buf;
+  bm_queue_send_fake.return_val = BmOK;
+  network_device.callbacks->receive(1, frame, sizeof(frame));
+
+  // Received, event queue full
+  bm_queue_send_fake.return_val = BmENOMEM;
+  network_device.callbacks->receive(1, frame, sizeof(frame));
+
+  // Received, no memory to copy the frame into
+  bm_l2_new_fake.return_val = NULL;
+  network_device.callbacks->receive(1, frame, sizeof(frame));
+
+  ASSERT_EQ(bm_l2_get_port_counters(1, &port_counters), BmOK);
+  EXPECT_EQ(port_counters.rx_frames, 3);
+  EXPECT_EQ(port_counters.rx_bytes, 3 * sizeof(frame));
+  EXPECT_EQ(port_counters.drop_rx_queue_full, 1);
+  EXPECT_EQ(port_counters.drop_rx_no_mem, 1);
+
+  // Nothing was attributed to the other port
+  ASSERT_EQ(bm_l2_get_port_counters(2, &port_counters), BmOK);
+  EXPECT_EQ(port_counters.rx_frames, 0);
+
+  // TX event queue full
+  bm_queue_send_fake.return_val = BmENOMEM;
+  EXPECT_NE(bm_l2_link_output(rx_buf, sizeof(rx_buf)), BmOK);
+  ASSERT_EQ(bm_l2_get_counters(&counters), BmOK);
+  EXPECT_EQ(counters.drop_tx_queue_full, 1);
+  EXPECT_EQ(counters.evt_queue_high_water, 1);
+
+  RESET_FAKE(bm_l2_new);
+  RESET_FAKE(bm_l2_get_payload);
+  RESET_FAKE(bm_queue_send);
+}
+
+static uint32_t pcap_count;
+static void pcap_cb(const uint8_t *frame, size_t len, uint8_t port_num,
+                    bool egress) {
+  (void)frame;
+  (void)len;
+  (void)port_num;
+  (void)egress;
+  pcap_count++;
+}
+
+static BmErr pcap_update_errs[2];
+static void pcap_update_cb(const uint8_t *frame, size_t len, uint8_t port_num,
+                           bool egress) {
+  (void)frame;
+  (void)len;
+  (void)port_num;
+  (void)egress;
+  const BmL2CaptureInsn accept_all[] = {{L2CaptureOpRet, 0, 0, 0, 1}};
+  pcap_update_errs[0] = bm_l2_set_capture_filter(accept_all, 1);
+  pcap_update_errs[1] = bm_l2_set_capture_filter(accept_all, 1);
+}
+
+/*!
+ @brief Only frames accepted by the capture filter reach the pcap callback
+ */
+TEST_F(L2, capture_filter) {
+  uint8_t frame[64] = {0};
+  uint8_t rx_buf[64];
+  bm_l2_new_fake.return_val = rx_buf;
+  bm_l2_get_payload_fake.return_val = rx_buf;
+  bm_queue_send_fake.return_val = BmOK;
+  pcap_count = 0;
+  EXPECT_EQ(bm_l2_register_pcap_callback(pcap_cb), BmOK);
+
+  // Capture port 2 only
+  const BmL2CaptureInsn prog[] = {
+      {L2CaptureOpJeq, L2CaptureFieldPort, 0, 1, 2},
+      {L2CaptureOpRet, 0, 0, 0, 1},
+      {L2CaptureOpRet, 0, 0, 0, 0},
+  };
+  const BmL2CaptureInsn invalid[] = {
+      {L2CaptureOpJeq, L2CaptureFieldPort, 0, 0, 2}};
+  EXPECT_EQ(bm_l2_set_capture_filter(invalid, 1), BmEINVAL);
+  EXPECT_EQ(bm_l2_set_capture_filter(prog, 3), BmOK);
+  network_device.callbacks->receive(1, frame, sizeof(frame));
+  EXPECT_EQ(pcap_count, 0);
+  network_device.callbacks->receive(2, frame, sizeof(frame));
+  EXPECT_EQ(pcap_count, 1);
+
+  // Replacing the program, then removing it
+  const BmL2CaptureInsn reject_all[] = {{L2CaptureOpRet, 0, 0, 0, 0}};
+  EXPECT_EQ(bm_l2_set_capture_filter(reject_all, 1), BmOK);
+  network_device.callbacks->receive(2, frame, sizeof(frame));
+  EXPECT_EQ(pcap_count, 1);
+  EXPECT_EQ(bm_l2_set_capture_filter(NULL, 0), BmOK);
+  network_device.callbacks->receive(1, frame, sizeof(frame));
+  EXPECT_EQ(pcap_count, 2);
+
+  // A capture still running a program holds its slot, so only one update
+  // can be made until it is done
+  EXPECT_EQ(bm_l2_set_capture_filter(prog, 3), BmOK);
+  EXPECT_EQ(bm_l2_register_pcap_callback(pcap_update_cb), BmOK);
+  pcap_update_errs[0] = pcap_update_errs[1] = BmENODEV;
+  network_device.callbacks->receive(2, frame, sizeof(frame));
+  EXPECT_EQ(pcap_update_errs[0], BmOK);
+  EXPECT_EQ(pcap_update_errs[1], BmEAGAIN);
+  EXPECT_EQ(bm_l2_set_capture_filter(prog, 3), BmOK);
+  EXPECT_EQ(bm_l2_register_pcap_callback(pcap_cb), BmOK);
+  EXPECT_EQ(bm_l2_set_capture_filter(NULL, 0), BmOK);
+
+  RESET_FAKE(bm_l2_new);
+  RESET_FAKE(bm_l2_get_payload);
+  RESET_FAKE(bm_queue_send);
+}
+
+/*!
+ @brief Global multicast frames looping back are dropped on ingress
+ */
+TEST_F(L2, flood_duplicate) {
+  uint8_t frame[96];
+  uint8_t rx_buf[96];
+  BmL2PortCounters port_counters;
+  BmL2Counters counters;
+  const BmIpAddr global_multicast = {{0xFF, 0x03, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                      0, 0, 0, 0, 1}};
+  RND.rnd_array(frame, sizeof(frame));
+  frame[12] = 0x86;
+  frame[13] = 0xDD;
+  memcpy(&frame[38], &global_multicast, sizeof(global_multicast));
+
+  bm_l2_new_fake.return_val = rx_buf;
+  bm_l2_get_payload_fake.return_val = rx_buf;
+  bm_queue_send_fake.return_val = BmOK;
+
+  // First copy is queued, the same frame looping back in on the other port
+  // is dropped before it is copied
+  network_device.callbacks->receive(1, frame, sizeof(frame));
+  network_device.callbacks->receive(2, frame, sizeof(frame));
+  EXPECT_EQ(bm_l2_new_fake.call_count, 1);
+  EXPECT_EQ(bm_queue_send_fake.call_count, 1);
+
+  ASSERT_EQ(bm_l2_get_port_counters(2, &port_counters), BmOK);
+  EXPECT_EQ(port_counters.rx_frames, 1);
+  EXPECT_EQ(port_counters.drop_flood_duplicate, 1);
+  ASSERT_EQ(bm_l2_get_counters(&counters), BmOK);
+  EXPECT_EQ(counters.flood_cache_hits, 1);
+  EXPECT_EQ(counters.flood_cache_misses, 1);
+
+  // Loaned duplicates are dropped, freeing the wrapper releases the loan
+  NetworkDeviceRxLoan loan = {frame, sizeof(frame), loan_release};
+  void *wrapped = (void *)RND.rnd_int(UINT32_MAX, UINT16_MAX);
+  bm_l2_new_ref_fake.return_val = wrapped;
+  EXPECT_EQ(network_device.callbacks->receive_loan(2, &loan), BmOK);
+  EXPECT_EQ(bm_l2_free_fake.call_count, 1);
+  EXPECT_EQ(bm_l2_free_fake.arg0_val, wrapped);
+  EXPECT_EQ(bm_queue_send_fake.call_count, 1);
+
+  // A loan that can't be wrapped is not looked up, so the copy the driver
+  // falls back to is judged on its own
+  uint8_t other[96];
+  memcpy(other, frame, sizeof(other));
+  other[60] ^= 0xFF;
+  NetworkDeviceRxLoan unwrapped = {other, sizeof(other), loan_release};
+  bm_l2_new_ref_fake.return_val = NULL;
+  ASSERT_EQ(bm_l2_get_counters(&counters), BmOK);
+  const uint32_t misses = counters.flood_cache_misses;
+  EXPECT_EQ(network_device.callbacks->receive_loan(2, &unwrapped), BmENOMEM);
+  ASSERT_EQ(bm_l2_get_counters(&counters), BmOK);
+  EXPECT_EQ(counters.flood_cache_misses, misses);
+  RESET_FAKE(bm_l2_new_ref);
+  RESET_FAKE(bm_l2_free);
+
+  // The same frame again on the port of the first copy is not a loop
+  network_device.callbacks->receive(1, frame, sizeof(frame));
+  EXPECT_EQ(bm_l2_new_fake.call_count, 2);
+  EXPECT_EQ(bm_queue_send_fake.call_count, 2);
+
+  RESET_FAKE(bm_l2_new);
+  RESET_FAKE(bm_l2_get_payload);
+  RESET_FAKE(bm_queue_send);
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <helpers.hpp>
+#include <string.h>
+
+#include "fff.h"
+
+DEFINE_FFF_GLOBALS;
+
+extern "C" {
+#include "mock_bm_ip.h"
+#include "mock_bm_os.h"
+#include "mock_l2.h"
+#include "middleware.h"
+}
+
+static uint32_t ROUTING_CB_CALLS;
+
+static bool routing_cb(uint8_t ingress_port, uint16_t *egress_ports,
+                       BmIpAddr *src) {
+  (void)src;
+  ROUTING_CB_CALLS++;
+  // Forward to the other port, only handle frames from port 1
+  *egress_ports |= ingress_port == 1 ? 0x2 : 0x1;
+  return ingress_port == 1;
+}
+
+static void rx_cb(uint64_t node_id, void *buf, uint32_t size) {
+  (void)node_id;
+  (void)buf;
+  (void)size;
+}
+
+/*!
+ @brief Link local routing decisions are cached per destination, source
+        and ingress port until an application or link change invalidates them
+ */
+TEST(Middleware, routing_cache) {
+  const BmIpAddr app_addr = {
+      {0xFF, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xAB, 0x01}};
+  const BmIpAddr other_addr = {
+      {0xFF, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xAB, 0x02}};
+  BmIpAddr src = {};
+  uint32_t hits, misses;
+  uint16_t egress;
+
+  bm_l2_register_link_local_routing_callback_fake.return_val = BmOK;
+  bm_l2_register_link_change_callback_fake.return_val = BmOK;
+  bm_middleware_init();
+  L2LinkLocalRoutingCb routing =
+      bm_l2_register_link_local_routing_callback_fake.arg0_val;
+  L2LinkChangeCb link_change = bm_l2_register_link_change_callback_fake.arg0_val;
+  ASSERT_NE(routing, nullptr);
+  ASSERT_NE(link_change, nullptr);
+
+  bm_udp_bind_port_fake.return_val = (void *)&src;
+  ASSERT_EQ(bm_middleware_add_application(1234, app_addr, rx_cb, routing_cb),
+            BmOK);
+
+  // First decision walks the applications, repeats come from the cache
+  for (uint8_t i = 0; i < 3; i++) {
+    egress = 0;
+    EXPECT_TRUE(routing(1, &egress, &src, &app_addr));
+    EXPECT_EQ(egress, 0x2);
+  }
+  EXPECT_EQ(ROUTING_CB_CALLS, 1);
+  bm_middleware_routing_cache_stats(&hits, &misses);
+  EXPECT_EQ(hits, 2);
+  EXPECT_EQ(misses, 1);
+
+  // Ingress port is part of the key
+  egress = 0;
+  EXPECT_FALSE(routing(2, &egress, &src, &app_addr));
+  EXPECT_EQ(egress, 0x1);
+  EXPECT_EQ(ROUTING_CB_CALLS, 2);
+
+  // So is the source, routing callbacks may decide by it
+  BmIpAddr other_src = src;
+  other_src.addr[15] = 0x42;
+  egress = 0;
+  EXPECT_TRUE(routing(1, &egress, &other_src, &app_addr));
+  EXPECT_EQ(egress, 0x2);
+  EXPECT_EQ(ROUTING_CB_CALLS, 3);
+  EXPECT_TRUE(routing(1, &egress, &other_src, &app_addr));
+  EXPECT_EQ(ROUTING_CB_CALLS, 3);
+
+  // No application for the destination, handled and not forwarded
+  egress = 0;
+  EXPECT_TRUE(routing(1, &egress, &src, &other_addr));
+  EXPECT_TRUE(routing(1, &egress, &src, &other_addr));
+  EXPECT_EQ(egress, 0);
+  EXPECT_EQ(ROUTING_CB_CALLS, 3);
+
+  // Link changes invalidate
+  link_change(1, false);
+  egress = 0;
+  EXPECT_TRUE(routing(1, &egress, &src, &app_addr));
+  EXPECT_EQ(egress, 0x2);
+  EXPECT_EQ(ROUTING_CB_CALLS, 4);
+
+  // So do new applications and explicit invalidation
+  ASSERT_EQ(bm_middleware_add_application(1235, other_addr, rx_cb, routing_cb),
+            BmOK);
+  egress = 0;
+  EXPECT_FALSE(routing(2, &egress, &src, &other_addr));
+  EXPECT_EQ(egress, 0x1);
+  EXPECT_EQ(ROUTING_CB_CALLS, 5);
+  bm_middleware_routing_cache_invalidate();
+  EXPECT_TRUE(routing(1, &egress, &src, &app_addr));
+  EXPECT_EQ(ROUTING_CB_CALLS, 6);
+}
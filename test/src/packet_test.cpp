@@ -2,6 +2,7 @@
 #include <helpers.hpp>
 #include <stddef.h>
 #include <string.h>
+#include <vector>
 
 #include "fff.h"
 
@@ -104,6 +105,9 @@ protected:
     };
     header.type = type;
     header.seq_num = seq_req;
+    // Not a fragment of a larger message
+    header.frag_total = 0;
+    header.frag_id = 0;
     memcpy(payload, (void *)&header, sizeof(BcmpHeader));
     memcpy((void *)(payload + sizeof(BcmpHeader)), data, sizeof(BcmpHeartbeat));
     return header;
@@ -334,3 +338,222 @@ TEST_F(Packet, fail_process_checksum) {
   ASSERT_EQ(process_received_message((void *)&data, sizeof(hb)), BmEBADMSG);
   ASSERT_EQ(bcmp_process_heartbeat_fake.call_count, 0);
 }
+
+static std::vector<uint8_t> reassembled;
+static BmErr capture_reassembled(BcmpProcessData data) {
+  reassembled.assign(data.payload, data.payload + data.size);
+  return BmOK;
+}
+
+class PacketFragment : public Packet {
+protected:
+  PacketTestData data;
+  BcmpHeader header;
+  std::vector<uint8_t> message;
+  BcmpReassemblyStats before;
+  // Each test starts past the timeout of whatever earlier tests left behind
+  static uint32_t now_ms;
+
+  void SetUp() override {
+    Packet::SetUp();
+    now_ms += bcmp_reassembly_timeout_ms + 1;
+    RESET_FAKE(bm_ticks_to_ms);
+    bm_ticks_to_ms_fake.return_val = now_ms;
+    bcmp_process_heartbeat_fake.custom_fake = capture_reassembled;
+    reassembled.clear();
+    packet_get_reassembly_stats(&before);
+
+    data.payload = test_payload;
+    RND.rnd_array((uint8_t *)data.src_addr, sizeof(data.src_addr));
+    RND.rnd_array((uint8_t *)data.dst_addr, sizeof(data.dst_addr));
+  }
+
+  // Heartbeat message type, so the registered process callback sees it
+  void new_message(uint32_t size, uint32_t seq_num) {
+    message.resize(size);
+    RND.rnd_array(message.data(), size);
+    memset(&header, 0, sizeof(header));
+    header.type = BcmpHeartbeatMessage;
+    header.seq_num = seq_num;
+    serialize_message_id(&header, message.data(), size);
+    header.frag_total = (size + bcmp_fragment_payload_len - 1) /
+                        bcmp_fragment_payload_len;
+  }
+
+  BmErr receive_fragment(uint8_t frag_id) {
+    const uint32_t offset = frag_id * bcmp_fragment_payload_len;
+    const uint32_t len =
+        std::min<uint32_t>(bcmp_fragment_payload_len, message.size() - offset);
+    header.frag_id = frag_id;
+    EXPECT_EQ(serialize_fragment(&data, &header, &message[offset], len), BmOK);
+    return process_received_message(&data, len);
+  }
+
+  BcmpReassemblyStats delta() {
+    BcmpReassemblyStats after;
+    packet_get_reassembly_stats(&after);
+    after.completed -= before.completed;
+    after.timed_out -= before.timed_out;
+    after.dropped -= before.dropped;
+    after.corrupt -= before.corrupt;
+    return after;
+  }
+};
+
+uint32_t PacketFragment::now_ms = 0;
+
+TEST_F(PacketFragment, reassembles_out_of_order) {
+  new_message(2 * bcmp_fragment_payload_len + 100, 7);
+  ASSERT_EQ(header.frag_total, 3);
+
+  EXPECT_EQ(receive_fragment(2), BmOK);
+  EXPECT_EQ(receive_fragment(0), BmOK);
+  // Duplicates are ignored
+  EXPECT_EQ(receive_fragment(0), BmOK);
+  EXPECT_EQ(bcmp_process_heartbeat_fake.call_count, 0);
+  EXPECT_EQ(receive_fragment(1), BmOK);
+
+  ASSERT_EQ(bcmp_process_heartbeat_fake.call_count, 1);
+  EXPECT_EQ(reassembled, message);
+  EXPECT_EQ(delta().completed, 1U);
+}
+
+TEST_F(PacketFragment, fragments_from_serialize_header) {
+  // The largest message fits in bcmp_max_fragments frames
+  new_message(bcmp_max_message_len, 0);
+  ASSERT_EQ(serialize_header(&header, message.data(), BcmpHeartbeatMessage, 0,
+                             NULL),
+            BmOK);
+  EXPECT_EQ(header.frag_total, 0);
+  serialize_message_id(&header, message.data(), message.size());
+  header.frag_total = bcmp_max_fragments;
+  for (uint8_t i = 0; i < bcmp_max_fragments; i++) {
+    EXPECT_EQ(receive_fragment(i), BmOK);
+  }
+  ASSERT_EQ(bcmp_process_heartbeat_fake.call_count, 1);
+  EXPECT_EQ(reassembled, message);
+}
+
+TEST_F(PacketFragment, incomplete_message_times_out) {
+  new_message(bcmp_fragment_payload_len + 1, 11);
+  EXPECT_EQ(receive_fragment(0), BmOK);
+
+  // The last fragment shows up too late, and starts over on its own
+  bm_ticks_to_ms_fake.return_val = now_ms + bcmp_reassembly_timeout_ms + 1;
+  EXPECT_EQ(receive_fragment(1), BmOK);
+  EXPECT_EQ(bcmp_process_heartbeat_fake.call_count, 0);
+  EXPECT_EQ(delta().timed_out, 1U);
+
+  // A resent first fragment completes the message in time
+  EXPECT_EQ(receive_fragment(0), BmOK);
+  ASSERT_EQ(bcmp_process_heartbeat_fake.call_count, 1);
+  EXPECT_EQ(reassembled, message);
+}
+
+TEST_F(PacketFragment, bounded_slots) {
+  // Every slot busy with a message missing its last fragment
+  new_message(bcmp_fragment_payload_len + 1, 100);
+  const BcmpHeader first_header = header;
+  const std::vector<uint8_t> first_message = message;
+  EXPECT_EQ(receive_fragment(0), BmOK);
+  for (uint32_t i = 1; i < bcmp_reassembly_slots; i++) {
+    new_message(bcmp_fragment_payload_len + 1, 100 + i);
+    EXPECT_EQ(receive_fragment(0), BmOK);
+  }
+  new_message(bcmp_fragment_payload_len + 1, 200);
+  EXPECT_EQ(receive_fragment(0), BmENOMEM);
+  EXPECT_EQ(delta().dropped, 1U);
+
+  // Finishing one frees its slot
+  const BcmpHeader last_header = header;
+  header = first_header;
+  message = first_message;
+  EXPECT_EQ(receive_fragment(1), BmOK);
+  EXPECT_EQ(reassembled, message);
+  header = last_header;
+  EXPECT_EQ(receive_fragment(0), BmOK);
+}
+
+TEST_F(PacketFragment, interleaved_unsequenced_messages) {
+  // Both messages have seq_num 0, only the message id tells them apart
+  new_message(2 * bcmp_fragment_payload_len + 10, 0);
+  const BcmpHeader first_header = header;
+  const std::vector<uint8_t> first_message = message;
+  new_message(2 * bcmp_fragment_payload_len + 10, 0);
+  const BcmpHeader second_header = header;
+  const std::vector<uint8_t> second_message = message;
+  ASSERT_NE(first_header.next_header, second_header.next_header);
+
+  for (uint8_t i = 0; i < first_header.frag_total; i++) {
+    header = first_header;
+    message = first_message;
+    EXPECT_EQ(receive_fragment(i), BmOK);
+    header = second_header;
+    message = second_message;
+    EXPECT_EQ(receive_fragment(i), BmOK);
+  }
+
+  EXPECT_EQ(bcmp_process_heartbeat_fake.call_count, 2);
+  EXPECT_EQ(delta().completed, 2U);
+  EXPECT_EQ(delta().corrupt, 0U);
+  EXPECT_EQ(reassembled, second_message);
+}
+
+TEST_F(PacketFragment, lost_fragment) {
+  new_message(2 * bcmp_fragment_payload_len + 10, 0);
+  EXPECT_EQ(receive_fragment(0), BmOK);
+  // Fragment 1 is lost on the way
+  EXPECT_EQ(receive_fragment(2), BmOK);
+
+  // The next message from the same sender does not pick up the stale parts
+  new_message(2 * bcmp_fragment_payload_len + 10, 0);
+  for (uint8_t i = 0; i < header.frag_total; i++) {
+    EXPECT_EQ(receive_fragment(i), BmOK);
+  }
+  ASSERT_EQ(bcmp_process_heartbeat_fake.call_count, 1);
+  EXPECT_EQ(reassembled, message);
+
+  // The incomplete message is dropped once it times out
+  bm_ticks_to_ms_fake.return_val = now_ms + bcmp_reassembly_timeout_ms + 1;
+  new_message(bcmp_fragment_payload_len + 1, 0);
+  EXPECT_EQ(receive_fragment(0), BmOK);
+  EXPECT_EQ(delta().timed_out, 1U);
+  EXPECT_EQ(delta().completed, 1U);
+  EXPECT_EQ(bcmp_process_heartbeat_fake.call_count, 1);
+}
+
+TEST_F(PacketFragment, corrupt_message) {
+  new_message(bcmp_fragment_payload_len + 100, 0);
+  // Damaged after the sender computed its CRC, every frame checksum passes
+  message[bcmp_fragment_payload_len + 50] ^= 0x01;
+  EXPECT_EQ(receive_fragment(0), BmOK);
+  EXPECT_EQ(receive_fragment(1), BmEBADMSG);
+
+  EXPECT_EQ(bcmp_process_heartbeat_fake.call_count, 0);
+  EXPECT_EQ(delta().corrupt, 1U);
+  EXPECT_EQ(delta().completed, 0U);
+}
+
+TEST_F(PacketFragment, malformed_fragments) {
+  new_message(2 * bcmp_fragment_payload_len, 300);
+
+  // Fragments but the last must be full
+  header.frag_id = 0;
+  ASSERT_EQ(serialize_fragment(&data, &header, message.data(), 100), BmOK);
+  EXPECT_EQ(process_received_message(&data, 100), BmEBADMSG);
+
+  // Fragment past the end of the message
+  header.frag_id = header.frag_total;
+  ASSERT_EQ(serialize_fragment(&data, &header, message.data(), 100), BmOK);
+  EXPECT_EQ(process_received_message(&data, 100), BmEBADMSG);
+
+  // More fragments than the largest message takes
+  header.frag_total = bcmp_max_fragments + 1;
+  header.frag_id = 0;
+  ASSERT_EQ(serialize_fragment(&data, &header, message.data(),
+                               bcmp_fragment_payload_len),
+            BmOK);
+  EXPECT_EQ(process_received_message(&data, bcmp_fragment_payload_len),
+            BmEBADMSG);
+  EXPECT_EQ(bcmp_process_heartbeat_fake.call_count, 0);
+}
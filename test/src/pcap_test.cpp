@@ -24,6 +24,7 @@ protected:
     s_captured.clear();
     RESET_FAKE(bm_get_tick_count);
     RESET_FAKE(bm_ticks_to_ms);
+    RESET_FAKE(bm_get_time_us);
   }
 };
 
@@ -52,9 +53,8 @@ TEST_F(Pcap, global_header) {
 
 // Verify a packet record has correct header fields and payload.
 TEST_F(Pcap, packet_record) {
-  // Configure tick stubs: 5500 ms elapsed.
-  bm_get_tick_count_fake.return_val = 42;
-  bm_ticks_to_ms_fake.return_val = 5500;
+  // 5.500123 s elapsed.
+  bm_get_time_us_fake.return_val = 5500123;
 
   pcap_init(capture_cb, nullptr);
   s_captured.clear(); // discard global header
@@ -71,8 +71,8 @@ TEST_F(Pcap, packet_record) {
   memcpy(&incl_len, &s_captured[8], 4);
   memcpy(&orig_len, &s_captured[12], 4);
 
-  EXPECT_EQ(ts_sec, 5u);       // 5500 / 1000
-  EXPECT_EQ(ts_usec, 500000u); // (5500 % 1000) * 1000
+  EXPECT_EQ(ts_sec, 5u);
+  EXPECT_EQ(ts_usec, 500123u);
   EXPECT_EQ(incl_len, sizeof(frame));
   EXPECT_EQ(orig_len, sizeof(frame));
 
@@ -99,3 +99,189 @@ TEST_F(Pcap, write_before_init) {
   // or from process start. Just verify no crash.
   pcap_write_packet(frame, sizeof(frame));
 }
+
+// Reads the little-endian 32-bit word at offset.
+static uint32_t word_at(size_t offset) {
+  uint32_t value;
+  memcpy(&value, &s_captured[offset], sizeof(value));
+  return value;
+}
+
+// Checks the Enhanced Packet Block at offset and returns its length.
+static size_t check_epb(size_t offset, uint32_t interface_id, uint64_t ts_us,
+                        const uint8_t *frame, uint32_t captured_len,
+                        uint32_t original_len, uint32_t flags) {
+  const uint32_t padded = (captured_len + 3) & ~3u;
+  const uint32_t total = 28 + padded + 16;
+  EXPECT_EQ(word_at(offset), 6u);
+  EXPECT_EQ(word_at(offset + 4), total);
+  EXPECT_EQ(word_at(offset + 8), interface_id);
+  EXPECT_EQ(word_at(offset + 12), (uint32_t)(ts_us >> 32));
+  EXPECT_EQ(word_at(offset + 16), (uint32_t)ts_us);
+  EXPECT_EQ(word_at(offset + 20), captured_len);
+  EXPECT_EQ(word_at(offset + 24), original_len);
+  EXPECT_EQ(memcmp(&s_captured[offset + 28], frame, captured_len), 0);
+  for (uint32_t i = captured_len; i < padded; i++) {
+    EXPECT_EQ(s_captured[offset + 28 + i], 0);
+  }
+  // epb_flags option, opt_endofopt, trailing block length
+  EXPECT_EQ(word_at(offset + 28 + padded), 0x00040002u);
+  EXPECT_EQ(word_at(offset + 32 + padded), flags);
+  EXPECT_EQ(word_at(offset + 36 + padded), 0u);
+  EXPECT_EQ(word_at(offset + 40 + padded), total);
+  return total;
+}
+
+// Section header followed by one interface per port.
+TEST_F(Pcap, pcapng_header) {
+  pcapng_init(capture_cb, nullptr, 2);
+
+  ASSERT_GE(s_captured.size(), 28u);
+  EXPECT_EQ(word_at(0), 0x0A0D0D0Au);
+  EXPECT_EQ(word_at(4), 28u);
+  EXPECT_EQ(word_at(8), 0x1A2B3C4Du);
+  EXPECT_EQ(word_at(12), 1u); // version 1.0
+  EXPECT_EQ(word_at(16), 0xFFFFFFFFu);
+  EXPECT_EQ(word_at(20), 0xFFFFFFFFu);
+  EXPECT_EQ(word_at(24), 28u);
+
+  size_t offset = 28;
+  for (uint8_t port = 1; port <= 2; port++) {
+    ASSERT_GE(s_captured.size(), offset + 16);
+    const uint32_t len = word_at(offset + 4);
+    ASSERT_EQ(s_captured.size() - offset >= len, true);
+    EXPECT_EQ(word_at(offset), 1u);
+    EXPECT_EQ(word_at(offset + 8), 1u); // LINKTYPE_ETHERNET
+    EXPECT_EQ(word_at(offset + 12), 65535u);
+    // if_name
+    EXPECT_EQ(word_at(offset + 16), 0x00050002u);
+    EXPECT_EQ(memcmp(&s_captured[offset + 20], port == 1 ? "port1" : "port2",
+                     5),
+              0);
+    // if_tsresol, microseconds
+    EXPECT_EQ(word_at(offset + 28), 0x00010009u);
+    EXPECT_EQ(s_captured[offset + 32], 6);
+    EXPECT_EQ(word_at(offset + 36), 0u);
+    EXPECT_EQ(word_at(offset + len - 4), len);
+    offset += len;
+  }
+  EXPECT_EQ(s_captured.size(), offset);
+}
+
+// Packets carry the port as interface ID, the direction as flags and a
+// 64-bit microsecond timestamp.
+TEST_F(Pcap, pcapng_packet) {
+  const uint64_t ts_us = 0x123456789ULL;
+  bm_get_time_us_fake.return_val = ts_us;
+  pcapng_init(capture_cb, nullptr, 2);
+  s_captured.clear();
+
+  const uint8_t frame[] = {0xDE, 0xAD, 0xBE, 0xEF, 0x01, 0x02};
+  pcapng_write_packet(frame, sizeof(frame), 2, PcapDirectionInbound);
+  size_t len = check_epb(0, 1, ts_us, frame, sizeof(frame), sizeof(frame), 1);
+  pcapng_write_packet(frame, 4, 1, PcapDirectionOutbound);
+  len += check_epb(len, 0, ts_us, frame, 4, 4, 2);
+  EXPECT_EQ(s_captured.size(), len);
+
+  // Unknown ports and directions are not written
+  pcapng_write_packet(frame, sizeof(frame), 0, PcapDirectionInbound);
+  pcapng_write_packet(frame, sizeof(frame), 3, PcapDirectionInbound);
+  pcapng_write_packet(frame, sizeof(frame), 1, PcapDirectionCount);
+  pcapng_write_packet(nullptr, sizeof(frame), 1, PcapDirectionInbound);
+  EXPECT_EQ(s_captured.size(), len);
+}
+
+// Async captures come out of the drain as the same blocks
+// pcapng_write_packet would have produced, in a single write per direction.
+TEST_F(Pcap, async_capture_and_drain) {
+  static uint32_t writes;
+  writes = 0;
+  bm_get_time_us_fake.return_val = 5500123;
+
+  ASSERT_EQ(pcap_async_init(
+                [](const uint8_t *data, size_t len, void *ctx) {
+                  writes++;
+                  capture_cb(data, len, ctx);
+                },
+                nullptr, 2),
+            BmOK);
+  EXPECT_EQ(bm_task_create_fake.call_count, 1u);
+  EXPECT_EQ(pcap_async_init(capture_cb, nullptr, 2), BmEALREADY);
+  s_captured.clear();
+  writes = 0;
+
+  // Nothing written until the ring is drained
+  const uint8_t frame[] = {0xDE, 0xAD, 0xBE, 0xEF, 0x01, 0x02};
+  for (uint8_t i = 0; i < 3; i++) {
+    pcap_async_capture(frame, sizeof(frame), 1, PcapDirectionInbound);
+  }
+  pcap_async_capture(frame, sizeof(frame), 2, PcapDirectionOutbound);
+  pcap_async_capture(frame, sizeof(frame), 1, PcapDirectionCount);
+  pcap_async_capture(frame, sizeof(frame), 3, PcapDirectionInbound);
+  pcap_async_capture(nullptr, sizeof(frame), 1, PcapDirectionInbound);
+  EXPECT_TRUE(s_captured.empty());
+
+  const size_t record_len = 28u + 8 + 16;
+  EXPECT_EQ(pcap_async_drain(), 4 * record_len);
+  EXPECT_EQ(writes, 2u);
+  ASSERT_EQ(s_captured.size(), 4 * record_len);
+  size_t offset = 0;
+  for (uint8_t i = 0; i < 3; i++) {
+    offset +=
+        check_epb(offset, 0, 5500123, frame, sizeof(frame), sizeof(frame), 1);
+  }
+  check_epb(offset, 1, 5500123, frame, sizeof(frame), sizeof(frame), 2);
+  EXPECT_EQ(pcap_async_drain(), 0u);
+
+  PcapAsyncStats stats;
+  pcap_async_get_stats(&stats);
+  EXPECT_EQ(stats.captured, 4u);
+  EXPECT_EQ(stats.dropped, 0u);
+
+  pcap_async_deinit();
+  RESET_FAKE(bm_task_create);
+}
+
+// A full ring drops and counts blocks, large frames are truncated to the
+// snap length and blocks wrapping around the end of the ring stay intact.
+TEST_F(Pcap, async_ring_full_and_wrap) {
+  ASSERT_EQ(pcap_async_init(capture_cb, nullptr, 2), BmOK);
+  s_captured.clear();
+
+  std::vector<uint8_t> frame(pcap_async_snap_len + 100);
+  for (size_t i = 0; i < frame.size(); i++) {
+    frame[i] = (uint8_t)i;
+  }
+  const size_t record_len = 28u + ((pcap_async_snap_len + 3) & ~3u) + 16;
+  const size_t fit = pcap_async_ring_size / record_len;
+  for (size_t i = 0; i < fit + 2; i++) {
+    pcap_async_capture(frame.data(), frame.size(), 1, PcapDirectionInbound);
+  }
+
+  PcapAsyncStats stats;
+  pcap_async_get_stats(&stats);
+  EXPECT_EQ(stats.captured, fit);
+  EXPECT_EQ(stats.dropped, 2u);
+
+  EXPECT_EQ(pcap_async_drain(), fit * record_len);
+  check_epb(0, 0, 0, frame.data(), pcap_async_snap_len, frame.size(), 1);
+
+  // Ring position is now mid buffer, the next blocks wrap around
+  s_captured.clear();
+  for (size_t i = 0; i < fit; i++) {
+    pcap_async_capture(frame.data(), 63, 2, PcapDirectionOutbound);
+    pcap_async_capture(frame.data(), frame.size(), 1, PcapDirectionInbound);
+  }
+  pcap_async_drain();
+  ASSERT_EQ(s_captured.size(), fit * record_len + fit * (28u + 64 + 16));
+  size_t offset = 0;
+  for (size_t i = 0; i < fit; i++) {
+    offset += check_epb(offset, 0, 0, frame.data(), pcap_async_snap_len,
+                        frame.size(), 1);
+  }
+  for (size_t i = 0; i < fit; i++) {
+    offset += check_epb(offset, 1, 0, frame.data(), 63, 63, 2);
+  }
+
+  pcap_async_deinit();
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <helpers.hpp>
 #include <string.h>
+#include <vector>
 
 #include "fff.h"
 
@@ -113,6 +114,8 @@ protected:
 
     data = (BmPubSubData *)bm_malloc(sizeof(BmPubSubData) + strlen(str) +
                                      array_size(buf));
+    // BmPubSubData ends in a flexible array, so clear it through bytes
+    memset((uint8_t *)data, 0, sizeof(BmPubSubData));
     data->topic_len = strlen(str);
     memcpy((void *)data->topic, str, strlen(str));
     bm_udp_get_payload_fake.return_val = data;
@@ -376,3 +379,205 @@ TEST_F(PubSub, utility) {
   ASSERT_EQ(bm_unsub(test_topic_1, sub_callback_2), BmOK);
   RESET_FAKE(bcmp_resource_discovery_add_resource);
 }
+
+// Frames handed to the middleware, played back to the receive path
+static std::vector<std::vector<uint8_t>> sent_frames;
+static void *udp_new_malloc(uint32_t size) { return bm_malloc(size); }
+static void *udp_payload_identity(void *buf) { return buf; }
+static void udp_cleanup_free(void *buf) { bm_free(buf); }
+static BmErr capture_net_tx(uint16_t port, void *buf, uint32_t size) {
+  (void)port;
+  sent_frames.emplace_back((uint8_t *)buf, (uint8_t *)buf + size);
+  return BmOK;
+}
+
+static std::vector<uint8_t> whole_message;
+static uint32_t whole_calls;
+static void whole_callback(uint64_t node_id, const char *topic,
+                           uint16_t topic_len, const uint8_t *data,
+                           uint16_t data_len, uint8_t type, uint8_t version) {
+  (void)node_id;
+  (void)topic;
+  (void)topic_len;
+  (void)type;
+  (void)version;
+  whole_message.assign(data, data + data_len);
+  whole_calls++;
+}
+
+static std::vector<uint8_t> chunked_message;
+static uint32_t chunk_calls;
+static uint32_t chunk_total_len;
+static void chunk_callback(uint64_t node_id, const char *topic,
+                           uint16_t topic_len, const uint8_t *data,
+                           uint16_t data_len, uint32_t offset,
+                           uint32_t total_len, uint8_t type, uint8_t version) {
+  (void)node_id;
+  (void)topic;
+  (void)topic_len;
+  (void)type;
+  (void)version;
+  if (chunked_message.size() < total_len) {
+    chunked_message.resize(total_len);
+  }
+  memcpy(&chunked_message[offset], data, data_len);
+  chunk_total_len = total_len;
+  chunk_calls++;
+}
+
+class PubSubStream : public PubSub {
+protected:
+  std::vector<uint8_t> message;
+
+  void SetUp() override {
+    PubSub::SetUp();
+    sent_frames.clear();
+    whole_message.clear();
+    chunked_message.clear();
+    whole_calls = 0;
+    chunk_calls = 0;
+    chunk_total_len = 0;
+    RESET_FAKE(bm_udp_new);
+    RESET_FAKE(bm_udp_get_payload);
+    RESET_FAKE(bm_udp_cleanup);
+    RESET_FAKE(bm_middleware_net_tx);
+    RESET_FAKE(bm_delay);
+    bm_udp_new_fake.custom_fake = udp_new_malloc;
+    bm_udp_get_payload_fake.custom_fake = udp_payload_identity;
+    bm_udp_cleanup_fake.custom_fake = udp_cleanup_free;
+    bm_middleware_net_tx_fake.custom_fake = capture_net_tx;
+    bcmp_resource_discovery_add_resource_fake.return_val = BmOK;
+  }
+
+  void TearDown() override {
+    RESET_FAKE(bm_udp_new);
+    RESET_FAKE(bm_udp_get_payload);
+    RESET_FAKE(bm_udp_cleanup);
+    RESET_FAKE(bm_middleware_net_tx);
+    RESET_FAKE(bcmp_resource_discovery_add_resource);
+  }
+
+  void new_message(uint32_t len) {
+    message.resize(len);
+    RND.rnd_array(message.data(), len);
+  }
+
+  void receive(const std::vector<uint8_t> &frame, uint64_t node_id = 1) {
+    bm_middleware_invoke_cb(4321, node_id, (void *)frame.data(),
+                            frame.size());
+  }
+};
+
+TEST_F(PubSubStream, segments_and_reassembles) {
+  const uint32_t len = 5000;
+  new_message(len);
+  ASSERT_EQ(bm_pub_stream(test_topic_0, message.data(), len, 1, 2), BmOK);
+
+  // Every segment fits one frame, paced apart
+  ASSERT_GT(sent_frames.size(), 3U);
+  for (const auto &frame : sent_frames) {
+    EXPECT_LE(frame.size(), (size_t)max_payload_len_udp);
+    EXPECT_TRUE(((BmPubSubData *)frame.data())->flags & BM_PUBSUB_FLAG_STREAM);
+  }
+  EXPECT_EQ(bm_delay_fake.call_count, sent_frames.size() - 1);
+
+  ASSERT_EQ(bm_sub(test_topic_0, whole_callback), BmOK);
+  ASSERT_EQ(bm_sub_stream(test_topic_0, chunk_callback), BmOK);
+  for (const auto &frame : sent_frames) {
+    receive(frame);
+  }
+
+  // One whole message, and one chunk per segment
+  EXPECT_EQ(whole_calls, 1U);
+  EXPECT_EQ(whole_message, message);
+  EXPECT_EQ(chunk_calls, sent_frames.size());
+  EXPECT_EQ(chunk_total_len, len);
+  EXPECT_EQ(chunked_message, message);
+
+  ASSERT_EQ(bm_unsub(test_topic_0, whole_callback), BmOK);
+  ASSERT_EQ(bm_unsub_stream(test_topic_0, chunk_callback), BmOK);
+  ASSERT_EQ(bm_unsub_stream(test_topic_0, chunk_callback), BmEINVAL);
+}
+
+TEST_F(PubSubStream, plain_messages_reach_chunked_subscribers) {
+  new_message(100);
+  ASSERT_EQ(bm_pub(test_topic_1, message.data(), 100, 0, 0), BmOK);
+  ASSERT_EQ(sent_frames.size(), 1U);
+
+  ASSERT_EQ(bm_sub_stream(test_topic_1, chunk_callback), BmOK);
+  receive(sent_frames[0]);
+  EXPECT_EQ(chunk_calls, 1U);
+  EXPECT_EQ(chunk_total_len, 100U);
+  EXPECT_EQ(chunked_message, message);
+  ASSERT_EQ(bm_unsub_stream(test_topic_1, chunk_callback), BmOK);
+}
+
+TEST_F(PubSubStream, lost_segment_drops_stream) {
+  new_message(4000);
+  ASSERT_EQ(bm_pub_stream(test_topic_0, message.data(), 4000, 0, 0), BmOK);
+  ASSERT_GE(sent_frames.size(), 3U);
+
+  ASSERT_EQ(bm_sub(test_topic_0, whole_callback), BmOK);
+  receive(sent_frames[0]);
+  receive(sent_frames[2]);
+  receive(sent_frames[1]);
+  for (size_t i = 3; i < sent_frames.size(); i++) {
+    receive(sent_frames[i]);
+  }
+  EXPECT_EQ(whole_calls, 0U);
+
+  // The next stream starts over cleanly
+  sent_frames.clear();
+  ASSERT_EQ(bm_pub_stream(test_topic_0, message.data(), 4000, 0, 0), BmOK);
+  for (const auto &frame : sent_frames) {
+    receive(frame);
+  }
+  EXPECT_EQ(whole_calls, 1U);
+  EXPECT_EQ(whole_message, message);
+  ASSERT_EQ(bm_unsub(test_topic_0, whole_callback), BmOK);
+}
+
+TEST_F(PubSubStream, receiver_memory_is_bounded) {
+  ASSERT_EQ(bm_sub(test_topic_0, whole_callback), BmOK);
+  ASSERT_EQ(bm_sub_stream(test_topic_0, chunk_callback), BmOK);
+
+  // Too large to reassemble, chunked subscribers still get all of it
+  new_message(BM_PUBSUB_STREAM_MAX_LEN + 1);
+  ASSERT_EQ(bm_pub_stream(test_topic_0, message.data(), message.size(), 0, 0),
+            BmOK);
+  for (const auto &frame : sent_frames) {
+    receive(frame);
+  }
+  EXPECT_EQ(whole_calls, 0U);
+  EXPECT_EQ(chunked_message, message);
+
+  // Interleaved streams from more senders than there are slots, the extra
+  // one isn't reassembled
+  sent_frames.clear();
+  new_message(3000);
+  ASSERT_EQ(bm_pub_stream(test_topic_0, message.data(), 3000, 0, 0), BmOK);
+  for (uint64_t node = 1; node <= BM_PUBSUB_STREAM_SLOTS + 1; node++) {
+    receive(sent_frames[0], node);
+  }
+  for (size_t i = 1; i < sent_frames.size(); i++) {
+    for (uint64_t node = 1; node <= BM_PUBSUB_STREAM_SLOTS + 1; node++) {
+      receive(sent_frames[i], node);
+    }
+  }
+  EXPECT_EQ(whole_calls, (uint32_t)BM_PUBSUB_STREAM_SLOTS);
+
+  ASSERT_EQ(bm_unsub(test_topic_0, whole_callback), BmOK);
+  ASSERT_EQ(bm_unsub_stream(test_topic_0, chunk_callback), BmOK);
+}
+
+TEST_F(PubSubStream, invalid_arguments) {
+  uint8_t data[8] = {0};
+  EXPECT_EQ(bm_pub_stream(NULL, data, sizeof(data), 0, 0), BmEINVAL);
+  EXPECT_EQ(bm_pub_stream(test_topic_0, NULL, sizeof(data), 0, 0), BmEINVAL);
+  EXPECT_EQ(bm_pub_stream(test_topic_0, data, 0, 0, 0), BmEINVAL);
+  EXPECT_EQ(bm_pub_stream_wl(test_topic_0, BM_TOPIC_MAX_LEN, data,
+                             sizeof(data), 0, 0),
+            BmEMSGSIZE);
+  EXPECT_EQ(bm_sub_stream(test_topic_0, NULL), BmEINVAL);
+  EXPECT_EQ(sent_frames.size(), 0U);
+}
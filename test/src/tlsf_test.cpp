@@ -0,0 +1,147 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "tlsf.h"
+}
+
+class Tlsf : public ::testing::Test {
+protected:
+  alignas(16) uint8_t pool[64 * 1024];
+  BmTlsf *tlsf;
+  void SetUp() override {
+    tlsf = bm_tlsf_create(pool, sizeof(pool));
+    ASSERT_NE(tlsf, nullptr);
+  }
+  BmHeapStats stats() {
+    BmHeapStats s;
+    bm_tlsf_stats(tlsf, &s);
+    return s;
+  }
+};
+
+TEST_F(Tlsf, create_rejects_small_regions) {
+  uint8_t small[32];
+  EXPECT_EQ(bm_tlsf_create(small, sizeof(small)), nullptr);
+  EXPECT_EQ(bm_tlsf_create(NULL, sizeof(pool)), nullptr);
+}
+
+TEST_F(Tlsf, empty_heap_is_one_free_block) {
+  BmHeapStats s = stats();
+  EXPECT_GT(s.total_bytes, 32U * 1024U);
+  EXPECT_LE(s.total_bytes, sizeof(pool));
+  EXPECT_EQ(s.live_bytes, 0U);
+  EXPECT_EQ(s.largest_free, s.total_bytes);
+}
+
+TEST_F(Tlsf, malloc_is_aligned_and_counted) {
+  void *a = bm_tlsf_malloc(tlsf, 1);
+  void *b = bm_tlsf_malloc(tlsf, 100);
+  void *c = bm_tlsf_malloc(tlsf, 5000);
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+  ASSERT_NE(c, nullptr);
+  EXPECT_EQ((uintptr_t)a % (2 * sizeof(void *)), 0U);
+  EXPECT_EQ((uintptr_t)b % (2 * sizeof(void *)), 0U);
+  EXPECT_EQ((uintptr_t)c % (2 * sizeof(void *)), 0U);
+
+  BmHeapStats s = stats();
+  EXPECT_GE(s.live_bytes, 5101U);
+  EXPECT_EQ(s.high_water, s.live_bytes);
+  EXPECT_EQ(s.alloc_count[0], 1U); // <= 16
+  EXPECT_EQ(s.alloc_count[3], 1U); // <= 128
+  EXPECT_EQ(s.alloc_count[bm_heap_size_classes - 1], 1U);
+
+  bm_tlsf_free(tlsf, b);
+  bm_tlsf_free(tlsf, a);
+  bm_tlsf_free(tlsf, c);
+  s = stats();
+  EXPECT_EQ(s.live_bytes, 0U);
+  EXPECT_GE(s.high_water, 5101U);
+  EXPECT_EQ(s.largest_free, s.total_bytes);
+}
+
+TEST_F(Tlsf, zero_and_oversized_requests) {
+  EXPECT_EQ(bm_tlsf_malloc(tlsf, 0), nullptr);
+  EXPECT_EQ(stats().failed, 0U);
+  EXPECT_EQ(bm_tlsf_malloc(tlsf, sizeof(pool)), nullptr);
+  EXPECT_EQ(bm_tlsf_malloc(tlsf, SIZE_MAX), nullptr);
+  EXPECT_EQ(stats().failed, 2U);
+  bm_tlsf_free(tlsf, NULL);
+}
+
+TEST_F(Tlsf, exhaustion_and_full_coalesce) {
+  std::vector<void *> blocks;
+  while (void *p = bm_tlsf_malloc(tlsf, 256)) {
+    blocks.push_back(p);
+  }
+  EXPECT_GT(blocks.size(), 100U);
+  EXPECT_EQ(stats().failed, 1U);
+
+  // Freeing every other block leaves only small holes
+  for (size_t i = 0; i < blocks.size(); i += 2) {
+    bm_tlsf_free(tlsf, blocks[i]);
+  }
+  BmHeapStats s = stats();
+  EXPECT_LT(s.largest_free, 1024U);
+  EXPECT_EQ(bm_tlsf_malloc(tlsf, 2048), nullptr);
+
+  // Freeing the rest merges everything back into one block
+  for (size_t i = 1; i < blocks.size(); i += 2) {
+    bm_tlsf_free(tlsf, blocks[i]);
+  }
+  s = stats();
+  EXPECT_EQ(s.live_bytes, 0U);
+  EXPECT_EQ(s.largest_free, s.total_bytes);
+}
+
+TEST_F(Tlsf, double_free_is_ignored) {
+  void *a = bm_tlsf_malloc(tlsf, 64);
+  void *b = bm_tlsf_malloc(tlsf, 64);
+  bm_tlsf_free(tlsf, a);
+  bm_tlsf_free(tlsf, a);
+  bm_tlsf_free(tlsf, b);
+  BmHeapStats s = stats();
+  EXPECT_EQ(s.live_bytes, 0U);
+  EXPECT_EQ(s.largest_free, s.total_bytes);
+}
+
+TEST_F(Tlsf, random_workload_keeps_blocks_intact) {
+  struct Live {
+    uint8_t *ptr;
+    size_t size;
+    uint8_t fill;
+  };
+  std::vector<Live> live;
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<size_t> size(1, 2000);
+
+  for (int i = 0; i < 20000; i++) {
+    if (!live.empty() && (rng() % 2 || live.size() > 40)) {
+      size_t n = rng() % live.size();
+      for (size_t b = 0; b < live[n].size; b++) {
+        ASSERT_EQ(live[n].ptr[b], live[n].fill);
+      }
+      bm_tlsf_free(tlsf, live[n].ptr);
+      live[n] = live.back();
+      live.pop_back();
+    } else {
+      Live l = {NULL, size(rng), (uint8_t)i};
+      l.ptr = (uint8_t *)bm_tlsf_malloc(tlsf, l.size);
+      if (l.ptr) {
+        ASSERT_GE(l.ptr, pool);
+        ASSERT_LE(l.ptr + l.size, pool + sizeof(pool));
+        memset(l.ptr, l.fill, l.size);
+        live.push_back(l);
+      }
+    }
+  }
+  for (Live &l : live) {
+    bm_tlsf_free(tlsf, l.ptr);
+  }
+  BmHeapStats s = stats();
+  EXPECT_EQ(s.live_bytes, 0U);
+  EXPECT_EQ(s.largest_free, s.total_bytes);
+}
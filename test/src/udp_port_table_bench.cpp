@@ -0,0 +1,65 @@
+#include <bench.hpp>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+
+extern "C" {
+#include "ll.h"
+#include "udp_port_table.h"
+}
+
+// Port table against the linked list the IP stacks searched per datagram
+// before, as the number of bound ports grows
+
+typedef struct {
+  UdpPortCb cb;
+} ListCb;
+
+static BmErr rx_cb(uint16_t, void *, uint64_t, uint32_t) { return BmOK; }
+
+TEST(UdpPortTableBench, bound_ports) {
+  const uint32_t counts[] = {1, 2, 4, 8, 16, udp_port_table_max_ports};
+  const uint32_t iterations = 1000000;
+
+  for (uint32_t count : counts) {
+    UdpPortTable table;
+    LL list;
+    memset(&table, 0, sizeof(table));
+    memset(&list, 0, sizeof(list));
+    for (uint32_t i = 0; i < count; i++) {
+      const uint16_t port = (uint16_t)(2222 + i * 7);
+      ASSERT_EQ(udp_port_table_add(&table, port, rx_cb), BmOK);
+      ListCb item = {rx_cb};
+      ASSERT_EQ(ll_item_add(&list, ll_create_item(NULL, &item, sizeof(item),
+                                                  port)),
+                BmOK);
+    }
+
+    // Look up the last bound port, the worst case for the list
+    const uint16_t port = (uint16_t)(2222 + (count - 1) * 7);
+    volatile UdpPortCb sink = NULL;
+    const double table_ns = ns_per_call(
+        [&] { sink = udp_port_table_find(&table, port); }, iterations);
+    const double list_ns = ns_per_call(
+        [&] {
+          ListCb *item = NULL;
+          ll_get_item(&list, port, (void **)&item);
+          sink = item->cb;
+        },
+        iterations);
+    EXPECT_EQ(udp_port_table_find(&table, port), rx_cb);
+    bench_report("%2u ports %6.1f ns table %6.1f ns list", count, table_ns,
+                 list_ns);
+    (void)sink;
+
+    LLItem *item = list.head;
+    while (item) {
+      LLItem *next = item->next;
+      ll_delete_item(item);
+      item = next;
+    }
+  }
+}
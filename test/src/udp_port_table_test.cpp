@@ -0,0 +1,129 @@
+#include <atomic>
+#include <gtest/gtest.h>
+#include <helpers.hpp>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+
+extern "C" {
+#include "udp_port_table.h"
+}
+
+static BmErr cb_a(uint16_t, void *, uint64_t, uint32_t) { return BmOK; }
+static BmErr cb_b(uint16_t, void *, uint64_t, uint32_t) { return BmOK; }
+
+class UdpPortTableTest : public ::testing::Test {
+protected:
+  UdpPortTable table;
+
+  void SetUp() override { memset(&table, 0, sizeof(table)); }
+};
+
+TEST_F(UdpPortTableTest, add_and_find) {
+  EXPECT_EQ(udp_port_table_find(&table, 2222), nullptr);
+  EXPECT_EQ(udp_port_table_add(&table, 2222, cb_a), BmOK);
+  EXPECT_EQ(udp_port_table_add(&table, 4321, cb_b), BmOK);
+  EXPECT_EQ(udp_port_table_find(&table, 2222), cb_a);
+  EXPECT_EQ(udp_port_table_find(&table, 4321), cb_b);
+  EXPECT_EQ(udp_port_table_find(&table, 2223), nullptr);
+  EXPECT_EQ(table.count, 2U);
+
+  // A port is bound once, the first binding stays
+  EXPECT_EQ(udp_port_table_add(&table, 2222, cb_b), BmEALREADY);
+  EXPECT_EQ(udp_port_table_find(&table, 2222), cb_a);
+  EXPECT_EQ(table.count, 2U);
+}
+
+TEST_F(UdpPortTableTest, invalid_arguments) {
+  EXPECT_EQ(udp_port_table_add(NULL, 2222, cb_a), BmEINVAL);
+  EXPECT_EQ(udp_port_table_add(&table, 0, cb_a), BmEINVAL);
+  EXPECT_EQ(udp_port_table_add(&table, 2222, NULL), BmEINVAL);
+  EXPECT_EQ(udp_port_table_find(NULL, 2222), nullptr);
+  // Port 0 marks empty slots and never matches
+  EXPECT_EQ(udp_port_table_find(&table, 0), nullptr);
+  EXPECT_EQ(table.count, 0U);
+}
+
+TEST_F(UdpPortTableTest, colliding_ports_probe) {
+  // Ports a multiple of 2^16 / size apart collide often under the hash, any
+  // set of ports has to stay reachable
+  std::vector<uint16_t> ports;
+  for (uint32_t i = 0; i < udp_port_table_max_ports; i++) {
+    ports.push_back((uint16_t)(1 + i * (65536 / udp_port_table_size)));
+  }
+  for (uint16_t port : ports) {
+    ASSERT_EQ(udp_port_table_add(&table, port, cb_a), BmOK) << port;
+  }
+  for (uint16_t port : ports) {
+    EXPECT_EQ(udp_port_table_find(&table, port), cb_a) << port;
+    EXPECT_EQ(udp_port_table_find(&table, port + 1), nullptr) << port;
+  }
+}
+
+TEST_F(UdpPortTableTest, full_table) {
+  rnd_gen RND;
+  std::vector<uint16_t> ports;
+  while (ports.size() < udp_port_table_max_ports) {
+    uint16_t port = 0;
+    RND.rnd_array((uint8_t *)&port, sizeof(port));
+    if (port && udp_port_table_find(&table, port) == nullptr) {
+      ASSERT_EQ(udp_port_table_add(&table, port, cb_b), BmOK);
+      ports.push_back(port);
+    }
+  }
+  EXPECT_EQ(table.count, udp_port_table_max_ports);
+
+  uint16_t extra = 1;
+  while (udp_port_table_find(&table, extra)) {
+    extra++;
+  }
+  EXPECT_EQ(udp_port_table_add(&table, extra, cb_b), BmENOMEM);
+  EXPECT_EQ(table.count, udp_port_table_max_ports);
+  for (uint16_t port : ports) {
+    EXPECT_EQ(udp_port_table_find(&table, port), cb_b);
+  }
+}
+
+TEST_F(UdpPortTableTest, concurrent_bind_and_lookup) {
+  // One thread binds while another keeps looking ports up, a port is either
+  // not found yet or found with its callback
+  std::atomic<bool> done(false);
+  uint32_t bad = 0;
+  std::thread reader([&] {
+    while (!done.load()) {
+      for (uint16_t port = 1000; port < 1000 + udp_port_table_max_ports;
+           port++) {
+        UdpPortCb cb = udp_port_table_find(&table, port);
+        if (cb != nullptr && cb != cb_a) {
+          bad++;
+        }
+      }
+    }
+  });
+  std::thread writers[2];
+  uint32_t added[2] = {0, 0};
+  for (int w = 0; w < 2; w++) {
+    writers[w] = std::thread([&, w] {
+      // Both writers race for the same ports, each is bound exactly once
+      for (uint16_t port = 1000; port < 1000 + udp_port_table_max_ports;
+           port++) {
+        if (udp_port_table_add(&table, port, cb_a) == BmOK) {
+          added[w]++;
+        }
+      }
+    });
+  }
+  for (auto &writer : writers) {
+    writer.join();
+  }
+  done.store(true);
+  reader.join();
+
+  EXPECT_EQ(bad, 0U);
+  EXPECT_EQ(added[0] + added[1], udp_port_table_max_ports);
+  EXPECT_EQ(table.count, udp_port_table_max_ports);
+}
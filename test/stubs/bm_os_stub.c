@@ -32,6 +32,9 @@ DEFINE_FAKE_VOID_FUNC(bm_delay, uint32_t);
 DEFINE_FAKE_VALUE_FUNC(uint32_t, bm_get_tick_count);
 DEFINE_FAKE_VALUE_FUNC(uint32_t, bm_ms_to_ticks, uint32_t);
 DEFINE_FAKE_VALUE_FUNC(uint32_t, bm_ticks_to_ms, uint32_t);
+DEFINE_FAKE_VALUE_FUNC(uint64_t, bm_get_time_us);
+DEFINE_FAKE_VALUE_FUNC(uint64_t, bm_get_time_ns);
+DEFINE_FAKE_VALUE_FUNC(BmErr, bm_heap_stats, BmHeapStats *);
 DEFINE_FAKE_VALUE_FUNC(BmTimer, bm_timer_create, const char *, uint32_t, bool,
                        void *, BmTimerCb);
 DEFINE_FAKE_VOID_FUNC(bm_timer_delete, BmTimer, uint32_t);
@@ -45,6 +48,8 @@ DEFINE_FAKE_VALUE_FUNC(uint32_t, bm_timer_get_id, BmTimer);
 DEFINE_FAKE_VALUE_FUNC(BmQueue, bm_queue_create, uint32_t, uint32_t);
 DEFINE_FAKE_VOID_FUNC(bm_queue_delete, BmQueue);
 DEFINE_FAKE_VALUE_FUNC(BmErr, bm_queue_receive, BmQueue, void *, uint32_t);
+DEFINE_FAKE_VALUE_FUNC(BmErr, bm_queue_receive_many, BmQueue, void *, uint32_t,
+                       uint32_t *, uint32_t);
 DEFINE_FAKE_VALUE_FUNC(BmErr, bm_queue_send, BmQueue, const void *, uint32_t);
 DEFINE_FAKE_VALUE_FUNC(BmErr, bm_queue_send_to_front_from_isr, BmQueue,
                        const void *);
@@ -5,6 +5,8 @@ DEFINE_FAKE_VOID_FUNC(bm_l2_deinit)
 DEFINE_FAKE_VALUE_FUNC(BmErr, bm_l2_init, NetworkDevice);
 DEFINE_FAKE_VALUE_FUNC(BmErr, bm_l2_register_link_change_callback,
                        L2LinkChangeCb);
+DEFINE_FAKE_VALUE_FUNC(BmErr, bm_l2_register_link_local_routing_callback,
+                       L2LinkLocalRoutingCb);
 DEFINE_FAKE_VALUE_FUNC(bool, bm_l2_get_port_state, uint8_t);
 DEFINE_FAKE_VALUE_FUNC(BmErr, bm_l2_netif_set_power, bool);
 DEFINE_FAKE_VALUE_FUNC(BmErr, bm_l2_netif_enable_disable_port, uint8_t, bool);
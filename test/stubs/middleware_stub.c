@@ -5,6 +5,7 @@ DEFINE_FAKE_VALUE_FUNC(BmErr, bm_middleware_rx, uint16_t, void *, uint64_t,
                        uint32_t);
 DEFINE_FAKE_VALUE_FUNC(BmErr, bm_middleware_init);
 DEFINE_FAKE_VALUE_FUNC(BmErr, bm_middleware_net_tx, uint16_t, void *, uint32_t);
+DEFINE_FAKE_VOID_FUNC(bm_middleware_routing_cache_invalidate);
 
 static LL applications;
 
@@ -15,6 +15,12 @@ DEFINE_FAKE_VALUE_FUNC(uint16_t, packet_checksum, void *, uint32_t);
 DEFINE_FAKE_VALUE_FUNC(BmErr, process_received_message, void *, uint32_t);
 DEFINE_FAKE_VALUE_FUNC(BmErr, serialize, void *, void *, uint32_t,
                        BcmpMessageType, uint32_t, BcmpSequencedRequestCb);
+DEFINE_FAKE_VALUE_FUNC(BmErr, serialize_header, BcmpHeader *, void *,
+                       BcmpMessageType, uint32_t, BcmpSequencedRequestCb);
+DEFINE_FAKE_VALUE_FUNC(BmErr, serialize_fragment, void *, const BcmpHeader *,
+                       const void *, uint32_t);
+DEFINE_FAKE_VOID_FUNC(serialize_message_id, BcmpHeader *, const void *,
+                      uint32_t);
 DEFINE_FAKE_VALUE_FUNC(BmErr, packet_remove, BcmpMessageType);
 
 /*!